@@ -0,0 +1,66 @@
+/*  =========================================================================
+    zarena - Bump allocator for transient strings
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZARENA_H_INCLUDED
+#define ZARENA_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Create a new zarena. Memory is taken from the system in blocks of at
+//  least block_size bytes, 0 uses a default.
+ZLOG_EXPORT zarena_t *
+    zarena_new (size_t block_size);
+
+//  Destroy the zarena and all memory allocated from it
+ZLOG_EXPORT void
+    zarena_destroy (zarena_t **self_p);
+
+//  Allocate size bytes aligned for any type. The memory is valid until the
+//  next reset and must not be freed.
+ZLOG_EXPORT void *
+    zarena_alloc (zarena_t *self, size_t size);
+
+//  Copy a string into the arena
+ZLOG_EXPORT char *
+    zarena_strdup (zarena_t *self, const char *string);
+
+//  Copy at most size bytes of a string into the arena, always terminated
+ZLOG_EXPORT char *
+    zarena_strndup (zarena_t *self, const char *string, size_t size);
+
+//  Format a string into the arena
+ZLOG_EXPORT char *
+    zarena_sprintf (zarena_t *self, const char *format, ...);
+
+//  Release all allocations at once. If the last round needed more than one
+//  block, the blocks are merged into one for the next round.
+ZLOG_EXPORT void
+    zarena_reset (zarena_t *self);
+
+//  Returns the number of bytes allocated since the last reset
+ZLOG_EXPORT size_t
+    zarena_used (zarena_t *self);
+
+//  Self test of this class
+ZLOG_EXPORT void
+    zarena_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
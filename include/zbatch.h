@@ -0,0 +1,75 @@
+/*  =========================================================================
+    zbatch - Columnar batch of log lines for collect messages
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZBATCH_H_INCLUDED
+#define ZBATCH_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Create a new zbatch
+ZLOG_EXPORT zbatch_t *
+    zbatch_new (void);
+
+//  Destroy the zbatch
+ZLOG_EXPORT void
+    zbatch_destroy (zbatch_t **self_p);
+
+//  Adds a log line to the batch
+ZLOG_EXPORT void
+    zbatch_add (zbatch_t *self, const char *line);
+
+//  Returns the number of lines added, or left to decode
+ZLOG_EXPORT size_t
+    zbatch_size (zbatch_t *self);
+
+//  Returns the bytes of the lines added as text, with a newline each
+ZLOG_EXPORT size_t
+    zbatch_bytes (zbatch_t *self);
+
+//  Encodes the lines added into a frame and empties the batch. Caller owns
+//  the frame.
+ZLOG_EXPORT zframe_t *
+    zbatch_encode (zbatch_t *self);
+
+//  Returns true if the frame holds a batch, false if it's a plain line
+ZLOG_EXPORT bool
+    zbatch_is (zframe_t *frame);
+
+//  Creates a zbatch to decode the lines of frame, NULL if it isn't a batch.
+//  The frame is copied.
+ZLOG_EXPORT zbatch_t *
+    zbatch_decode (zframe_t *frame);
+
+//  Returns the next line of a decoded batch, NULL if there are no lines
+//  left or the batch is malformed. The line is valid until the next call.
+ZLOG_EXPORT const char *
+    zbatch_next (zbatch_t *self);
+
+//  Returns the timestamp of the line last returned by zbatch_next, 0 if it
+//  has none
+ZLOG_EXPORT uint64_t
+    zbatch_timestamp (zbatch_t *self);
+
+//  Self test of this class
+ZLOG_EXPORT void
+    zbatch_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+/*  =========================================================================
+    zbinlog - Binary causal log with deferred formatting
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZBINLOG_H_INCLUDED
+#define ZBINLOG_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Create a new zbinlog
+ZLOG_EXPORT zbinlog_t *
+    zbinlog_new (void);
+
+//  Destroy the zbinlog, records not yet saved are lost
+ZLOG_EXPORT void
+    zbinlog_destroy (zbinlog_t **self_p);
+
+//  Registers a printf format string and returns its id, or -1 if it has
+//  a conversion which isn't supported. The format is only parsed here.
+//  Registering the same string again returns its id, formats are told
+//  apart by their address.
+ZLOG_EXPORT int
+    zbinlog_register (zbinlog_t *self, const char *format);
+
+//  Returns the format string registered with id, NULL if there is none.
+ZLOG_EXPORT const char *
+    zbinlog_format (zbinlog_t *self, int format_id);
+
+//  Records a log entry of a registered format with its raw arguments and
+//  events the clock, like zvector_info does.
+ZLOG_EXPORT void
+    zbinlog_log (zbinlog_t *self, zvector_t *clock, int format_id, ...);
+
+//  Returns the bytes of records not yet saved
+ZLOG_EXPORT size_t
+    zbinlog_size (zbinlog_t *self);
+
+//  Appends the records to the file at path and clears the buffer. All
+//  saves of a zbinlog must go to the same file. Returns 0 on success, -1
+//  if the file can't be written.
+ZLOG_EXPORT int
+    zbinlog_save (zbinlog_t *self, const char *path);
+
+//  Decodes the binary log at source filepath into text lines at destination
+//  filepath, stamped with the vector clock like lines of zvector_info. A
+//  truncated last record is skipped. Returns the number of decoded entries
+//  or -1 if a file can't be opened.
+ZLOG_EXPORT int
+    zbinlog_decode (const char *path_src, const char *path_dst);
+
+//  Self test of this class
+ZLOG_EXPORT void
+    zbinlog_test (bool verbose);
+
+//  @end
+
+//  Records a log entry, the format must be a string literal. It is
+//  registered with the binlog on first use and looked up afterwards.
+#define ZBINLOG(binlog, clock, format, ...) \
+    zbinlog_log ((binlog), (clock), zbinlog_register ((binlog), (format)), ##__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+/*  =========================================================================
+    zbloom - Implements a bloom clock
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZBLOOM_H_INCLUDED
+#define ZBLOOM_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Create a new zbloom with size cells, hashes cells are incremented per
+//  event. 0 takes the defaults, 64 cells and 3 hashes.
+ZLOG_EXPORT zbloom_t *
+    zbloom_new (const char *pid, size_t size, size_t hashes);
+
+//  Destroy the zbloom
+ZLOG_EXPORT void
+    zbloom_destroy (zbloom_t **self_p);
+
+//  Duplicates the given zbloom, returns a freshly allocated duplicate.
+ZLOG_EXPORT zbloom_t *
+    zbloom_dup (zbloom_t *self);
+
+//  Increments the own clock value
+ZLOG_EXPORT void
+    zbloom_event (zbloom_t *self);
+
+//  Eventing own clock & packing the cells with given msg
+ZLOG_EXPORT zmsg_t *
+    zbloom_send_prepare (zbloom_t *self, zmsg_t *msg);
+
+//  Recv the cells & updates own clock. Malformed clocks and clocks of a
+//  different size are ignored.
+ZLOG_EXPORT void
+    zbloom_recv (zbloom_t *self, zmsg_t *msg);
+
+//  Compares zbloom self to zbloom other.
+//  Returns -1 at probably happened before other, 0 at parallel, 1 at
+//  probably happened after and 2 when clocks are the same. Clocks of a
+//  different size are parallel.
+ZLOG_EXPORT int
+    zbloom_compare_to (zbloom_t *self, zbloom_t *other);
+
+//  Returns the probability that self happened before other is a false
+//  positive, i.e. that the events of self which other hasn't seen are
+//  covered by the events other has seen beyond self. Returns 0 if self
+//  isn't reported to happen before other.
+ZLOG_EXPORT double
+    zbloom_false_positive (zbloom_t *self, zbloom_t *other);
+
+//  Converts the zbloom into string representation
+ZLOG_EXPORT char *
+    zbloom_to_string (zbloom_t *self);
+
+//  Creates an anonymous zbloom from a given string representation. Returns
+//  NULL if the string is malformed.
+ZLOG_EXPORT zbloom_t *
+    zbloom_from_string (const char *clock_string);
+
+//  Self test of this class
+ZLOG_EXPORT void
+    zbloom_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+/*  =========================================================================
+    zdeps - Rebuilds vector clocks from direct dependencies
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZDEPS_H_INCLUDED
+#define ZDEPS_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Create a new zdeps
+ZLOG_EXPORT zdeps_t *
+    zdeps_new (void);
+
+//  Destroy the zdeps
+ZLOG_EXPORT void
+    zdeps_destroy (zdeps_t **self_p);
+
+//  Adds a log line with a direct dependency record. The lines of a process
+//  must be added in order. Returns 0 if the line was taken, -1 if it has no
+//  valid record.
+ZLOG_EXPORT int
+    zdeps_add (zdeps_t *self, const char *logmsg);
+
+//  Returns the next line whose clock could be rebuilt, the record replaced
+//  by the full vector clock. Returns NULL if no line is complete yet.
+//  Caller owns the line.
+ZLOG_EXPORT char *
+    zdeps_next (zdeps_t *self);
+
+//  Returns the next line like zdeps_next, but rebuilds it even if records
+//  it depends on are missing. Their dependencies are left out of the
+//  clock. Returns NULL if there are no lines left. Caller owns the line.
+ZLOG_EXPORT char *
+    zdeps_flush (zdeps_t *self);
+
+//  Marks pid as departed, no more records of it will be added. Records
+//  waiting for its later records are rebuilt from what is known.
+ZLOG_EXPORT void
+    zdeps_retire (zdeps_t *self, const char *pid);
+
+//  Returns the bytes of the lines not yet returned
+ZLOG_EXPORT size_t
+    zdeps_pending (zdeps_t *self);
+
+//  Returns copies of the lines not yet returned as they were added, in the
+//  order of each process. Caller owns the list.
+ZLOG_EXPORT zlistx_t *
+    zdeps_pending_lines (zdeps_t *self);
+
+//  Reads the log of source filepath and writes it to destination filepath
+//  with the direct dependency records replaced by full vector clocks.
+//  Lines without a record are copied as they are. Returns the number of
+//  rebuilt lines.
+ZLOG_EXPORT size_t
+    zdeps_rebuild_log (const char *path_src, const char *path_dst);
+
+//  Self test of this class
+ZLOG_EXPORT void
+    zdeps_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,6 +26,10 @@ typedef void (zecho_process_fn) (
 //  Create custom INFORM or COLLECT messages content
 typedef zmsg_t * (zecho_create_fn) (
     zecho_t *self, void *handler);
+//  Combine the COLLECT messages content acc and msg into one. Takes ownership
+//  of both messages and returns the combined message.
+typedef zmsg_t * (zecho_reduce_fn) (
+    zecho_t *self, zmsg_t *acc, zmsg_t *msg, void *handler);
 
 //  Create a new zecho
 ZLOG_EXPORT zecho_t *
@@ -35,14 +39,35 @@ ZLOG_EXPORT zecho_t *
 ZLOG_EXPORT void
     zecho_destroy (zecho_t **self_p);
 
-//  Initiate the echo algorithm
-ZLOG_EXPORT void
+//  Initiate the echo algorithm. Returns the id of the new wave. Several waves
+//  may be in progress at the same time.
+ZLOG_EXPORT const char *
     zecho_init (zecho_t *self);
 
-//  Handle a received echo token
+//  Handle a received echo token. Returns 1 if the token's wave is concluded
+//  on this node, 0 if the wave is still in progress and -1 if the token
+//  belongs to an unknown or expired wave.
 ZLOG_EXPORT int
     zecho_recv (zecho_t *self, zyre_event_t *token);
 
+//  Get the id of the last initiated or handled wave
+ZLOG_EXPORT const char *
+    zecho_wave_id (zecho_t *self);
+
+//  Returns the number of waves currently in progress on this node.
+ZLOG_EXPORT size_t
+    zecho_waves (zecho_t *self);
+
+//  Set the maximum number of waves tracked concurrently. If more waves are
+//  started the least recently active one is dropped. Default is 16.
+ZLOG_EXPORT void
+    zecho_set_max_waves (zecho_t *self, size_t max_waves);
+
+//  Set the time in msecs after which a wave without any received tokens is
+//  dropped. Default is 30000.
+ZLOG_EXPORT void
+    zecho_set_wave_timeout (zecho_t *self, int64_t wave_timeout);
+
 //  Sets a handler which is passed to custom collect functions.
 ZLOG_EXPORT void
     zecho_set_collect_handler (zecho_t *self, void *handler);
@@ -58,6 +83,48 @@ ZLOG_EXPORT void
 ZLOG_EXPORT void
     zecho_set_collect_create (zecho_t *self, zecho_create_fn *collect_fn);
 
+//  Enable/disable reuse of the spanning tree of the last INFORM flood for
+//  subsequent waves. Default is enabled.
+ZLOG_EXPORT void
+    zecho_set_tree_reuse (zecho_t *self, bool tree_reuse);
+
+//  Drop the cached spanning tree; Must be called whenever the membership of
+//  the node's groups changes. The next wave will flood again.
+ZLOG_EXPORT void
+    zecho_reset_tree (zecho_t *self);
+
+//  Returns true if a spanning tree is cached.
+ZLOG_EXPORT bool
+    zecho_has_tree (zecho_t *self);
+
+//  Set a user-defined function to combine collect messages; If set, collect
+//  messages of children are reduced together with the own collect message
+//  before they are sent to the father. The initiator passes the final result
+//  of each wave to the collect process function once.
+ZLOG_EXPORT void
+    zecho_set_collect_reduce (zecho_t *self, zecho_reduce_fn *reduce_fn);
+
+//  Built-in reduce function; Sums up the values of equal keys. Messages
+//  consist of key/value frame pairs with decimal values, e.g. lines logged
+//  per node or histogram buckets.
+ZLOG_EXPORT zmsg_t *
+    zecho_reduce_sum (zecho_t *self, zmsg_t *acc, zmsg_t *msg, void *handler);
+
+//  Built-in reduce function; Keeps the minimum value of equal keys. Messages
+//  consist of key/value frame pairs with decimal values.
+ZLOG_EXPORT zmsg_t *
+    zecho_reduce_min (zecho_t *self, zmsg_t *acc, zmsg_t *msg, void *handler);
+
+//  Built-in reduce function; Keeps the maximum value of equal keys, e.g. the
+//  max clock per pid. Messages consist of key/value frame pairs with decimal
+//  values.
+ZLOG_EXPORT zmsg_t *
+    zecho_reduce_max (zecho_t *self, zmsg_t *acc, zmsg_t *msg, void *handler);
+
+//  Built-in reduce function; Builds the deduplicated set of all frames.
+ZLOG_EXPORT zmsg_t *
+    zecho_reduce_union (zecho_t *self, zmsg_t *acc, zmsg_t *msg, void *handler);
+
 //  Sets a handler which is passed to custom inform functions.
 ZLOG_EXPORT void
     zecho_set_inform_handler (zecho_t *self, void *handler);
@@ -78,10 +145,23 @@ ZLOG_EXPORT void
 ZLOG_EXPORT void
     zecho_set_clock (zecho_t *self, zvector_t *clock);
 
+//  Set a hybrid logical clock handle. If not NULL echo messages will be
+//  prepended with its timestamp instead of the vector.
+ZLOG_EXPORT void
+    zecho_set_hlc (zecho_t *self, zhlc_t *hlc);
+
+//  Set a metrics handle. Sent echo messages are counted if not NULL.
+ZLOG_EXPORT void
+    zecho_set_metrics (zecho_t *self, zmetrics_t *metrics);
+
 //  Enable/disable verbose logging.
 ZLOG_EXPORT void
     zecho_set_verbose (zecho_t *self, bool verbose);
 
+//  Print echo status to command line
+ZLOG_EXPORT void
+    zecho_print (zecho_t *self);
+
 //  Self test of this class
 ZLOG_EXPORT void
     zecho_test (bool verbose);
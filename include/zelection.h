@@ -26,12 +26,21 @@ ZLOG_EXPORT zelection_t *
 ZLOG_EXPORT void
     zelection_destroy (zelection_t **self_p);
 
-//  Initiate election
+//  Initiate election. May be called again to re-elect after membership
+//  changed, the outcome of a previous election is dropped. If this node
+//  already takes part in the wave of a smaller initiator nothing is sent.
+//  Every call starts a new round, tokens of earlier rounds are ignored.
 ZLOG_EXPORT void
     zelection_start (zelection_t *self);
 
+//  A peer left. If it initiated the active wave, the wave never concludes
+//  and would block every later start, it is dropped.
+ZLOG_EXPORT void
+    zelection_peer_left (zelection_t *self, const char *peer);
+
 //  Handle received election and leader messages. Return 1 if election is
 //  still in progress, 0 if election is concluded and -1 is an error occurred.
+//  Tokens of a replaced or already finished round are ignored and return 1.
 ZLOG_EXPORT int
     zelection_recv (zelection_t *self, zyre_event_t *event);
 
@@ -52,6 +61,15 @@ ZLOG_EXPORT bool
 ZLOG_EXPORT void
     zelection_set_clock (zelection_t *self, zvector_t *clock);
 
+//  Set a hybrid logical clock handle. If not NULL election messages will be
+//  prepended with its timestamp instead of the vector.
+ZLOG_EXPORT void
+    zelection_set_hlc (zelection_t *self, zhlc_t *hlc);
+
+//  Set a metrics handle. Sent election messages are counted if not NULL.
+ZLOG_EXPORT void
+    zelection_set_metrics (zelection_t *self, zmetrics_t *metrics);
+
 //  Enable/disable verbose logging.
 ZLOG_EXPORT void
     zelection_set_verbose (zelection_t *self, bool verbose);
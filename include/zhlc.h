@@ -0,0 +1,76 @@
+/*  =========================================================================
+    zhlc - Implements a hybrid logical clock
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZHLC_H_INCLUDED
+#define ZHLC_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Create a new zhlc
+ZLOG_EXPORT zhlc_t *
+    zhlc_new (const char *pid);
+
+//  Destroy the zhlc
+ZLOG_EXPORT void
+    zhlc_destroy (zhlc_t **self_p);
+
+//  Piggyback the vector clock on every nth sent message, 0 disables the
+//  sample. Received samples are merged into the vector clock. The vector
+//  clock is not owned.
+ZLOG_EXPORT void
+    zhlc_set_sample (zhlc_t *self, zvector_t *clock, size_t every);
+
+//  Advances the clock for a local event
+ZLOG_EXPORT void
+    zhlc_event (zhlc_t *self);
+
+//  Eventing own clock & packing the timestamp with given msg
+ZLOG_EXPORT zmsg_t *
+    zhlc_send_prepare (zhlc_t *self, zmsg_t *msg);
+
+//  Recv the timestamp & updates own clock
+ZLOG_EXPORT void
+    zhlc_recv (zhlc_t *self, zmsg_t *msg);
+
+//  Returns the timestamp, physical time in ms in the upper 48 bits and a
+//  logical counter in the lower 16 bits.
+ZLOG_EXPORT uint64_t
+    zhlc_value (zhlc_t *self);
+
+//  Converts the zhlc into string representation
+ZLOG_EXPORT char *
+    zhlc_to_string (zhlc_t *self);
+
+//  Parses the timestamp of a string representation into value and the
+//  own pid into pid if not NULL. Returns 0 on success, -1 if the string
+//  isn't a zhlc.
+ZLOG_EXPORT int
+    zhlc_parse (const char *clock_string, uint64_t *value, char *pid, size_t pid_max);
+
+//  Log informational message - low priority. Prepends the current HLC.
+ZLOG_EXPORT void
+    zhlc_info (zhlc_t *self, const char *format, ...);
+
+//  Self test of this class
+ZLOG_EXPORT void
+    zhlc_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+/*  =========================================================================
+    zitc - Implements an interval tree clock
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZITC_H_INCLUDED
+#define ZITC_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Create the seed zitc, it owns the whole id space
+ZLOG_EXPORT zitc_t *
+    zitc_new (void);
+
+//  Destroy the zitc
+ZLOG_EXPORT void
+    zitc_destroy (zitc_t **self_p);
+
+//  Split the id of self in two. Self keeps one half, the returned zitc gets
+//  the other, e.g. for a joining process.
+ZLOG_EXPORT zitc_t *
+    zitc_fork (zitc_t *self);
+
+//  Merge other into self, e.g. when a process leaves. Self takes over the
+//  id of other and other is destroyed.
+ZLOG_EXPORT void
+    zitc_join (zitc_t *self, zitc_t **other_p);
+
+//  Returns an anonymous copy of self, it has the events but no id
+ZLOG_EXPORT zitc_t *
+    zitc_peek (zitc_t *self);
+
+//  Duplicates the given zitc, returns a freshly allocated duplicate.
+ZLOG_EXPORT zitc_t *
+    zitc_dup (zitc_t *self);
+
+//  Increments the own clock value
+ZLOG_EXPORT void
+    zitc_event (zitc_t *self);
+
+//  Eventing own clock & packing the events with given msg
+ZLOG_EXPORT zmsg_t *
+    zitc_send_prepare (zitc_t *self, zmsg_t *msg);
+
+//  Recv the events & updates own clock
+ZLOG_EXPORT void
+    zitc_recv (zitc_t *self, zmsg_t *msg);
+
+//  Compares zitc self to zitc other.
+//  Returns -1 at happened before other, 0 at parallel, 1 at happened after
+//  and 2 when clocks are the same
+ZLOG_EXPORT int
+    zitc_compare_to (zitc_t *self, zitc_t *other);
+
+//  Converts the zitc into string representation
+ZLOG_EXPORT char *
+    zitc_to_string (zitc_t *self);
+
+//  Creates a zitc from a given string representation. Returns NULL if the
+//  string is malformed.
+ZLOG_EXPORT zitc_t *
+    zitc_from_string (const char *clock_string);
+
+//  Self test of this class
+ZLOG_EXPORT void
+    zitc_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -19,6 +19,13 @@ extern "C" {
 
 
 //  @interface
+//  Opcodes of binary pipe commands
+#define ZLOG_CMD_SEND_RANDOM    1   //  Send batch of content/owner pairs
+#define ZLOG_CMD_INFO           2   //  Log batch of entries
+#define ZLOG_CMD_BATCH          3   //  Deliver received messages in batches
+#define ZLOG_CMD_DELIVER        4   //  Batch of received content/owner pairs
+#define ZLOG_CMD_MAX            32  //  Opcodes are below this value
+
 //  Create new zlog actor instance.
 //  @TODO: Describe the purpose of this actor!
 //
@@ -40,6 +47,161 @@ extern "C" {
 //
 //      zstr_sendx (zlog, "STOP", NULL);
 //
+//  The election of the leader starts once no peer entered, joined or left
+//  for a quiet period, every later membership change elects again. Set the
+//  quiet period in ms, default is 250:
+//
+//      zstr_sendx (zlog, "STARTUP QUIET", "500", NULL);
+//
+//  Start the first election as soon as this many peers joined, without
+//  waiting for the quiet period. 0 disables it, the default.
+//
+//      zstr_sendx (zlog, "EXPECTED PEERS", "2", NULL);
+//
+//  Wait until the election of this node concluded. Replies with a signal
+//  0 once it did, 1 if there were no peers to elect with, or 2 if it didn't
+//  conclude within the optional timeout in ms, default is 10000.
+//
+//      zstr_sendx (zlog, "READY", "5000", NULL);
+//      int rc = zsock_wait (zlog);
+//
+//  Select the clock stamped on messages and log entries before START. All
+//  nodes must use the same mode. "VC" is a vector clock, the default. "HLC"
+//  is a hybrid logical clock with a constant size of 8 bytes on the wire,
+//  the ordered log is totally ordered by its timestamps. Optionally the
+//  vector clock is piggybacked on every nth message for causal checks.
+//  An HLC entry is stable once every process which sent entries has sent
+//  one with a higher timestamp.
+//
+//      zstr_sendx (zlog, "CLOCK MODE", "HLC", "16", NULL);
+//
+//  "DD" tracks direct dependencies only: messages carry the sender's pid
+//  and counter, log entries the messages received since the previous
+//  entry. The leader rebuilds the vector clocks of the entries before it
+//  orders them. An entry waits until the entries it depends on arrived,
+//  its bytes count towards ORDERED LOG MAX.
+//
+//      zstr_sendx (zlog, "CLOCK MODE", "DD", NULL);
+//
+//  Set the interval between two collect waves of the leader in ms. Takes
+//  effect when the next election is won. Default is 5000.
+//
+//      zstr_sendx (zlog, "COLLECT INTERVAL", "1000", NULL);
+//
+//  Limit the bytes of not yet stable ordered log entries the leader holds
+//  in memory. Beyond the limit the oldest entries are written out even if
+//  entries they depend on are still missing. 0 is unlimited, default is
+//  64 MiB. Stable entries are always written out and evicted.
+//
+//      zstr_sendx (zlog, "ORDERED LOG MAX", "1048576", NULL);
+//
+//  Limit the bytes of collected log entries a peer holds in memory, more
+//  are spilled to disk. It also limits the bytes forwarded per collect
+//  wave. 0 is unlimited, default is 16 MiB.
+//
+//      zstr_sendx (zlog, "COLLECT LOG MAX", "1048576", NULL);
+//
+//  Set the prefix of the ordered log files, default is ./ordered_log, and
+//  the directory of the vc_<uuid>.log files to collect, default is /tmp.
+//  Every term of a leader writes its own file <prefix>.<uuid>.<term>, the
+//  lines collected after a term ended are ordered by the next leader. The
+//  files of all nodes together hold each line once, concatenate them and
+//  order them with zlog_order_log () for the complete ordered log.
+//
+//      zstr_sendx (zlog, "ORDERED LOG", "/var/lib/zlog/ordered_log", NULL);
+//      zstr_sendx (zlog, "LOG DIR", "/var/log/zlog", NULL);
+//
+//  Checkpoint the state of the actor to a file every interval ms and when
+//  it's destroyed, before START. If the file exists the actor resumes from
+//  it first: the clock follows every event of the previous incarnations,
+//  whose logs are collected from the first line the leader didn't
+//  acknowledge, and a leader keeps its frontiers. A restart ends the term
+//  of a leader, the file of the term is completed after the stable prefix
+//  of the checkpoint with the entries which weren't stable yet, they are
+//  kept in <file>.tail.0 or <file>.tail.1. A leader acknowledges only the
+//  lines of its last checkpoint, the interval should stay well below the
+//  retransmit timeout of the peers.
+//
+//      zstr_sendx (zlog, "CHECKPOINT", "/var/lib/zlog.checkpoint", "1000", NULL);
+//
+//  Select the CLOCK MODE, ORDERED LOG and LOG DIR first. The clock of the
+//  previous incarnation is merged in the selected mode: vector clocks as a
+//  whole, "DD" records as a dependency on the last entry and "HLC"
+//  timestamps by moving the HLC past them.
+//
+//  Query the vector clock of the actor:
+//
+//      zstr_send (zlog, "CLOCK");
+//      char *command, *clock;
+//      zstr_recvx (zlog, &command, &clock, NULL);
+//
+//  Query the status of the actor. The reply carries the current leader
+//  (empty if none), the number of collect waves concluded by this node and
+//  the number of entries it ordered as strings. The last two frames hold the
+//  latencies in usecs of concluded collect waves and of log entries until
+//  they were ordered, as arrays of int64_t. Latencies are reset with every
+//  query.
+//
+//      zstr_send (zlog, "STATUS");
+//      zmsg_t *status = zmsg_recv (zlog);
+//      //  [STATUS][leader][waves][entries][wave latencies][entry latencies]
+//
+//  Query the metrics of the actor. The reply carries a JSON object with
+//  messages and bytes sent and received per type (ZLE, ZECHO, BAKERY),
+//  clock bytes on the wire, collect wave duration and lines per wave,
+//  the ordered log size and the time spent in each handler. clock.entries
+//  is the number of pids in the vector clock. When a peer exits, every
+//  node shouts the last clock value of it that it saw to the GLOBAL group.
+//  Once all live peers have reported, the peer is pruned from the clock
+//  and counted in clock.pruned. clock.deps_pending are the bytes of "DD"
+//  entries waiting for the entries they depend on. Log entries are
+//  forwarded as columnar batches, collect.text_bytes and
+//  collect.batch_bytes are their bytes before and after encoding. Log
+//  lines are numbered per node, the leader acknowledges them with the
+//  next collect wave and drops lines it already has. Lines carry how many
+//  lines of their node were acknowledged, a new leader continues from
+//  there and drops lines after a gap. Nodes send lines again
+//  once none was acknowledged for 30 s, relays drop lines they already
+//  spooled: collect.unacked, collect.retransmitted, collect.duplicates and
+//  collect.out_of_order count them.
+//  collect.resumed are the logs of previous incarnations not yet
+//  collected completely. election.started counts the elections this node
+//  started. A leader which loses a re-election ends its term and writes
+//  out its ordered log, counted in ordered_log.drained.
+//
+//      zstr_send (zlog, "STATS");
+//      char *command, *stats;
+//      zstr_recvx (zlog, &command, &stats, NULL);
+//
+//  Dump the metrics to the log every interval ms, 0 disables the dump:
+//
+//      zstr_sendx (zlog, "STATS INTERVAL", "10000", NULL);
+//
+//  Write the actor's trace events to path in Chrome trace format, replies
+//  with a signal 0 on success. Requires a build with ZLOG_TRACE:
+//
+//      zstr_sendx (zlog, "TRACE", "trace.json", NULL);
+//      zsock_wait (zlog);
+//
+//  Send content to a random peer, owner is optional:
+//
+//      zstr_sendx (zlog, "SEND RANDOM", content, owner, NULL);
+//
+//  Binary commands start with a single opcode byte frame and carry a batch
+//  of requests in the following frames:
+//
+//      byte opcode = ZLOG_CMD_SEND_RANDOM;
+//      zmsg_t *batch = zmsg_new ();
+//      zmsg_addmem (batch, &opcode, 1);
+//      zmsg_addstr (batch, content);   //  Repeat content/owner pairs,
+//      zmsg_addstr (batch, owner);     //  an empty owner is own uuid
+//      zmsg_send (&batch, zlog);
+//
+//  ZLOG_CMD_INFO logs every following frame as one entry. ZLOG_CMD_BATCH
+//  switches the delivery of received messages to batches: instead of one
+//  [content][owner] message per received message, the actor sends
+//  [ZLOG_CMD_DELIVER][content][owner]... messages.
+//
 //  This is the zlog constructor as a zactor_fn;
 ZLOG_EXPORT void
     zlog_actor (zsock_t *pipe, void *args);
@@ -49,6 +211,12 @@ ZLOG_EXPORT void
 ZLOG_EXPORT int
     zlog_compare_log_msg_vc (const char *logMsg_a, const char *logMsg_b);
 
+//  Compares the hybrid logical clocks of given logMsg a to logMsg b, ties
+//  are broken by pid. Messages without HLC sort first.
+//  Returns -1 if a < b, otherwiese 1
+ZLOG_EXPORT int
+    zlog_compare_log_msg_hlc (const char *logMsg_a, const char *logMsg_b);
+
 //  Compares the timestamps's of given logMsg a to logMsg b.
 //  Returns -1 if a < b, otherwiese 1
 ZLOG_EXPORT int
@@ -78,6 +78,22 @@ typedef struct _selection_t selection_t;
 #define SELECTION_T_DEFINED
 typedef struct _zlog_t zlog_t;
 #define ZLOG_T_DEFINED
+typedef struct _zmetrics_t zmetrics_t;
+#define ZMETRICS_T_DEFINED
+typedef struct _zarena_t zarena_t;
+#define ZARENA_T_DEFINED
+typedef struct _zhlc_t zhlc_t;
+#define ZHLC_T_DEFINED
+typedef struct _zitc_t zitc_t;
+#define ZITC_T_DEFINED
+typedef struct _zdeps_t zdeps_t;
+#define ZDEPS_T_DEFINED
+typedef struct _zbloom_t zbloom_t;
+#define ZBLOOM_T_DEFINED
+typedef struct _zbinlog_t zbinlog_t;
+#define ZBINLOG_T_DEFINED
+typedef struct _zbatch_t zbatch_t;
+#define ZBATCH_T_DEFINED
 #endif // ZLOG_BUILD_DRAFT_API
 
 
@@ -88,6 +104,14 @@ typedef struct _zlog_t zlog_t;
 #include "zelection.h"
 #include "selection.h"
 #include "zlog.h"
+#include "zmetrics.h"
+#include "zarena.h"
+#include "zhlc.h"
+#include "zitc.h"
+#include "zdeps.h"
+#include "zbloom.h"
+#include "zbinlog.h"
+#include "zbatch.h"
 #endif // ZLOG_BUILD_DRAFT_API
 
 #ifdef ZLOG_BUILD_DRAFT_API
@@ -0,0 +1,82 @@
+/*  =========================================================================
+    zmetrics - Counters, gauges and histograms
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZMETRICS_H_INCLUDED
+#define ZMETRICS_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Create a new zmetrics
+ZLOG_EXPORT zmetrics_t *
+    zmetrics_new (void);
+
+//  Destroy the zmetrics
+ZLOG_EXPORT void
+    zmetrics_destroy (zmetrics_t **self_p);
+
+//  Returns the handle of the counter name, creating the counter at 0.
+//  Resolve handles once, updates by handle don't look up the name.
+ZLOG_EXPORT size_t
+    zmetrics_counter (zmetrics_t *self, const char *name);
+
+//  Returns the handle of the gauge name, creating the gauge at 0
+ZLOG_EXPORT size_t
+    zmetrics_gauge (zmetrics_t *self, const char *name);
+
+//  Returns the handle of the histogram name, creating the histogram empty.
+//  Its buckets are powers of two.
+ZLOG_EXPORT size_t
+    zmetrics_histogram (zmetrics_t *self, const char *name);
+
+//  Add value to a counter
+ZLOG_EXPORT void
+    zmetrics_count (zmetrics_t *self, size_t metric, uint64_t value);
+
+//  Set a gauge to value
+ZLOG_EXPORT void
+    zmetrics_set (zmetrics_t *self, size_t metric, int64_t value);
+
+//  Record value in a histogram
+ZLOG_EXPORT void
+    zmetrics_observe (zmetrics_t *self, size_t metric, uint64_t value);
+
+//  Returns the value of a counter or gauge, or the sum of a histogram
+ZLOG_EXPORT int64_t
+    zmetrics_value (zmetrics_t *self, size_t metric);
+
+//  Returns the number of values recorded in a histogram
+ZLOG_EXPORT uint64_t
+    zmetrics_observations (zmetrics_t *self, size_t metric);
+
+//  Returns all metrics as JSON object sorted by name. Histograms report
+//  count, sum, min, max and estimated percentiles. Caller owns the string.
+ZLOG_EXPORT char *
+    zmetrics_to_json (zmetrics_t *self);
+
+//  Print all metrics for debug purposes
+ZLOG_EXPORT void
+    zmetrics_print (zmetrics_t *self);
+
+//  Self test of this class
+ZLOG_EXPORT void
+    zmetrics_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
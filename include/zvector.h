@@ -18,6 +18,13 @@ extern "C" {
 #endif
 
 //  @interface
+//  A clock entry parsed in place, see zvector_parse
+typedef struct {
+    const char *pid;            //  Not null terminated
+    size_t pid_size;
+    unsigned long value;
+} zvector_entry_t;
+
 //  Create a new zvector
 ZLOG_EXPORT zvector_t *
     zvector_new (const char* pid);
@@ -26,6 +33,22 @@ ZLOG_EXPORT zvector_t *
 ZLOG_EXPORT void
     zvector_destroy (zvector_t **self_p);
 
+//  Take transient strings from arena instead of the heap. The caller owns
+//  the arena and resets it after strings returned by this class are freed.
+ZLOG_EXPORT void
+    zvector_set_arena (zvector_t *self, zarena_t *arena);
+
+//  Track direct dependencies only. Sent messages carry the own pid and
+//  counter instead of the whole clock and log records list the messages
+//  received since the previous record. The full clocks are rebuilt from
+//  the records by zdeps. Received whole clocks are still merged.
+ZLOG_EXPORT void
+    zvector_set_direct (zvector_t *self, bool direct);
+
+//  Increments the own clock value
+ZLOG_EXPORT void
+    zvector_event (zvector_t *self);
+
 //  Eventing own clock & packing vectorclock with given msg
 ZLOG_EXPORT zmsg_t *
     zvector_send_prepare (zvector_t *self, zmsg_t *msg);
@@ -42,10 +65,30 @@ ZLOG_EXPORT char *
 ZLOG_EXPORT char *
     zvector_to_string_short (zvector_t *self, uint8_t pid_length);
 
-//  Creates a zvector from a given string representation
+//  Creates a zvector from a given string representation. Returns NULL if
+//  the string is malformed.
 ZLOG_EXPORT zvector_t *
     zvector_from_string (char *clock_string);
 
+//  Parses a string representation without allocating. The clock ends at
+//  size, a null or a '/', so it can be parsed inside a log line. Pids point
+//  into clock_string and are not terminated. Writes the own pid and value
+//  into own and at most entries_max entries into entries. Returns the
+//  number of entries of the clock, which may exceed entries_max, or -1 if
+//  it is malformed.
+ZLOG_EXPORT int
+    zvector_parse (const char *clock_string, size_t size, zvector_entry_t *own,
+                   zvector_entry_t *entries, size_t entries_max);
+
+//  Compares two clocks in string representation like zvector_compare_to,
+//  without creating them. The clocks end at a null or a '/'. Returns -2 if
+//  one of them is malformed.
+ZLOG_EXPORT int
+    zvector_compare_strings (const char *clock_a, const char *clock_b);
+
+//  Writes the space-time diagram of this process to <pid>.sdot. States
+//  are named <pid>:<own counter>, so the dumps of all processes can be
+//  concatenated into one graph.
 ZLOG_EXPORT void
     zvector_dump_time_space (zvector_t *self);
 
@@ -55,6 +98,27 @@ ZLOG_EXPORT void
 ZLOG_EXPORT int
     zvector_compare_to (zvector_t *zv_self, zvector_t *zv_other);
 
+//  Returns the clock value of pid, 0 if pid is unknown
+ZLOG_EXPORT unsigned long
+    zvector_value (zvector_t *self, const char *pid);
+
+//  Returns the number of pids in the clock
+ZLOG_EXPORT size_t
+    zvector_size (zvector_t *self);
+
+//  Returns a number which changes whenever the value of a pid other than
+//  the own one changes. While it stays the same, the clock only differs in
+//  the own value.
+ZLOG_EXPORT uint64_t
+    zvector_generation (zvector_t *self);
+
+//  Removes a departed pid from the clock. Values up to final received later
+//  are ignored, so messages still in flight don't add it again. Call it
+//  once every live process has seen the final value of pid. The own pid
+//  can't be pruned.
+ZLOG_EXPORT void
+    zvector_prune (zvector_t *self, const char *pid, unsigned long final);
+
 //  Log informational message - low priority. Prepends the current VC.
 ZLOG_EXPORT void
     zvector_info (zvector_t *self, char *format, ...);
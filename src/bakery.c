@@ -19,6 +19,26 @@
 
 #include "zlog_classes.h"
 
+//  Create a binary command message for the zlog actor
+
+static zmsg_t *
+s_batch_new (byte opcode)
+{
+    zmsg_t *batch = zmsg_new ();
+    zmsg_addmem (batch, &opcode, 1);
+    return batch;
+}
+
+//  Returns true if the frame's content starts with prefix
+
+static bool
+s_frame_startswith (zframe_t *frame, const char *prefix)
+{
+    size_t prefix_size = strlen (prefix);
+    return zframe_size (frame) >= prefix_size
+        && memcmp (zframe_data (frame), prefix, prefix_size) == 0;
+}
+
 int main (int argc, char *argv [])
 {
     bool verbose = false;
@@ -84,9 +104,19 @@ int main (int argc, char *argv [])
     if (dump_ts)
         zstr_send (zlog, "DUMP TS");
 
+    //  Receive messages in batches
+    zmsg_t *batch = s_batch_new (ZLOG_CMD_BATCH);
+    zmsg_send (&batch, zlog);
+
     zstr_send (zlog, "START");
-    //  Give time to interconnect and elect
-    zclock_sleep (750);
+    //  Wait until discovery settled and the leader is elected
+    zstr_send (zlog, "READY");
+    int ready = zsock_wait (zlog);
+    if (ready == 1)
+        zsys_warning ("bakery - no peers found, baking alone");
+    else
+    if (ready == 2)
+        zsys_warning ("bakery - no leader elected yet, baking anyway");
 
     int64_t time = zclock_mono ();
     waittime *= 1000;
@@ -97,23 +127,30 @@ int main (int argc, char *argv [])
     while (zclock_mono () - time < waittime) {
         zmsg_t *msg = zmsg_recv_nowait (zlog);
         if (msg) {
-            char *content = zmsg_popstr (msg);
-            char *owner = zmsg_popstr (msg);
-            if (strncmp (content, "STIRRED", 6) == 0) {
-                zstr_sendm (zlog, "SEND RANDOM");
-                zstr_sendm (zlog, "BAKED");
-                zstr_send (zlog, owner);
+            //  Answer all received messages with a single batch
+            zmsg_t *replies = NULL;
+            zframe_t *opcode = zmsg_first (msg);
+            assert (zframe_size (opcode) == 1 && zframe_data (opcode) [0] == ZLOG_CMD_DELIVER);
+            zframe_t *content = zmsg_next (msg);
+            while (content) {
+                zframe_t *owner = zmsg_next (msg);
+                const char *reply = NULL;
+                if (s_frame_startswith (content, "STIRRED"))
+                    reply = "BAKED";
+                else
+                if (s_frame_startswith (content, "BAKED"))
+                    reply = "EATEN";
 
+                if (reply) {
+                    if (!replies)
+                        replies = s_batch_new (ZLOG_CMD_SEND_RANDOM);
+                    zmsg_addstr (replies, reply);
+                    zmsg_addmem (replies, zframe_data (owner), zframe_size (owner));
+                }
+                content = zmsg_next (msg);
             }
-            else
-            if (strncmp (content, "BAKED", 5) == 0) {
-                zstr_sendm (zlog, "SEND RANDOM");
-                zstr_sendm (zlog, "EATEN");
-                zstr_send (zlog, owner);
-            }
-
-            zstr_free (&content);
-            zstr_free (&owner);
+            if (replies)
+                zmsg_send (&replies, zlog);
             zmsg_destroy (&msg);
         }
         /*zclock_sleep (100);*/
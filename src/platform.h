@@ -0,0 +1,6 @@
+
+#define HAVE_LINUX_WIRELESS_H
+#define HAVE_NET_IF_H
+/* #undef HAVE_NET_IF_MEDIA_H */
+#define HAVE_GETIFADDRS
+#define HAVE_FREEIFADDRS
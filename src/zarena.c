@@ -0,0 +1,266 @@
+/*  =========================================================================
+    zarena - Bump allocator for transient strings
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zarena - Bump allocator for transient strings
+@discuss
+    Handling a single message allocates many short lived strings which are
+    all freed before the handler returns. An arena hands them out by bumping
+    a pointer in a block and releases all of them at once with a reset.
+    Allocations which don't fit into the current block get a new block. A
+    reset merges the blocks of the last round into one, so after warming up
+    a round is served from a single block without touching the system
+    allocator.
+@end
+*/
+
+#include "zlog_classes.h"
+
+#define ZARENA_BLOCK_SIZE 4096
+#define ZARENA_ALIGNMENT 16
+
+typedef struct _block_t block_t;
+
+struct _block_t {
+    block_t *next;              //  Previously filled block
+    size_t size;                //  Usable bytes in data
+    size_t used;                //  Bytes handed out
+    //  Keep data aligned for any type
+    union {
+        long double ld;
+        void *p;
+        int64_t i;
+    } data [];
+};
+
+//  Structure of our class
+
+struct _zarena_t {
+    block_t *block;             //  Current block, older blocks are chained
+    size_t block_size;          //  Minimum size of new blocks
+    size_t used;                //  Bytes handed out since the last reset
+};
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+static block_t *
+s_block_new (size_t size, block_t *next)
+{
+    block_t *block = (block_t *) malloc (sizeof (block_t) + size);
+    assert (block);
+    block->next = next;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+static void
+s_blocks_destroy (block_t *block)
+{
+    while (block) {
+        block_t *next = block->next;
+        free (block);
+        block = next;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new zarena. Memory is taken from the system in blocks of at
+//  least block_size bytes, 0 uses a default.
+
+zarena_t *
+zarena_new (size_t block_size)
+{
+    zarena_t *self = (zarena_t *) zmalloc (sizeof (zarena_t));
+    assert (self);
+    //  Initialize class properties here
+    self->block_size = block_size? block_size: ZARENA_BLOCK_SIZE;
+    self->block = s_block_new (self->block_size, NULL);
+    self->used = 0;
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the zarena and all memory allocated from it
+
+void
+zarena_destroy (zarena_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zarena_t *self = *self_p;
+        //  Free class properties here
+        s_blocks_destroy (self->block);
+        //  Free object itself
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Allocate size bytes aligned for any type. The memory is valid until the
+//  next reset and must not be freed.
+
+void *
+zarena_alloc (zarena_t *self, size_t size)
+{
+    assert (self);
+    size = (size + ZARENA_ALIGNMENT - 1) & ~((size_t) ZARENA_ALIGNMENT - 1);
+    block_t *block = self->block;
+    if (block->size - block->used < size) {
+        size_t block_size = size > self->block_size? size: self->block_size;
+        block = s_block_new (block_size, block);
+        self->block = block;
+    }
+    void *memory = (char *) block->data + block->used;
+    block->used += size;
+    self->used += size;
+    return memory;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Copy a string into the arena
+
+char *
+zarena_strdup (zarena_t *self, const char *string)
+{
+    assert (self);
+    assert (string);
+    size_t size = strlen (string);
+    char *copy = (char *) zarena_alloc (self, size + 1);
+    memcpy (copy, string, size + 1);
+    return copy;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Copy at most size bytes of a string into the arena, always terminated
+
+char *
+zarena_strndup (zarena_t *self, const char *string, size_t size)
+{
+    assert (self);
+    assert (string);
+    const char *end = (const char *) memchr (string, 0, size);
+    if (end)
+        size = end - string;
+    char *copy = (char *) zarena_alloc (self, size + 1);
+    memcpy (copy, string, size);
+    copy [size] = 0;
+    return copy;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Format a string into the arena
+
+char *
+zarena_sprintf (zarena_t *self, const char *format, ...)
+{
+    assert (self);
+    assert (format);
+    va_list argptr;
+    va_start (argptr, format);
+    int size = vsnprintf (NULL, 0, format, argptr);
+    va_end (argptr);
+    assert (size >= 0);
+
+    char *string = (char *) zarena_alloc (self, size + 1);
+    va_start (argptr, format);
+    vsnprintf (string, size + 1, format, argptr);
+    va_end (argptr);
+    return string;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Release all allocations at once. If the last round needed more than one
+//  block, the blocks are merged into one for the next round.
+
+void
+zarena_reset (zarena_t *self)
+{
+    assert (self);
+    if (self->block->next) {
+        size_t size = 0;
+        block_t *block;
+        for (block = self->block; block; block = block->next)
+            size += block->size;
+        s_blocks_destroy (self->block);
+        self->block = s_block_new (size, NULL);
+    }
+    self->block->used = 0;
+    self->used = 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the number of bytes allocated since the last reset
+
+size_t
+zarena_used (zarena_t *self)
+{
+    assert (self);
+    return self->used;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+zarena_test (bool verbose)
+{
+    printf (" * zarena: ");
+
+    //  @selftest
+    zarena_t *self = zarena_new (64);
+    assert (self);
+
+    char *string = zarena_strdup (self, "hello");
+    assert (streq (string, "hello"));
+    assert (((uintptr_t) string % ZARENA_ALIGNMENT) == 0);
+    string = zarena_strndup (self, "hello world", 5);
+    assert (streq (string, "hello"));
+    string = zarena_strndup (self, "hi", 5);
+    assert (streq (string, "hi"));
+    string = zarena_sprintf (self, "%s,%lu;", "pid", 42UL);
+    assert (streq (string, "pid,42;"));
+    assert (zarena_used (self) == 4 * ZARENA_ALIGNMENT);
+
+    //  Allocations larger than a block get their own block
+    char *large = (char *) zarena_alloc (self, 1000);
+    memset (large, 'x', 1000);
+    assert (streq (string, "pid,42;"));
+    string = zarena_strdup (self, "after");
+    assert (streq (string, "after"));
+
+    //  After a reset the round fits into one block
+    zarena_reset (self);
+    assert (zarena_used (self) == 0);
+    large = (char *) zarena_alloc (self, 1000);
+    string = zarena_strdup (self, "again");
+    assert (self->block->next == NULL);
+    assert (streq (string, "again"));
+
+    zarena_destroy (&self);
+    //  @end
+
+    printf ("OK\n");
+}
@@ -0,0 +1,919 @@
+/*  =========================================================================
+    zbatch - Columnar batch of log lines for collect messages
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zbatch - Columnar batch of log lines for collect messages
+@discuss
+    Consecutive log lines repeat most of their text: the timestamp, the
+    hostname and syslog tag and the pids of the vector clock. zbatch splits
+    the lines of a collect message into columns and encodes them into one
+    frame:
+
+        timestamps  delta to the previous line, the date as offset to it
+        hosts       host and tag as index into a dictionary of the batch
+        clocks      vector clocks as changes to the previous clock of the
+                    same process, pids as dictionary indexes
+        messages    the text after the clock
+
+    Lines are rendered back byte for byte. Lines which don't have the
+    rsyslog layout, and clocks which aren't vector clocks, are kept as
+    text. Decoding reuses one line buffer, so only lines which are kept
+    have to be copied.
+@end
+*/
+
+#include "zlog_classes.h"
+
+//  Frame signature and version
+#define ZBATCH_SIGNATURE "ZB\x01"
+#define ZBATCH_SIGNATURE_SIZE 3
+
+//  Maximum number of clock entries of a line encoded as vector clock
+#define ZBATCH_ENTRIES 64
+
+//  Maximum offset of a date to its timestamp in seconds
+#define ZBATCH_DATE_OFFSET_MAX (1LL << 40)
+
+//  Kinds of lines
+#define ZBATCH_RAW 0            //  Whole line as message
+#define ZBATCH_TEXT 1           //  Timestamps, rest as message
+#define ZBATCH_VC 2             //  Timestamps, host, vector clock, message
+#define ZBATCH_CLOCK 3          //  Timestamps, host, clock as text, message
+
+//  Changes of a vector clock against the previous one of its process
+#define ZBATCH_CLOCK_FULL 0     //  Size, pid indexes and values
+#define ZBATCH_CLOCK_DELTA 1    //  Number of changes, positions and deltas
+
+//  Columns of a batch
+typedef enum {
+    COLUMN_KINDS,
+    COLUMN_TIMESTAMPS,
+    COLUMN_HOSTS,
+    COLUMN_CLOCKS,
+    COLUMN_MESSAGES,
+    COLUMNS
+} column_id_t;
+
+typedef struct {
+    byte *data;
+    size_t size;
+    size_t max;
+} buffer_t;
+
+typedef struct {
+    const byte *cursor;
+    const byte *end;
+} column_t;
+
+//  Previous clock of a process, pids as dictionary indexes
+
+typedef struct {
+    uint64_t *pids;
+    unsigned long *values;
+    size_t size;
+    size_t max;
+} process_t;
+
+typedef struct {
+    const char *string;         //  Points into the decoded frame
+    size_t size;
+} word_t;
+
+//  Structure of our class
+
+struct _zbatch_t {
+    size_t size;                //  Lines added or left to decode
+    size_t bytes;               //  Text bytes of the lines added
+    uint64_t timestamp;         //  Timestamp of the previous line
+    bool timestamped;           //  Line last decoded has a timestamp
+    process_t *processes;       //  Previous clocks by own pid index
+    size_t processes_size;
+
+    //  Encoding
+    buffer_t columns [COLUMNS];
+    buffer_t dictionary;
+    zhashx_t *words;            //  Dictionary index + 1 by word
+    size_t words_size;
+
+    //  Decoding
+    byte *data;                 //  Copy of the frame
+    column_t cursors [COLUMNS];
+    word_t *dictionary_words;
+    size_t dictionary_size;
+    char *line;                 //  Rendered line
+    size_t line_size;
+    size_t line_max;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+static void
+s_buffer_write (buffer_t *buffer, const void *data, size_t size)
+{
+    if (buffer->size + size > buffer->max) {
+        while (buffer->size + size > buffer->max)
+            buffer->max = buffer->max? buffer->max * 2: 256;
+        buffer->data = (byte *) realloc (buffer->data, buffer->max);
+        assert (buffer->data);
+    }
+    memcpy (buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void
+s_put_varint (buffer_t *buffer, uint64_t value)
+{
+    byte bytes [10];
+    size_t size = 0;
+    while (value >= 0x80) {
+        bytes [size++] = (byte) (value | 0x80);
+        value >>= 7;
+    }
+    bytes [size++] = (byte) value;
+    s_buffer_write (buffer, bytes, size);
+}
+
+//  Signed values are zigzag encoded so small negative deltas stay short
+
+static void
+s_put_signed (buffer_t *buffer, int64_t value)
+{
+    s_put_varint (buffer, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+static void
+s_put_string (buffer_t *buffer, const char *string, size_t size)
+{
+    s_put_varint (buffer, size);
+    s_buffer_write (buffer, string, size);
+}
+
+static bool
+s_get_varint (column_t *column, uint64_t *value)
+{
+    *value = 0;
+    int shift;
+    for (shift = 0; shift < 64 && column->cursor < column->end; shift += 7) {
+        byte next = *column->cursor++;
+        *value |= (uint64_t) (next & 0x7f) << shift;
+        if (!(next & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static bool
+s_get_signed (column_t *column, int64_t *value)
+{
+    uint64_t zigzag;
+    if (!s_get_varint (column, &zigzag))
+        return false;
+    *value = (int64_t) (zigzag >> 1) ^ -(int64_t) (zigzag & 1);
+    return true;
+}
+
+static bool
+s_get_string (column_t *column, const char **string, size_t *size)
+{
+    uint64_t length;
+    if (!s_get_varint (column, &length) || length > (uint64_t) (column->end - column->cursor))
+        return false;
+    *string = (const char *) column->cursor;
+    *size = (size_t) length;
+    column->cursor += length;
+    return true;
+}
+
+//  Days since the epoch of a civil date and back, proleptic gregorian.
+//  Dates are rendered without the time zone, their offset to the unix
+//  timestamp is recorded.
+
+static int64_t
+s_days_from_civil (int64_t year, unsigned month, unsigned day)
+{
+    year -= month <= 2;
+    int64_t era = (year >= 0? year: year - 399) / 400;
+    unsigned year_of_era = (unsigned) (year - era * 400);
+    unsigned day_of_year = (153 * (month > 2? month - 3: month + 9) + 2) / 5 + day - 1;
+    unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + (int64_t) day_of_era - 719468;
+}
+
+//  Renders seconds since the epoch as 'YYYY.MM.DD HH:MM:SS' into date,
+//  which holds at least 32 bytes. Returns the length.
+
+static int
+s_date_render (int64_t seconds, char *date)
+{
+    int64_t days = seconds / 86400;
+    int64_t rest = seconds % 86400;
+    if (rest < 0) {
+        rest += 86400;
+        days--;
+    }
+    days += 719468;
+    int64_t era = (days >= 0? days: days - 146096) / 146097;
+    unsigned day_of_era = (unsigned) (days - era * 146097);
+    unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    int64_t year = (int64_t) year_of_era + era * 400;
+    unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    unsigned month_shifted = (5 * day_of_year + 2) / 153;
+    unsigned day = day_of_year - (153 * month_shifted + 2) / 5 + 1;
+    unsigned month = month_shifted < 10? month_shifted + 3: month_shifted - 9;
+    year += month <= 2;
+    int length = snprintf (date, 32, "%04lld.%02u.%02u %02d:%02d:%02d", (long long) year, month, day,
+                           (int) (rest / 3600), (int) (rest / 60 % 60), (int) (rest % 60));
+    return length < 32? length: 31;
+}
+
+//  Parses 'YYYY.MM.DD HH:MM:SS' into seconds since the epoch. Returns
+//  false if the date wouldn't render back to the same text.
+
+static bool
+s_date_parse (const char *date, int64_t *seconds)
+{
+    static const char *layout = "dddd.dd.dd dd:dd:dd";
+    int fields [6] = { 0 };
+    int field = 0;
+    const char *needle;
+    for (needle = layout; *needle; needle++, date++) {
+        if (*needle == 'd') {
+            if (*date < '0' || *date > '9')
+                return false;
+            fields [field] = fields [field] * 10 + (*date - '0');
+        }
+        else {
+            if (*date != *needle)
+                return false;
+            field++;
+        }
+    }
+    if (fields [1] < 1 || fields [1] > 12 || fields [2] < 1 || fields [2] > 31)
+        return false;
+    *seconds = s_days_from_civil (fields [0], fields [1], fields [2]) * 86400
+             + fields [3] * 3600 + fields [4] * 60 + fields [5];
+    char rendered [32];
+    return s_date_render (*seconds, rendered) == 19
+        && memcmp (rendered, date - 19, 19) == 0;
+}
+
+//  Parses the decimal unix timestamp at the start of a line, which must be
+//  followed by a space. Returns the end of it, NULL if there is none or it
+//  wouldn't render back to the same text.
+
+static const char *
+s_timestamp_parse (const char *line, uint64_t *timestamp)
+{
+    const char *needle = line;
+    *timestamp = 0;
+    while (*needle >= '0' && *needle <= '9') {
+        uint64_t digit = *needle - '0';
+        if (*timestamp > (UINT64_MAX - digit) / 10)
+            return NULL;
+        *timestamp = *timestamp * 10 + digit;
+        needle++;
+    }
+    if (needle == line || *needle != ' ' || (*line == '0' && needle - line > 1))
+        return NULL;
+    return needle;
+}
+
+//  Returns the dictionary index of a word, adds it if it's new
+
+static uint64_t
+s_word_index (zbatch_t *self, const char *word, size_t size)
+{
+    char buffer [256];
+    char *key = size < sizeof (buffer)? buffer: (char *) malloc (size + 1);
+    assert (key);
+    memcpy (key, word, size);
+    key [size] = 0;
+    uint64_t index = (uint64_t) (uintptr_t) zhashx_lookup (self->words, key);
+    if (index)
+        index--;
+    else {
+        index = self->words_size++;
+        zhashx_insert (self->words, key, (void *) (uintptr_t) (index + 1));
+        s_put_string (&self->dictionary, word, size);
+    }
+    if (key != buffer)
+        free (key);
+    return index;
+}
+
+static process_t *
+s_process_require (zbatch_t *self, uint64_t index)
+{
+    if (index >= self->processes_size) {
+        size_t size = (size_t) index + 1;
+        self->processes = (process_t *) realloc (self->processes, size * sizeof (process_t));
+        assert (self->processes);
+        memset (self->processes + self->processes_size, 0,
+                (size - self->processes_size) * sizeof (process_t));
+        self->processes_size = size;
+    }
+    return &self->processes [index];
+}
+
+static void
+s_process_resize (process_t *process, size_t size)
+{
+    if (size > process->max) {
+        process->max = size;
+        process->pids = (uint64_t *) realloc (process->pids, size * sizeof (uint64_t));
+        process->values = (unsigned long *) realloc (process->values, size * sizeof (unsigned long));
+        assert (process->pids);
+        assert (process->values);
+    }
+    process->size = size;
+}
+
+static void
+s_processes_reset (zbatch_t *self)
+{
+    size_t index;
+    for (index = 0; index < self->processes_size; index++) {
+        free (self->processes [index].pids);
+        free (self->processes [index].values);
+    }
+    free (self->processes);
+    self->processes = NULL;
+    self->processes_size = 0;
+}
+
+//  Encodes a vector clock against the previous clock of its process.
+//  Returns false if it isn't a vector clock which renders back to the same
+//  text.
+
+static bool
+s_clock_encode (zbatch_t *self, const char *clock, size_t size)
+{
+    zvector_entry_t own;
+    zvector_entry_t entries [ZBATCH_ENTRIES];
+    int count = zvector_parse (clock, size, &own, entries, ZBATCH_ENTRIES);
+    if (count < 0 || count > ZBATCH_ENTRIES)
+        return false;
+
+    //  The text must be exactly what zvector_to_string writes
+    char rendered [32];
+    size_t length = snprintf (rendered, sizeof (rendered), "VC:%d;own:", count);
+    if (length + own.pid_size + 1 > size || memcmp (clock, rendered, length) != 0)
+        return false;
+    length += own.pid_size + 1;
+    int entry;
+    for (entry = 0; entry < count; entry++) {
+        length += entries [entry].pid_size
+                + snprintf (rendered, sizeof (rendered), ",%lu;", entries [entry].value);
+        if (length > size
+        ||  memcmp (clock + length - strlen (rendered), rendered, strlen (rendered)) != 0)
+            return false;
+    }
+    if (length != size)
+        return false;
+
+    buffer_t *column = &self->columns [COLUMN_CLOCKS];
+    uint64_t own_index = s_word_index (self, own.pid, own.pid_size);
+    s_put_varint (column, own_index);
+    uint64_t pids [ZBATCH_ENTRIES];
+    for (entry = 0; entry < count; entry++)
+        pids [entry] = s_word_index (self, entries [entry].pid, entries [entry].pid_size);
+
+    process_t *process = s_process_require (self, own_index);
+    if (process->size == (size_t) count
+    &&  memcmp (process->pids, pids, count * sizeof (uint64_t)) == 0) {
+        //  Same pids in the same order, usually only the own value changed
+        uint64_t changes = 0;
+        for (entry = 0; entry < count; entry++)
+            changes += entries [entry].value != process->values [entry];
+        s_put_varint (column, ZBATCH_CLOCK_DELTA);
+        s_put_varint (column, changes);
+        for (entry = 0; entry < count; entry++) {
+            if (entries [entry].value != process->values [entry]) {
+                s_put_varint (column, entry);
+                s_put_signed (column, (int64_t) (entries [entry].value - process->values [entry]));
+                process->values [entry] = entries [entry].value;
+            }
+        }
+    }
+    else {
+        s_process_resize (process, count);
+        s_put_varint (column, ZBATCH_CLOCK_FULL);
+        s_put_varint (column, count);
+        for (entry = 0; entry < count; entry++) {
+            s_put_varint (column, pids [entry]);
+            s_put_varint (column, entries [entry].value);
+            process->pids [entry] = pids [entry];
+            process->values [entry] = entries [entry].value;
+        }
+    }
+    return true;
+}
+
+static void
+s_line_append (zbatch_t *self, const void *data, size_t size)
+{
+    if (self->line_size + size + 1 > self->line_max) {
+        while (self->line_size + size + 1 > self->line_max)
+            self->line_max = self->line_max? self->line_max * 2: 256;
+        self->line = (char *) realloc (self->line, self->line_max);
+        assert (self->line);
+    }
+    memcpy (self->line + self->line_size, data, size);
+    self->line_size += size;
+    self->line [self->line_size] = 0;
+}
+
+static bool
+s_word_append (zbatch_t *self, uint64_t index)
+{
+    if (index >= self->dictionary_size)
+        return false;
+    s_line_append (self, self->dictionary_words [index].string, self->dictionary_words [index].size);
+    return true;
+}
+
+static bool
+s_clock_decode (zbatch_t *self)
+{
+    column_t *column = &self->cursors [COLUMN_CLOCKS];
+    uint64_t own_index, mode, count;
+    if (!s_get_varint (column, &own_index) || own_index >= self->dictionary_size
+    ||  !s_get_varint (column, &mode) || !s_get_varint (column, &count))
+        return false;
+    process_t *process = s_process_require (self, own_index);
+    uint64_t entry;
+    if (mode == ZBATCH_CLOCK_FULL) {
+        if (count > ZBATCH_ENTRIES)
+            return false;
+        s_process_resize (process, (size_t) count);
+        for (entry = 0; entry < count; entry++) {
+            uint64_t value;
+            if (!s_get_varint (column, &process->pids [entry])
+            ||  process->pids [entry] >= self->dictionary_size
+            ||  !s_get_varint (column, &value))
+                return false;
+            process->values [entry] = (unsigned long) value;
+        }
+    }
+    else
+    if (mode == ZBATCH_CLOCK_DELTA) {
+        for (entry = 0; entry < count; entry++) {
+            uint64_t position;
+            int64_t delta;
+            if (!s_get_varint (column, &position) || position >= process->size
+            ||  !s_get_signed (column, &delta))
+                return false;
+            process->values [position] += (unsigned long) delta;
+        }
+    }
+    else
+        return false;
+
+    char number [32];
+    s_line_append (self, number, snprintf (number, sizeof (number), "VC:%zu;own:", process->size));
+    s_word_append (self, own_index);
+    s_line_append (self, ";", 1);
+    for (entry = 0; entry < process->size; entry++) {
+        s_word_append (self, process->pids [entry]);
+        s_line_append (self, number, snprintf (number, sizeof (number), ",%lu;", process->values [entry]));
+    }
+    return true;
+}
+
+//  Stops decoding a malformed batch
+
+static const char *
+s_malformed (zbatch_t *self)
+{
+    self->size = 0;
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new zbatch
+
+zbatch_t *
+zbatch_new (void)
+{
+    zbatch_t *self = (zbatch_t *) zmalloc (sizeof (zbatch_t));
+    assert (self);
+    self->words = zhashx_new ();
+    assert (self->words);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the zbatch
+
+void
+zbatch_destroy (zbatch_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zbatch_t *self = *self_p;
+        int column;
+        for (column = 0; column < COLUMNS; column++)
+            free (self->columns [column].data);
+        free (self->dictionary.data);
+        zhashx_destroy (&self->words);
+        s_processes_reset (self);
+        free (self->data);
+        free (self->dictionary_words);
+        free (self->line);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Adds a log line to the batch
+
+void
+zbatch_add (zbatch_t *self, const char *line)
+{
+    assert (self);
+    assert (line);
+    ZLOG_TRACE_BEGIN ("zbatch_add");
+    size_t line_size = strlen (line);
+    self->size++;
+    self->bytes += line_size + 1;
+
+    //  '<timestamp> YYYY.MM.DD HH:MM:SS <host> <tag>: /<clock>/ <message>'
+    uint64_t timestamp;
+    int64_t date;
+    const char *needle = s_timestamp_parse (line, &timestamp);
+    if (!needle
+    ||  strnlen (needle + 1, 20) < 20 || needle [20] != ' '
+    ||  !s_date_parse (needle + 1, &date)) {
+        byte kind = ZBATCH_RAW;
+        s_buffer_write (&self->columns [COLUMN_KINDS], &kind, 1);
+        s_put_string (&self->columns [COLUMN_MESSAGES], line, line_size);
+        ZLOG_TRACE_END ("zbatch_add");
+        return;
+    }
+    buffer_t *timestamps = &self->columns [COLUMN_TIMESTAMPS];
+    s_put_signed (timestamps, (int64_t) (timestamp - self->timestamp));
+    s_put_signed (timestamps, date - (int64_t) (timestamp / 10000));
+    self->timestamp = timestamp;
+
+    const char *rest = needle + 21;
+    const char *clock = strstr (rest, " /");
+    const char *clock_end = clock? strchr (clock + 2, '/'): NULL;
+    byte kind;
+    if (clock_end) {
+        size_t clock_size = clock_end - clock - 2;
+        kind = s_clock_encode (self, clock + 2, clock_size)? ZBATCH_VC: ZBATCH_CLOCK;
+        if (kind == ZBATCH_CLOCK)
+            s_put_string (&self->columns [COLUMN_CLOCKS], clock + 2, clock_size);
+        s_put_varint (&self->columns [COLUMN_HOSTS], s_word_index (self, rest, clock - rest));
+        s_put_string (&self->columns [COLUMN_MESSAGES], clock_end + 1, line + line_size - clock_end - 1);
+    }
+    else {
+        kind = ZBATCH_TEXT;
+        s_put_string (&self->columns [COLUMN_MESSAGES], rest, line + line_size - rest);
+    }
+    s_buffer_write (&self->columns [COLUMN_KINDS], &kind, 1);
+    ZLOG_TRACE_END ("zbatch_add");
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the number of lines added, or left to decode
+
+size_t
+zbatch_size (zbatch_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the bytes of the lines added as text, with a newline each
+
+size_t
+zbatch_bytes (zbatch_t *self)
+{
+    assert (self);
+    return self->bytes;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Encodes the lines added into a frame and empties the batch. Caller owns
+//  the frame.
+
+zframe_t *
+zbatch_encode (zbatch_t *self)
+{
+    assert (self);
+    ZLOG_TRACE_BEGIN ("zbatch_encode");
+    buffer_t header = { NULL, 0, 0 };
+    s_buffer_write (&header, ZBATCH_SIGNATURE, ZBATCH_SIGNATURE_SIZE);
+    s_put_varint (&header, self->size);
+    s_put_varint (&header, self->words_size);
+    int column;
+    for (column = 0; column < COLUMNS; column++)
+        s_put_varint (&header, self->columns [column].size);
+
+    size_t size = header.size + self->dictionary.size;
+    for (column = 0; column < COLUMNS; column++)
+        size += self->columns [column].size;
+    zframe_t *frame = zframe_new (NULL, size);
+    byte *data = zframe_data (frame);
+    memcpy (data, header.data, header.size);
+    data += header.size;
+    if (self->dictionary.size)
+        memcpy (data, self->dictionary.data, self->dictionary.size);
+    data += self->dictionary.size;
+    for (column = 0; column < COLUMNS; column++) {
+        if (self->columns [column].size)
+            memcpy (data, self->columns [column].data, self->columns [column].size);
+        data += self->columns [column].size;
+        self->columns [column].size = 0;
+    }
+    free (header.data);
+
+    //  Dictionary and clocks start over with the next batch
+    self->dictionary.size = 0;
+    zhashx_purge (self->words);
+    self->words_size = 0;
+    s_processes_reset (self);
+    self->timestamp = 0;
+    self->size = 0;
+    self->bytes = 0;
+    ZLOG_TRACE_END ("zbatch_encode");
+    return frame;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns true if the frame holds a batch, false if it's a plain line
+
+bool
+zbatch_is (zframe_t *frame)
+{
+    assert (frame);
+    return zframe_size (frame) >= ZBATCH_SIGNATURE_SIZE
+        && memcmp (zframe_data (frame), ZBATCH_SIGNATURE, ZBATCH_SIGNATURE_SIZE) == 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Creates a zbatch to decode the lines of frame, NULL if it isn't a batch.
+//  The frame is copied.
+
+zbatch_t *
+zbatch_decode (zframe_t *frame)
+{
+    assert (frame);
+    if (!zbatch_is (frame))
+        return NULL;
+    zbatch_t *self = zbatch_new ();
+    self->data = (byte *) malloc (zframe_size (frame));
+    assert (self->data);
+    memcpy (self->data, zframe_data (frame), zframe_size (frame));
+
+    column_t frame_column = {
+        self->data + ZBATCH_SIGNATURE_SIZE, self->data + zframe_size (frame)
+    };
+    uint64_t size, words;
+    uint64_t sizes [COLUMNS];
+    bool valid = s_get_varint (&frame_column, &size)
+              && s_get_varint (&frame_column, &words)
+              && words <= (uint64_t) (frame_column.end - frame_column.cursor);
+    int column;
+    for (column = 0; valid && column < COLUMNS; column++)
+        valid = s_get_varint (&frame_column, &sizes [column]);
+    if (valid) {
+        self->dictionary_words = (word_t *) malloc ((words? words: 1) * sizeof (word_t));
+        assert (self->dictionary_words);
+        for (; valid && self->dictionary_size < words; self->dictionary_size++) {
+            word_t *word = &self->dictionary_words [self->dictionary_size];
+            valid = s_get_string (&frame_column, &word->string, &word->size);
+        }
+    }
+    for (column = 0; valid && column < COLUMNS; column++) {
+        valid = sizes [column] <= (uint64_t) (frame_column.end - frame_column.cursor);
+        if (valid) {
+            self->cursors [column].cursor = frame_column.cursor;
+            self->cursors [column].end = frame_column.cursor + sizes [column];
+            frame_column.cursor += sizes [column];
+        }
+    }
+    if (!valid) {
+        zbatch_destroy (&self);
+        return NULL;
+    }
+    self->size = (size_t) size;
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the next line of a decoded batch, NULL if there are no lines
+//  left or the batch is malformed. The line is valid until the next call.
+
+const char *
+zbatch_next (zbatch_t *self)
+{
+    assert (self);
+    if (!self->size)
+        return NULL;
+    self->size--;
+    self->timestamped = false;
+    self->line_size = 0;
+    s_line_append (self, "", 0);
+
+    column_t *kinds = &self->cursors [COLUMN_KINDS];
+    column_t *messages = &self->cursors [COLUMN_MESSAGES];
+    const char *message;
+    size_t message_size;
+    if (kinds->cursor == kinds->end)
+        return s_malformed (self);
+    byte kind = *kinds->cursor++;
+    if (kind == ZBATCH_RAW) {
+        if (!s_get_string (messages, &message, &message_size))
+            return s_malformed (self);
+        s_line_append (self, message, message_size);
+        return self->line;
+    }
+    if (kind > ZBATCH_CLOCK)
+        return s_malformed (self);
+
+    int64_t delta, date_offset;
+    if (!s_get_signed (&self->cursors [COLUMN_TIMESTAMPS], &delta)
+    ||  !s_get_signed (&self->cursors [COLUMN_TIMESTAMPS], &date_offset)
+    ||  date_offset > ZBATCH_DATE_OFFSET_MAX || date_offset < -ZBATCH_DATE_OFFSET_MAX)
+        return s_malformed (self);
+    self->timestamp += (uint64_t) delta;
+    self->timestamped = true;
+    char number [32];
+    s_line_append (self, number, snprintf (number, sizeof (number), "%llu ",
+                   (unsigned long long) self->timestamp));
+    s_line_append (self, number, s_date_render ((int64_t) (self->timestamp / 10000) + date_offset, number));
+    s_line_append (self, " ", 1);
+
+    if (kind != ZBATCH_TEXT) {
+        uint64_t host;
+        if (!s_get_varint (&self->cursors [COLUMN_HOSTS], &host) || !s_word_append (self, host))
+            return s_malformed (self);
+        s_line_append (self, " /", 2);
+        if (kind == ZBATCH_VC) {
+            if (!s_clock_decode (self))
+                return s_malformed (self);
+        }
+        else {
+            const char *clock;
+            size_t clock_size;
+            if (!s_get_string (&self->cursors [COLUMN_CLOCKS], &clock, &clock_size))
+                return s_malformed (self);
+            s_line_append (self, clock, clock_size);
+        }
+        s_line_append (self, "/", 1);
+    }
+    if (!s_get_string (messages, &message, &message_size))
+        return s_malformed (self);
+    s_line_append (self, message, message_size);
+    return self->line;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the timestamp of the line last returned by zbatch_next, 0 if it
+//  has none
+
+uint64_t
+zbatch_timestamp (zbatch_t *self)
+{
+    assert (self);
+    return self->timestamped? self->timestamp: 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+zbatch_test (bool verbose)
+{
+    printf (" * zbatch: ");
+
+    //  @selftest
+    const char *lines [] = {
+        "15000000001234 2017.07.14 04:40:00 host-a zlogger[12]: /VC:2;own:1001;1000,3;1001,7;/ send",
+        "15000000001240 2017.07.14 04:40:00 host-a zlogger[12]: /VC:2;own:1001;1000,3;1001,8;/ recv",
+        "15000000005000 2017.07.14 06:40:00 host-b zlogger[34]: /VC:1;own:1000;1000,4;/ tz",
+        "15000000001250 2017.07.14 04:40:00 host-a zlogger[12]: /VC:3;own:1001;1002,1;1000,5;1001,9;/",
+        "15000000001260 2017.07.14 04:40:00 host-a zlogger[12]: /HLC:0000015d3e4a0001;own:1001;/ hlc",
+        "15000000001270 2017.07.14 04:40:00 host-a zlogger[12]: /VC:02;own:1001;1000,3;1001,7;/ odd",
+        "15000000001280 2017.07.14 04:40:00 host-a kernel: no clock",
+        "15000000001290 2017.02.30 04:40:00 host-a zlogger[12]: /VC:1;own:1001;1001,1;/ date",
+        "015 2017.07.14 04:40:00 host-a zlogger[12]: /VC:1;own:1001;1001,1;/ zero",
+        "garbage",
+        ""
+    };
+    size_t lines_size = sizeof (lines) / sizeof (lines [0]);
+
+    zbatch_t *self = zbatch_new ();
+    assert (self);
+    size_t index;
+    for (index = 0; index < lines_size; index++)
+        zbatch_add (self, lines [index]);
+    assert (zbatch_size (self) == lines_size);
+    zframe_t *frame = zbatch_encode (self);
+    assert (zbatch_size (self) == 0);
+    assert (zbatch_bytes (self) == 0);
+    assert (zbatch_is (frame));
+
+    //  Lines render back byte for byte
+    zbatch_t *batch = zbatch_decode (frame);
+    assert (batch);
+    assert (zbatch_size (batch) == lines_size);
+    for (index = 0; index < lines_size; index++) {
+        const char *line = zbatch_next (batch);
+        if (verbose)
+            printf ("%s\n", line);
+        assert (line);
+        assert (streq (line, lines [index]));
+    }
+    assert (zbatch_next (batch) == NULL);
+    zbatch_destroy (&batch);
+
+    //  Truncated batches are malformed, but never read past the frame
+    size_t size;
+    for (size = 0; size < zframe_size (frame); size++) {
+        zframe_t *truncated = zframe_new (zframe_data (frame), size);
+        batch = zbatch_decode (truncated);
+        if (batch) {
+            while (zbatch_next (batch));
+            zbatch_destroy (&batch);
+        }
+        zframe_destroy (&truncated);
+    }
+    zframe_destroy (&frame);
+    frame = zframe_new ("plain line", 10);
+    assert (!zbatch_is (frame));
+    assert (zbatch_decode (frame) == NULL);
+    zframe_destroy (&frame);
+
+    //  Lines of a running cluster shrink by an order of magnitude
+    const char *pids [] = {
+        "5e0b3c7a9f1e4b2d8c6a0f1e2d3c4b5a", "6f1c4d8b0a2f5c3e9d7b1a2f3e4d5c6b",
+        "7a2d5e9c1b3a6d4f0e8c2b3a4f5e6d7c", "8b3e6f0d2c4b7e5a1f9d3c4b5a6f7e8d"
+    };
+    //  Each process logs its events, every eighth one receives from the next
+    unsigned long clocks [4][4] = { { 0 } };
+    for (index = 0; index < 400; index++) {
+        size_t own = index % 4;
+        unsigned long *clock = clocks [own];
+        clock [own]++;
+        if (index % 32 < 4) {
+            size_t peer;
+            for (peer = 0; peer < 4; peer++)
+                if (clocks [(own + 1) % 4][peer] > clock [peer])
+                    clock [peer] = clocks [(own + 1) % 4][peer];
+        }
+        size_t first = (own + 1) % 4, second = (own + 2) % 4, third = (own + 3) % 4;
+        char *line = zsys_sprintf (
+            "%llu 2017.07.14 04:40:%02zu node-%zu zlogger[%zu]: "
+            "/VC:4;own:%s;%s,%lu;%s,%lu;%s,%lu;%s,%lu;/ event %zu",
+            15000000000000ULL + index * 37, index * 37 / 10000, own, 100 + own, pids [own],
+            pids [first], clock [first], pids [second], clock [second],
+            pids [third], clock [third], pids [own], clock [own], index);
+        zbatch_add (self, line);
+        zstr_free (&line);
+    }
+    size_t bytes = zbatch_bytes (self);
+    frame = zbatch_encode (self);
+    if (verbose)
+        printf ("%zu bytes as text, %zu bytes encoded\n", bytes, zframe_size (frame));
+    assert (zframe_size (frame) * 10 < bytes);
+    batch = zbatch_decode (frame);
+    assert (zbatch_size (batch) == 400);
+    const char *line = zbatch_next (batch);
+    assert (line);
+    assert (zbatch_timestamp (batch) == 15000000000000ULL);
+    while (zbatch_next (batch));
+    zbatch_destroy (&batch);
+    zframe_destroy (&frame);
+    zbatch_destroy (&self);
+    //  @end
+
+    printf ("OK\n");
+}
@@ -0,0 +1,882 @@
+/*  =========================================================================
+    zbinlog - Binary causal log with deferred formatting
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zbinlog - Binary causal log with deferred formatting
+@discuss
+    zvector_info formats the message and the clock and sends it to syslog
+    on every call. zbinlog defers all formatting: a format string is
+    registered once and gets an id, a log call only appends the id, a
+    timestamp, the own clock value and the raw arguments to a buffer.
+    The whole clock is only recorded when another pid's value changed
+    since the last entry, entries refer to it otherwise. The buffer is
+    appended to a file and turned into text lines later by zbinlog_decode,
+    which look like the lines zvector_info writes via syslog, so they can
+    be ordered with zlog_order_log.
+
+    Supported conversions are those of printf except %n and long double,
+    including * for width and precision. Strings are copied, up to their
+    precision. The file is in host byte order and must be decoded on the
+    same architecture.
+
+    Use the ZBINLOG macro to register the format on first use:
+
+        ZBINLOG (binlog, clock, "Peer %s joined after %d ms", name, delay);
+
+    Formats are interned by address, registering the same string again
+    only looks up its id. A zbinlog must not be shared between threads.
+@end
+*/
+
+#include "zlog_classes.h"
+
+//  Record types of the file
+#define ZBINLOG_HEADER 'H'      //  Hostname
+#define ZBINLOG_FORMAT 'F'      //  Id, format string
+#define ZBINLOG_CLOCK 'C'       //  Whole serialized clock
+#define ZBINLOG_ENTRY 'E'       //  Id, timestamp, own value, arguments
+
+//  Argument types, the raw bytes of the type are recorded
+
+typedef enum {
+    ARG_NONE,                   //  Literal text or %%
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_INTMAX,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_POINTER,
+    ARG_STRING                  //  Length and bytes
+} arg_type_t;
+
+//  A format string is split into literal text and conversions
+
+typedef struct {
+    char *text;                 //  Literal text or the conversion spec
+    arg_type_t type;
+    int stars;                  //  Number of * ints before the argument
+    bool precision_star;        //  Last * is the precision
+    int precision;              //  Literal precision, -1 if none
+} segment_t;
+
+typedef struct {
+    const char *source;         //  Registered format string, not owned
+    segment_t *segments;
+    size_t size;
+} format_t;
+
+//  Structure of our class
+
+struct _zbinlog_t {
+    byte *data;                 //  Records not yet saved
+    size_t size;
+    size_t max;
+    format_t *formats;          //  Registered formats by id
+    size_t formats_size;
+    size_t formats_max;
+    int *interned;              //  Format ids by address, -1 if free
+    size_t interned_max;
+    zvector_t *clock;           //  Clock of the last recorded clock
+    uint64_t generation;        //  Generation of the last recorded clock
+    char *own_pid;              //  Own pid of the last recorded clock
+};
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+static void
+s_write (zbinlog_t *self, const void *data, size_t size)
+{
+    if (self->size + size > self->max) {
+        while (self->size + size > self->max)
+            self->max = self->max? self->max * 2: 4096;
+        self->data = (byte *) realloc (self->data, self->max);
+        assert (self->data);
+    }
+    memcpy (self->data + self->size, data, size);
+    self->size += size;
+}
+
+static void
+s_write_string (zbinlog_t *self, const char *string, uint32_t length)
+{
+    s_write (self, &length, sizeof (length));
+    s_write (self, string, length);
+}
+
+static void
+s_format_destroy (format_t *format)
+{
+    size_t index;
+    for (index = 0; index < format->size; index++)
+        free (format->segments [index].text);
+    free (format->segments);
+}
+
+static segment_t *
+s_segment_add (format_t *format, const char *text, size_t length)
+{
+    format->segments = (segment_t *) realloc (format->segments, (format->size + 1) * sizeof (segment_t));
+    assert (format->segments);
+    segment_t *segment = &format->segments [format->size++];
+    memset (segment, 0, sizeof (segment_t));
+    segment->text = strndup (text, length);
+    segment->precision = -1;
+    return segment;
+}
+
+//  Splits a format string into segments. Returns -1 if it has a conversion
+//  which isn't supported.
+
+static int
+s_format_parse (format_t *format, const char *string)
+{
+    const char *needle = string;
+    while (*needle) {
+        const char *percent = strchr (needle, '%');
+        if (!percent) {
+            s_segment_add (format, needle, strlen (needle));
+            break;
+        }
+        if (percent > needle)
+            s_segment_add (format, needle, percent - needle);
+
+        //  %[flags][width][.precision][length]conversion
+        const char *spec = percent + 1;
+        int stars = 0;
+        bool precision_star = false;
+        int precision = -1;
+        while (*spec && strchr ("-+ #0", *spec))
+            spec++;
+        if (*spec == '*') {
+            stars++;
+            spec++;
+        }
+        while (isdigit ((unsigned char) *spec))
+            spec++;
+        if (*spec == '.') {
+            spec++;
+            if (*spec == '*') {
+                stars++;
+                precision_star = true;
+                spec++;
+            }
+            else {
+                precision = atoi (spec);
+                while (isdigit ((unsigned char) *spec))
+                    spec++;
+            }
+        }
+        arg_type_t type = ARG_INT;
+        if (spec [0] == 'h')
+            spec += spec [1] == 'h'? 2: 1;
+        else
+        if (spec [0] == 'l' && spec [1] == 'l') {
+            type = ARG_LLONG;
+            spec += 2;
+        }
+        else
+        if (spec [0] == 'l') {
+            type = ARG_LONG;
+            spec++;
+        }
+        else
+        if (spec [0] == 'z') {
+            type = ARG_SIZE;
+            spec++;
+        }
+        else
+        if (spec [0] == 'j') {
+            type = ARG_INTMAX;
+            spec++;
+        }
+        else
+        if (spec [0] == 't') {
+            type = ARG_PTRDIFF;
+            spec++;
+        }
+
+        if (*spec == '%' && spec == percent + 1)
+            type = ARG_NONE;
+        else
+        if (*spec && strchr ("fFeEgGaA", *spec))
+            type = ARG_DOUBLE;
+        else
+        if (*spec == 's')
+            type = ARG_STRING;
+        else
+        if (*spec == 'p')
+            type = ARG_POINTER;
+        else
+        if (!*spec || !strchr ("diouxXc", *spec))
+            return -1;          //  %n, long double or garbage
+
+        segment_t *segment = s_segment_add (format, percent, spec + 1 - percent);
+        segment->type = type;
+        segment->stars = stars;
+        segment->precision_star = precision_star;
+        segment->precision = precision;
+        needle = spec + 1;
+    }
+    return 0;
+}
+
+//  Appends formatted text to a growable string
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t max;
+} text_t;
+
+static void
+s_text_append (text_t *text, const char *format, ...)
+{
+    va_list argptr;
+    va_start (argptr, format);
+    int size = vsnprintf (NULL, 0, format, argptr);
+    va_end (argptr);
+    if (size < 0)
+        return;
+    if (text->size + size + 1 > text->max) {
+        while (text->size + size + 1 > text->max)
+            text->max = text->max? text->max * 2: 256;
+        text->data = (char *) realloc (text->data, text->max);
+        assert (text->data);
+    }
+    va_start (argptr, format);
+    vsnprintf (text->data + text->size, size + 1, format, argptr);
+    va_end (argptr);
+    text->size += size;
+}
+
+//  Reads size bytes at the cursor, returns false at the end of the data
+
+static bool
+s_read (const byte **cursor, const byte *end, void *data, size_t size)
+{
+    if ((size_t) (end - *cursor) < size)
+        return false;
+    memcpy (data, *cursor, size);
+    *cursor += size;
+    return true;
+}
+
+static char *
+s_read_string (const byte **cursor, const byte *end)
+{
+    uint32_t length;
+    if (!s_read (cursor, end, &length, sizeof (length)) || (size_t) (end - *cursor) < length)
+        return NULL;
+    char *string = strndup ((const char *) *cursor, length);
+    *cursor += length;
+    return string;
+}
+
+//  Formats one conversion with its * ints and the raw argument at the
+//  cursor. Returns false at the end of the data.
+
+#define S_APPEND(value) \
+    (segment->stars == 0? s_text_append (text, segment->text, value): \
+     segment->stars == 1? s_text_append (text, segment->text, stars [0], value): \
+                          s_text_append (text, segment->text, stars [0], stars [1], value))
+
+static bool
+s_decode_arg (segment_t *segment, const byte **cursor, const byte *end, text_t *text)
+{
+    int stars [2] = { 0, 0 };
+    int index;
+    for (index = 0; index < segment->stars; index++)
+        if (!s_read (cursor, end, &stars [index], sizeof (int)))
+            return false;
+
+    switch (segment->type) {
+        case ARG_NONE:
+            s_text_append (text, "%s", streq (segment->text, "%%")? "%": segment->text);
+            return true;
+        case ARG_INT: {
+            int value;
+            if (!s_read (cursor, end, &value, sizeof (value)))
+                return false;
+            S_APPEND (value);
+            return true;
+        }
+        case ARG_LONG: {
+            long value;
+            if (!s_read (cursor, end, &value, sizeof (value)))
+                return false;
+            S_APPEND (value);
+            return true;
+        }
+        case ARG_LLONG: {
+            long long value;
+            if (!s_read (cursor, end, &value, sizeof (value)))
+                return false;
+            S_APPEND (value);
+            return true;
+        }
+        case ARG_SIZE: {
+            size_t value;
+            if (!s_read (cursor, end, &value, sizeof (value)))
+                return false;
+            S_APPEND (value);
+            return true;
+        }
+        case ARG_INTMAX: {
+            intmax_t value;
+            if (!s_read (cursor, end, &value, sizeof (value)))
+                return false;
+            S_APPEND (value);
+            return true;
+        }
+        case ARG_PTRDIFF: {
+            ptrdiff_t value;
+            if (!s_read (cursor, end, &value, sizeof (value)))
+                return false;
+            S_APPEND (value);
+            return true;
+        }
+        case ARG_DOUBLE: {
+            double value;
+            if (!s_read (cursor, end, &value, sizeof (value)))
+                return false;
+            S_APPEND (value);
+            return true;
+        }
+        case ARG_POINTER: {
+            void *value;
+            if (!s_read (cursor, end, &value, sizeof (value)))
+                return false;
+            S_APPEND (value);
+            return true;
+        }
+        case ARG_STRING: {
+            char *value = s_read_string (cursor, end);
+            if (!value)
+                return false;
+            S_APPEND (value);
+            free (value);
+            return true;
+        }
+    }
+    return false;
+}
+
+//  Returns the serialized clock with the value of its last entry, the own
+//  one, replaced. Caller owns the string.
+
+static char *
+s_clock_patch (const char *clock_string, const char *own_pid, unsigned long value)
+{
+    size_t length = strlen (clock_string);
+    const char *entry = clock_string + length - 1;
+    while (entry > clock_string && entry [-1] != ';')
+        entry--;
+    size_t own_length = strlen (own_pid);
+    if (strncmp (entry, own_pid, own_length) != 0 || entry [own_length] != ',')
+        return strdup (clock_string);
+    return zsys_sprintf ("%.*s%s,%lu;", (int) (entry - clock_string), clock_string, own_pid, value);
+}
+
+
+//  Returns the slot of format in the interned table, either the one which
+//  holds its id or the free one where it belongs. The table is never full.
+
+static size_t
+s_interned_slot (zbinlog_t *self, const char *format)
+{
+    size_t slot = (size_t) (((uintptr_t) format >> 3) * 2654435761u) & (self->interned_max - 1);
+    while (self->interned [slot] != -1
+       &&  self->formats [self->interned [slot]].source != format)
+        slot = (slot + 1) & (self->interned_max - 1);
+    return slot;
+}
+
+//  Keeps the interned table at most half full
+
+static void
+s_interned_grow (zbinlog_t *self)
+{
+    if (self->formats_size * 2 < self->interned_max)
+        return;
+    free (self->interned);
+    self->interned_max = self->interned_max? self->interned_max * 2: 32;
+    self->interned = (int *) malloc (self->interned_max * sizeof (int));
+    assert (self->interned);
+    size_t index;
+    for (index = 0; index < self->interned_max; index++)
+        self->interned [index] = -1;
+    for (index = 0; index < self->formats_size; index++)
+        self->interned [s_interned_slot (self, self->formats [index].source)] = (int) index;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new zbinlog
+
+zbinlog_t *
+zbinlog_new (void)
+{
+    zbinlog_t *self = (zbinlog_t *) zmalloc (sizeof (zbinlog_t));
+    assert (self);
+    //  Initialize class properties here
+    byte type = ZBINLOG_HEADER;
+    s_write (self, &type, 1);
+    char *hostname = zsys_hostname ();
+    s_write_string (self, hostname? hostname: "localhost", hostname? strlen (hostname): 9);
+    zstr_free (&hostname);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the zbinlog, records not yet saved are lost
+
+void
+zbinlog_destroy (zbinlog_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zbinlog_t *self = *self_p;
+        //  Free class properties here
+        size_t index;
+        for (index = 0; index < self->formats_size; index++)
+            s_format_destroy (&self->formats [index]);
+        free (self->formats);
+        free (self->interned);
+        free (self->data);
+        zstr_free (&self->own_pid);
+        //  Free object itself
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Registers a printf format string and returns its id, or -1 if it has
+//  a conversion which isn't supported. The format is only parsed here.
+//  Registering the same string again returns its id, formats are told
+//  apart by their address.
+
+int
+zbinlog_register (zbinlog_t *self, const char *format)
+{
+    assert (self);
+    assert (format);
+    if (self->interned_max) {
+        int id = self->interned [s_interned_slot (self, format)];
+        if (id != -1)
+            return id;
+    }
+    format_t parsed = { format, NULL, 0 };
+    if (s_format_parse (&parsed, format) == -1) {
+        s_format_destroy (&parsed);
+        return -1;
+    }
+    if (self->formats_size == self->formats_max) {
+        self->formats_max = self->formats_max? self->formats_max * 2: 16;
+        self->formats = (format_t *) realloc (self->formats, self->formats_max * sizeof (format_t));
+        assert (self->formats);
+    }
+    uint32_t id = (uint32_t) self->formats_size;
+    self->formats [self->formats_size++] = parsed;
+    s_interned_grow (self);
+    self->interned [s_interned_slot (self, format)] = (int) id;
+
+    byte type = ZBINLOG_FORMAT;
+    s_write (self, &type, 1);
+    s_write (self, &id, sizeof (id));
+    s_write_string (self, format, strlen (format));
+    return (int) id;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the format string registered with id, NULL if there is none.
+
+const char *
+zbinlog_format (zbinlog_t *self, int format_id)
+{
+    assert (self);
+    if (format_id < 0 || (size_t) format_id >= self->formats_size)
+        return NULL;
+    return self->formats [format_id].source;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Records a log entry of a registered format with its raw arguments and
+//  events the clock, like zvector_info does.
+
+void
+zbinlog_log (zbinlog_t *self, zvector_t *clock, int format_id, ...)
+{
+    assert (self);
+    assert (clock);
+    assert (format_id >= 0 && (size_t) format_id < self->formats_size);
+    ZLOG_TRACE_BEGIN ("zbinlog_log");
+
+    //  The whole clock only if another pid's value changed
+    uint64_t generation = zvector_generation (clock);
+    if (clock != self->clock || generation != self->generation || !self->own_pid) {
+        char *clock_string = zvector_to_string (clock);
+        const char *own = strstr (clock_string, ";own:") + 5;
+        zstr_free (&self->own_pid);
+        self->own_pid = strndup (own, strchr (own, ';') - own);
+        byte type = ZBINLOG_CLOCK;
+        s_write (self, &type, 1);
+        s_write_string (self, clock_string, strlen (clock_string));
+        zstr_free (&clock_string);
+        self->clock = clock;
+        self->generation = generation;
+    }
+
+    byte type = ZBINLOG_ENTRY;
+    uint32_t id = (uint32_t) format_id;
+    int64_t timestamp = zclock_time ();
+    unsigned long value = zvector_value (clock, self->own_pid);
+    s_write (self, &type, 1);
+    s_write (self, &id, sizeof (id));
+    s_write (self, &timestamp, sizeof (timestamp));
+    s_write (self, &value, sizeof (value));
+
+    format_t *format = &self->formats [format_id];
+    va_list argptr;
+    va_start (argptr, format_id);
+    size_t index;
+    for (index = 0; index < format->size; index++) {
+        segment_t *segment = &format->segments [index];
+        int stars [2] = { 0, 0 };
+        int star;
+        for (star = 0; star < segment->stars; star++) {
+            stars [star] = va_arg (argptr, int);
+            s_write (self, &stars [star], sizeof (int));
+        }
+        switch (segment->type) {
+            case ARG_NONE:
+                break;
+            case ARG_INT: {
+                int arg = va_arg (argptr, int);
+                s_write (self, &arg, sizeof (arg));
+                break;
+            }
+            case ARG_LONG: {
+                long arg = va_arg (argptr, long);
+                s_write (self, &arg, sizeof (arg));
+                break;
+            }
+            case ARG_LLONG: {
+                long long arg = va_arg (argptr, long long);
+                s_write (self, &arg, sizeof (arg));
+                break;
+            }
+            case ARG_SIZE: {
+                size_t arg = va_arg (argptr, size_t);
+                s_write (self, &arg, sizeof (arg));
+                break;
+            }
+            case ARG_INTMAX: {
+                intmax_t arg = va_arg (argptr, intmax_t);
+                s_write (self, &arg, sizeof (arg));
+                break;
+            }
+            case ARG_PTRDIFF: {
+                ptrdiff_t arg = va_arg (argptr, ptrdiff_t);
+                s_write (self, &arg, sizeof (arg));
+                break;
+            }
+            case ARG_DOUBLE: {
+                double arg = va_arg (argptr, double);
+                s_write (self, &arg, sizeof (arg));
+                break;
+            }
+            case ARG_POINTER: {
+                void *arg = va_arg (argptr, void *);
+                s_write (self, &arg, sizeof (arg));
+                break;
+            }
+            case ARG_STRING: {
+                const char *arg = va_arg (argptr, const char *);
+                if (!arg)
+                    arg = "(null)";
+                int precision = segment->precision_star? stars [segment->stars - 1]: segment->precision;
+                size_t length = precision >= 0? strnlen (arg, precision): strlen (arg);
+                s_write_string (self, arg, (uint32_t) length);
+                break;
+            }
+        }
+    }
+    va_end (argptr);
+    zvector_event (clock);
+    ZLOG_TRACE_END ("zbinlog_log");
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the bytes of records not yet saved
+
+size_t
+zbinlog_size (zbinlog_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Appends the records to the file at path and clears the buffer. All
+//  saves of a zbinlog must go to the same file. Returns 0 on success, -1
+//  if the file can't be written.
+
+int
+zbinlog_save (zbinlog_t *self, const char *path)
+{
+    assert (self);
+    assert (path);
+    FILE *file = fopen (path, "ab");
+    if (!file)
+        return -1;
+    size_t written = fwrite (self->data, 1, self->size, file);
+    if (fclose (file) != 0 || written != self->size)
+        return -1;
+    self->size = 0;
+    return 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Decodes the binary log at source filepath into text lines at destination
+//  filepath, stamped with the vector clock like lines of zvector_info. A
+//  truncated last record is skipped. Returns the number of decoded entries
+//  or -1 if a file can't be opened.
+
+int
+zbinlog_decode (const char *path_src, const char *path_dst)
+{
+    assert (path_src);
+    assert (path_dst);
+    zfile_t *file_src = zfile_new (NULL, path_src);
+    if (!file_src || zfile_input (file_src) == -1) {
+        zfile_destroy (&file_src);
+        return -1;
+    }
+    zchunk_t *chunk = zfile_read (file_src, zfile_cursize (file_src), 0);
+    zfile_destroy (&file_src);
+    FILE *file_dst = fopen (path_dst, "w");
+    if (!chunk || !file_dst) {
+        zchunk_destroy (&chunk);
+        if (file_dst)
+            fclose (file_dst);
+        return -1;
+    }
+
+    const byte *cursor = zchunk_data (chunk);
+    const byte *end = cursor + zchunk_size (chunk);
+    char *hostname = NULL;
+    char *clock_string = NULL;
+    char *own_pid = NULL;
+    format_t *formats = NULL;
+    size_t formats_size = 0;
+    text_t text = { NULL, 0, 0 };
+    int entries = 0;
+    byte type;
+    while (s_read (&cursor, end, &type, 1)) {
+        if (type == ZBINLOG_HEADER) {
+            zstr_free (&hostname);
+            if (!(hostname = s_read_string (&cursor, end)))
+                break;
+        }
+        else
+        if (type == ZBINLOG_FORMAT) {
+            uint32_t id;
+            char *format = NULL;
+            if (!s_read (&cursor, end, &id, sizeof (id))
+            ||  !(format = s_read_string (&cursor, end))
+            ||  id != formats_size) {
+                zstr_free (&format);
+                break;
+            }
+            formats = (format_t *) realloc (formats, (formats_size + 1) * sizeof (format_t));
+            assert (formats);
+            formats [formats_size].source = NULL;
+            formats [formats_size].segments = NULL;
+            formats [formats_size].size = 0;
+            s_format_parse (&formats [formats_size++], format);
+            zstr_free (&format);
+        }
+        else
+        if (type == ZBINLOG_CLOCK) {
+            zstr_free (&clock_string);
+            zstr_free (&own_pid);
+            if (!(clock_string = s_read_string (&cursor, end)))
+                break;
+            const char *own = strstr (clock_string, ";own:");
+            const char *own_end = own? strchr (own + 5, ';'): NULL;
+            if (!own_end)
+                break;
+            own_pid = strndup (own + 5, own_end - own - 5);
+        }
+        else
+        if (type == ZBINLOG_ENTRY) {
+            uint32_t id;
+            int64_t timestamp;
+            unsigned long value;
+            if (!s_read (&cursor, end, &id, sizeof (id))
+            ||  !s_read (&cursor, end, &timestamp, sizeof (timestamp))
+            ||  !s_read (&cursor, end, &value, sizeof (value))
+            ||  id >= formats_size || !clock_string)
+                break;
+            text.size = 0;
+            s_text_append (&text, "%s", "");
+            size_t index;
+            for (index = 0; index < formats [id].size; index++)
+                if (!s_decode_arg (&formats [id].segments [index], &cursor, end, &text))
+                    break;
+            if (index < formats [id].size)
+                break;
+
+            //  Same layout as the syslog template, unix time with four
+            //  subsecond digits first
+            time_t seconds = (time_t) (timestamp / 1000);
+            struct tm tm;
+            localtime_r (&seconds, &tm);
+            char date [32];
+            strftime (date, sizeof (date), "%Y.%m.%d %H:%M:%S", &tm);
+            char *clock = s_clock_patch (clock_string, own_pid, value);
+            fprintf (file_dst, "%" PRId64 "%04d %s %s zbinlog: /%s/ %s\n",
+                     timestamp / 1000, (int) (timestamp % 1000) * 10, date,
+                     hostname? hostname: "localhost", clock, text.data);
+            zstr_free (&clock);
+            entries++;
+        }
+        else
+            break;
+    }
+
+    size_t index;
+    for (index = 0; index < formats_size; index++)
+        s_format_destroy (&formats [index]);
+    free (formats);
+    free (text.data);
+    zstr_free (&hostname);
+    zstr_free (&clock_string);
+    zstr_free (&own_pid);
+    zchunk_destroy (&chunk);
+    fclose (file_dst);
+    return entries;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+zbinlog_test (bool verbose)
+{
+    printf (" * zbinlog: ");
+
+    //  @selftest
+    const char *path = "zbinlog_test.bin";
+    const char *path_text = "zbinlog_test.log";
+    zsys_file_delete (path);
+
+    zbinlog_t *self = zbinlog_new ();
+    assert (self);
+    zvector_t *clock = zvector_new ("1000");
+    assert (zbinlog_register (self, "%n") == -1);
+    assert (zbinlog_register (self, "%Lf") == -1);
+    int id = zbinlog_register (self, "int %d long %ld size %zu hex %#06x %.2f %% %-4s| %.*s %c");
+    assert (id == 0);
+    zbinlog_log (self, clock, id, -7, 123456789012L, (size_t) 42, 255, 3.14159, "ab", 3, "xyzzy", 'q');
+    assert (zvector_value (clock, "1000") == 1);
+
+    //  Entries refer to the recorded clock until another pid changes
+    size_t size = zbinlog_size (self);
+    zbinlog_log (self, clock, id, 1, 2L, (size_t) 3, 4, 5.0, "s", 0, "", 'c');
+    size_t entry_size = zbinlog_size (self) - size;
+    zmsg_t *msg = zmsg_new ();
+    zmsg_pushstr (msg, "VC:1;own:1001;1001,5;");
+    zvector_recv (clock, msg);
+    zmsg_destroy (&msg);
+    size = zbinlog_size (self);
+    zbinlog_log (self, clock, id, 1, 2L, (size_t) 3, 4, 5.0, "s", 0, "", 'c');
+    assert (zbinlog_size (self) - size > entry_size);
+
+    //  Formats registered after a save are in the next save
+    assert (zbinlog_save (self, path) == 0);
+    assert (zbinlog_size (self) == 0);
+    const char *plain = "plain text";
+    assert (zbinlog_register (self, plain) == 1);
+    assert (zbinlog_format (self, 1) == plain);
+    assert (zbinlog_format (self, 2) == NULL);
+    zbinlog_log (self, clock, 1);
+    assert (zbinlog_register (self, plain) == 1);
+
+    ZBINLOG (self, clock, "peer %s", "1001");
+    assert (zbinlog_save (self, path) == 0);
+    assert (zvector_value (clock, "1000") == 6);
+
+    assert (zbinlog_decode (path, path_text) == 5);
+    zfile_t *file = zfile_new (NULL, path_text);
+    zfile_input (file);
+    const char *line = zfile_readln (file);
+    assert (line);
+    assert (strstr (line, " zbinlog: /VC:1;own:1000;1000,0;/ "
+                          "int -7 long 123456789012 size 42 hex 0x00ff 3.14 % ab  | xyz q"));
+    line = zfile_readln (file);
+    assert (strstr (line, "/VC:1;own:1000;1000,1;/ int 1 long 2 size 3 hex 0x0004 5.00 % s   |  c"));
+    line = zfile_readln (file);
+    assert (strstr (line, "/VC:2;own:1000;1001,5;1000,3;/ int 1"));
+    line = zfile_readln (file);
+    assert (strstr (line, "/VC:2;own:1000;1001,5;1000,4;/ plain text"));
+    line = zfile_readln (file);
+    assert (strstr (line, "/VC:2;own:1000;1001,5;1000,5;/ peer 1001"));
+    assert (zfile_readln (file) == NULL);
+    zfile_destroy (&file);
+
+    //  A truncated record is skipped
+    FILE *truncated = fopen (path, "ab");
+    assert (truncated);
+    fwrite ("E\0\0", 1, 3, truncated);
+    fclose (truncated);
+    assert (zbinlog_decode (path, path_text) == 5);
+    assert (zbinlog_decode ("zbinlog_missing.bin", path_text) == -1);
+
+    //  A call site used with two binlogs registers its format once in each
+    zbinlog_t *other = zbinlog_new ();
+    int registered = 0;
+    while (zbinlog_format (self, registered))
+        registered++;
+    int round;
+    for (round = 0; round < 4; round++) {
+        zbinlog_t *binlog = round % 2? other: self;
+        ZBINLOG (binlog, clock, "call site %d", round);
+    }
+    assert (zbinlog_format (self, registered));
+    assert (zbinlog_format (self, registered + 1) == NULL);
+    assert (zbinlog_format (other, 0));
+    assert (zbinlog_format (other, 1) == NULL);
+    zbinlog_destroy (&other);
+
+    zsys_file_delete (path);
+    zsys_file_delete (path_text);
+    zvector_destroy (&clock);
+    zbinlog_destroy (&self);
+    //  @end
+
+    printf ("OK\n");
+}
@@ -0,0 +1,406 @@
+/*  =========================================================================
+    zbloom - Implements a bloom clock
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zbloom - Implements a bloom clock
+@discuss
+    A bloom clock (Ramabaja 2019) is a causality clock with a fixed size,
+    no matter how many processes there are. It is a counting bloom filter
+    of the events seen: an event of a process increments k of the m cells,
+    chosen by hashing its pid and counter. Receiving a clock takes the
+    highest value of every cell.
+
+    If a happened before b, every cell of a is at most the cell of b. The
+    reverse doesn't hold, cells may be covered by other events, so a
+    happened before answer is only probably right. The probability of a
+    false positive is given by zbloom_false_positive, it grows with the
+    number of events b has seen beyond a. Concurrent and happened after
+    answers are exact.
+
+    A clock is written as BC:$m,$k;$cell1,...,$cellm; and sent anonymously.
+    Clocks of different size can't be compared or merged.
+@end
+*/
+
+#include "zlog_classes.h"
+
+#define ZBLOOM_SIZE 64
+#define ZBLOOM_HASHES 3
+
+//  Structure of our class
+
+struct _zbloom_t {
+    char *own_pid;
+    unsigned long counter;      //  Own events
+    size_t size;                //  Number of cells, m
+    size_t hashes;              //  Cells incremented per event, k
+    unsigned long *cells;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+//  FNV-1a hash of the pid and counter of an event
+
+static uint64_t
+s_hash (const char *pid, unsigned long counter)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *pid; pid++)
+        hash = (hash ^ (byte) *pid) * 1099511628211ULL;
+    int index;
+    for (index = 0; index < 8; index++)
+        hash = (hash ^ (byte) ((uint64_t) counter >> (8 * index))) * 1099511628211ULL;
+    return hash;
+}
+
+//  Returns base to the power of exponent
+
+static double
+s_power (double base, unsigned long exponent)
+{
+    double result = 1;
+    while (exponent) {
+        if (exponent & 1)
+            result *= base;
+        base *= base;
+        exponent >>= 1;
+    }
+    return result;
+}
+
+//  Returns true if every cell of self is at most the cell of other
+
+static bool
+s_leq (zbloom_t *self, zbloom_t *other)
+{
+    size_t index;
+    for (index = 0; index < self->size; index++)
+        if (self->cells [index] > other->cells [index])
+            return false;
+    return true;
+}
+
+static unsigned long
+s_sum (zbloom_t *self)
+{
+    unsigned long sum = 0;
+    size_t index;
+    for (index = 0; index < self->size; index++)
+        sum += self->cells [index];
+    return sum;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new zbloom with size cells, hashes cells are incremented per
+//  event. 0 takes the defaults, 64 cells and 3 hashes.
+
+zbloom_t *
+zbloom_new (const char *pid, size_t size, size_t hashes)
+{
+    assert (pid);
+    zbloom_t *self = (zbloom_t *) zmalloc (sizeof (zbloom_t));
+    assert (self);
+    //  Initialize class properties here
+    self->own_pid = strdup (pid);
+    self->counter = 0;
+    self->size = size? size: ZBLOOM_SIZE;
+    self->hashes = hashes? hashes: ZBLOOM_HASHES;
+    self->cells = (unsigned long *) zmalloc (self->size * sizeof (unsigned long));
+    assert (self->cells);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the zbloom
+
+void
+zbloom_destroy (zbloom_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zbloom_t *self = *self_p;
+        //  Free class properties here
+        zstr_free (&self->own_pid);
+        free (self->cells);
+        //  Free object itself
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Duplicates the given zbloom, returns a freshly allocated duplicate.
+
+zbloom_t *
+zbloom_dup (zbloom_t *self)
+{
+    assert (self);
+    zbloom_t *dup = zbloom_new (self->own_pid, self->size, self->hashes);
+    dup->counter = self->counter;
+    memcpy (dup->cells, self->cells, self->size * sizeof (unsigned long));
+    return dup;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Increments the own clock value
+
+void
+zbloom_event (zbloom_t *self)
+{
+    assert (self);
+    self->counter++;
+    //  Double hashing derives the k cells from one hash
+    uint64_t hash = s_hash (self->own_pid, self->counter);
+    uint64_t first = hash & 0xffffffff;
+    uint64_t step = (hash >> 32) | 1;
+    size_t index;
+    for (index = 0; index < self->hashes; index++)
+        self->cells [(first + index * step) % self->size]++;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Eventing own clock & packing the cells with given msg
+
+zmsg_t *
+zbloom_send_prepare (zbloom_t *self, zmsg_t *msg)
+{
+    assert (self);
+    assert (msg);
+
+    zbloom_event (self);
+    char *clock_string = zbloom_to_string (self);
+    zmsg_pushstr (msg, clock_string);
+    zstr_free (&clock_string);
+    return msg;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Recv the cells & updates own clock. Malformed clocks and clocks of a
+//  different size are ignored.
+
+void
+zbloom_recv (zbloom_t *self, zmsg_t *msg)
+{
+    assert (self);
+    assert (msg);
+
+    char *clock_string = zmsg_popstr (msg);
+    assert (clock_string);
+    zbloom_t *sender = zbloom_from_string (clock_string);
+    zstr_free (&clock_string);
+    if (sender && sender->size == self->size && sender->hashes == self->hashes) {
+        size_t index;
+        for (index = 0; index < self->size; index++)
+            if (sender->cells [index] > self->cells [index])
+                self->cells [index] = sender->cells [index];
+    }
+    zbloom_destroy (&sender);
+    zbloom_event (self);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Compares zbloom self to zbloom other.
+//  Returns -1 at probably happened before other, 0 at parallel, 1 at
+//  probably happened after and 2 when clocks are the same. Clocks of a
+//  different size are parallel.
+
+int
+zbloom_compare_to (zbloom_t *self, zbloom_t *other)
+{
+    assert (self);
+    assert (other);
+    if (self->size != other->size || self->hashes != other->hashes)
+        return 0;
+    bool before = s_leq (self, other);
+    bool after = s_leq (other, self);
+    if (before && after)
+        return 2;
+    return before? -1: after? 1: 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the probability that self happened before other is a false
+//  positive, i.e. that the events of self which other hasn't seen are
+//  covered by the events other has seen beyond self. Returns 0 if self
+//  isn't reported to happen before other.
+
+double
+zbloom_false_positive (zbloom_t *self, zbloom_t *other)
+{
+    assert (self);
+    assert (other);
+    if (zbloom_compare_to (self, other) != -1)
+        return 0;
+    //  A cell is covered if one of the surplus increments hit it
+    unsigned long surplus = s_sum (other) - s_sum (self);
+    double covered = 1 - s_power (1 - 1.0 / self->size, surplus);
+    return s_power (covered, self->hashes);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Converts the zbloom into string representation
+//  formation: 'BC:$m,$k;$cell1,...,$cellm;\0'
+
+char *
+zbloom_to_string (zbloom_t *self)
+{
+    assert (self);
+    //  Header and up to 20 digits and a separator per cell
+    char *result = (char *) zmalloc (2 * 21 + 4 + self->size * 21 + 1);
+    assert (result);
+    char *needle = result;
+    needle += sprintf (needle, "BC:%zu,%zu;", self->size, self->hashes);
+    size_t index;
+    for (index = 0; index < self->size; index++)
+        needle += sprintf (needle, "%lu%c", self->cells [index],
+                           index + 1 < self->size? ',': ';');
+    return result;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Creates an anonymous zbloom from a given string representation. Returns
+//  NULL if the string is malformed.
+
+zbloom_t *
+zbloom_from_string (const char *clock_string)
+{
+    assert (clock_string);
+    if (strncmp (clock_string, "BC:", 3) != 0 || !isdigit ((unsigned char) clock_string [3]))
+        return NULL;
+    char *needle;
+    unsigned long size = strtoul (clock_string + 3, &needle, 10);
+    if (*needle != ',' || !isdigit ((unsigned char) needle [1]))
+        return NULL;
+    unsigned long hashes = strtoul (needle + 1, &needle, 10);
+    //  Every cell takes at least two characters
+    if (*needle != ';' || !size || !hashes || size > strlen (needle) / 2)
+        return NULL;
+
+    zbloom_t *self = zbloom_new ("", size, hashes);
+    size_t index;
+    for (index = 0; index < self->size; index++) {
+        const char *cell = needle + 1;
+        if (!isdigit ((unsigned char) *cell))
+            break;
+        self->cells [index] = strtoul (cell, &needle, 10);
+        if (*needle != (index + 1 < self->size? ',': ';'))
+            break;
+    }
+    if (index < self->size || needle [1]) {
+        zbloom_destroy (&self);
+        return NULL;
+    }
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+zbloom_test (bool verbose)
+{
+    printf (" * zbloom: ");
+
+    //  @selftest
+    //  TEST: representation
+    zbloom_t *self = zbloom_new ("1000", 4, 2);
+    assert (self);
+    char *clock_string = zbloom_to_string (self);
+    assert (streq (clock_string, "BC:4,2;0,0,0,0;"));
+    zstr_free (&clock_string);
+    zbloom_event (self);
+    assert (s_sum (self) == 2);
+    clock_string = zbloom_to_string (self);
+    zbloom_t *copy = zbloom_from_string (clock_string);
+    assert (copy);
+    assert (zbloom_compare_to (self, copy) == 2);
+    zstr_free (&clock_string);
+    zbloom_destroy (&copy);
+    assert (zbloom_from_string ("BC:4,2;0,0,0;") == NULL);
+    assert (zbloom_from_string ("BC:4,2;0,0,0,0,0;") == NULL);
+    assert (zbloom_from_string ("BC:4,2;0,0,x,0;") == NULL);
+    assert (zbloom_from_string ("BC:1000000000,2;0;") == NULL);
+    assert (zbloom_from_string ("BC:0,2;") == NULL);
+    assert (zbloom_from_string ("VC:1;own:a;a,1;") == NULL);
+    zbloom_destroy (&self);
+
+    //  TEST: causality over messages
+    zbloom_t *alice = zbloom_new ("alice", 256, 0);
+    zbloom_t *bob = zbloom_new ("bob", 256, 0);
+    zbloom_t *carol = zbloom_new ("carol", 256, 0);
+    zbloom_event (alice);
+    zbloom_event (carol);
+    zbloom_t *sent = zbloom_dup (alice);
+    zmsg_t *msg = zmsg_new ();
+    zbloom_send_prepare (alice, msg);
+    zbloom_recv (bob, msg);
+    assert (zmsg_size (msg) == 0);
+    assert (zbloom_compare_to (sent, bob) == -1);
+    assert (zbloom_compare_to (bob, sent) == 1);
+    assert (zbloom_compare_to (carol, bob) == 0);
+    assert (zbloom_compare_to (bob, carol) == 0);
+    double false_positive = zbloom_false_positive (sent, bob);
+    assert (false_positive > 0 && false_positive < 0.001);
+    assert (zbloom_false_positive (bob, sent) == 0);
+    assert (zbloom_false_positive (carol, bob) == 0);
+
+    //  The clock keeps its size with many processes, the error grows
+    zbloom_destroy (&sent);
+    sent = zbloom_dup (bob);
+    size_t length = strlen (clock_string = zbloom_to_string (bob));
+    zstr_free (&clock_string);
+    int index;
+    for (index = 0; index < 100; index++) {
+        char pid [16];
+        snprintf (pid, sizeof (pid), "%d", index);
+        zbloom_t *process = zbloom_new (pid, 256, 0);
+        zbloom_event (process);
+        zbloom_send_prepare (process, msg);
+        zbloom_recv (bob, msg);
+        zbloom_destroy (&process);
+    }
+    assert (zbloom_compare_to (sent, bob) == -1);
+    assert (zbloom_false_positive (sent, bob) > false_positive);
+    clock_string = zbloom_to_string (bob);
+    assert (strlen (clock_string) < length + 256 * 3);
+    zstr_free (&clock_string);
+
+    //  Clocks of a different size are ignored
+    zbloom_t *small = zbloom_new ("small", 8, 0);
+    zbloom_send_prepare (small, msg);
+    zbloom_recv (bob, msg);
+    assert (zbloom_compare_to (small, bob) == 0);
+    zmsg_destroy (&msg);
+
+    zbloom_destroy (&small);
+    zbloom_destroy (&sent);
+    zbloom_destroy (&carol);
+    zbloom_destroy (&bob);
+    zbloom_destroy (&alice);
+    //  @end
+
+    printf ("OK\n");
+}
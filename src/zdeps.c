@@ -0,0 +1,686 @@
+/*  =========================================================================
+    zdeps - Rebuilds vector clocks from direct dependencies
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zdeps - Rebuilds vector clocks from direct dependencies
+@discuss
+    With direct dependency tracking (Fowler and Zwaenepoel) a message only
+    carries its sender's pid and counter, and a log record only lists the
+    messages received since the previous record of its process:
+
+        DD:own:$ownPid,$val;$pid1,$val1,$own1;...;$pidx,$valx,$ownx;
+
+    Each listed message names the sender, the sender's state when sending
+    and the own state when receiving. The full vector clock of a record is
+    the transitive closure over these dependencies. It is rebuilt once all
+    records it depends on have been added, and the record is replaced by
+    a 'VC:' clock in its log line, so the lines can be ordered like lines
+    with full clocks. Lines of a process come out in the order they were
+    added.
+
+    The rebuilt clocks of the last ZDEPS_HISTORY_MAX records per process are
+    kept. A dependency on an older state is left out of the clock.
+@end
+*/
+
+#include "zlog_classes.h"
+
+#define ZDEPS_HISTORY_MAX 4096
+
+typedef struct {
+    char *pid;                  //  Sender
+    unsigned long counter;      //  Sender's state when sending
+    unsigned long received;     //  Own state when receiving
+} dep_t;
+
+typedef struct {
+    unsigned long counter;      //  Own state of the record
+    dep_t *deps;                //  Messages received since the previous record
+    size_t deps_size;
+    zhashx_t *clock;            //  Rebuilt clock, NULL until resolved
+    char *line;                 //  Log line, NULL once emitted
+} record_t;
+
+typedef struct {
+    char *pid;
+    record_t **records;         //  Records in order of their counter
+    size_t size;
+    size_t max;
+    size_t resolved;            //  Records before have a rebuilt clock
+    size_t emitted;             //  Records before have been returned
+    bool retired;               //  No more records will be added
+} process_t;
+
+//  Structure of our class
+
+struct _zdeps_t {
+    zhashx_t *processes;        //  process_t by pid
+    size_t pending;             //  Bytes of lines not yet returned
+};
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+static void
+s_destroy_clock_value (void **clock_value_p)
+{
+    assert (clock_value_p);
+    if (*clock_value_p) {
+        unsigned long *clock_value = (unsigned long *) *clock_value_p;
+        free (clock_value);
+    }
+}
+
+static zhashx_t *
+s_clock_new (void)
+{
+    zhashx_t *clock = zhashx_new ();
+    zhashx_set_destructor (clock, s_destroy_clock_value);
+    return clock;
+}
+
+//  Raises the value of pid in clock to at least value
+
+static void
+s_clock_raise (zhashx_t *clock, const char *pid, unsigned long value)
+{
+    unsigned long *own_value = (unsigned long *) zhashx_lookup (clock, pid);
+    if (!own_value) {
+        own_value = (unsigned long *) zmalloc (sizeof (unsigned long));
+        zhashx_insert (clock, pid, own_value);
+    }
+    if (value > *own_value)
+        *own_value = value;
+}
+
+static void
+s_clock_merge (zhashx_t *clock, zhashx_t *other)
+{
+    unsigned long *value = (unsigned long *) zhashx_first (other);
+    while (value) {
+        s_clock_raise (clock, (const char *) zhashx_cursor (other), *value);
+        value = (unsigned long *) zhashx_next (other);
+    }
+}
+
+static void
+s_record_destroy (record_t **self_p)
+{
+    if (*self_p) {
+        record_t *self = *self_p;
+        size_t index;
+        for (index = 0; index < self->deps_size; index++)
+            free (self->deps [index].pid);
+        free (self->deps);
+        zhashx_destroy (&self->clock);
+        zstr_free (&self->line);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+static void
+s_process_destroy (process_t **self_p)
+{
+    if (*self_p) {
+        process_t *self = *self_p;
+        size_t index;
+        for (index = 0; index < self->size; index++)
+            s_record_destroy (&self->records [index]);
+        free (self->records);
+        free (self->pid);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+static process_t *
+s_zdeps_process (zdeps_t *self, const char *pid)
+{
+    process_t *process = (process_t *) zhashx_lookup (self->processes, pid);
+    if (!process) {
+        process = (process_t *) zmalloc (sizeof (process_t));
+        process->pid = strdup (pid);
+        zhashx_insert (self->processes, pid, process);
+    }
+    return process;
+}
+
+//  Parses a comma separated pid and value at the start of string, the pid
+//  ends at the last comma before end. Returns a pointer past the value or
+//  NULL if malformed.
+
+static const char *
+s_parse_pid_value (const char *string, const char *end, char **pid, unsigned long *value)
+{
+    if (end <= string)
+        return NULL;
+    const char *comma = end - 1;
+    while (comma > string && *comma != ',')
+        comma--;
+    if (comma == string || !isdigit ((unsigned char) comma [1]))
+        return NULL;
+    char *value_end;
+    *value = strtoul (comma + 1, &value_end, 10);
+    if (value_end != end)
+        return NULL;
+    *pid = strndup (string, comma - string);
+    return value_end;
+}
+
+//  Parses the direct dependency record of a log line. Returns NULL if the
+//  line has none or it is malformed.
+
+static record_t *
+s_record_parse (const char *logmsg, char **pid)
+{
+    const char *needle = strstr (logmsg, "/DD:own:");
+    if (!needle)
+        return NULL;
+    needle += 8;
+    const char *end = strchr (needle, ';');
+    const char *stop = strchr (needle, '/');
+    if (!end || !stop || end > stop)
+        return NULL;
+
+    record_t *record = (record_t *) zmalloc (sizeof (record_t));
+    if (!s_parse_pid_value (needle, end, pid, &record->counter)) {
+        free (record);
+        return NULL;
+    }
+    size_t deps_max = 0;
+    for (needle = end + 1; needle < stop; needle = end + 1) {
+        end = strchr (needle, ';');
+        if (!end || end > stop)
+            break;
+        //  Triple is pid,counter,received, the pid may contain commas
+        const char *comma = end;
+        while (comma > needle && *comma != ',')
+            comma--;
+        char *value_end;
+        unsigned long received = strtoul (comma + 1, &value_end, 10);
+        if (comma == needle || value_end != end)
+            break;
+        if (record->deps_size == deps_max) {
+            deps_max = deps_max? deps_max * 2: 4;
+            record->deps = (dep_t *) realloc (record->deps, deps_max * sizeof (dep_t));
+            assert (record->deps);
+        }
+        dep_t *dep = &record->deps [record->deps_size];
+        if (!s_parse_pid_value (needle, comma, &dep->pid, &dep->counter))
+            break;
+        dep->received = received;
+        record->deps_size++;
+    }
+    if (needle != stop) {
+        zstr_free (pid);
+        s_record_destroy (&record);
+        return NULL;
+    }
+    record->line = strdup (logmsg);
+    return record;
+}
+
+static bool
+s_zdeps_resolve (zdeps_t *self, process_t *process, size_t index, bool forced);
+
+//  Merges the state counter of process pid into clock. That is the clock
+//  of its last record up to counter, raised by the messages it received
+//  up to counter. Returns false if records are missing, unless forced.
+
+static bool
+s_zdeps_state (zdeps_t *self, const char *pid, unsigned long counter, zhashx_t *clock, bool forced)
+{
+    process_t *process = (process_t *) zhashx_lookup (self->processes, pid);
+    if (!process || !process->size) {
+        if (!forced)
+            return false;
+        s_clock_raise (clock, pid, counter);
+        return true;
+    }
+
+    //  Index of the first record after counter
+    size_t low = 0;
+    size_t high = process->size;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (process->records [middle]->counter <= counter)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low > 0) {
+        if (!s_zdeps_resolve (self, process, low - 1, forced))
+            return false;
+        if (process->records [low - 1]->clock)
+            s_clock_merge (clock, process->records [low - 1]->clock);
+    }
+    if (low < process->size) {
+        record_t *next = process->records [low];
+        size_t index;
+        for (index = 0; index < next->deps_size; index++) {
+            dep_t *dep = &next->deps [index];
+            if (dep->received <= counter
+            &&  !s_zdeps_state (self, dep->pid, dep->counter, clock, forced))
+                return false;
+        }
+    }
+    else
+    if (!process->retired && !forced)
+        return false;           //  Messages received up to counter unknown
+
+    s_clock_raise (clock, pid, counter);
+    return true;
+}
+
+//  Rebuilds the clocks of the records of process up to index. Returns false
+//  if records they depend on are missing, unless forced.
+
+static bool
+s_zdeps_resolve (zdeps_t *self, process_t *process, size_t index, bool forced)
+{
+    while (process->resolved <= index) {
+        record_t *record = process->records [process->resolved];
+        zhashx_t *clock = s_clock_new ();
+        if (process->resolved > 0 && process->records [process->resolved - 1]->clock)
+            s_clock_merge (clock, process->records [process->resolved - 1]->clock);
+        size_t dep;
+        for (dep = 0; dep < record->deps_size; dep++) {
+            if (!s_zdeps_state (self, record->deps [dep].pid, record->deps [dep].counter, clock, forced)) {
+                zhashx_destroy (&clock);
+                return false;
+            }
+        }
+        s_clock_raise (clock, process->pid, record->counter);
+        record->clock = clock;
+        process->resolved++;
+    }
+    return true;
+}
+
+//  Replaces the record of the line by the rebuilt clock
+
+static char *
+s_zdeps_rewrite (record_t *record, const char *pid)
+{
+    const char *begin = strstr (record->line, "/DD:own:");
+    assert (begin);
+    const char *end = strchr (begin + 1, '/');
+    assert (end);
+
+    size_t size = (begin - record->line) + strlen (end) + strlen ("/VC:;own:;") + 20 + strlen (pid) + 1;
+    unsigned long *value = (unsigned long *) zhashx_first (record->clock);
+    while (value) {
+        size += strlen ((const char *) zhashx_cursor (record->clock)) + 22;
+        value = (unsigned long *) zhashx_next (record->clock);
+    }
+    char *line = (char *) zmalloc (size);
+    char *needle = line;
+    memcpy (needle, record->line, begin - record->line);
+    needle += begin - record->line;
+    needle += sprintf (needle, "/VC:%zu;own:%s;", zhashx_size (record->clock), pid);
+    value = (unsigned long *) zhashx_first (record->clock);
+    while (value) {
+        needle += sprintf (needle, "%s,%lu;", (const char *) zhashx_cursor (record->clock), *value);
+        value = (unsigned long *) zhashx_next (record->clock);
+    }
+    strcpy (needle, end);
+    return line;
+}
+
+//  Returns the next line of process if it can be rebuilt, NULL otherwise
+
+static char *
+s_zdeps_emit (zdeps_t *self, process_t *process, bool forced)
+{
+    if (process->emitted == process->size
+    || !s_zdeps_resolve (self, process, process->emitted, forced))
+        return NULL;
+
+    record_t *record = process->records [process->emitted++];
+    char *line = s_zdeps_rewrite (record, process->pid);
+    self->pending -= strlen (record->line) + 1;
+    zstr_free (&record->line);
+
+    //  Forget the oldest history in one go
+    if (process->emitted > 2 * ZDEPS_HISTORY_MAX) {
+        size_t index;
+        for (index = 0; index < ZDEPS_HISTORY_MAX; index++)
+            s_record_destroy (&process->records [index]);
+        process->size -= ZDEPS_HISTORY_MAX;
+        memmove (process->records, process->records + ZDEPS_HISTORY_MAX,
+                 process->size * sizeof (record_t *));
+        process->resolved -= ZDEPS_HISTORY_MAX;
+        process->emitted -= ZDEPS_HISTORY_MAX;
+    }
+    return line;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new zdeps
+
+zdeps_t *
+zdeps_new (void)
+{
+    zdeps_t *self = (zdeps_t *) zmalloc (sizeof (zdeps_t));
+    assert (self);
+    //  Initialize class properties here
+    self->processes = zhashx_new ();
+    zhashx_set_destructor (self->processes, (zhashx_destructor_fn *) s_process_destroy);
+    self->pending = 0;
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the zdeps
+
+void
+zdeps_destroy (zdeps_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zdeps_t *self = *self_p;
+        //  Free class properties here
+        zhashx_destroy (&self->processes);
+        //  Free object itself
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Adds a log line with a direct dependency record. The lines of a process
+//  must be added in order. Returns 0 if the line was taken, -1 if it has no
+//  valid record.
+
+int
+zdeps_add (zdeps_t *self, const char *logmsg)
+{
+    assert (self);
+    assert (logmsg);
+    char *pid = NULL;
+    record_t *record = s_record_parse (logmsg, &pid);
+    if (!record)
+        return -1;
+
+    process_t *process = s_zdeps_process (self, pid);
+    zstr_free (&pid);
+    if (process->size && record->counter <= process->records [process->size - 1]->counter) {
+        s_record_destroy (&record);
+        return -1;              //  Out of order or duplicate
+    }
+    if (process->size == process->max) {
+        process->max = process->max? process->max * 2: 16;
+        process->records = (record_t **) realloc (process->records, process->max * sizeof (record_t *));
+        assert (process->records);
+    }
+    process->records [process->size++] = record;
+    self->pending += strlen (logmsg) + 1;
+    return 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the next line whose clock could be rebuilt, the record replaced
+//  by the full vector clock. Returns NULL if no line is complete yet.
+//  Caller owns the line.
+
+char *
+zdeps_next (zdeps_t *self)
+{
+    assert (self);
+    process_t *process = (process_t *) zhashx_first (self->processes);
+    while (process) {
+        char *line = s_zdeps_emit (self, process, false);
+        if (line)
+            return line;
+        process = (process_t *) zhashx_next (self->processes);
+    }
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the next line like zdeps_next, but rebuilds it even if records
+//  it depends on are missing. Their dependencies are left out of the
+//  clock. Returns NULL if there are no lines left. Caller owns the line.
+
+char *
+zdeps_flush (zdeps_t *self)
+{
+    assert (self);
+    char *line = zdeps_next (self);
+    process_t *process = (process_t *) zhashx_first (self->processes);
+    while (process && !line) {
+        line = s_zdeps_emit (self, process, true);
+        process = (process_t *) zhashx_next (self->processes);
+    }
+    return line;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Marks pid as departed, no more records of it will be added. Records
+//  waiting for its later records are rebuilt from what is known.
+
+void
+zdeps_retire (zdeps_t *self, const char *pid)
+{
+    assert (self);
+    assert (pid);
+    s_zdeps_process (self, pid)->retired = true;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the bytes of the lines not yet returned
+
+size_t
+zdeps_pending (zdeps_t *self)
+{
+    assert (self);
+    return self->pending;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns copies of the lines not yet returned as they were added, in the
+//  order of each process. Caller owns the list.
+
+zlistx_t *
+zdeps_pending_lines (zdeps_t *self)
+{
+    assert (self);
+    zlistx_t *lines = zlistx_new ();
+    zlistx_set_destructor (lines, (zlistx_destructor_fn *) zstr_free);
+    process_t *process = (process_t *) zhashx_first (self->processes);
+    while (process) {
+        size_t index;
+        for (index = process->emitted; index < process->size; index++)
+            if (process->records [index]->line)
+                zlistx_add_end (lines, strdup (process->records [index]->line));
+        process = (process_t *) zhashx_next (self->processes);
+    }
+    return lines;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Reads the log of source filepath and writes it to destination filepath
+//  with the direct dependency records replaced by full vector clocks.
+//  Lines without a record are copied as they are. Returns the number of
+//  rebuilt lines.
+
+size_t
+zdeps_rebuild_log (const char *path_src, const char *path_dst)
+{
+    assert (path_src);
+    assert (path_dst);
+
+    zfile_t *file_src = zfile_new (NULL, path_src);
+    FILE *file_dst = fopen (path_dst, "w");
+    assert (file_src);
+    assert (file_dst);
+
+    zfile_input (file_src);
+    zdeps_t *self = zdeps_new ();
+    size_t rebuilt = 0;
+    char *line;
+    const char *logmsg = zfile_readln (file_src);
+    while (logmsg) {
+        if (zdeps_add (self, logmsg) == 0) {
+            while ((line = zdeps_next (self))) {
+                fprintf (file_dst, "%s\n", line);
+                zstr_free (&line);
+                rebuilt++;
+            }
+        }
+        else
+            fprintf (file_dst, "%s\n", logmsg);
+        logmsg = zfile_readln (file_src);
+    }
+    //  All records are in, the remaining ones depend on lost records
+    while ((line = zdeps_flush (self))) {
+        fprintf (file_dst, "%s\n", line);
+        zstr_free (&line);
+        rebuilt++;
+    }
+
+    zdeps_destroy (&self);
+    zfile_destroy (&file_src);
+    fclose (file_dst);
+    return rebuilt;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+zdeps_test (bool verbose)
+{
+    printf (" * zdeps: ");
+
+    //  @selftest
+    //  Process a sends to b, b forwards to c. c learns of a only transitively.
+    zdeps_t *self = zdeps_new ();
+    assert (self);
+    assert (zdeps_add (self, "I: c /DD:own:c,3;b,4,2;/ got it") == 0);
+    assert (zdeps_next (self) == NULL);
+    assert (zdeps_add (self, "I: b /DD:own:b,1;/ start") == 0);
+    assert (zdeps_add (self, "I: b /DD:own:b,5;a,2,3;/ forward") == 0);
+    assert (zdeps_add (self, "I: a /DD:own:a,1;/ send") == 0);
+    assert (zdeps_add (self, "I: a /DD:own:a,1;/ duplicate") == -1);
+    assert (zdeps_add (self, "I: a /VC:1;own:a;a,1;/ whole clock") == -1);
+    assert (zdeps_add (self, "I: a /DD:own:a,x;/ malformed") == -1);
+    assert (zdeps_add (self, "I: a /DD:own:a,2;b,1;/ malformed") == -1);
+    assert (zdeps_pending (self) > 0);
+    zlistx_t *pending = zdeps_pending_lines (self);
+    assert (zlistx_size (pending) == 4);
+    bool found = false;
+    const char *pending_line = (const char *) zlistx_first (pending);
+    while (pending_line) {
+        if (streq (pending_line, "I: c /DD:own:c,3;b,4,2;/ got it"))
+            found = true;
+        pending_line = (const char *) zlistx_next (pending);
+    }
+    assert (found);
+    zlistx_destroy (&pending);
+
+    //  b's state 4 received a's message at 3, but only b's record at 5
+    //  lists it. c needs a's later records to know a's state 2 fully.
+    size_t lines = 0;
+    char *line;
+    while ((line = zdeps_next (self))) {
+        assert (!strstr (line, "forward"));
+        assert (!strstr (line, "got it"));
+        zstr_free (&line);
+        lines++;
+    }
+    assert (lines == 2);
+    assert (zdeps_add (self, "I: a /DD:own:a,6;/ more") == 0);
+    lines = 0;
+    while ((line = zdeps_next (self))) {
+        if (strstr (line, "got it")) {
+            char *clock_string = strndup (strstr (line, "/VC:") + 1, strlen (strstr (line, "/VC:")) - 9);
+            zvector_t *clock = zvector_from_string (clock_string);
+            assert (zvector_size (clock) == 3);
+            assert (zvector_value (clock, "c") == 3);
+            assert (zvector_value (clock, "b") == 4);
+            assert (zvector_value (clock, "a") == 2);
+            zvector_destroy (&clock);
+            zstr_free (&clock_string);
+        }
+        if (strstr (line, "more"))
+            assert (strstr (line, "/VC:1;own:a;a,6;/ more"));
+        zstr_free (&line);
+        lines++;
+    }
+    assert (lines == 3);
+    assert (zdeps_pending (self) == 0);
+
+    //  A departed process releases records waiting for it
+    assert (zdeps_add (self, "I: d /DD:own:d,2;e,1,1;/ from e") == 0);
+    assert (zdeps_add (self, "I: e /DD:own:e,0;/ e") == 0);
+    line = zdeps_next (self);
+    assert (line && strstr (line, "own:e;"));
+    zstr_free (&line);
+    assert (zdeps_next (self) == NULL);
+    zdeps_retire (self, "e");
+    line = zdeps_next (self);
+    assert (line && strstr (line, "/VC:2;own:d;"));
+    zstr_free (&line);
+
+    //  Flush leaves out what is missing
+    assert (zdeps_add (self, "I: f /DD:own:f,2;g,7,1;/ from g") == 0);
+    assert (zdeps_next (self) == NULL);
+    line = zdeps_flush (self);
+    assert (line && strstr (line, "/VC:2;own:f;"));
+    assert (strstr (line, "g,7;"));
+    zstr_free (&line);
+    assert (zdeps_flush (self) == NULL);
+    zdeps_destroy (&self);
+
+    //  Rebuild a log file offline
+    const char *path_src = "zdeps_test.log";
+    const char *path_dst = "zdeps_test_rebuilt.log";
+    FILE *file = fopen (path_src, "w");
+    assert (file);
+    fprintf (file, "I: q /DD:own:q,2;p,2,1;/ recv\n");
+    fprintf (file, "no record\n");
+    fprintf (file, "I: p /DD:own:p,0;/ send\n");
+    fprintf (file, "I: p /DD:own:p,3;/ done\n");
+    fclose (file);
+    assert (zdeps_rebuild_log (path_src, path_dst) == 3);
+    zfile_t *rebuilt = zfile_new (NULL, path_dst);
+    zfile_input (rebuilt);
+    assert (streq (zfile_readln (rebuilt), "no record"));
+    lines = 0;
+    const char *logmsg;
+    while ((logmsg = zfile_readln (rebuilt))) {
+        assert (strstr (logmsg, "/VC:"));
+        assert (!strstr (logmsg, "/DD:"));
+        lines++;
+    }
+    assert (lines == 3);
+    zfile_destroy (&rebuilt);
+    zsys_file_delete (path_src);
+    zsys_file_delete (path_dst);
+    //  @end
+
+    printf ("OK\n");
+}
@@ -20,6 +20,16 @@
             initiator. It it used to collect things from peers. Collectables are
             e.g. ACKs or arbitrary data.
 @discuss
+    Each wave is identified by its wave id. The state of every wave in
+    progress is kept in a small table so that several waves can overlap.
+    Waves that receive no tokens for the wave timeout are dropped.
+
+    The spanning tree built by the newest concluded INFORM flood is cached.
+    Later waves send TREE tokens along the cached tree edges only, which needs n-1
+    instead of 2|E| messages. A node whose cache does not match answers a
+    TREE token with RESET, which invalidates the cache up to the initiator
+    so that the next wave floods again. Membership changes must be reported
+    with zecho_reset_tree.
 @end
 */
 
@@ -28,9 +38,17 @@
 //  Structure of our class
 
 struct _zecho_t {
-    unsigned int recv_msg;      //  Counts the number of received messages.
-    char *father;               //  Father in the echo wave
-    char *wave_id;              //  Id of the current wave
+    zhashx_t *waves;            //  Active waves, keyed by wave id
+    char *wave_id;              //  Id of the last initiated or handled wave
+    unsigned int wave_seq;      //  Number of waves initiated by self
+    size_t max_waves;           //  Maximum number of concurrent waves
+    int64_t wave_timeout;       //  Msecs after which an idle wave expires
+
+    bool tree_reuse;            //  Reuse cached spanning tree?
+    char *tree_father;          //  Father in cached spanning tree
+    zlist_t *tree_children;     //  Children in cached spanning tree
+    unsigned long tree_neighbors;   //  Number of neighbors when cached
+    char *tree_wave;            //  Id of the flood that built the cached tree
 
     void *inform_handler;                   //  Inform handler object
     zecho_process_fn *inform_process_fn;    //  Process inform messages
@@ -38,12 +56,61 @@ struct _zecho_t {
     void *collect_handler;                  //  Collect handler object
     zecho_process_fn *collect_process_fn;   //  Process collect messages
     zecho_create_fn *collect_create_fn;     //  Create own collect message
+    zecho_reduce_fn *collect_reduce_fn;     //  Combine collect messages
 
     zyre_t *node;       //  Own zyre handle (not owned!)
     zvector_t *clock;   //  vector clock handle (not owned!)
+    zhlc_t *hlc;        //  hybrid logical clock handle (not owned!)
+    zmetrics_t *metrics;    //  metrics handle (not owned!)
+    size_t metric_sent;         //  Handle of sent.ZECHO
+    size_t metric_bytes_sent;   //  Handle of bytes_sent.ZECHO
+    size_t metric_clock_bytes;  //  Handle of clock.bytes_sent
     bool verbose;       //  verbose logging?
 };
 
+//  State of a single echo wave
+
+typedef struct {
+    unsigned int recv_msg;      //  Counts the number of received messages.
+    char *father;               //  Father in the echo wave
+    int64_t last_active;        //  Time of the last token for this wave
+    zmsg_t *collected;          //  Reduced collect messages of children
+    zlist_t *children;          //  Peers that answered with COLLECT
+    unsigned long expected;     //  Expected tokens on a tree wave, else 0
+    bool stale;                 //  Cached tree turned out to be outdated
+} wave_t;
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+static wave_t *
+s_wave_new (const char *father)
+{
+    wave_t *self = (wave_t *) zmalloc (sizeof (wave_t));
+    assert (self);
+    self->recv_msg = 0;
+    self->father = strdup (father);
+    self->last_active = zclock_mono ();
+    self->children = zlist_new ();
+    zlist_autofree (self->children);
+    return self;
+}
+
+static void
+s_wave_destroy (wave_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        wave_t *self = *self_p;
+        zstr_free (&self->father);
+        zmsg_destroy (&self->collected);
+        zlist_destroy (&self->children);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
 
 //  --------------------------------------------------------------------------
 //  Create a new zecho
@@ -54,9 +121,16 @@ zecho_new (zyre_t *node)
     zecho_t *self = (zecho_t *) zmalloc (sizeof (zecho_t));
     assert (self);
     //  Initialize class properties here
-    self->recv_msg = 0;
-    self->father = NULL;
+    self->waves = zhashx_new ();
+    zhashx_set_destructor (self->waves, (zhashx_destructor_fn *) s_wave_destroy);
     self->wave_id = NULL;
+    self->wave_seq = 0;
+    self->max_waves = 16;
+    self->wave_timeout = 30000;
+    self->tree_reuse = true;
+    self->tree_father = NULL;
+    self->tree_children = NULL;
+    self->tree_wave = NULL;
     self->node = node;
     return self;
 }
@@ -72,8 +146,11 @@ zecho_destroy (zecho_t **self_p)
     if (*self_p) {
         zecho_t *self = *self_p;
         //  Free class properties here
-        zstr_free (&self->father);
+        zhashx_destroy (&self->waves);
         zstr_free (&self->wave_id);
+        zstr_free (&self->tree_father);
+        zlist_destroy (&self->tree_children);
+        zstr_free (&self->tree_wave);
         //  Free object itself
         free (self);
         *self_p = NULL;
@@ -82,15 +159,135 @@ zecho_destroy (zecho_t **self_p)
 
 
 //  --------------------------------------------------------------------------
-//  Initiate the echo algorithm
+//  Remember the id of the wave that is initiated or handled right now.
 
-void
-zecho_init (zecho_t *self)
+static void
+s_zecho_set_wave_id (zecho_t *self, const char *wave_id)
 {
     assert (self);
-    self->father = strdup("initiator");
-    self->wave_id = strdup (zyre_uuid (self->node));
+    if (self->wave_id != wave_id) {
+        zstr_free (&self->wave_id);
+        self->wave_id = strdup (wave_id);
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Drop all waves that have been idle for longer than the wave timeout.
+//  Tokens of dropped waves will be rejected by zecho_recv.
+
+static void
+s_zecho_expire_waves (zecho_t *self)
+{
+    assert (self);
+    int64_t now = zclock_mono ();
+    zlistx_t *wave_ids = zhashx_keys (self->waves);
+    const char *wave_id = (const char *) zlistx_first (wave_ids);
+    while (wave_id) {
+        wave_t *wave = (wave_t *) zhashx_lookup (self->waves, wave_id);
+        if (now - wave->last_active > self->wave_timeout) {
+            if (self->verbose)
+                zsys_info ("Expire wave %s\n", wave_id);
+            zhashx_delete (self->waves, wave_id);
+        }
+        wave_id = (const char *) zlistx_next (wave_ids);
+    }
+    zlistx_destroy (&wave_ids);
+}
+
 
+//  --------------------------------------------------------------------------
+//  Insert a new wave into the wave table. If the table is full the least
+//  recently active wave is evicted.
+
+static wave_t *
+s_zecho_insert_wave (zecho_t *self, const char *wave_id, const char *father)
+{
+    assert (self);
+    if (zhashx_size (self->waves) >= self->max_waves) {
+        const char *oldest_id = NULL;
+        int64_t oldest_active = 0;
+        wave_t *wave = (wave_t *) zhashx_first (self->waves);
+        while (wave) {
+            if (!oldest_id || wave->last_active < oldest_active) {
+                oldest_id = (const char *) zhashx_cursor (self->waves);
+                oldest_active = wave->last_active;
+            }
+            wave = (wave_t *) zhashx_next (self->waves);
+        }
+        if (oldest_id) {
+            if (self->verbose)
+                zsys_info ("Evict wave %s\n", oldest_id);
+            zhashx_delete (self->waves, oldest_id);
+        }
+    }
+    wave_t *wave = s_wave_new (father);
+    zhashx_insert (self->waves, wave_id, wave);
+    return wave;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns true if tokens with direction flow back to the initiator.
+
+static bool
+s_is_collect (const char *direction)
+{
+    return streq (direction, "COLLECT") || streq (direction, "RESET");
+}
+
+
+//  --------------------------------------------------------------------------
+//  Send an INFORM, TREE, COLLECT or RESET token of the given wave to peer
+
+static void
+s_zecho_send (zecho_t *self, const char *wave_id, const char *direction, const char *peer,
+              zmsg_t **payload_p)
+{
+    assert (self);
+    zmsg_t *wave_msg = zmsg_new ();
+    zmsg_addstr (wave_msg, "ZECHO");
+    zmsg_addstr (wave_msg, wave_id);
+    zmsg_addstr (wave_msg, direction);
+    //  TREE tokens name the flood that built the tree they follow
+    if (streq (direction, "TREE"))
+        zmsg_addstr (wave_msg, self->tree_wave);
+    //  Use given payload or get inform or collect message from handler
+    if (payload_p && *payload_p)
+        zmsg_addmsg (wave_msg, payload_p);
+    else
+    if (!s_is_collect (direction) && self->inform_create_fn) {
+        zmsg_t *handler_msg = self->inform_create_fn (self, self->inform_handler);
+        zmsg_addmsg (wave_msg, &handler_msg);
+    }
+    else
+    if (s_is_collect (direction) && self->collect_create_fn) {
+        zmsg_t *handler_msg = self->collect_create_fn (self, self->collect_handler);
+        zmsg_addmsg (wave_msg, &handler_msg);
+    }
+    if (self->hlc)
+        zhlc_send_prepare (self->hlc, wave_msg);
+    else
+    if (self->clock)
+        zvector_send_prepare (self->clock, wave_msg);
+
+    if (self->metrics) {
+        zmetrics_count (self->metrics, self->metric_sent, 1);
+        zmetrics_count (self->metrics, self->metric_bytes_sent, zmsg_content_size (wave_msg));
+        if (self->hlc || self->clock)
+            zmetrics_count (self->metrics, self->metric_clock_bytes, zframe_size (zmsg_first (wave_msg)));
+    }
+    zyre_whisper (self->node, peer, &wave_msg);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Send INFORM token of the given wave to all neighbors but father
+
+static void
+s_zecho_inform (zecho_t *self, const char *wave_id, const char *father)
+{
+    assert (self);
     zlist_t *groups = zyre_own_groups (self->node);
     const char *group = (const char *) zlist_first (groups);
     while (group) {
@@ -100,22 +297,10 @@ zecho_init (zecho_t *self)
 
         char *neighbor = (char *) zlist_first (neighbors);
         while (neighbor) {
-            if (!streq (neighbor, self->father)) {
-                //  Send token to neighbor
-                zmsg_t *inform_msg = zmsg_new ();
-                zmsg_addstr (inform_msg, "ZECHO");
-                zmsg_addstr (inform_msg, self->wave_id);
-                zmsg_addstr (inform_msg, "INFORM");
-                //  Get inform message from handler
-                if (self->inform_create_fn) {
-                    zmsg_t *handler_msg = self->inform_create_fn (self, self->inform_handler);
-                    zmsg_addmsg (inform_msg, &handler_msg);
-                }
-                if (self->clock)
-                    zvector_send_prepare (self->clock, inform_msg);
-
-                //  Send INFORM message to neighbor
-                zyre_whisper (self->node, neighbor, &inform_msg);
+            if (!streq (neighbor, father)) {
+                s_zecho_send (self, wave_id, "INFORM", neighbor, NULL);
+                if (self->verbose)
+                    zsys_info ("Forward to %s in group %s\n", neighbor, group);
             }
             //  Get next item in list
             neighbor = (char *) zlist_next (neighbors);
@@ -150,146 +335,291 @@ s_zecho_neighbor_count (zecho_t *self)
 
 
 //  --------------------------------------------------------------------------
-//  Handle a received echo token
+//  Returns true if the cached spanning tree may be used. The cache is
+//  dropped if the number of neighbors changed since it was built.
 
-int
-zecho_recv (zecho_t *self, zyre_event_t *token)
+static bool
+s_zecho_tree_valid (zecho_t *self)
 {
     assert (self);
-    assert (token);
-    self->recv_msg++;
+    if (!self->tree_reuse || !self->tree_father)
+        return false;
+    if (self->tree_neighbors != s_zecho_neighbor_count (self)) {
+        zecho_reset_tree (self);
+        return false;
+    }
+    return true;
+}
+
 
-    char *wave_id = zmsg_popstr (zyre_event_msg (token));
-    if (self->father && !streq (self->wave_id, wave_id)) {
-        zstr_free (&wave_id);
-        zyre_event_destroy (&token);
-        return -1;     //  Wrong wave
+//  --------------------------------------------------------------------------
+//  Returns true if wave_id was initiated after the flood that built the
+//  cached tree. Wave ids are "<initiator>-<sequence>", a wave of another
+//  initiator always replaces the tree.
+
+static bool
+s_zecho_wave_newer (zecho_t *self, const char *wave_id)
+{
+    assert (self);
+    if (!self->tree_wave)
+        return true;
+    const char *seq = strrchr (wave_id, '-');
+    const char *tree_seq = strrchr (self->tree_wave, '-');
+    if (!seq || !tree_seq
+    ||  seq - wave_id != tree_seq - self->tree_wave
+    ||  strncmp (wave_id, self->tree_wave, seq - wave_id) != 0)
+        return true;
+    return strtoul (seq + 1, NULL, 10) > strtoul (tree_seq + 1, NULL, 10);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Remember the spanning tree of a concluded INFORM flood. Floods may
+//  overlap and conclude in any order, only the newest one is cached so that
+//  all nodes cache the tree of the same flood.
+
+static void
+s_zecho_cache_tree (zecho_t *self, const char *wave_id, wave_t *wave)
+{
+    assert (self);
+    assert (wave);
+    if (!s_zecho_wave_newer (self, wave_id))
+        return;
+    zecho_reset_tree (self);
+    self->tree_father = strdup (wave->father);
+    self->tree_children = wave->children;
+    wave->children = NULL;
+    self->tree_neighbors = s_zecho_neighbor_count (self);
+    zstr_free (&self->tree_wave);
+    self->tree_wave = strdup (wave_id);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Send TREE token of the given wave to all children of the cached tree
+
+static void
+s_zecho_inform_tree (zecho_t *self, const char *wave_id)
+{
+    assert (self);
+    const char *child = (const char *) zlist_first (self->tree_children);
+    while (child) {
+        s_zecho_send (self, wave_id, "TREE", child, NULL);
+        if (self->verbose)
+            zsys_info ("Forward to child %s\n", child);
+        child = (const char *) zlist_next (self->tree_children);
     }
+}
 
-    char *wave_direction = zmsg_popstr (zyre_event_msg (token));
-    if (!self->father) {
-        self->father = strdup (zyre_event_peer_uuid (token));
-        self->wave_id = wave_id;
-        //  Forward token to all neighbors but father
-        zlist_t *groups = zyre_own_groups (self->node);
-        const char *group = (const char *) zlist_first (groups);
-        while (group) {
-            zlist_t *neighbors = zyre_peers_by_group (self->node, group);
-            char *neighbor = (char *) zlist_first (neighbors);
-            while (neighbor) {
-                if (!streq (neighbor, self->father)) {
-                    zmsg_t *inform_msg = zmsg_new ();
-                    zmsg_addstr (inform_msg, "ZECHO");
-                    zmsg_addstr (inform_msg, self->wave_id);
-                    zmsg_addstr (inform_msg, "INFORM");
-                    //  Process inform message
-                    if (self->inform_process_fn) {
-                        zmsg_t *msg = zyre_event_msg (token);
-                        zmsg_t *popmsg = zmsg_popmsg (msg);
-                        self->inform_process_fn (self, popmsg, self->inform_handler);
-                    }
-
-                    //  Get inform message from handler
-                    if (self->inform_create_fn) {
-                        zmsg_t *handler_msg = self->inform_create_fn (self, self->inform_handler);
-                        zmsg_addmsg (inform_msg, &handler_msg);
-                    }
-                    if (self->clock)
-                        zvector_send_prepare (self->clock, inform_msg);
-
-                    //  Send INFORM message to neighbor
-                    zyre_whisper (self->node, neighbor, &inform_msg);
-                    if (self->verbose)
-                        zsys_info ("Forward to %s in group %s\n", neighbor, group);
-
-                }
-                //  Get next item in list
-                neighbor = (char *) zlist_next (neighbors);
-            }
 
-            group = (const char *) zlist_next (groups);
-            zlist_destroy (&neighbors);
-        }
-        zlist_destroy (&groups);
-        zyre_event_destroy (&token);
+//  --------------------------------------------------------------------------
+//  Initiate the echo algorithm. Returns the id of the new wave. Several waves
+//  may be in progress at the same time.
+
+const char *
+zecho_init (zecho_t *self)
+{
+    assert (self);
+    s_zecho_expire_waves (self);
+
+    char *wave_id = zsys_sprintf ("%s-%u", zyre_uuid (self->node), ++self->wave_seq);
+    wave_t *wave = s_zecho_insert_wave (self, wave_id, "initiator");
+    s_zecho_set_wave_id (self, wave_id);
+    if (s_zecho_tree_valid (self)
+    &&  streq (self->tree_father, "initiator")
+    &&  zlist_size (self->tree_children) > 0) {
+        wave->expected = zlist_size (self->tree_children);
+        s_zecho_inform_tree (self, wave_id);
+    }
+    else {
+        s_zecho_inform (self, wave_id, "initiator");
+        //  Without neighbors the wave would never conclude
+        if (s_zecho_neighbor_count (self) == 0)
+            zhashx_delete (self->waves, wave_id);
+    }
+
+    zstr_free (&wave_id);
+    return self->wave_id;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Combine two collect messages with the reduce function. Takes ownership of
+//  both messages.
+
+static zmsg_t *
+s_zecho_reduce (zecho_t *self, zmsg_t *acc, zmsg_t *msg)
+{
+    assert (self);
+    assert (self->collect_reduce_fn);
+    if (!acc)
+        return msg;
+    if (!msg)
+        return acc;
+    return self->collect_reduce_fn (self, acc, msg, self->collect_handler);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Fold own collect message into the reduced collect messages of a wave's
+//  children. Returns the result and passes its ownership to the caller.
+
+static zmsg_t *
+s_zecho_reduce_own (zecho_t *self, wave_t *wave)
+{
+    assert (self);
+    assert (wave);
+    zmsg_t *payload = wave->collected;
+    wave->collected = NULL;
+    if (self->collect_create_fn) {
+        zmsg_t *own_msg = self->collect_create_fn (self, self->collect_handler);
+        payload = s_zecho_reduce (self, payload, own_msg);
     }
+    return payload;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Pass the payload of a token to the matching process function. If a reduce
+//  function is set collect messages are combined into the wave instead.
+
+static void
+s_zecho_process (zecho_t *self, wave_t *wave, zmsg_t *msg, const char *direction)
+{
+    assert (self);
+    zmsg_t *payload = zmsg_popmsg (msg);
+    if (!payload)
+        return;
+
+    if (s_is_collect (direction) && self->collect_reduce_fn)
+        wave->collected = s_zecho_reduce (self, wave->collected, payload);
+    else
+    if (!s_is_collect (direction) && self->inform_process_fn)
+        self->inform_process_fn (self, payload, self->inform_handler);
     else
-        zstr_free (&wave_id);
+    if (s_is_collect (direction) && self->collect_process_fn)
+        self->collect_process_fn (self, payload, self->collect_handler);
+    else
+        zmsg_destroy (&payload);
+}
 
-    if (self->recv_msg == s_zecho_neighbor_count (self)) {
-        if (streq (self->father, "initiator")) {
-            //  Decide
-            if (token && self->collect_process_fn) {
-                zmsg_t *msg = zyre_event_msg (token);
-                self->collect_process_fn (self, zmsg_popmsg (msg), self->collect_handler);
+
+//  --------------------------------------------------------------------------
+//  Handle a received echo token. Returns 1 if the token's wave is concluded
+//  on this node, 0 if the wave is still in progress and -1 if the token
+//  belongs to an unknown or expired wave.
+
+int
+zecho_recv (zecho_t *self, zyre_event_t *token)
+{
+    assert (self);
+    assert (token);
+    ZLOG_TRACE_BEGIN ("zecho_recv");
+    s_zecho_expire_waves (self);
+
+    zmsg_t *msg = zyre_event_msg (token);
+    char *wave_id = zmsg_popstr (msg);
+    char *wave_direction = zmsg_popstr (msg);
+    const char *sender = zyre_event_peer_uuid (token);
+    int rc = 0;
+
+    wave_t *wave = (wave_t *) zhashx_lookup (self->waves, wave_id);
+    if (!wave) {
+        if (s_is_collect (wave_direction)) {
+            rc = -1;     //  Wave unknown or already expired
+            goto cleanup;
+        }
+        s_zecho_set_wave_id (self, wave_id);
+        if (streq (wave_direction, "TREE")) {
+            char *tree_wave = zmsg_popstr (msg);
+            bool outdated = !s_zecho_tree_valid (self)
+                         || !streq (self->tree_father, sender)
+                         || !tree_wave || !streq (self->tree_wave, tree_wave);
+            zstr_free (&tree_wave);
+            if (outdated) {
+                //  Cached tree is outdated or was built by another flood
+                //  than the father's, answer as leaf and force a flood
+                if (self->verbose)
+                    zsys_info ("Reset tree of wave %s\n", wave_id);
+                zecho_reset_tree (self);
+                s_zecho_send (self, wave_id, "RESET", sender, NULL);
+                rc = 1;
+                goto cleanup;
             }
+            //  First token of this wave, follow the cached tree
+            wave = s_zecho_insert_wave (self, wave_id, sender);
+            wave->expected = zlist_size (self->tree_children) + 1;
+            s_zecho_process (self, wave, msg, wave_direction);
+            s_zecho_inform_tree (self, wave_id);
+        }
+        else {
+            //  First token of this wave, sender becomes father
+            wave = s_zecho_insert_wave (self, wave_id, sender);
+            s_zecho_process (self, wave, msg, wave_direction);
+            //  Forward token to all neighbors but father
+            s_zecho_inform (self, wave_id, wave->father);
+        }
+    }
+    else {
+        s_zecho_set_wave_id (self, wave_id);
+        s_zecho_process (self, wave, msg, wave_direction);
+        if (streq (wave_direction, "COLLECT")) {
+            if (!wave->expected)
+                zlist_append (wave->children, (void *) sender);
+            if (self->verbose)
+                zsys_info ("Received from peer\n");
+        }
+        else
+        if (streq (wave_direction, "RESET")) {
+            wave->stale = true;
+            zecho_reset_tree (self);
+        }
+    }
+    wave->recv_msg++;
+    wave->last_active = zclock_mono ();
+
+    unsigned long expected = wave->expected? wave->expected: s_zecho_neighbor_count (self);
+    if (wave->recv_msg == expected) {
+        //  A concluded flood spans a tree that later waves can reuse
+        if (!wave->expected && !wave->stale && self->tree_reuse)
+            s_zecho_cache_tree (self, wave_id, wave);
 
+        if (streq (wave->father, "initiator")) {
+            //  Decide
+            if (self->collect_reduce_fn) {
+                zmsg_t *payload = s_zecho_reduce_own (self, wave);
+                if (payload && self->collect_process_fn)
+                    self->collect_process_fn (self, payload, self->collect_handler);
+                else
+                    zmsg_destroy (&payload);
+            }
             if (self->verbose)
                 zsys_info ("Decide\n");
         }
         else {
-            zmsg_t *collect_msg = zmsg_new ();
-            zmsg_addstr (collect_msg, "ZECHO");
-            zmsg_addstr (collect_msg, self->wave_id);
-            zmsg_addstr (collect_msg, "COLLECT");
-            //  Process message from peer
-            if (token) {
-                if (streq (wave_direction, "INFORM")) {
-                    if (self->inform_process_fn) {
-                        zmsg_t *msg = zyre_event_msg (token);
-                        zmsg_t *popmsg = zmsg_popmsg (msg);
-                        self->inform_process_fn (self, popmsg, self->inform_handler);
-                    }
-                }
-                else
-                if (streq (wave_direction, "COLLECT")) {
-                    if (self->collect_process_fn) {
-                        zmsg_t *msg = zyre_event_msg (token);
-                        zmsg_t *popmsg = zmsg_popmsg (msg);
-                        self->collect_process_fn (self, popmsg, self->collect_handler);
-                    }
-                }
-            }
-
-            //  Get collect message from handler
-            if (self->collect_create_fn) {
-                zmsg_t *handler_msg = self->collect_create_fn (self, self->collect_handler);
-                zmsg_addmsg (collect_msg, &handler_msg);
-            }
-            if (self->clock)
-                zvector_send_prepare (self->clock, collect_msg);
-
             //  Send COLLECT message to father
-            zyre_whisper (self->node, self->father, &collect_msg);
+            zmsg_t *payload = NULL;
+            if (self->collect_reduce_fn)
+                payload = s_zecho_reduce_own (self, wave);
+            s_zecho_send (self, wave_id, wave->stale? "RESET": "COLLECT", wave->father, &payload);
             if (self->verbose)
                 zsys_info ("Send to father\n");
-
         }
-        zyre_event_destroy (&token);
-        zstr_free (&wave_direction);
-        return 1;
+        zhashx_delete (self->waves, wave_id);
+        rc = 1;
     }
-    else
-    if (streq (wave_direction, "COLLECT")) {
-        //  Process collect message from peer
-        if (self->collect_process_fn) {
-            zmsg_t *msg = zyre_event_msg (token);
-            zmsg_t *popmsg = zmsg_popmsg (msg);
-            self->collect_process_fn (self, popmsg, self->collect_handler);
-        }
 
-        if (self->verbose)
-            zsys_info ("Received from peer\n");
-
-    }
+cleanup:
     zyre_event_destroy (&token);
+    zstr_free (&wave_id);
     zstr_free (&wave_direction);
-    return 0;
+    ZLOG_TRACE_END ("zecho_recv");
+    return rc;
 }
 
 
 //  --------------------------------------------------------------------------
-//  Get wave id
+//  Get the id of the last initiated or handled wave
 
 const char *
 zecho_wave_id (zecho_t *self)
@@ -299,6 +629,42 @@ zecho_wave_id (zecho_t *self)
 }
 
 
+//  --------------------------------------------------------------------------
+//  Returns the number of waves currently in progress on this node.
+
+size_t
+zecho_waves (zecho_t *self)
+{
+    assert (self);
+    return zhashx_size (self->waves);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Set the maximum number of waves tracked concurrently. If more waves are
+//  started the least recently active one is dropped. Default is 16.
+
+void
+zecho_set_max_waves (zecho_t *self, size_t max_waves)
+{
+    assert (self);
+    assert (max_waves > 0);
+    self->max_waves = max_waves;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Set the time in msecs after which a wave without any received tokens is
+//  dropped. Default is 30000.
+
+void
+zecho_set_wave_timeout (zecho_t *self, int64_t wave_timeout)
+{
+    assert (self);
+    self->wave_timeout = wave_timeout;
+}
+
+
 //  --------------------------------------------------------------------------
 //  Sets a handler which is passed to custom collect functions.
 
@@ -335,6 +701,58 @@ zecho_set_collect_create (zecho_t *self, zecho_create_fn *collect_fn)
 }
 
 
+//  --------------------------------------------------------------------------
+//  Enable/disable reuse of the spanning tree of the last INFORM flood for
+//  subsequent waves. Default is enabled.
+
+void
+zecho_set_tree_reuse (zecho_t *self, bool tree_reuse)
+{
+    assert (self);
+    self->tree_reuse = tree_reuse;
+    if (!tree_reuse)
+        zecho_reset_tree (self);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Drop the cached spanning tree; Must be called whenever the membership of
+//  the node's groups changes. The next wave will flood again.
+
+void
+zecho_reset_tree (zecho_t *self)
+{
+    assert (self);
+    zstr_free (&self->tree_father);
+    zlist_destroy (&self->tree_children);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns true if a spanning tree is cached.
+
+bool
+zecho_has_tree (zecho_t *self)
+{
+    assert (self);
+    return self->tree_father != NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Set a user-defined function to combine collect messages; If set, collect
+//  messages of children are reduced together with the own collect message
+//  before they are sent to the father. The initiator passes the final result
+//  of each wave to the collect process function once.
+
+void
+zecho_set_collect_reduce (zecho_t *self, zecho_reduce_fn *reduce_fn)
+{
+    assert (self);
+    self->collect_reduce_fn = reduce_fn;
+}
+
+
 //  --------------------------------------------------------------------------
 //  Sets a handler which is passed to custom inform functions.
 
@@ -383,6 +801,34 @@ zecho_set_clock (zecho_t *self, zvector_t *clock)
 }
 
 
+//  --------------------------------------------------------------------------
+//  Set a hybrid logical clock handle. If not NULL echo messages will be
+//  prepended with its timestamp instead of the vector.
+
+void
+zecho_set_hlc (zecho_t *self, zhlc_t *hlc)
+{
+    assert (self);
+    self->hlc = hlc;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Set a metrics handle. Sent echo messages are counted if not NULL.
+
+void
+zecho_set_metrics (zecho_t *self, zmetrics_t *metrics)
+{
+    assert (self);
+    self->metrics = metrics;
+    if (metrics) {
+        self->metric_sent = zmetrics_counter (metrics, "sent.ZECHO");
+        self->metric_bytes_sent = zmetrics_counter (metrics, "bytes_sent.ZECHO");
+        self->metric_clock_bytes = zmetrics_counter (metrics, "clock.bytes_sent");
+    }
+}
+
+
 //  --------------------------------------------------------------------------
 //  Enable/disable verbose logging.
 
@@ -394,6 +840,138 @@ zecho_set_verbose (zecho_t *self, bool verbose)
 }
 
 
+//  --------------------------------------------------------------------------
+//  Combine messages of key/value frame pairs; Values are decimal numbers.
+
+#define ZECHO_REDUCE_SUM 0
+#define ZECHO_REDUCE_MIN 1
+#define ZECHO_REDUCE_MAX 2
+
+static void
+s_destroy_reduce_value (void **value_p)
+{
+    assert (value_p);
+    if (*value_p) {
+        unsigned long long *value = (unsigned long long *) *value_p;
+        free (value);
+        *value_p = NULL;
+    }
+}
+
+static zmsg_t *
+s_zecho_reduce_pairs (zmsg_t *acc, zmsg_t *msg, int op)
+{
+    assert (acc);
+    assert (msg);
+    zhashx_t *values = zhashx_new ();
+    zhashx_set_destructor (values, s_destroy_reduce_value);
+
+    zmsg_t *inputs [2] = { acc, msg };
+    int index;
+    for (index = 0; index < 2; index++) {
+        char *key = zmsg_popstr (inputs [index]);
+        while (key) {
+            char *value_str = zmsg_popstr (inputs [index]);
+            unsigned long long value = value_str? strtoull (value_str, NULL, 10): 0;
+            unsigned long long *current = (unsigned long long *) zhashx_lookup (values, key);
+            if (!current) {
+                current = (unsigned long long *) zmalloc (sizeof (unsigned long long));
+                *current = value;
+                zhashx_insert (values, key, current);
+            }
+            else
+            if (op == ZECHO_REDUCE_SUM)
+                *current += value;
+            else
+            if (op == ZECHO_REDUCE_MIN && value < *current)
+                *current = value;
+            else
+            if (op == ZECHO_REDUCE_MAX && value > *current)
+                *current = value;
+
+            zstr_free (&value_str);
+            zstr_free (&key);
+            key = zmsg_popstr (inputs [index]);
+        }
+        zmsg_destroy (&inputs [index]);
+    }
+
+    zmsg_t *result = zmsg_new ();
+    unsigned long long *value = (unsigned long long *) zhashx_first (values);
+    while (value) {
+        zmsg_addstr (result, (const char *) zhashx_cursor (values));
+        zmsg_addstrf (result, "%llu", *value);
+        value = (unsigned long long *) zhashx_next (values);
+    }
+    zhashx_destroy (&values);
+    return result;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Built-in reduce function; Sums up the values of equal keys. Messages
+//  consist of key/value frame pairs with decimal values, e.g. lines logged
+//  per node or histogram buckets.
+
+zmsg_t *
+zecho_reduce_sum (zecho_t *self, zmsg_t *acc, zmsg_t *msg, void *handler)
+{
+    return s_zecho_reduce_pairs (acc, msg, ZECHO_REDUCE_SUM);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Built-in reduce function; Keeps the minimum value of equal keys. Messages
+//  consist of key/value frame pairs with decimal values.
+
+zmsg_t *
+zecho_reduce_min (zecho_t *self, zmsg_t *acc, zmsg_t *msg, void *handler)
+{
+    return s_zecho_reduce_pairs (acc, msg, ZECHO_REDUCE_MIN);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Built-in reduce function; Keeps the maximum value of equal keys, e.g. the
+//  max clock per pid. Messages consist of key/value frame pairs with decimal
+//  values.
+
+zmsg_t *
+zecho_reduce_max (zecho_t *self, zmsg_t *acc, zmsg_t *msg, void *handler)
+{
+    return s_zecho_reduce_pairs (acc, msg, ZECHO_REDUCE_MAX);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Built-in reduce function; Builds the deduplicated set of all frames.
+
+zmsg_t *
+zecho_reduce_union (zecho_t *self, zmsg_t *acc, zmsg_t *msg, void *handler)
+{
+    assert (acc);
+    assert (msg);
+    zhashx_t *seen = zhashx_new ();
+    zframe_t *frame = zmsg_first (acc);
+    while (frame) {
+        char *item = zframe_strdup (frame);
+        zhashx_insert (seen, item, acc);
+        zstr_free (&item);
+        frame = zmsg_next (acc);
+    }
+    char *item = zmsg_popstr (msg);
+    while (item) {
+        if (zhashx_insert (seen, item, acc) == 0)
+            zmsg_addstr (acc, item);
+        zstr_free (&item);
+        item = zmsg_popstr (msg);
+    }
+    zhashx_destroy (&seen);
+    zmsg_destroy (&msg);
+    return acc;
+}
+
+
 //  --------------------------------------------------------------------------
 //  Print echo status to command line
 
@@ -401,9 +979,20 @@ void
 zecho_print (zecho_t *self) {
     printf ("zecho : {\n");
     printf ("    ID: %s,\n", zyre_uuid (self->node));
-    printf ("    count: %d\n", self->recv_msg);
-    printf ("    father: %s\n", self->father);
     printf ("    wave id: %s\n", self->wave_id);
+    printf ("    tree father: %s\n", self->tree_father);
+    printf ("    tree wave: %s\n", self->tree_wave);
+    printf ("    tree children: %lu\n", self->tree_children? zlist_size (self->tree_children): 0);
+    printf ("    waves: {\n");
+    wave_t *wave = (wave_t *) zhashx_first (self->waves);
+    while (wave) {
+        printf ("        %s: {\n", (const char *) zhashx_cursor (self->waves));
+        printf ("            count: %d\n", wave->recv_msg);
+        printf ("            father: %s\n", wave->father);
+        printf ("        }\n");
+        wave = (wave_t *) zhashx_next (self->waves);
+    }
+    printf ("    }\n");
     printf ("}\n");
 }
 
@@ -430,6 +1019,58 @@ s_test_zecho_create (zecho_t *self, void *handler)
     return msg;
 }
 
+static void
+s_test_zecho_process_sum (zecho_t *self, zmsg_t *msg,  void *handler)
+{
+    assert (self);
+    char *key = zmsg_popstr (msg);
+    char *value = zmsg_popstr (msg);
+    assert (streq (key, "lines"));
+    *(int *) handler = atoi (value);
+    zstr_free (&key);
+    zstr_free (&value);
+    zmsg_destroy (&msg);
+}
+
+zmsg_t *
+s_test_zecho_create_sum (zecho_t *self, void *handler)
+{
+    assert (self);
+    zmsg_t *msg = zmsg_new ();
+    zmsg_addstr (msg, "lines");
+    zmsg_addstr (msg, "1");
+    return msg;
+}
+
+static char *
+s_test_zecho_lookup (zmsg_t *msg, const char *key)
+{
+    zframe_t *frame = zmsg_first (msg);
+    while (frame) {
+        if (zframe_streq (frame, key))
+            return zframe_strdup (zmsg_next (msg));
+        frame = zmsg_next (msg);
+    }
+    return NULL;
+}
+
+static int
+s_test_zecho_deliver (zyre_t *node, zecho_t *echo)
+{
+    zyre_event_t *event = NULL;
+    do {
+        event = zyre_event_new (node);
+        if (!streq (zyre_event_type (event), "WHISPER"))
+            zyre_event_destroy (&event);
+        else
+            break;
+    } while (1);
+    char *type = zmsg_popstr (zyre_event_msg (event));
+    assert (streq (type, "ZECHO"));
+    zstr_free (&type);
+    return zecho_recv (echo, event);
+}
+
 void
 zecho_test (bool verbose)
 {
@@ -561,6 +1202,126 @@ zecho_test (bool verbose)
         zecho_print (echo3);
     }
 
+    //  Several waves may be in progress at the same time
+    char *wave1 = strdup (zecho_init (echo1));
+    char *wave2 = strdup (zecho_init (echo1));
+    assert (!streq (wave1, wave2));
+    assert (zecho_waves (echo1) == 2);
+    assert (s_test_zecho_deliver (node2, echo2) == 0);
+    assert (s_test_zecho_deliver (node2, echo2) == 0);
+    assert (zecho_waves (echo2) == 2);
+    assert (s_test_zecho_deliver (node3, echo3) == 1);
+    assert (s_test_zecho_deliver (node3, echo3) == 1);
+    assert (s_test_zecho_deliver (node2, echo2) == 1);
+    assert (s_test_zecho_deliver (node2, echo2) == 1);
+    assert (s_test_zecho_deliver (node1, echo1) == 1);
+    assert (s_test_zecho_deliver (node1, echo1) == 1);
+    assert (zecho_waves (echo1) == 0);
+    assert (zecho_waves (echo2) == 0);
+    assert (zecho_waves (echo3) == 0);
+    zstr_free (&wave1);
+    zstr_free (&wave2);
+
+    //  Collect messages are reduced at each hop
+    int lines = 0;
+    zecho_set_collect_handler (echo1, &lines);
+    zecho_set_collect_process (echo1, s_test_zecho_process_sum);
+    zecho_set_collect_create (echo1, s_test_zecho_create_sum);
+    zecho_set_collect_create (echo2, s_test_zecho_create_sum);
+    zecho_set_collect_create (echo3, s_test_zecho_create_sum);
+    zecho_set_collect_reduce (echo1, zecho_reduce_sum);
+    zecho_set_collect_reduce (echo2, zecho_reduce_sum);
+    zecho_set_collect_reduce (echo3, zecho_reduce_sum);
+    zecho_init (echo1);
+    assert (s_test_zecho_deliver (node2, echo2) == 0);
+    assert (s_test_zecho_deliver (node3, echo3) == 1);
+    assert (s_test_zecho_deliver (node2, echo2) == 1);
+    assert (s_test_zecho_deliver (node1, echo1) == 1);
+    assert (lines == 3);
+
+    //  An outdated tree is reset up to the initiator, next wave floods
+    assert (zecho_has_tree (echo1));
+    zecho_reset_tree (echo2);
+    zecho_init (echo1);
+    assert (s_test_zecho_deliver (node2, echo2) == 1);
+    assert (s_test_zecho_deliver (node1, echo1) == 1);
+    assert (lines == 2);
+    assert (!zecho_has_tree (echo1));
+    zecho_init (echo1);
+    assert (s_test_zecho_deliver (node2, echo2) == 0);
+    assert (s_test_zecho_deliver (node3, echo3) == 1);
+    assert (s_test_zecho_deliver (node2, echo2) == 1);
+    assert (s_test_zecho_deliver (node1, echo1) == 1);
+    assert (lines == 3);
+    assert (zecho_has_tree (echo1));
+    assert (zecho_has_tree (echo2));
+    assert (zecho_has_tree (echo3));
+
+    //  Overlapping floods only replace the tree with a newer one
+    char *tree_wave = strdup (echo1->tree_wave);
+    char *older = strdup (tree_wave);
+    strcpy (strrchr (older, '-') + 1, "0");
+    assert (!s_zecho_wave_newer (echo1, older));
+    assert (!s_zecho_wave_newer (echo1, tree_wave));
+    assert (s_zecho_wave_newer (echo1, "other-1"));
+    wave_t *late = s_wave_new ("initiator");
+    s_zecho_cache_tree (echo1, older, late);
+    assert (streq (echo1->tree_wave, tree_wave));
+    s_wave_destroy (&late);
+    zstr_free (&older);
+    zstr_free (&tree_wave);
+
+    //  Built-in reduce functions
+    zmsg_t *acc = zmsg_new ();
+    zmsg_addstr (acc, "a");
+    zmsg_addstr (acc, "1");
+    zmsg_addstr (acc, "b");
+    zmsg_addstr (acc, "5");
+    zmsg_t *other = zmsg_dup (acc);
+    zmsg_t *part = zmsg_new ();
+    zmsg_addstr (part, "a");
+    zmsg_addstr (part, "2");
+    zmsg_addstr (part, "c");
+    zmsg_addstr (part, "7");
+    zmsg_t *part_dup = zmsg_dup (part);
+    acc = zecho_reduce_sum (NULL, acc, part, NULL);
+    char *value = s_test_zecho_lookup (acc, "a");
+    assert (streq (value, "3"));
+    zstr_free (&value);
+    value = s_test_zecho_lookup (acc, "c");
+    assert (streq (value, "7"));
+    zstr_free (&value);
+    zmsg_destroy (&acc);
+    other = zecho_reduce_max (NULL, other, part_dup, NULL);
+    value = s_test_zecho_lookup (other, "a");
+    assert (streq (value, "2"));
+    zstr_free (&value);
+    value = s_test_zecho_lookup (other, "b");
+    assert (streq (value, "5"));
+    zstr_free (&value);
+    zmsg_destroy (&other);
+
+    acc = zmsg_new ();
+    zmsg_addstr (acc, "x");
+    zmsg_addstr (acc, "y");
+    part = zmsg_new ();
+    zmsg_addstr (part, "y");
+    zmsg_addstr (part, "z");
+    acc = zecho_reduce_union (NULL, acc, part, NULL);
+    assert (zmsg_size (acc) == 3);
+    zmsg_destroy (&acc);
+
+    //  Idle waves expire, the least recently active wave is evicted
+    zecho_set_wave_timeout (echo1, 0);
+    zecho_init (echo1);
+    zclock_sleep (10);
+    zecho_init (echo1);
+    assert (zecho_waves (echo1) == 1);
+    zecho_set_wave_timeout (echo1, 30000);
+    zecho_set_max_waves (echo1, 1);
+    zecho_init (echo1);
+    assert (zecho_waves (echo1) == 1);
+
     //  Cleanup
     zecho_destroy (&echo1);
     zecho_destroy (&echo2);
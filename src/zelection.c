@@ -23,6 +23,8 @@
 
 struct _zelection_t {
     char *caw;          //  Current active wave
+    unsigned long caw_round;    //  Round of the current active wave
+    unsigned long round;        //  Last round initiated by this node
     char *father;       //  Father in the current active wave
     unsigned int erec;  //  Number of received election messages
     unsigned int lrec;  //  Number of received leader messages
@@ -32,6 +34,11 @@ struct _zelection_t {
 
     zyre_t *node;       //  zyre handle (not owned!)
     zvector_t *clock;   //  vector clock handle (not owned!)
+    zhlc_t *hlc;        //  hybrid logical clock handle (not owned!)
+    zmetrics_t *metrics;    //  metrics handle (not owned!)
+    size_t metric_sent;         //  Handle of sent.ZLE
+    size_t metric_bytes_sent;   //  Handle of bytes_sent.ZLE
+    size_t metric_clock_bytes;  //  Handle of clock.bytes_sent
     bool verbose;       //  verbose logging?
 };
 
@@ -46,6 +53,8 @@ zelection_new (zyre_t *node)
     assert (self);
     //  Initialize class properties here
     self->caw = NULL;
+    self->caw_round = 0;
+    self->round = 0;
     self->father = NULL;
     self->erec = 0;
     self->lrec = 0;
@@ -55,6 +64,8 @@ zelection_new (zyre_t *node)
 
     self->node = node;
     self->clock = NULL;
+    self->hlc = NULL;
+    self->metrics = NULL;
     self->verbose = false;
     return self;
 }
@@ -134,6 +145,65 @@ s_neighbors (zelection_t *self, bool with_father)
     return all_neighbors;
 }
 
+//  Prepend the clock to an election message, the hybrid logical clock takes
+//  precedence over the vector clock
+
+static void
+s_stamp (zelection_t *self, zmsg_t *msg)
+{
+    if (self->hlc)
+        zhlc_send_prepare (self->hlc, msg);
+    else
+    if (self->clock)
+        zvector_send_prepare (self->clock, msg);
+}
+
+//  Log informational message with the clock in use
+
+static void
+s_info (zelection_t *self, const char *format, ...)
+{
+    va_list argptr;
+    va_start (argptr, format);
+    char *logmsg = zsys_vprintf (format, argptr);
+    va_end (argptr);
+    if (self->hlc)
+        zhlc_info (self->hlc, "%s", logmsg);
+    else
+    if (self->clock)
+        zvector_info (self->clock, "%s", logmsg);
+    else
+        zsys_info ("%s", logmsg);
+    zstr_free (&logmsg);
+}
+
+//  Count a sent election message, the clock has to be prepended already
+
+static void
+s_count_sent (zelection_t *self, zmsg_t *msg)
+{
+    if (!self->metrics)
+        return;
+    zmetrics_count (self->metrics, self->metric_sent, 1);
+    zmetrics_count (self->metrics, self->metric_bytes_sent, zmsg_content_size (msg));
+    if (self->hlc || self->clock)
+        zmetrics_count (self->metrics, self->metric_clock_bytes, zframe_size (zmsg_first (msg)));
+}
+
+//  Create an election or leader message for the wave of initiator r in the
+//  given round
+
+static zmsg_t *
+s_message (const char *type, const char *r, unsigned long round)
+{
+    zmsg_t *msg = zmsg_new ();
+    zmsg_addstr (msg, "ZLE");
+    zmsg_addstr (msg, type);
+    zmsg_addstr (msg, r);
+    zmsg_addstrf (msg, "%lu", round);
+    return msg;
+}
+
 static void
 s_send_to (zelection_t *self, zmsg_t *msg, zlist_t *peers)
 {
@@ -148,9 +218,9 @@ s_send_to (zelection_t *self, zmsg_t *msg, zlist_t *peers)
     while (peer) {
         //  Send message to peer
         zmsg_t *copy = zmsg_dup (msg);
-        if (self->clock)
-            zvector_send_prepare (self->clock, copy);
+        s_stamp (self, copy);
 
+        s_count_sent (self, copy);
         zyre_whisper (self->node, peer, &copy);
 
         //  Get next peer in list
@@ -163,136 +233,178 @@ cleanup:
 }
 
 //  --------------------------------------------------------------------------
-//  Initiate election
+//  Initiate election. May be called again to re-elect after membership
+//  changed, the outcome of a previous election is dropped. If this node
+//  already takes part in the wave of a smaller initiator, that wave wins
+//  anyway and nothing is sent. Every call starts a new round, tokens of an
+//  earlier round of the same initiator are ignored by all nodes.
 
 void
 zelection_start (zelection_t *self)
 {
     assert (self);
+    if (self->caw && strcmp (self->caw, zyre_uuid (self->node)) < 0)
+        return;
+
+    zstr_free (&self->caw);
+    zstr_free (&self->father);
+    zstr_free (&self->leader);
+    self->erec = 0;
+    self->lrec = 0;
+    self->state = false;
     self->caw = strdup (zyre_uuid (self->node));
+    self->caw_round = ++self->round;
 
-    zmsg_t *election_msg = zmsg_new ();
-    zmsg_addstr (election_msg, "ZLE");
-    zmsg_addstr (election_msg, "ELECTION");
-    zmsg_addstr (election_msg, zyre_uuid (self->node));
+    zmsg_t *election_msg = s_message ("ELECTION", self->caw, self->caw_round);
 
     //  Send election message to all neighbors
     s_send_to (self, election_msg, s_neighbors (self, true));
     if (self->verbose)
-        zvector_info (self->clock, "ELECTION started by %s\n", zyre_uuid (self->node));
+        s_info (self, "ELECTION started by %s\n", zyre_uuid (self->node));
+}
+
+
+//  --------------------------------------------------------------------------
+//  A peer left. If it initiated the active wave, the wave never concludes
+//  and would block every later start, it is dropped.
+
+void
+zelection_peer_left (zelection_t *self, const char *peer)
+{
+    assert (self);
+    assert (peer);
+    if (!self->caw || !streq (self->caw, peer))
+        return;
+
+    if (self->verbose)
+        s_info (self, "Wave of %s dropped by %s\n", peer, zyre_uuid (self->node));
+    zstr_free (&self->caw);
+    zstr_free (&self->father);
+    zstr_free (&self->leader);
+    self->caw_round = 0;
+    self->erec = 0;
+    self->lrec = 0;
+    self->state = false;
 }
 
 
 //  --------------------------------------------------------------------------
 //  Handle received election and leader messages. Return 1 if election is
 //  still in progress, 0 if election is concluded and -1 is an error occurred.
+//  Tokens of a replaced or already finished round are ignored and return 1.
 
 int
 zelection_recv (zelection_t *self, zyre_event_t *event)
 {
     assert (self);
     assert (event);
+    ZLOG_TRACE_BEGIN ("zelection_recv");
 
     zmsg_t *msg = zyre_event_msg (event);
     char *type = zmsg_popstr (msg);
     char *r = zmsg_popstr (msg);
+    char *round_str = zmsg_popstr (msg);
+    if (!type || !r || !round_str) {
+        zstr_free (&type);
+        zstr_free (&r);
+        zstr_free (&round_str);
+        zyre_event_destroy (&event);
+        ZLOG_TRACE_END ("zelection_recv");
+        return -1;
+    }
+    unsigned long round = strtoul (round_str, NULL, 10);
+    zstr_free (&round_str);
+    //  Tokens of the active wave, a wave is its initiator and round
+    bool active = self->caw && streq (r, self->caw) && round == self->caw_round;
+    int rc = 1;
 
     if (streq (type, "ELECTION")) {
-        //  Initiate or re-initiate leader election
-        if (!self->caw || strcmp (r, self->caw) < 0) {
+        //  Initiate or re-initiate leader election, a later round of the
+        //  active initiator replaces its earlier one
+        if (!self->caw || strcmp (r, self->caw) < 0
+        || (streq (r, self->caw) && round > self->caw_round)) {
             zstr_free (&self->caw);     //  Free caw when re-initiated
             zstr_free (&self->father);  //  Free father when re-initiated
             zstr_free (&self->leader);  //  Free leader when re-initiated
             self->caw = strdup (r);
+            self->caw_round = round;
             self->erec = 0;
             self->lrec = 0;
             self->father = strdup (zyre_event_peer_uuid (event));
+            active = true;
 
-            zmsg_t *election_msg = zmsg_new ();
-            zmsg_addstr (election_msg, "ZLE");
-            zmsg_addstr (election_msg, "ELECTION");
-            zmsg_addstr (election_msg, r);
+            zmsg_t *election_msg = s_message ("ELECTION", r, round);
 
             //  Send election message to all neighbors but father but father
             s_send_to (self, election_msg, s_neighbors (self, false));
             if (self->verbose)
-                zvector_info (self->clock, "Initialise election %s\n", zyre_uuid (self->node));
+                s_info (self, "Initialise election %s\n", zyre_uuid (self->node));
         }
 
         //  Participate in current active wave
-        if (strcmp (r, self->caw) == 0) {
+        if (active) {
             self->erec++;
             if (self->erec == s_neighbors_count (self)) {
                 if (streq (self->caw, zyre_uuid (self->node))) {
-                    zmsg_t *leader_msg = zmsg_new ();
-                    zmsg_addstr (leader_msg, "ZLE");
-                    zmsg_addstr (leader_msg, "LEADER");
-                    zmsg_addstr (leader_msg, r);
+                    zmsg_t *leader_msg = s_message ("LEADER", r, round);
 
                     //  Send leader message to all neighbors
                     s_send_to (self, leader_msg, s_neighbors (self, true));
                     if (self->verbose)
-                        zvector_info (self->clock, "LEADER decision by %s\n", zyre_uuid (self->node));
+                        s_info (self, "LEADER decision by %s\n", zyre_uuid (self->node));
                 }
                 else {
-                    zmsg_t *election_msg = zmsg_new ();
-                    zmsg_addstr (election_msg, "ZLE");
-                    zmsg_addstr (election_msg, "ELECTION");
-                    zmsg_addstr (election_msg, self->caw);
-
-                    if (self->clock)
-                        zvector_send_prepare (self->clock, election_msg);
+                    zmsg_t *election_msg = s_message ("ELECTION", self->caw, self->caw_round);
+                    s_stamp (self, election_msg);
 
                     //  Send election message to father
+                    s_count_sent (self, election_msg);
                     zyre_whisper (self->node, self->father, &election_msg);
                     if (self->verbose)
-                        zvector_info (self->clock, "Echo wave to father %s\n", zyre_uuid (self->node));
+                        s_info (self, "Echo wave to father %s\n", zyre_uuid (self->node));
                 }
             }
         }
-        //  If r > caw, the message is ignored!
+        //  If r > caw or the round is stale, the message is ignored!
     }
     else
-    if (streq (type, "LEADER")) {
-        if (self->lrec == 0) {
-            zmsg_t *leader_msg = zmsg_new ();
-            zmsg_addstr (leader_msg, "ZLE");
-            zmsg_addstr (leader_msg, "LEADER");
-            zmsg_addstr (leader_msg, r);
+    if (streq (type, "LEADER") && active) {
+        //  The initiator already sent its decision to all neighbors
+        if (self->lrec == 0 && !streq (r, zyre_uuid (self->node))) {
+            zmsg_t *leader_msg = s_message ("LEADER", r, round);
 
             //  Send leader message to all neighbors
             s_send_to (self, leader_msg, s_neighbors (self, true));
             if (self->verbose)
-                zvector_info (self->clock, "Propagate LEADER by %s\n", zyre_uuid (self->node));
+                s_info (self, "Propagate LEADER by %s\n", zyre_uuid (self->node));
         }
         self->lrec++;
         zstr_free (&self->leader);
         self->leader = strdup (r);
         if (self->verbose)
-            zvector_info (self->clock, "Received LEADER by %s\n", zyre_uuid (self->node));
-    }
+            s_info (self, "Received LEADER by %s\n", zyre_uuid (self->node));
 
-    zstr_free (&type);
-    zstr_free (&r);
-    zyre_event_destroy (&event);
-
-    if (self->lrec == s_neighbors_count (self)) {
-        self->state = streq (self->leader, zyre_uuid (self->node));
-        zstr_free (&self->caw);     //  Free caw as election is finished
-        if (self->verbose)
-            zvector_info (self->clock, "Election finished %s, %s!\n", zyre_uuid (self->node), self->state? "true": "false");
+        if (self->lrec == s_neighbors_count (self)) {
+            self->state = streq (self->leader, zyre_uuid (self->node));
+            zstr_free (&self->caw);     //  Free caw as election is finished
+            if (self->verbose)
+                s_info (self, "Election finished %s, %s!\n", zyre_uuid (self->node), self->state? "true": "false");
 
-        return 0;
+            rc = 0;
+        }
     }
     else
-    if (self->lrec > s_neighbors_count (self)) {
+    if (streq (type, "LEADER")) {
+        //  Leader of a replaced or already finished wave
         if (self->verbose)
-            zvector_info (self->clock, "Too much %s, %s!\n", zyre_uuid (self->node), self->state? "true": "false");
-
-        return 1;
+            s_info (self, "Stale LEADER %s round %lu ignored by %s\n", r, round, zyre_uuid (self->node));
     }
-    else
-        return 1;
+
+    zstr_free (&type);
+    zstr_free (&r);
+    zyre_event_destroy (&event);
+    ZLOG_TRACE_END ("zelection_recv");
+    return rc;
 }
 
 
@@ -340,6 +452,34 @@ zelection_set_clock (zelection_t *self, zvector_t *clock)
 }
 
 
+//  --------------------------------------------------------------------------
+//  Set a hybrid logical clock handle. If not NULL election messages will be
+//  prepended with its timestamp instead of the vector.
+
+void
+zelection_set_hlc (zelection_t *self, zhlc_t *hlc)
+{
+    assert (self);
+    self->hlc = hlc;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Set a metrics handle. Sent election messages are counted if not NULL.
+
+void
+zelection_set_metrics (zelection_t *self, zmetrics_t *metrics)
+{
+    assert (self);
+    self->metrics = metrics;
+    if (metrics) {
+        self->metric_sent = zmetrics_counter (metrics, "sent.ZLE");
+        self->metric_bytes_sent = zmetrics_counter (metrics, "bytes_sent.ZLE");
+        self->metric_clock_bytes = zmetrics_counter (metrics, "clock.bytes_sent");
+    }
+}
+
+
 //  --------------------------------------------------------------------------
 //  Enable/disable verbose logging.
 
@@ -360,6 +500,7 @@ zelection_print (zelection_t *self) {
     printf ("    ID: %s,\n", zyre_uuid (self->node));
     printf ("    father: %s\n", self->father);
     printf ("    CAW: %s\n", self->caw);
+    printf ("    round: %lu\n", self->caw_round);
     printf ("    election count: %d\n", self->erec);
     printf ("    leader count: %d\n", self->lrec);
     printf ("    state: %s\n", !self->leader? "undecided": self->state? "leader": "looser");
@@ -371,6 +512,51 @@ zelection_print (zelection_t *self) {
 //  --------------------------------------------------------------------------
 //  Self test of this class
 
+//  Receive the next election message of a node, returns its initiator
+
+static char *
+s_test_initiator (zyre_t *node, zelection_t *election)
+{
+    zyre_event_t *event = NULL;
+    do {
+        event = zyre_event_new (node);
+        if (!streq (zyre_event_type (event), "WHISPER"))
+            zyre_event_destroy (&event);
+        else
+            break;
+    } while (1);
+    zvector_recv (election->clock, zyre_event_msg (event));
+    char *type = zmsg_popstr (zyre_event_msg (event));
+    assert (streq (type, "ZLE"));
+    zstr_free (&type);
+    type = zmsg_popstr (zyre_event_msg (event));
+    assert (streq (type, "ELECTION"));
+    zstr_free (&type);
+    char *initiator = zmsg_popstr (zyre_event_msg (event));
+    zyre_event_destroy (&event);
+    return initiator;
+}
+
+//  Receive the next election message of a node and pass it to its election
+
+static int
+s_test_recv (zyre_t *node, zelection_t *election)
+{
+    zyre_event_t *event = NULL;
+    do {
+        event = zyre_event_new (node);
+        if (!streq (zyre_event_type (event), "WHISPER"))
+            zyre_event_destroy (&event);
+        else
+            break;
+    } while (1);
+    zvector_recv (election->clock, zyre_event_msg (event));
+    char *type = zmsg_popstr (zyre_event_msg (event));
+    assert (streq (type, "ZLE"));
+    zstr_free (&type);
+    return zelection_recv (election, event);
+}
+
 void
 zelection_test (bool verbose)
 {
@@ -489,6 +675,50 @@ zelection_test (bool verbose)
     assert (leader_count == 1);
     assert (looser_count == 1);
 
+    //  Two rounds in a row, the tokens of the first one must not be counted
+    //  towards the second one
+    zelection_start (node1_election);
+    zelection_start (node1_election);
+    assert (!zelection_finished (node1_election));
+    rc = s_test_recv (node2, node2_election);   //  ELECTION round 2
+    assert (rc == 1);
+    rc = s_test_recv (node2, node2_election);   //  ELECTION round 3
+    assert (rc == 1);
+    rc = s_test_recv (node1, node1_election);   //  Stale echo of round 2
+    assert (rc == 1);
+    assert (!zelection_finished (node1_election));
+    rc = s_test_recv (node1, node1_election);   //  Echo of round 3
+    assert (rc == 1);
+    rc = s_test_recv (node2, node2_election);   //  LEADER round 3
+    assert (rc == 0);
+    rc = s_test_recv (node1, node1_election);   //  Propagated LEADER
+    assert (rc == 0);
+    assert (zelection_won (node1_election));
+    assert (!zelection_won (node2_election));
+    assert (streq (zelection_leader (node1_election), zelection_leader (node2_election)));
+
+    //  The smaller initiator leaves in the middle of its round. The other
+    //  node joined its wave, which never concludes, and elects again once
+    //  it dropped the wave.
+    bool node1_smaller = strcmp (zyre_uuid (node1), zyre_uuid (node2)) < 0;
+    zyre_t *smaller_node = node1_smaller? node1: node2;
+    zyre_t *larger_node = node1_smaller? node2: node1;
+    zelection_t *smaller = node1_smaller? node1_election: node2_election;
+    zelection_t *larger = node1_smaller? node2_election: node1_election;
+    zelection_start (smaller);
+    rc = s_test_recv (larger_node, larger);     //  ELECTION of the smaller
+    assert (rc == 1);
+    zelection_start (larger);                   //  The smaller wave wins
+    zelection_peer_left (larger, zyre_uuid (smaller_node));
+    assert (!zelection_leader (larger));
+    zelection_start (larger);
+    char *initiator = s_test_initiator (smaller_node, smaller);
+    assert (streq (initiator, zyre_uuid (smaller_node)));   //  Echo
+    zstr_free (&initiator);
+    initiator = s_test_initiator (smaller_node, smaller);
+    assert (streq (initiator, zyre_uuid (larger_node)));    //  New wave
+    zstr_free (&initiator);
+
     //  Cleanup
     zelection_destroy (&node1_election);
     zelection_destroy (&node2_election);
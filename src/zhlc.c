@@ -0,0 +1,350 @@
+/*  =========================================================================
+    zhlc - Implements a hybrid logical clock
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zhlc - Implements a hybrid logical clock
+@discuss
+    A hybrid logical clock keeps close to physical time but never runs
+    backwards and respects causality: if a happened before b, the
+    timestamp of a is lower than the timestamp of b. Unlike a vector clock
+    its size on the wire is constant, 8 bytes in network byte order. The
+    upper 48 bits hold the highest physical time in ms seen, the lower 16
+    bits a counter of events within that ms. A counter overflow carries
+    into the physical part.
+
+    Timestamps give a total order consistent with causality, but they
+    can't tell whether two events are concurrent. For causal checks a
+    vector clock can be sampled: every nth sent message additionally
+    carries it in the frame after the timestamp.
+@end
+*/
+
+#include "zlog_classes.h"
+
+#define ZHLC_COUNTER_BITS 16
+
+//  Structure of our class
+
+struct _zhlc_t {
+    char *own_pid;
+    uint64_t value;             //  Physical ms << 16 | counter
+    zvector_t *sample;          //  Sampled vector clock (not owned!)
+    size_t sample_every;        //  Piggyback sample every nth send
+    size_t sends;               //  Number of sent messages
+};
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+//  Returns the physical time as timestamp with a zero counter
+
+static uint64_t
+s_physical (void)
+{
+    return (uint64_t) zclock_time () << ZHLC_COUNTER_BITS;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new zhlc
+
+zhlc_t *
+zhlc_new (const char *pid)
+{
+    assert (pid);
+    zhlc_t *self = (zhlc_t *) zmalloc (sizeof (zhlc_t));
+    assert (self);
+    //  Initialize class properties here
+    self->own_pid = strdup (pid);
+    self->value = 0;
+    self->sample = NULL;
+    self->sample_every = 0;
+    self->sends = 0;
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the zhlc
+
+void
+zhlc_destroy (zhlc_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zhlc_t *self = *self_p;
+        //  Free class properties here
+        zstr_free (&self->own_pid);
+        //  Free object itself
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Piggyback the vector clock on every nth sent message, 0 disables the
+//  sample. Received samples are merged into the vector clock. The vector
+//  clock is not owned.
+
+void
+zhlc_set_sample (zhlc_t *self, zvector_t *clock, size_t every)
+{
+    assert (self);
+    self->sample = clock;
+    self->sample_every = every;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Advances the clock for a local event
+
+void
+zhlc_event (zhlc_t *self)
+{
+    assert (self);
+    uint64_t physical = s_physical ();
+    if (physical > self->value)
+        self->value = physical;
+    else
+        self->value++;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Eventing own clock & packing the timestamp with given msg
+
+zmsg_t *
+zhlc_send_prepare (zhlc_t *self, zmsg_t *msg)
+{
+    assert (self);
+    assert (msg);
+
+    zhlc_event (self);
+    self->sends++;
+    if (self->sample && self->sample_every && self->sends % self->sample_every == 0)
+        zvector_send_prepare (self->sample, msg);
+
+    byte timestamp [8];
+    int index;
+    for (index = 0; index < 8; index++)
+        timestamp [index] = (byte) (self->value >> (56 - 8 * index));
+    zmsg_pushmem (msg, timestamp, sizeof (timestamp));
+    return msg;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Recv the timestamp & updates own clock
+
+void
+zhlc_recv (zhlc_t *self, zmsg_t *msg)
+{
+    assert (self);
+    assert (msg);
+
+    zframe_t *frame = zmsg_pop (msg);
+    assert (frame);
+    uint64_t received = 0;
+    if (zframe_size (frame) == 8) {
+        byte *timestamp = zframe_data (frame);
+        int index;
+        for (index = 0; index < 8; index++)
+            received = (received << 8) | timestamp [index];
+    }
+    zframe_destroy (&frame);
+
+    //  Take the highest of own, received and physical time. The counter
+    //  is only reset if physical time is ahead of both.
+    uint64_t physical = s_physical ();
+    if (received > self->value)
+        self->value = received;
+    if (physical > self->value)
+        self->value = physical;
+    else
+        self->value++;
+
+    frame = zmsg_first (msg);
+    if (frame && zframe_size (frame) > 3 && memcmp (zframe_data (frame), "VC:", 3) == 0) {
+        if (self->sample)
+            zvector_recv (self->sample, msg);
+        else {
+            frame = zmsg_pop (msg);
+            zframe_destroy (&frame);
+        }
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the timestamp, physical time in ms in the upper 48 bits and a
+//  logical counter in the lower 16 bits.
+
+uint64_t
+zhlc_value (zhlc_t *self)
+{
+    assert (self);
+    return self->value;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Converts the zhlc into string representation. The timestamp has a fixed
+//  width, so strings of different clocks sort by timestamp and pid.
+
+char *
+zhlc_to_string (zhlc_t *self)
+{
+    assert (self);
+    return zsys_sprintf ("HLC:%016" PRIx64 ";own:%s;", self->value, self->own_pid);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Parses the timestamp of a string representation into value and the
+//  own pid into pid if not NULL. Returns 0 on success, -1 if the string
+//  isn't a zhlc.
+
+int
+zhlc_parse (const char *clock_string, uint64_t *value, char *pid, size_t pid_max)
+{
+    assert (clock_string);
+    assert (value);
+    if (strncmp (clock_string, "HLC:", 4) != 0)
+        return -1;
+    char *end;
+    *value = (uint64_t) strtoull (clock_string + 4, &end, 16);
+    if (end != clock_string + 20 || strncmp (end, ";own:", 5) != 0)
+        return -1;
+    if (pid) {
+        const char *own = end + 5;
+        const char *own_end = strchr (own, ';');
+        if (!own_end || (size_t) (own_end - own) >= pid_max)
+            return -1;
+        memcpy (pid, own, own_end - own);
+        pid [own_end - own] = 0;
+    }
+    return 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Log informational message - low priority. Prepends the current HLC.
+
+void
+zhlc_info (zhlc_t *self, const char *format, ...)
+{
+    assert (self);
+    va_list argptr;
+    va_start (argptr, format);
+    char *logmsg = zsys_vprintf (format, argptr);
+    va_end (argptr);
+    char *clockstr = zhlc_to_string (self);
+    zsys_info ("/%s/ %s", clockstr, logmsg);
+    zhlc_event (self);
+    zstr_free (&clockstr);
+    zstr_free (&logmsg);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+zhlc_test (bool verbose)
+{
+    printf (" * zhlc: ");
+
+    //  @selftest
+    zhlc_t *self = zhlc_new ("1000");
+    assert (self);
+    assert (zhlc_value (self) == 0);
+
+    //  Local events follow physical time
+    int64_t before = zclock_time ();
+    zhlc_event (self);
+    uint64_t value = zhlc_value (self);
+    assert ((int64_t) (value >> ZHLC_COUNTER_BITS) >= before);
+    assert ((int64_t) (value >> ZHLC_COUNTER_BITS) <= zclock_time ());
+
+    //  A timestamp from the future is taken over and counted up
+    zhlc_t *other = zhlc_new ("2000");
+    other->value = ((uint64_t) (zclock_time () + 60000)) << ZHLC_COUNTER_BITS | 7;
+    zmsg_t *msg = zmsg_new ();
+    zmsg_addstr (msg, "PAYLOAD");
+    zhlc_send_prepare (other, msg);
+    assert (zmsg_size (msg) == 2);
+    assert (zframe_size (zmsg_first (msg)) == 8);
+    uint64_t sent = zhlc_value (other);
+    assert ((sent & 0xffff) == 8);
+
+    zhlc_recv (self, msg);
+    assert (zhlc_value (self) == sent + 1);
+    char *payload = zmsg_popstr (msg);
+    assert (streq (payload, "PAYLOAD"));
+    zstr_free (&payload);
+    zmsg_destroy (&msg);
+    zhlc_event (self);
+    assert (zhlc_value (self) == sent + 2);
+
+    //  String representation
+    char *clock_string = zhlc_to_string (self);
+    char pid [16];
+    assert (zhlc_parse (clock_string, &value, pid, sizeof (pid)) == 0);
+    assert (value == sent + 2);
+    assert (streq (pid, "1000"));
+    zstr_free (&clock_string);
+    assert (zhlc_parse ("VC:own:1000;1000,1;", &value, NULL, 0) == -1);
+    assert (zhlc_parse ("HLC:12;own:1000;", &value, NULL, 0) == -1);
+
+    //  Every second message carries the sampled vector clock
+    zvector_t *other_vector = zvector_new ("2000");
+    zvector_t *vector = zvector_new ("1000");
+    zhlc_set_sample (other, other_vector, 2);
+    zhlc_set_sample (self, vector, 2);
+    int index;
+    for (index = 0; index < 4; index++) {
+        msg = zmsg_new ();
+        zmsg_addstr (msg, "PAYLOAD");
+        zhlc_send_prepare (other, msg);
+        assert (zmsg_size (msg) == (other->sends % 2? 2: 3));
+        zhlc_recv (self, msg);
+        assert (zmsg_size (msg) == 1);
+        zmsg_destroy (&msg);
+    }
+    clock_string = zvector_to_string (vector);
+    assert (strstr (clock_string, ";1000,2;"));
+    assert (strstr (clock_string, ";2000,2;"));
+    zstr_free (&clock_string);
+
+    //  Samples are dropped without a vector clock
+    zhlc_set_sample (self, NULL, 0);
+    for (index = 0; index < 2; index++) {
+        msg = zmsg_new ();
+        zmsg_addstr (msg, "PAYLOAD");
+        zhlc_send_prepare (other, msg);
+        zhlc_recv (self, msg);
+        assert (zmsg_size (msg) == 1);
+        zmsg_destroy (&msg);
+    }
+    assert (zhlc_value (self) > zhlc_value (other));
+
+    zvector_destroy (&vector);
+    zvector_destroy (&other_vector);
+    zhlc_destroy (&other);
+    zhlc_destroy (&self);
+    //  @end
+
+    printf ("OK\n");
+}
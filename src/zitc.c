@@ -0,0 +1,832 @@
+/*  =========================================================================
+    zitc - Implements an interval tree clock
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zitc - Implements an interval tree clock
+@discuss
+    An interval tree clock (Almeida, Baquero, Fonte 2008) is a causality
+    clock for a dynamic set of processes. Instead of a pid every process
+    owns a part of the interval [0, 1), its id. A joining process gets its
+    id by forking the id of an existing one, a leaving process returns it
+    by joining. Events are counted in a tree following the ids in use, so
+    the size of a clock tracks the current membership and not every process
+    which ever existed.
+
+    Ids are written as 0, 1 or (left,right), events as n or (n,left,right)
+    where the children count on top of n. A clock is written as
+    ITC:<id>;<events>; and sent anonymously, i.e. with id 0.
+@end
+*/
+
+#include "zlog_classes.h"
+
+//  Cost of expanding an event leaf when growing, larger than any depth
+#define ZITC_GROW_EXPAND 1000
+
+//  Id tree, leaves are 0 or 1
+
+typedef struct _itc_id_t itc_id_t;
+
+struct _itc_id_t {
+    byte value;                 //  Value of a leaf
+    itc_id_t *left;             //  NULL for leaves
+    itc_id_t *right;
+};
+
+//  Event tree, children count on top of their parent
+
+typedef struct _itc_event_t itc_event_t;
+
+struct _itc_event_t {
+    unsigned long value;
+    itc_event_t *left;          //  NULL for leaves
+    itc_event_t *right;
+};
+
+//  Structure of our class
+
+struct _zitc_t {
+    itc_id_t *id;               //  Owned part of the id space
+    itc_event_t *event;         //  Known events
+};
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+static itc_id_t *
+s_id_leaf (byte value)
+{
+    itc_id_t *id = (itc_id_t *) zmalloc (sizeof (itc_id_t));
+    assert (id);
+    id->value = value;
+    return id;
+}
+
+static void
+s_id_destroy (itc_id_t **id_p)
+{
+    if (*id_p) {
+        s_id_destroy (&(*id_p)->left);
+        s_id_destroy (&(*id_p)->right);
+        free (*id_p);
+        *id_p = NULL;
+    }
+}
+
+static bool
+s_id_is (itc_id_t *id, byte value)
+{
+    return !id->left && id->value == value;
+}
+
+//  Creates a normalized node, (0,0) is 0 and (1,1) is 1
+
+static itc_id_t *
+s_id_node (itc_id_t *left, itc_id_t *right)
+{
+    if (!left->left && !right->left && left->value == right->value) {
+        byte value = left->value;
+        s_id_destroy (&left);
+        s_id_destroy (&right);
+        return s_id_leaf (value);
+    }
+    itc_id_t *id = s_id_leaf (0);
+    id->left = left;
+    id->right = right;
+    return id;
+}
+
+static itc_id_t *
+s_id_dup (itc_id_t *id)
+{
+    if (!id->left)
+        return s_id_leaf (id->value);
+    itc_id_t *copy = s_id_leaf (0);
+    copy->left = s_id_dup (id->left);
+    copy->right = s_id_dup (id->right);
+    return copy;
+}
+
+//  Splits id into two disjoint ids which together make up id
+
+static void
+s_id_split (itc_id_t *id, itc_id_t **left_p, itc_id_t **right_p)
+{
+    if (s_id_is (id, 0)) {
+        *left_p = s_id_leaf (0);
+        *right_p = s_id_leaf (0);
+    }
+    else
+    if (s_id_is (id, 1)) {
+        *left_p = s_id_node (s_id_leaf (1), s_id_leaf (0));
+        *right_p = s_id_node (s_id_leaf (0), s_id_leaf (1));
+    }
+    else
+    if (s_id_is (id->left, 0)) {
+        itc_id_t *left, *right;
+        s_id_split (id->right, &left, &right);
+        *left_p = s_id_node (s_id_leaf (0), left);
+        *right_p = s_id_node (s_id_leaf (0), right);
+    }
+    else
+    if (s_id_is (id->right, 0)) {
+        itc_id_t *left, *right;
+        s_id_split (id->left, &left, &right);
+        *left_p = s_id_node (left, s_id_leaf (0));
+        *right_p = s_id_node (right, s_id_leaf (0));
+    }
+    else {
+        *left_p = s_id_node (s_id_dup (id->left), s_id_leaf (0));
+        *right_p = s_id_node (s_id_leaf (0), s_id_dup (id->right));
+    }
+}
+
+//  Sums two disjoint ids, consumes both
+
+static itc_id_t *
+s_id_sum (itc_id_t *a, itc_id_t *b)
+{
+    if (s_id_is (a, 0)) {
+        s_id_destroy (&a);
+        return b;
+    }
+    if (s_id_is (b, 0)) {
+        s_id_destroy (&b);
+        return a;
+    }
+    //  Overlapping ids would count the same events twice
+    assert (a->left && b->left);
+    itc_id_t *left = s_id_sum (a->left, b->left);
+    itc_id_t *right = s_id_sum (a->right, b->right);
+    free (a);
+    free (b);
+    return s_id_node (left, right);
+}
+
+static itc_event_t *
+s_event_leaf (unsigned long value)
+{
+    itc_event_t *event = (itc_event_t *) zmalloc (sizeof (itc_event_t));
+    assert (event);
+    event->value = value;
+    return event;
+}
+
+static void
+s_event_destroy (itc_event_t **event_p)
+{
+    if (*event_p) {
+        s_event_destroy (&(*event_p)->left);
+        s_event_destroy (&(*event_p)->right);
+        free (*event_p);
+        *event_p = NULL;
+    }
+}
+
+static itc_event_t *
+s_event_dup (itc_event_t *event)
+{
+    itc_event_t *copy = s_event_leaf (event->value);
+    if (event->left) {
+        copy->left = s_event_dup (event->left);
+        copy->right = s_event_dup (event->right);
+    }
+    return copy;
+}
+
+static unsigned long
+s_event_min (itc_event_t *event)
+{
+    if (!event->left)
+        return event->value;
+    unsigned long left = s_event_min (event->left);
+    unsigned long right = s_event_min (event->right);
+    return event->value + (left < right? left: right);
+}
+
+static unsigned long
+s_event_max (itc_event_t *event)
+{
+    if (!event->left)
+        return event->value;
+    unsigned long left = s_event_max (event->left);
+    unsigned long right = s_event_max (event->right);
+    return event->value + (left > right? left: right);
+}
+
+//  Creates a normalized node of normalized children. Equal leaves are
+//  merged, the common minimum of the children is sunk into the node.
+
+static itc_event_t *
+s_event_node (unsigned long value, itc_event_t *left, itc_event_t *right)
+{
+    if (!left->left && !right->left && left->value == right->value) {
+        value += left->value;
+        s_event_destroy (&left);
+        s_event_destroy (&right);
+        return s_event_leaf (value);
+    }
+    //  The minimum of a normalized tree is its root value
+    unsigned long min = left->value < right->value? left->value: right->value;
+    left->value -= min;
+    right->value -= min;
+    itc_event_t *event = s_event_leaf (value + min);
+    event->left = left;
+    event->right = right;
+    return event;
+}
+
+//  Normalizes an event tree, consumes it
+
+static itc_event_t *
+s_event_norm (itc_event_t *event)
+{
+    if (!event->left)
+        return event;
+    itc_event_t *left = s_event_norm (event->left);
+    itc_event_t *right = s_event_norm (event->right);
+    unsigned long value = event->value;
+    free (event);
+    return s_event_node (value, left, right);
+}
+
+//  Returns true if every count of a lifted by offset_a is not above the
+//  count of b lifted by offset_b
+
+static bool
+s_event_leq (itc_event_t *a, unsigned long offset_a, itc_event_t *b, unsigned long offset_b)
+{
+    unsigned long base_a = offset_a + a->value;
+    unsigned long base_b = offset_b + b->value;
+    if (base_a > base_b)
+        return false;
+    if (!a->left)
+        return true;
+    if (!b->left)
+        return s_event_leq (a->left, base_a, b, offset_b)
+            && s_event_leq (a->right, base_a, b, offset_b);
+    return s_event_leq (a->left, base_a, b->left, base_b)
+        && s_event_leq (a->right, base_a, b->right, base_b);
+}
+
+//  Joins two event trees to their maximum, consumes both
+
+static itc_event_t *
+s_event_join (itc_event_t *a, itc_event_t *b)
+{
+    if (!a->left && !b->left) {
+        if (b->value > a->value)
+            a->value = b->value;
+        s_event_destroy (&b);
+        return a;
+    }
+    if (a->value > b->value) {
+        itc_event_t *swap = a;
+        a = b;
+        b = swap;
+    }
+    if (!a->left) {
+        a->left = s_event_leaf (0);
+        a->right = s_event_leaf (0);
+    }
+    if (!b->left) {
+        b->left = s_event_leaf (0);
+        b->right = s_event_leaf (0);
+    }
+    //  Lift the children of b onto the base of a
+    unsigned long lift = b->value - a->value;
+    b->left->value += lift;
+    b->right->value += lift;
+    itc_event_t *left = s_event_join (a->left, b->left);
+    itc_event_t *right = s_event_join (a->right, b->right);
+    unsigned long value = a->value;
+    free (a);
+    free (b);
+    return s_event_node (value, left, right);
+}
+
+//  Inflates the parts of event owned by id to the maximum of their
+//  neighbors, without adding new events. Consumes event, sets changed if
+//  anything was inflated.
+
+static itc_event_t *
+s_event_fill (itc_id_t *id, itc_event_t *event, bool *changed)
+{
+    if (s_id_is (id, 0) || !event->left)
+        return event;
+    if (s_id_is (id, 1)) {
+        //  A normalized node is never flat, so this always inflates
+        unsigned long max = s_event_max (event);
+        s_event_destroy (&event);
+        *changed = true;
+        return s_event_leaf (max);
+    }
+    unsigned long value = event->value;
+    itc_event_t *left = event->left;
+    itc_event_t *right = event->right;
+    free (event);
+    if (s_id_is (id->left, 1)) {
+        right = s_event_fill (id->right, right, changed);
+        unsigned long max = s_event_max (left);
+        unsigned long min = s_event_min (right);
+        if (min > max)
+            max = min;
+        if (left->left || left->value != max)
+            *changed = true;
+        s_event_destroy (&left);
+        left = s_event_leaf (max);
+    }
+    else
+    if (s_id_is (id->right, 1)) {
+        left = s_event_fill (id->left, left, changed);
+        unsigned long max = s_event_max (right);
+        unsigned long min = s_event_min (left);
+        if (min > max)
+            max = min;
+        if (right->left || right->value != max)
+            *changed = true;
+        s_event_destroy (&right);
+        right = s_event_leaf (max);
+    }
+    else {
+        left = s_event_fill (id->left, left, changed);
+        right = s_event_fill (id->right, right, changed);
+    }
+    return s_event_node (value, left, right);
+}
+
+//  Returns the cost of growing event within id, NULL is a leaf 0. Every
+//  level adds 1, expanding a leaf adds ZITC_GROW_EXPAND.
+
+static unsigned long
+s_event_grow_cost (itc_id_t *id, itc_event_t *event)
+{
+    if (!id->left)
+        return 0;
+    unsigned long cost = 1;
+    itc_event_t *left = NULL;
+    itc_event_t *right = NULL;
+    if (event && event->left) {
+        left = event->left;
+        right = event->right;
+    }
+    else
+        cost += ZITC_GROW_EXPAND;
+
+    if (s_id_is (id->left, 0))
+        return cost + s_event_grow_cost (id->right, right);
+    if (s_id_is (id->right, 0))
+        return cost + s_event_grow_cost (id->left, left);
+    unsigned long cost_left = s_event_grow_cost (id->left, left);
+    unsigned long cost_right = s_event_grow_cost (id->right, right);
+    return cost + (cost_left < cost_right? cost_left: cost_right);
+}
+
+//  Adds an event within id, choosing the branch which keeps the tree
+//  smallest
+
+static void
+s_event_grow (itc_id_t *id, itc_event_t *event)
+{
+    if (!id->left) {
+        event->value++;
+        return;
+    }
+    if (!event->left) {
+        event->left = s_event_leaf (0);
+        event->right = s_event_leaf (0);
+    }
+    if (s_id_is (id->left, 0))
+        s_event_grow (id->right, event->right);
+    else
+    if (s_id_is (id->right, 0))
+        s_event_grow (id->left, event->left);
+    else
+    if (s_event_grow_cost (id->left, event->left) < s_event_grow_cost (id->right, event->right))
+        s_event_grow (id->left, event->left);
+    else
+        s_event_grow (id->right, event->right);
+}
+
+static void
+s_id_format (itc_id_t *id, zchunk_t *chunk)
+{
+    if (!id->left)
+        zchunk_extend (chunk, id->value? "1": "0", 1);
+    else {
+        zchunk_extend (chunk, "(", 1);
+        s_id_format (id->left, chunk);
+        zchunk_extend (chunk, ",", 1);
+        s_id_format (id->right, chunk);
+        zchunk_extend (chunk, ")", 1);
+    }
+}
+
+static void
+s_event_format (itc_event_t *event, zchunk_t *chunk)
+{
+    char value [24];
+    int size = snprintf (value, sizeof (value), "%lu", event->value);
+    if (!event->left)
+        zchunk_extend (chunk, value, size);
+    else {
+        zchunk_extend (chunk, "(", 1);
+        zchunk_extend (chunk, value, size);
+        zchunk_extend (chunk, ",", 1);
+        s_event_format (event->left, chunk);
+        zchunk_extend (chunk, ",", 1);
+        s_event_format (event->right, chunk);
+        zchunk_extend (chunk, ")", 1);
+    }
+}
+
+//  Parses an id at needle and advances needle. Returns NULL on errors.
+
+static itc_id_t *
+s_id_parse (const char **needle)
+{
+    if (**needle == '0' || **needle == '1')
+        return s_id_leaf (*(*needle)++ - '0');
+    if (**needle != '(')
+        return NULL;
+    (*needle)++;
+    itc_id_t *left = s_id_parse (needle);
+    itc_id_t *right = NULL;
+    if (left && *(*needle)++ == ',')
+        right = s_id_parse (needle);
+    if (!right || *(*needle)++ != ')') {
+        s_id_destroy (&left);
+        s_id_destroy (&right);
+        return NULL;
+    }
+    return s_id_node (left, right);
+}
+
+//  Parses an event tree at needle and advances needle. Returns NULL on
+//  errors. The tree isn't normalized.
+
+static itc_event_t *
+s_event_parse (const char **needle)
+{
+    char *end;
+    if (isdigit ((unsigned char) **needle)) {
+        unsigned long value = strtoul (*needle, &end, 10);
+        *needle = end;
+        return s_event_leaf (value);
+    }
+    if (**needle != '(' || !isdigit ((unsigned char) (*needle) [1]))
+        return NULL;
+    itc_event_t *event = s_event_leaf (strtoul (*needle + 1, &end, 10));
+    *needle = end;
+    if (*(*needle)++ == ',')
+        event->left = s_event_parse (needle);
+    if (event->left && *(*needle)++ == ',')
+        event->right = s_event_parse (needle);
+    if (!event->right || *(*needle)++ != ')')
+        s_event_destroy (&event);
+    return event;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create the seed zitc, it owns the whole id space
+
+zitc_t *
+zitc_new (void)
+{
+    zitc_t *self = (zitc_t *) zmalloc (sizeof (zitc_t));
+    assert (self);
+    //  Initialize class properties here
+    self->id = s_id_leaf (1);
+    self->event = s_event_leaf (0);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the zitc
+
+void
+zitc_destroy (zitc_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zitc_t *self = *self_p;
+        //  Free class properties here
+        s_id_destroy (&self->id);
+        s_event_destroy (&self->event);
+        //  Free object itself
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Split the id of self in two. Self keeps one half, the returned zitc gets
+//  the other, e.g. for a joining process.
+
+zitc_t *
+zitc_fork (zitc_t *self)
+{
+    assert (self);
+    zitc_t *other = (zitc_t *) zmalloc (sizeof (zitc_t));
+    assert (other);
+    itc_id_t *left, *right;
+    s_id_split (self->id, &left, &right);
+    s_id_destroy (&self->id);
+    self->id = left;
+    other->id = right;
+    other->event = s_event_dup (self->event);
+    return other;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Merge other into self, e.g. when a process leaves. Self takes over the
+//  id of other and other is destroyed.
+
+void
+zitc_join (zitc_t *self, zitc_t **other_p)
+{
+    assert (self);
+    assert (other_p);
+    zitc_t *other = *other_p;
+    if (other) {
+        self->id = s_id_sum (self->id, other->id);
+        self->event = s_event_join (self->event, other->event);
+        free (other);
+        *other_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns an anonymous copy of self, it has the events but no id
+
+zitc_t *
+zitc_peek (zitc_t *self)
+{
+    assert (self);
+    zitc_t *copy = (zitc_t *) zmalloc (sizeof (zitc_t));
+    assert (copy);
+    copy->id = s_id_leaf (0);
+    copy->event = s_event_dup (self->event);
+    return copy;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Duplicates the given zitc, returns a freshly allocated duplicate.
+
+zitc_t *
+zitc_dup (zitc_t *self)
+{
+    assert (self);
+    zitc_t *copy = (zitc_t *) zmalloc (sizeof (zitc_t));
+    assert (copy);
+    copy->id = s_id_dup (self->id);
+    copy->event = s_event_dup (self->event);
+    return copy;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Increments the own clock value. Inflating the own part of the event tree
+//  is preferred as it shrinks the tree, otherwise the tree grows where it
+//  adds the least nodes.
+
+void
+zitc_event (zitc_t *self)
+{
+    assert (self);
+    //  Anonymous clocks can't count events
+    assert (!s_id_is (self->id, 0));
+    bool changed = false;
+    self->event = s_event_fill (self->id, self->event, &changed);
+    if (!changed) {
+        s_event_grow (self->id, self->event);
+        self->event = s_event_norm (self->event);
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Eventing own clock & packing the events with given msg
+
+zmsg_t *
+zitc_send_prepare (zitc_t *self, zmsg_t *msg)
+{
+    assert (self);
+    assert (msg);
+
+    zitc_event (self);
+    zitc_t *stamp = zitc_peek (self);
+    char *clock_string = zitc_to_string (stamp);
+    zmsg_pushstr (msg, clock_string);
+    zstr_free (&clock_string);
+    zitc_destroy (&stamp);
+    return msg;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Recv the events & updates own clock. Malformed clocks are ignored.
+
+void
+zitc_recv (zitc_t *self, zmsg_t *msg)
+{
+    assert (self);
+    assert (msg);
+
+    char *clock_string = zmsg_popstr (msg);
+    assert (clock_string);
+    zitc_t *sender = zitc_from_string (clock_string);
+    zstr_free (&clock_string);
+    if (sender) {
+        self->event = s_event_join (self->event, sender->event);
+        sender->event = NULL;
+        zitc_destroy (&sender);
+    }
+    zitc_event (self);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Compares zitc self to zitc other.
+//  Returns -1 at happened before other, 0 at parallel, 1 at happened after
+//  and 2 when clocks are the same
+
+int
+zitc_compare_to (zitc_t *self, zitc_t *other)
+{
+    assert (self);
+    assert (other);
+    bool before = s_event_leq (self->event, 0, other->event, 0);
+    bool after = s_event_leq (other->event, 0, self->event, 0);
+    if (before && after)
+        return 2;
+    return before? -1: after? 1: 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Converts the zitc into string representation
+//  formation: 'ITC:$id;$events;\0'
+
+char *
+zitc_to_string (zitc_t *self)
+{
+    assert (self);
+    zchunk_t *chunk = zchunk_new ("ITC:", 4);
+    s_id_format (self->id, chunk);
+    zchunk_extend (chunk, ";", 1);
+    s_event_format (self->event, chunk);
+    zchunk_extend (chunk, ";", 2);      //  Including null terminator
+
+    char *result = strdup ((const char *) zchunk_data (chunk));
+    zchunk_destroy (&chunk);
+    return result;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Creates a zitc from a given string representation. Returns NULL if the
+//  string is malformed.
+
+zitc_t *
+zitc_from_string (const char *clock_string)
+{
+    assert (clock_string);
+    if (strncmp (clock_string, "ITC:", 4) != 0)
+        return NULL;
+    const char *needle = clock_string + 4;
+    itc_id_t *id = s_id_parse (&needle);
+    itc_event_t *event = NULL;
+    if (id && *needle++ == ';')
+        event = s_event_parse (&needle);
+    if (!event || *needle++ != ';' || *needle) {
+        s_id_destroy (&id);
+        s_event_destroy (&event);
+        return NULL;
+    }
+    zitc_t *self = (zitc_t *) zmalloc (sizeof (zitc_t));
+    assert (self);
+    self->id = id;
+    self->event = s_event_norm (event);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+zitc_test (bool verbose)
+{
+    printf (" * zitc: ");
+
+    //  @selftest
+    //  TEST: seed and events
+    zitc_t *seed = zitc_new ();
+    assert (seed);
+    char *clock_string = zitc_to_string (seed);
+    assert (streq (clock_string, "ITC:1;0;"));
+    zstr_free (&clock_string);
+    zitc_event (seed);
+    zitc_event (seed);
+    clock_string = zitc_to_string (seed);
+    assert (streq (clock_string, "ITC:1;2;"));
+    zstr_free (&clock_string);
+
+    //  TEST: fork, events and compare
+    zitc_t *forked = zitc_fork (seed);
+    clock_string = zitc_to_string (seed);
+    assert (streq (clock_string, "ITC:(1,0);2;"));
+    zstr_free (&clock_string);
+    clock_string = zitc_to_string (forked);
+    assert (streq (clock_string, "ITC:(0,1);2;"));
+    zstr_free (&clock_string);
+    assert (zitc_compare_to (seed, forked) == 2);
+
+    zitc_event (seed);
+    clock_string = zitc_to_string (seed);
+    assert (streq (clock_string, "ITC:(1,0);(2,1,0);"));
+    zstr_free (&clock_string);
+    assert (zitc_compare_to (forked, seed) == -1);
+    assert (zitc_compare_to (seed, forked) == 1);
+    zitc_event (forked);
+    assert (zitc_compare_to (seed, forked) == 0);
+
+    //  TEST: send and recv
+    zmsg_t *msg = zmsg_new ();
+    zmsg_addstr (msg, "PAYLOAD");
+    zitc_send_prepare (seed, msg);
+    assert (zframe_streq (zmsg_first (msg), "ITC:0;(2,2,0);"));
+    zitc_t *before = zitc_dup (seed);
+    zitc_recv (forked, msg);
+    char *payload = zmsg_popstr (msg);
+    assert (streq (payload, "PAYLOAD"));
+    zstr_free (&payload);
+    zmsg_destroy (&msg);
+    assert (zitc_compare_to (before, forked) == -1);
+    clock_string = zitc_to_string (forked);
+    assert (streq (clock_string, "ITC:(0,1);4;"));
+    zstr_free (&clock_string);
+    zitc_destroy (&before);
+
+    //  TEST: parsing
+    zitc_t *parsed = zitc_from_string ("ITC:((1,0),0);(1,(0,2,2),3);");
+    assert (parsed);
+    clock_string = zitc_to_string (parsed);
+    assert (streq (clock_string, "ITC:((1,0),0);(3,0,1);"));
+    zstr_free (&clock_string);
+    zitc_destroy (&parsed);
+    assert (zitc_from_string ("VC:1;own:1000;1000,1;") == NULL);
+    assert (zitc_from_string ("ITC:2;0;") == NULL);
+    assert (zitc_from_string ("ITC:(1,0);(1,2);") == NULL);
+    assert (zitc_from_string ("ITC:1;1") == NULL);
+
+    //  TEST: the clock shrinks when processes leave
+    zitc_t *processes [100];
+    int index;
+    for (index = 0; index < 100; index++) {
+        processes [index] = zitc_fork (index? processes [index / 2]: seed);
+        zitc_event (processes [index]);
+    }
+    for (index = 0; index < 100; index++) {
+        msg = zmsg_new ();
+        zitc_send_prepare (processes [index], msg);
+        zitc_recv (seed, msg);
+        zmsg_destroy (&msg);
+    }
+    clock_string = zitc_to_string (seed);
+    size_t churned_size = strlen (clock_string);
+    zstr_free (&clock_string);
+    for (index = 99; index >= 0; index--)
+        zitc_join (index? processes [index / 2]: seed, &processes [index]);
+    zitc_join (seed, &forked);
+    zitc_event (seed);
+    clock_string = zitc_to_string (seed);
+    if (verbose)
+        printf ("%zu bytes with 101 processes, %s after they left\n", churned_size, clock_string);
+    assert (strncmp (clock_string, "ITC:1;", 6) == 0);
+    assert (strchr (clock_string + 6, '(') == NULL);
+    zstr_free (&clock_string);
+
+    zitc_destroy (&seed);
+    //  @end
+
+    printf ("OK\n");
+}
@@ -19,6 +19,167 @@
 
 #include "zlog_classes.h"
 
+//  Maximum number of zyre events handled in one go in batch mode
+#define ZLOG_BATCH_MAX 256
+
+//  Default interval between two collect waves of the leader in ms
+#define ZLOG_COLLECT_INTERVAL 5000
+
+//  Default time in ms without membership changes before an election starts
+#define ZLOG_STARTUP_QUIET 250
+
+//  Maximum number of collect waves whose start time is tracked
+#define ZLOG_WAVE_STARTS_MAX 64
+
+//  Default bytes of unstable ordered log entries held by the leader
+#define ZLOG_ORDERED_LOG_MAX (64 * 1024 * 1024)
+
+//  Default bytes of collected log entries held in memory by a peer
+#define ZLOG_COLLECT_LOG_MAX (16 * 1024 * 1024)
+
+//  Bytes at the end of a log searched for its last clock on restore
+#define ZLOG_CHECKPOINT_TAIL (64 * 1024)
+
+//  Msecs without an acknowledgement after which sent lines count as lost,
+//  the collect wave that carried them has expired by then
+#define ZLOG_RETRANSMIT_TIMEOUT 30000
+
+//  Msecs READY waits for the election to conclude by default. Every
+//  membership change restarts the startup quiet period before an election,
+//  10 s leave room for a cluster whose nodes are discovered over several
+//  seconds. An election which starves is answered with 2 instead of
+//  blocking the caller.
+#define ZLOG_READY_TIMEOUT 10000
+
+//  Agreement on the final clock value of a departed peer
+
+typedef struct {
+    unsigned long final;        //  Highest value of the departed pid reported
+    zhashx_t *reporters;        //  Peers which reported, by uuid
+    bool reported;              //  Did this node report?
+} prune_t;
+
+//  Consecutive lines of an origin in a collect message
+
+typedef struct {
+    char *origin;
+    uint64_t acked;             //  Lines of the origin acknowledged by a leader
+    uint64_t first;             //  Number of the first line
+    uint64_t size;              //  Number of lines
+} run_t;
+
+//  Log of a previous incarnation of this node, shipped until the leader
+//  acknowledged all of its lines
+
+typedef struct {
+    int lines_read;             //  Lines read from its log
+    int lines_acked;            //  Lines ingested by the leader
+    int64_t acked_at;           //  Time lines_acked last advanced
+} resumed_t;
+
+//  Lines of an origin a relay spooled for its father
+
+typedef struct {
+    uint64_t spooled;           //  Highest line spooled
+    uint64_t acked;             //  Highest line ingested by the leader
+    int64_t acked_at;           //  Time acked last advanced
+} relayed_t;
+
+//  Metrics of the actor, resolved to handles once when it is created.
+//  Only STATS looks them up by name.
+
+enum {
+    METRIC_BYTES_RECV_BAKERY,
+    METRIC_BYTES_RECV_ZECHO,
+    METRIC_BYTES_RECV_ZLE,
+    METRIC_BYTES_SENT_BAKERY,
+    METRIC_CHECKPOINT_WRITTEN,
+    METRIC_CLOCK_BYTES_RECV,
+    METRIC_CLOCK_BYTES_SENT,
+    METRIC_CLOCK_DEPARTED_PENDING,
+    METRIC_CLOCK_DEPS_PENDING,
+    METRIC_CLOCK_ENTRIES,
+    METRIC_CLOCK_PRUNED,
+    METRIC_COLLECT_BATCH_BYTES,
+    METRIC_COLLECT_DUPLICATES,
+    METRIC_COLLECT_LINES,
+    METRIC_COLLECT_OUT_OF_ORDER,
+    METRIC_COLLECT_RESUMED,
+    METRIC_COLLECT_RETRANSMITTED,
+    METRIC_COLLECT_TEXT_BYTES,
+    METRIC_COLLECT_UNACKED,
+    METRIC_COLLECT_WAVE_US,
+    METRIC_COLLECT_WAVES_PENDING,
+    METRIC_COLLECT_LOG_BYTES,
+    METRIC_COLLECT_LOG_ENTRIES,
+    METRIC_COLLECT_LOG_SPILLED_BYTES,
+    METRIC_ELECTION_STARTED,
+    METRIC_HANDLER_API_US,
+    METRIC_HANDLER_CHECKPOINT_US,
+    METRIC_HANDLER_COLLECT_US,
+    METRIC_HANDLER_RESTORE_US,
+    METRIC_HANDLER_ZYRE_EVENTS,
+    METRIC_HANDLER_ZYRE_US,
+    METRIC_ORDERED_LOG_BYTES,
+    METRIC_ORDERED_LOG_DEPS_FORCED,
+    METRIC_ORDERED_LOG_DRAINED,
+    METRIC_ORDERED_LOG_ENTRIES,
+    METRIC_ORDERED_LOG_EVICTED,
+    METRIC_ORDERED_LOG_FORCED,
+    METRIC_RECV_BAKERY,
+    METRIC_RECV_ZECHO,
+    METRIC_RECV_ZLE,
+    METRIC_SENT_BAKERY,
+    METRICS
+};
+
+static const struct {
+    const char *name;
+    size_t (*resolve) (zmetrics_t *self, const char *name);
+} s_metrics [METRICS] = {
+    { "bytes_recv.BAKERY", zmetrics_counter },
+    { "bytes_recv.ZECHO", zmetrics_counter },
+    { "bytes_recv.ZLE", zmetrics_counter },
+    { "bytes_sent.BAKERY", zmetrics_counter },
+    { "checkpoint.written", zmetrics_counter },
+    { "clock.bytes_recv", zmetrics_counter },
+    { "clock.bytes_sent", zmetrics_counter },
+    { "clock.departed_pending", zmetrics_gauge },
+    { "clock.deps_pending", zmetrics_gauge },
+    { "clock.entries", zmetrics_gauge },
+    { "clock.pruned", zmetrics_counter },
+    { "collect.batch_bytes", zmetrics_counter },
+    { "collect.duplicates", zmetrics_counter },
+    { "collect.lines", zmetrics_histogram },
+    { "collect.out_of_order", zmetrics_counter },
+    { "collect.resumed", zmetrics_gauge },
+    { "collect.retransmitted", zmetrics_counter },
+    { "collect.text_bytes", zmetrics_counter },
+    { "collect.unacked", zmetrics_gauge },
+    { "collect.wave_us", zmetrics_histogram },
+    { "collect.waves_pending", zmetrics_gauge },
+    { "collect_log.bytes", zmetrics_gauge },
+    { "collect_log.entries", zmetrics_gauge },
+    { "collect_log.spilled_bytes", zmetrics_gauge },
+    { "election.started", zmetrics_counter },
+    { "handler.api_us", zmetrics_histogram },
+    { "handler.checkpoint_us", zmetrics_histogram },
+    { "handler.collect_us", zmetrics_histogram },
+    { "handler.restore_us", zmetrics_histogram },
+    { "handler.zyre_events", zmetrics_histogram },
+    { "handler.zyre_us", zmetrics_histogram },
+    { "ordered_log.bytes", zmetrics_gauge },
+    { "ordered_log.deps_forced", zmetrics_counter },
+    { "ordered_log.drained", zmetrics_counter },
+    { "ordered_log.entries", zmetrics_gauge },
+    { "ordered_log.evicted", zmetrics_counter },
+    { "ordered_log.forced", zmetrics_counter },
+    { "recv.BAKERY", zmetrics_counter },
+    { "recv.ZECHO", zmetrics_counter },
+    { "recv.ZLE", zmetrics_counter },
+    { "sent.BAKERY", zmetrics_counter },
+};
+
 //  Structure of our actor
 
 struct _zlog_t {
@@ -28,17 +189,62 @@ struct _zlog_t {
     bool verbose;               //  Verbose logging enabled?
     //  Actor properties
     bool dump_ts;               //  Dump time space subgraph during destruction
+    bool batch;                 //  Deliver received messages in batches?
+    zmsg_t *deliveries;         //  Batch of received messages to deliver
 
     //  Leader properties
     int leader_timer;           //  ID of leader's collect timer
-    zlistx_t *ordered_log;      //  List of ordered log entries
+    int collect_interval;       //  Interval between collect waves in ms
+    zhashx_t *wave_starts;      //  Start time in usecs of pending collect waves
+    size_t waves;               //  Number of concluded collect waves
+    zchunk_t *wave_latencies;   //  Collect wave latencies in usecs
+    zchunk_t *entry_latencies;  //  Log entry to ordered log latencies in usecs
+    size_t wave_lines;          //  Lines collected by the current wave
+    zlistx_t *ordered_log;      //  Ordered log entries not yet stable
+    size_t ordered_log_bytes;   //  Bytes held by ordered_log
+    size_t ordered_log_max;     //  Bytes held before entries are forced out
+    size_t ordered_entries;     //  Number of entries ever ordered
+    zhashx_t *frontier;         //  Highest own clock value received per pid
+    zhashx_t *hlc_frontier;     //  Highest HLC timestamp received per pid
+    zhashx_t *ingested;         //  Lines ingested per origin
+    zhashx_t *durable;          //  Lines ingested per origin at the last checkpoint
+    zdeps_t *deps;              //  Entries waiting for their clock in DD mode
+    zactor_t *writer;           //  Writes the ordered log while leading
+    char *ordered_log_path;     //  Prefix of the ordered log files
+    char *ordered_term;         //  Ordered log file of the current term
+    size_t terms;               //  Leadership terms of this node
+    uint64_t ordered_stable;    //  Bytes handed to the writer as stable
     //  Peer properties
-    zlistx_t *collect_log;      //  Collect log messages from peers to forward to father
+    char *log_dir;              //  Directory of the logs to collect
+    zlog_spool_t *collect_log;  //  Collect log messages from peers to forward to father
+    size_t collect_log_max;     //  Bytes held in memory and sent per wave
+    zbatch_t *collect_batch;    //  Encodes the log messages sent per wave
     int linesRead;              //  How many lines have been read from logfile
+    int lines_acked;            //  Lines of the logfile ingested by the leader
+    int64_t acked_at;           //  Time lines_acked last advanced
+    zhashx_t *relayed;          //  Lines spooled for the father per origin
+    zmsg_t *acks;               //  Acknowledgements of the leader to forward
+    zhashx_t *resumed;          //  Logs of previous incarnations by uuid
+    char *checkpoint;           //  Checkpoint file, NULL if disabled
+    int checkpoint_timer;       //  ID of the checkpoint timer
+    char *checkpoint_tail;      //  Ordered log tail of the last checkpoint
     //  Communication properties
     zelection_t *election;      //  Election mechanism
+    int election_timer;         //  ID of the membership quiet period timer
+    int startup_quiet;          //  Quiet period in ms before an election starts
+    size_t expected_peers;      //  Peers to start the first election, 0 if unknown
+    bool running;               //  Was the node started?
+    bool elected;               //  Did the first election start?
+    bool ready_pending;         //  Signal the pipe when the election concluded?
+    int ready_timer;            //  ID of the timer failing a pending READY
     zecho_t *collector;         //  Log collector
     zvector_t *clock;           //  Vector clock for this self
+    zhlc_t *hlc;                //  Hybrid logical clock, NULL in VC mode
+    zhashx_t *departed;         //  Pending prunes of departed peers by uuid
+    zmetrics_t *metrics;        //  Counters and histograms of this actor
+    size_t metric [METRICS];    //  Handles of the metrics
+    zarena_t *arena;            //  Transient strings, reset after each handler
+    int stats_timer;            //  ID of the periodic metrics dump timer
 
     zyre_t *node;               //  Zyre handle
 };
@@ -47,9 +253,6 @@ struct _zlog_t {
 //  --------------------------------------------------------------------------
 //  Internal helper functions
 
-static zvector_t *
-s_get_clock_from_log_msg (char *logMsg);
-
 static unsigned long long *
 s_get_timestamp_from_logMsg (char *logMsg);
 
@@ -59,6 +262,24 @@ s_zlog_recv_api (zloop_t *loop, zsock_t *reader, void *arg);
 static int
 s_zlog_recv_zyre (zloop_t *loop, zsock_t *reader, void *arg);
 
+static void
+s_zlog_process_collect_log (zecho_t *echo, zmsg_t *msg, zlog_t *self);
+
+static zmsg_t *
+s_zlog_send_collect_log (zecho_t *echo, zlog_t *self);
+
+static void
+s_prune_destroy (prune_t **self_p);
+
+static void
+s_zlog_process_acks (zecho_t *echo, zmsg_t *msg, zlog_t *self);
+
+static zmsg_t *
+s_zlog_send_acks (zecho_t *echo, zlog_t *self);
+
+static void
+s_zlog_checkpoint (zlog_t *self);
+
 //  --------------------------------------------------------------------------
 //  Create a new zlog instance
 
@@ -80,19 +301,81 @@ zlog_new (zsock_t *pipe, void *args)
     self->node = zyre_new (NULL);
     zloop_reader (self->loop, zyre_socket (self->node), s_zlog_recv_zyre, self);
     self->clock = zvector_new (zyre_uuid (self->node));
+    self->arena = zarena_new (0);
+    zvector_set_arena (self->clock, self->arena);
+    self->departed = zhashx_new ();
+    zhashx_set_destructor (self->departed, (zhashx_destructor_fn *) s_prune_destroy);
+    self->metrics = zmetrics_new ();
+    size_t metric;
+    for (metric = 0; metric < METRICS; metric++)
+        self->metric [metric] = s_metrics [metric].resolve (self->metrics, s_metrics [metric].name);
+    self->stats_timer = -1;
     self->election = zelection_new (self->node);
     zelection_set_clock (self->election, self->clock);
+    zelection_set_metrics (self->election, self->metrics);
+    self->election_timer = -1;
+    self->startup_quiet = ZLOG_STARTUP_QUIET;
+    self->expected_peers = 0;
+    self->running = false;
+    self->elected = false;
+    self->ready_pending = false;
+    self->ready_timer = -1;
+    self->collector = zecho_new (self->node);
+    zecho_set_clock (self->collector, self->clock);
+    zecho_set_metrics (self->collector, self->metrics);
+    zecho_set_collect_handler (self->collector, self);
+    zecho_set_collect_process (self->collector, (zecho_process_fn *) s_zlog_process_collect_log);
+    zecho_set_collect_create (self->collector, (zecho_create_fn *) s_zlog_send_collect_log);
+    zecho_set_inform_handler (self->collector, self);
+    zecho_set_inform_process (self->collector, (zecho_process_fn *) s_zlog_process_acks);
+    zecho_set_inform_create (self->collector, (zecho_create_fn *) s_zlog_send_acks);
     self->dump_ts = false;
 
     //  Initialize leader properties
+    self->leader_timer = -1;
     self->ordered_log = zlistx_new ();
     zlistx_set_destructor (self->ordered_log, (zlistx_destructor_fn *) zstr_free);
     zlistx_set_comparator (self->ordered_log, (zlistx_comparator_fn *) zlog_compare_log_msg_vc);
+    self->ordered_log_bytes = 0;
+    self->ordered_log_max = ZLOG_ORDERED_LOG_MAX;
+    self->ordered_entries = 0;
+    self->frontier = zhashx_new ();
+    zhashx_set_destructor (self->frontier, (zhashx_destructor_fn *) zstr_free);
+    self->hlc_frontier = zhashx_new ();
+    zhashx_set_destructor (self->hlc_frontier, (zhashx_destructor_fn *) zstr_free);
+    self->ingested = zhashx_new ();
+    zhashx_set_destructor (self->ingested, (zhashx_destructor_fn *) zstr_free);
+    self->durable = zhashx_new ();
+    zhashx_set_destructor (self->durable, (zhashx_destructor_fn *) zstr_free);
+    self->deps = zdeps_new ();
+    self->ordered_log_path = strdup ("./ordered_log");
+    self->writer = NULL;
+    self->ordered_term = NULL;
+    self->terms = 0;
+    self->ordered_stable = 0;
+    self->collect_interval = ZLOG_COLLECT_INTERVAL;
+    self->wave_starts = zhashx_new ();
+    zhashx_set_destructor (self->wave_starts, (zhashx_destructor_fn *) zstr_free);
+    self->waves = 0;
+    self->wave_latencies = zchunk_new (NULL, 0);
+    self->entry_latencies = zchunk_new (NULL, 0);
 
     //  Initialize peer properties
-    self->collect_log = zlistx_new ();
-    zlistx_set_destructor (self->collect_log, (zlistx_destructor_fn *) zstr_free);
+    self->log_dir = strdup ("/tmp");
+    self->collect_log_max = ZLOG_COLLECT_LOG_MAX;
+    char *spool_path = zsys_sprintf ("/tmp/collect_%s", zyre_uuid (self->node));
+    self->collect_log = zlog_spool_new (spool_path, self->collect_log_max);
+    zstr_free (&spool_path);
+    self->collect_batch = zbatch_new ();
     self->linesRead = 0;
+    self->lines_acked = 0;
+    self->acked_at = zclock_mono ();
+    self->relayed = zhashx_new ();
+    zhashx_set_destructor (self->relayed, (zhashx_destructor_fn *) zstr_free);
+    self->resumed = zhashx_new ();
+    zhashx_set_destructor (self->resumed, (zhashx_destructor_fn *) zstr_free);
+    self->checkpoint_timer = -1;
+    self->checkpoint_tail = NULL;
 
     //  Enable Gossip discovery
     if (params) {
@@ -122,16 +405,46 @@ zlog_destroy (zlog_t **self_p)
     if (*self_p) {
         zlog_t *self = *self_p;
 
+        s_zlog_checkpoint (self);
         if (self->dump_ts)
             zvector_dump_time_space (self->clock);
+#if defined (ZLOG_TRACE)
+        char *trace = zsys_sprintf ("trace_%s.json", zyre_uuid (self->node));
+        zlog_trace_flush (trace);
+        zstr_free (&trace);
+#endif
+        zlog_trace_release ();
 
         //  Free actor properties
+        zhlc_destroy (&self->hlc);
         zvector_destroy (&self->clock);
+        zhashx_destroy (&self->departed);
+        zarena_destroy (&self->arena);
+        zmetrics_destroy (&self->metrics);
         zelection_destroy (&self->election);
         zecho_destroy (&self->collector);
         zyre_destroy (&self->node);
         zlistx_destroy (&self->ordered_log);
-        zlistx_destroy (&self->collect_log);
+        zhashx_destroy (&self->frontier);
+        zhashx_destroy (&self->hlc_frontier);
+        zhashx_destroy (&self->ingested);
+        zhashx_destroy (&self->durable);
+        zdeps_destroy (&self->deps);
+        zactor_destroy (&self->writer);
+        zstr_free (&self->ordered_log_path);
+        zstr_free (&self->ordered_term);
+        zhashx_destroy (&self->wave_starts);
+        zchunk_destroy (&self->wave_latencies);
+        zchunk_destroy (&self->entry_latencies);
+        zlog_spool_destroy (&self->collect_log);
+        zbatch_destroy (&self->collect_batch);
+        zmsg_destroy (&self->acks);
+        zhashx_destroy (&self->resumed);
+        zhashx_destroy (&self->relayed);
+        zstr_free (&self->checkpoint);
+        zstr_free (&self->checkpoint_tail);
+        zstr_free (&self->log_dir);
+        zmsg_destroy (&self->deliveries);
 
         //  Free object itself
         zloop_destroy (&self->loop);
@@ -141,6 +454,105 @@ zlog_destroy (zlog_t **self_p)
 }
 
 
+//  Returns the number of peers in the GLOBAL group, the neighbors of the
+//  election
+
+static size_t
+s_zlog_peers (zlog_t *self)
+{
+    zlist_t *peers = zyre_peers_by_group (self->node, "GLOBAL");
+    size_t size = peers? zlist_size (peers): 0;
+    zlist_destroy (&peers);
+    return size;
+}
+
+
+//  Answer a pending READY with status, 0 if the election concluded, 1 if
+//  there are no peers and 2 if it didn't conclude in time.
+
+static void
+s_zlog_ready_reply (zlog_t *self, int status)
+{
+    assert (self);
+    if (self->ready_timer != -1)
+        zloop_timer_end (self->loop, self->ready_timer);
+    self->ready_timer = -1;
+    self->ready_pending = false;
+    zsock_signal (self->pipe, status);
+}
+
+
+static int
+s_zlog_ready_timer (zloop_t *loop, int timer_id, void *arg)
+{
+    assert (arg);
+    zlog_t *self = (zlog_t *) arg;
+    self->ready_timer = -1;
+    if (self->ready_pending)
+        s_zlog_ready_reply (self, 2);
+    return 0;
+}
+
+
+//  Start an election among the current peers. The leader stops collecting
+//  until the outcome is known. A pending READY is answered with 1 if there
+//  is no one to elect.
+
+static void
+s_zlog_elect (zlog_t *self)
+{
+    assert (self);
+    if (self->election_timer != -1)
+        zloop_timer_end (self->loop, self->election_timer);
+    self->election_timer = -1;
+    if (self->leader_timer != -1)
+        zloop_timer_end (self->loop, self->leader_timer);
+    self->leader_timer = -1;
+
+    self->elected = true;
+    zmetrics_count (self->metrics, self->metric [METRIC_ELECTION_STARTED], 1);
+    zelection_start (self->election);
+    if (self->ready_pending && s_zlog_peers (self) == 0)
+        s_zlog_ready_reply (self, 1);
+}
+
+
+static int
+s_zlog_election_timer (zloop_t *loop, int timer_id, void *arg)
+{
+    assert (arg);
+    zlog_t *self = (zlog_t *) arg;
+    self->election_timer = -1;
+    s_zlog_elect (self);
+    return 0;
+}
+
+
+//  An election which starts before discovery finished counts the wrong
+//  neighbors and never concludes. Every membership change therefore
+//  restarts the quiet period, the election starts once it passed without
+//  further changes. This also re-elects among late joiners. The first
+//  election starts right away once the expected peers are known.
+
+static void
+s_zlog_membership_changed (zlog_t *self)
+{
+    assert (self);
+    if (!self->running)
+        return;
+    if (self->election_timer != -1)
+        zloop_timer_end (self->loop, self->election_timer);
+    self->election_timer = -1;
+
+    if (!self->elected
+    &&  self->expected_peers > 0
+    &&  s_zlog_peers (self) >= self->expected_peers)
+        s_zlog_elect (self);
+    else
+        self->election_timer = zloop_timer (self->loop, self->startup_quiet, 1, s_zlog_election_timer, self);
+}
+
+
 //  Start this actor. Return a value greater or equal to zero if initialization
 //  was successful. Otherwise -1.
 
@@ -155,10 +567,9 @@ zlog_start (zlog_t *self)
     rc = zyre_join (self->node, "GLOBAL");
     assert (rc == 0);
 
-    //  Give time to interconnect
-    zclock_sleep (250);
-
-    zelection_start (self->election);
+    //  The election starts once discovery settled
+    self->running = true;
+    s_zlog_membership_changed (self);
 
     return rc;
 }
@@ -173,30 +584,16 @@ zlog_stop (zlog_t *self)
     assert (self);
 
     //  Shutdown actions
+    if (self->election_timer != -1)
+        zloop_timer_end (self->loop, self->election_timer);
+    self->election_timer = -1;
+    self->running = false;
     zyre_stop (self->node);
 
     return 0;
 }
 
 
-//  Extracts the vectorclock from a given logMsg and returns as new vector
-
-static zvector_t *
-s_get_clock_from_log_msg (char *logMsg)
-{
-  assert (logMsg);
-
-  char *log = strdup (logMsg);
-  char *clock_ptr = NULL;
-  clock_ptr = strtok(log, "/");
-  clock_ptr = strtok(NULL, "/");
-
-  zvector_t *ret = zvector_from_string(clock_ptr);
-  zstr_free (&log);
-
-  return ret;
-}
-
 //  Extracts the timestamp from a given logMsg
 
 static unsigned long long *
@@ -216,6 +613,809 @@ s_get_timestamp_from_logMsg (char *logMsg)
 }
 
 
+//  Log informational message with the clock in use
+
+static void
+s_zlog_info (zlog_t *self, const char *format, ...)
+{
+    assert (self);
+    va_list argptr;
+    va_start (argptr, format);
+    char *logmsg = zsys_vprintf (format, argptr);
+    va_end (argptr);
+    if (self->hlc)
+        zhlc_info (self->hlc, "%s", logmsg);
+    else
+        zvector_info (self->clock, "%s", logmsg);
+    zstr_free (&logmsg);
+}
+
+
+//  Switch the clock stamped on messages and log entries. In HLC mode the
+//  vector clock is piggybacked on every sample_every-th message, 0 never.
+
+static void
+s_zlog_set_clock_mode (zlog_t *self, const char *mode, size_t sample_every)
+{
+    assert (self);
+    zhlc_destroy (&self->hlc);
+    if (streq (mode, "HLC")) {
+        self->hlc = zhlc_new (zyre_uuid (self->node));
+        zhlc_set_sample (self->hlc, self->clock, sample_every);
+    }
+    else
+    if (!streq (mode, "VC") && !streq (mode, "DD"))
+        zsys_error ("invalid clock mode '%s'", mode);
+    zvector_set_direct (self->clock, streq (mode, "DD"));
+
+    zelection_set_hlc (self->election, self->hlc);
+    zecho_set_hlc (self->collector, self->hlc);
+    zlistx_set_comparator (self->ordered_log, self->hlc?
+                           (zlistx_comparator_fn *) zlog_compare_log_msg_hlc:
+                           (zlistx_comparator_fn *) zlog_compare_log_msg_vc);
+}
+
+
+//  Parses the HLC of a log message into value and own pid. Returns 0 on
+//  success, -1 if the message has no HLC.
+
+static int
+s_zlog_hlc_parse (const char *logmsg, uint64_t *value, char *own, size_t own_max)
+{
+    const char *needle = strstr (logmsg, "/HLC:");
+    return needle? zhlc_parse (needle + 1, value, own, own_max): -1;
+}
+
+
+//  Parses the clock of a log message into the own pid. Returns a pointer to
+//  the first value of the clock or NULL if the message has no clock.
+
+static const char *
+s_zlog_clock_own (const char *logmsg, char *own, size_t own_max)
+{
+    const char *needle = strstr (logmsg, "/VC:");
+    needle = needle? strstr (needle, ";own:"): NULL;
+    if (!needle)
+        return NULL;
+    needle += 5;
+    const char *end = strchr (needle, ';');
+    if (!end || (size_t) (end - needle) >= own_max)
+        return NULL;
+    memcpy (own, needle, end - needle);
+    own [end - needle] = 0;
+    return end + 1;
+}
+
+//  Parses the next value of a clock into pid and value. Returns a pointer
+//  to the following value or NULL at the end of the clock.
+
+static const char *
+s_zlog_clock_next (const char *needle, char *pid, size_t pid_max, unsigned long *value)
+{
+    if (*needle == '/' || *needle == 0)
+        return NULL;
+    const char *comma = strchr (needle, ',');
+    if (!comma || (size_t) (comma - needle) >= pid_max)
+        return NULL;
+    memcpy (pid, needle, comma - needle);
+    pid [comma - needle] = 0;
+    char *value_end;
+    *value = strtoul (comma + 1, &value_end, 10);
+    return *value_end == ';'? value_end + 1: NULL;
+}
+
+
+//  Returns the lowest of the highest HLC timestamps received per pid. The
+//  entries of a process arrive in order, so no process which sent entries
+//  before will send an entry with a lower timestamp. Live peers and self
+//  count even before their first entry arrived, it may still be on its way.
+
+static uint64_t
+s_zlog_hlc_stable (zlog_t *self)
+{
+    assert (self);
+    uint64_t *received = (uint64_t *) zhashx_lookup (self->hlc_frontier, zyre_uuid (self->node));
+    uint64_t stable = received? *received: 0;
+    zlist_t *peers = zyre_peers_by_group (self->node, "GLOBAL");
+    const char *peer = peers? (const char *) zlist_first (peers): NULL;
+    while (peer && stable > 0) {
+        received = (uint64_t *) zhashx_lookup (self->hlc_frontier, peer);
+        if (!received || *received < stable)
+            stable = received? *received: 0;
+        peer = (const char *) zlist_next (peers);
+    }
+    zlist_destroy (&peers);
+
+    received = (uint64_t *) zhashx_first (self->hlc_frontier);
+    while (received) {
+        if (*received < stable)
+            stable = *received;
+        received = (uint64_t *) zhashx_next (self->hlc_frontier);
+    }
+    return stable;
+}
+
+
+//  An entry is stable once all entries it causally depends on have arrived.
+//  Entries which arrive later never precede it in the ordered log. An entry
+//  with an HLC is stable when it's not above hlc_stable.
+
+static bool
+s_zlog_entry_stable (zlog_t *self, const char *logmsg, uint64_t hlc_stable)
+{
+    assert (self);
+    char own [64];
+    char pid [64];
+    uint64_t hlc;
+    if (s_zlog_hlc_parse (logmsg, &hlc, own, sizeof (own)) == 0)
+        return hlc <= hlc_stable;
+
+    unsigned long value;
+    const char *needle = s_zlog_clock_own (logmsg, own, sizeof (own));
+    while (needle && (needle = s_zlog_clock_next (needle, pid, sizeof (pid), &value))) {
+        if (streq (pid, own))
+            continue;
+        unsigned long *received = (unsigned long *) zhashx_lookup (self->frontier, pid);
+        if (!received || *received < value)
+            return false;
+    }
+    return true;
+}
+
+
+//  Insert a log entry into the ordered log and record how long it took the
+//  entry to get there.
+
+static void
+s_zlog_order_entry (zlog_t *self, char *logmsg);
+
+//  Orders the entries whose clocks were rebuilt from direct dependencies.
+//  Beyond the ordered log limit entries are rebuilt without the entries
+//  they still wait for.
+
+static void
+s_zlog_order_rebuilt (zlog_t *self)
+{
+    assert (self);
+    char *logmsg;
+    while ((logmsg = zdeps_next (self->deps)))
+        s_zlog_order_entry (self, logmsg);
+    while (self->ordered_log_max
+    &&     self->ordered_log_bytes + zdeps_pending (self->deps) > self->ordered_log_max
+    &&     (logmsg = zdeps_flush (self->deps))) {
+        zmetrics_count (self->metrics, self->metric [METRIC_ORDERED_LOG_DEPS_FORCED], 1);
+        s_zlog_order_entry (self, logmsg);
+    }
+}
+
+static void
+s_zlog_order_entry (zlog_t *self, char *logmsg)
+{
+    assert (self);
+    assert (logmsg);
+    //  Entries with direct dependencies wait for their clock
+    if (zdeps_add (self->deps, logmsg) == 0) {
+        zstr_free (&logmsg);
+        s_zlog_order_rebuilt (self);
+        return;
+    }
+    unsigned long long *ts = s_get_timestamp_from_logMsg (logmsg);
+    //  Timestamps are unix time with four subsecond digits
+    if (*ts > 0) {
+        int64_t latency = zclock_time () * 1000 - (int64_t) *ts * 100;
+        zchunk_extend (self->entry_latencies, &latency, sizeof (latency));
+    }
+    free (ts);
+
+    //  The entries of a process arrive in order, so all of them up to this
+    //  entry's own clock value have arrived
+    char own [64];
+    char pid [64];
+    uint64_t hlc;
+    if (s_zlog_hlc_parse (logmsg, &hlc, own, sizeof (own)) == 0) {
+        uint64_t *received = (uint64_t *) zhashx_lookup (self->hlc_frontier, own);
+        if (!received) {
+            received = (uint64_t *) zmalloc (sizeof (uint64_t));
+            zhashx_insert (self->hlc_frontier, own, received);
+        }
+        if (hlc > *received)
+            *received = hlc;
+    }
+    unsigned long value;
+    const char *needle = s_zlog_clock_own (logmsg, own, sizeof (own));
+    while (needle && (needle = s_zlog_clock_next (needle, pid, sizeof (pid), &value))) {
+        if (streq (pid, own)) {
+            unsigned long *received = (unsigned long *) zhashx_lookup (self->frontier, own);
+            if (!received) {
+                received = (unsigned long *) zmalloc (sizeof (unsigned long));
+                zhashx_insert (self->frontier, own, received);
+            }
+            if (value > *received)
+                *received = value;
+            break;
+        }
+    }
+    self->ordered_log_bytes += strlen (logmsg) + 1;
+    self->ordered_entries++;
+    zlistx_insert (self->ordered_log, logmsg, true);
+}
+
+
+//  Hand the ordered log over to the writer. Stable entries at the head are
+//  evicted and appended to the file for good. While more than
+//  ordered_log_max bytes are held, or if drain is set, the head is forced
+//  out even if it is not stable yet. The remaining entries are written as
+//  the file's tail.
+
+static void
+s_zlog_write_ordered_log (zlog_t *self, bool drain)
+{
+    assert (self);
+    zchunk_t *stable = NULL;
+    uint64_t hlc_stable = s_zlog_hlc_stable (self);
+    char *logmsg = (char *) zlistx_first (self->ordered_log);
+    while (logmsg) {
+        bool forced = drain
+                   || (self->ordered_log_max && self->ordered_log_bytes > self->ordered_log_max);
+        if (!forced && !s_zlog_entry_stable (self, logmsg, hlc_stable))
+            break;
+        size_t length = strlen (logmsg);
+        if (!stable)
+            stable = zchunk_new (NULL, 0);
+        zchunk_extend (stable, logmsg, length);
+        zchunk_extend (stable, "\n", 1);
+        self->ordered_log_bytes -= length + 1;
+        zmetrics_count (self->metrics, self->metric [forced? METRIC_ORDERED_LOG_FORCED: METRIC_ORDERED_LOG_EVICTED], 1);
+
+        logmsg = (char *) zlistx_detach (self->ordered_log, NULL);
+        zstr_free (&logmsg);
+        logmsg = (char *) zlistx_first (self->ordered_log);
+    }
+
+    //  Render a snapshot of the tail, the writer does the disk I/O so it
+    //  doesn't block our event loop
+    zchunk_t *tail = zchunk_new (NULL, self->ordered_log_bytes);
+    logmsg = (char *) zlistx_first (self->ordered_log);
+    while (logmsg) {
+        zchunk_append (tail, logmsg, strlen (logmsg));
+        zchunk_append (tail, "\n", 1);
+        //  Next log message
+        logmsg = (char *) zlistx_next (self->ordered_log);
+    }
+    if (stable)
+        self->ordered_stable += zchunk_size (stable);
+    assert (self->writer);
+    zsock_send (self->writer, "spp", "WRITE", stable, tail);
+}
+
+
+//  Start a term of leadership. Every term orders into a file of its own,
+//  <ordered log>.<uuid>.<term> unless path is given. The files of all
+//  terms together hold each collected line once.
+
+static void
+s_zlog_term_start (zlog_t *self, const char *path)
+{
+    assert (self);
+    assert (!self->writer);
+    self->ordered_term = path?
+        strdup (path):
+        zsys_sprintf ("%s.%s.%zu", self->ordered_log_path, zyre_uuid (self->node), ++self->terms);
+    self->ordered_stable = 0;
+    self->writer = zactor_new (zlog_writer_actor, self->ordered_term);
+}
+
+
+//  End a term of leadership. Everything ordered during the term is written
+//  out, including the entries still waiting for their dependencies. The
+//  lines collected afterwards belong to the next leader's term.
+
+static void
+s_zlog_term_end (zlog_t *self)
+{
+    assert (self);
+    if (!self->writer)
+        return;
+    char *logmsg;
+    while ((logmsg = zdeps_flush (self->deps))) {
+        zmetrics_count (self->metrics, self->metric [METRIC_ORDERED_LOG_DEPS_FORCED], 1);
+        s_zlog_order_entry (self, logmsg);
+    }
+    zmetrics_count (self->metrics, self->metric [METRIC_ORDERED_LOG_DRAINED], zlistx_size (self->ordered_log));
+    s_zlog_write_ordered_log (self, true);
+    //  The writer finishes its pending writes before it terminates
+    zactor_destroy (&self->writer);
+    zstr_free (&self->ordered_term);
+    self->ordered_stable = 0;
+}
+
+
+//  Record the latency of a concluded collect wave initiated by this node
+
+static void
+s_zlog_wave_concluded (zlog_t *self, const char *wave_id)
+{
+    assert (self);
+    char *start = wave_id? (char *) zhashx_lookup (self->wave_starts, wave_id): NULL;
+    if (start) {
+        int64_t latency = zclock_usecs () - atoll (start);
+        zchunk_extend (self->wave_latencies, &latency, sizeof (latency));
+        zhashx_delete (self->wave_starts, wave_id);
+        self->waves++;
+        zmetrics_observe (self->metrics, self->metric [METRIC_COLLECT_WAVE_US], latency);
+        zmetrics_observe (self->metrics, self->metric [METRIC_COLLECT_LINES], self->wave_lines);
+        self->wave_lines = 0;
+    }
+}
+
+
+//  Returns the metrics of this actor as JSON. Caller owns the string.
+
+static char *
+s_zlog_stats (zlog_t *self)
+{
+    assert (self);
+    zmetrics_set (self->metrics, self->metric [METRIC_ORDERED_LOG_ENTRIES], zlistx_size (self->ordered_log));
+    zmetrics_set (self->metrics, self->metric [METRIC_ORDERED_LOG_BYTES], self->ordered_log_bytes);
+    zmetrics_set (self->metrics, self->metric [METRIC_COLLECT_LOG_ENTRIES], zlog_spool_size (self->collect_log));
+    zmetrics_set (self->metrics, self->metric [METRIC_COLLECT_LOG_BYTES], zlog_spool_bytes (self->collect_log));
+    zmetrics_set (self->metrics, self->metric [METRIC_COLLECT_LOG_SPILLED_BYTES], zlog_spool_spilled (self->collect_log));
+    zmetrics_set (self->metrics, self->metric [METRIC_COLLECT_WAVES_PENDING], zecho_waves (self->collector));
+    zmetrics_set (self->metrics, self->metric [METRIC_COLLECT_UNACKED], self->linesRead - self->lines_acked);
+    zmetrics_set (self->metrics, self->metric [METRIC_COLLECT_RESUMED], zhashx_size (self->resumed));
+    zmetrics_set (self->metrics, self->metric [METRIC_CLOCK_ENTRIES], zvector_size (self->clock));
+    zmetrics_set (self->metrics, self->metric [METRIC_CLOCK_DEPARTED_PENDING], zhashx_size (self->departed));
+    zmetrics_set (self->metrics, self->metric [METRIC_CLOCK_DEPS_PENDING], zdeps_pending (self->deps));
+    return zmetrics_to_json (self->metrics);
+}
+
+
+//  Dump the metrics of this actor to the log
+
+static int
+s_zlog_stats_timer (zloop_t *loop, int timer_id, void *arg)
+{
+    assert (arg);
+    zlog_t *self = (zlog_t *) arg;
+    char *stats = s_zlog_stats (self);
+    zsys_info ("STATS %s %s", zyre_uuid (self->node), stats);
+    zstr_free (&stats);
+    return 0;
+}
+
+
+//  Replace the counters of a map by copies of those of another
+
+static void
+s_zlog_copy_map (zhashx_t *map, zhashx_t *other)
+{
+    zhashx_purge (map);
+    uint64_t *value = (uint64_t *) zhashx_first (other);
+    while (value) {
+        uint64_t *copy = (uint64_t *) zmalloc (sizeof (uint64_t));
+        *copy = *value;
+        zhashx_insert (map, (const char *) zhashx_cursor (other), copy);
+        value = (uint64_t *) zhashx_next (other);
+    }
+}
+
+
+//  Save the values of a map of counters into section name of the checkpoint
+
+static void
+s_zlog_checkpoint_map (zconfig_t *root, const char *name, zhashx_t *map, bool wide)
+{
+    zconfig_t *section = zconfig_new (name, root);
+    void *value = zhashx_first (map);
+    while (value) {
+        zconfig_t *item = zconfig_new ((const char *) zhashx_cursor (map), section);
+        zconfig_set_value (item, "%" PRIu64, wide? *(uint64_t *) value: (uint64_t) *(unsigned long *) value);
+        value = zhashx_next (map);
+    }
+}
+
+
+//  Save the entries of the ordered log which aren't stable yet, including
+//  those waiting for their dependencies. Returns 0 on success, otherwise -1.
+
+static int
+s_zlog_save_tail (zlog_t *self, const char *path)
+{
+    FILE *file = fopen (path, "w");
+    if (!file)
+        return -1;
+    int rc = 0;
+    const char *logmsg = (const char *) zlistx_first (self->ordered_log);
+    while (logmsg && rc == 0) {
+        if (fprintf (file, "%s\n", logmsg) < 0)
+            rc = -1;
+        logmsg = (const char *) zlistx_next (self->ordered_log);
+    }
+    zlistx_t *waiting = zdeps_pending_lines (self->deps);
+    logmsg = (const char *) zlistx_first (waiting);
+    while (logmsg && rc == 0) {
+        if (fprintf (file, "%s\n", logmsg) < 0)
+            rc = -1;
+        logmsg = (const char *) zlistx_next (waiting);
+    }
+    zlistx_destroy (&waiting);
+    if (fclose (file) != 0)
+        rc = -1;
+    return rc;
+}
+
+
+//  Write the state needed to resume after a restart: the clock, the lines
+//  of the logs acknowledged by the leader and the leader's frontiers. The
+//  file is replaced at once, a crash leaves the previous checkpoint. The
+//  ordered log resumes from the stable prefix on disk and the tail saved
+//  next to the checkpoint. A checkpointing leader acknowledges only the
+//  lines of its last checkpoint, lines ordered later are sent again after
+//  a restart and are neither lost nor ordered twice.
+
+static void
+s_zlog_checkpoint (zlog_t *self)
+{
+    assert (self);
+    if (!self->checkpoint)
+        return;
+    int64_t start = zclock_usecs ();
+    zconfig_t *root = zconfig_new ("root", NULL);
+    char *tail_path = NULL;
+    if (self->writer) {
+        //  The tail alternates between two files, the one of the previous
+        //  checkpoint stays until this one replaced it
+        tail_path = zsys_sprintf ("%s.tail.%d", self->checkpoint,
+            self->checkpoint_tail && self->checkpoint_tail [strlen (self->checkpoint_tail) - 1] == '0');
+        s_zlog_write_ordered_log (self, false);
+        zstr_send (self->writer, "SYNC");
+        if (zsock_wait (self->writer) != 0 || s_zlog_save_tail (self, tail_path) != 0) {
+            zsys_error ("cannot write checkpoint %s", self->checkpoint);
+            zsys_file_delete (tail_path);
+            zstr_free (&tail_path);
+            zconfig_destroy (&root);
+            return;
+        }
+        zconfig_put (root, "ordered_log/path", self->ordered_term);
+        zconfig_putf (root, "ordered_log/stable", "%" PRIu64, self->ordered_stable);
+        zconfig_put (root, "ordered_log/tail", tail_path);
+    }
+    char *clock = zvector_to_string (self->clock);
+    zconfig_put (root, "clock", clock);
+    zstr_free (&clock);
+    if (self->hlc) {
+        clock = zhlc_to_string (self->hlc);
+        zconfig_put (root, "hlc", clock);
+        zstr_free (&clock);
+    }
+
+    zconfig_t *logs = zconfig_new ("log", root);
+    zconfig_t *log = zconfig_new (zyre_uuid (self->node), logs);
+    zconfig_set_value (log, "%d", self->lines_acked);
+    resumed_t *resumed = (resumed_t *) zhashx_first (self->resumed);
+    while (resumed) {
+        log = zconfig_new ((const char *) zhashx_cursor (self->resumed), logs);
+        zconfig_set_value (log, "%d", resumed->lines_acked);
+        resumed = (resumed_t *) zhashx_next (self->resumed);
+    }
+    s_zlog_checkpoint_map (root, "ingested", self->ingested, true);
+    s_zlog_checkpoint_map (root, "frontier", self->frontier, false);
+    s_zlog_checkpoint_map (root, "hlc_frontier", self->hlc_frontier, true);
+
+    char *path = zsys_sprintf ("%s.tmp", self->checkpoint);
+    if (zconfig_save (root, path) == 0 && rename (path, self->checkpoint) == 0) {
+        zmetrics_count (self->metrics, self->metric [METRIC_CHECKPOINT_WRITTEN], 1);
+        if (self->checkpoint_tail && (!tail_path || !streq (tail_path, self->checkpoint_tail)))
+            zsys_file_delete (self->checkpoint_tail);
+        zstr_free (&self->checkpoint_tail);
+        self->checkpoint_tail = tail_path;
+        tail_path = NULL;
+        s_zlog_copy_map (self->durable, self->ingested);
+    }
+    else
+        zsys_error ("cannot write checkpoint %s", self->checkpoint);
+    if (tail_path)
+        zsys_file_delete (tail_path);
+    zstr_free (&tail_path);
+    zstr_free (&path);
+    zconfig_destroy (&root);
+    zmetrics_observe (self->metrics, self->metric [METRIC_HANDLER_CHECKPOINT_US], zclock_usecs () - start);
+}
+
+
+static int
+s_zlog_checkpoint_timer (zloop_t *loop, int timer_id, void *arg)
+{
+    assert (arg);
+    s_zlog_checkpoint ((zlog_t *) arg);
+    return 0;
+}
+
+
+//  Restore the values of section name of the checkpoint into a map of
+//  counters
+
+static void
+s_zlog_restore_map (zconfig_t *root, const char *name, zhashx_t *map, bool wide)
+{
+    zconfig_t *section = zconfig_locate (root, name);
+    zconfig_t *item = section? zconfig_child (section): NULL;
+    while (item) {
+        const char *text = zconfig_value (item);
+        uint64_t value = text? strtoull (text, NULL, 10): 0;
+        void *counter = zmalloc (wide? sizeof (uint64_t): sizeof (unsigned long));
+        if (wide)
+            *(uint64_t *) counter = value;
+        else
+            *(unsigned long *) counter = (unsigned long) value;
+        zhashx_update (map, zconfig_name (item), counter);
+        item = zconfig_next (item);
+    }
+}
+
+
+//  Merge a clock of a previous incarnation, like a message from it. A
+//  vector clock is merged as a whole. Of a direct dependency record only
+//  the own pid and value count, they become a dependency of the next entry.
+//  An HLC timestamp moves the HLC past it.
+
+static void
+s_zlog_merge_clock (zlog_t *self, const char *clock)
+{
+    assert (self);
+    if (!clock)
+        return;
+    zmsg_t *msg = zmsg_new ();
+    uint64_t timestamp;
+    if (strncmp (clock, "VC:", 3) == 0) {
+        zmsg_addstr (msg, clock);
+        zvector_recv (self->clock, msg);
+    }
+    else
+    if (strncmp (clock, "DD:own:", 7) == 0) {
+        const char *own = clock + 7;
+        const char *own_end = strchr (own, ';');
+        if (own_end) {
+            zmsg_addstrf (msg, "DD:%.*s;", (int) (own_end - own), own);
+            zvector_recv (self->clock, msg);
+        }
+    }
+    else
+    if (self->hlc && zhlc_parse (clock, &timestamp, NULL, 0) == 0) {
+        byte frame [8];
+        int index;
+        for (index = 0; index < 8; index++)
+            frame [index] = (byte) (timestamp >> (56 - 8 * index));
+        zmsg_addmem (msg, frame, sizeof (frame));
+        zhlc_recv (self->hlc, msg);
+    }
+    zmsg_destroy (&msg);
+}
+
+
+//  Returns the clock of the last line of the log of origin, NULL if there
+//  is none. Vector clocks, direct dependency records and HLC timestamps
+//  are found. Only the tail of the log is read.
+
+static char *
+s_zlog_last_clock (zlog_t *self, const char *origin)
+{
+    char *path = zsys_sprintf ("%s/vc_%s.log", self->log_dir, origin);
+    FILE *file = fopen (path, "r");
+    zstr_free (&path);
+    if (!file)
+        return NULL;
+    char *tail = (char *) malloc (ZLOG_CHECKPOINT_TAIL + 1);
+    assert (tail);
+    size_t size = 0;
+    if (fseeko (file, 0, SEEK_END) == 0) {
+        off_t end = ftello (file);
+        fseeko (file, end > ZLOG_CHECKPOINT_TAIL? end - ZLOG_CHECKPOINT_TAIL: 0, SEEK_SET);
+        size = fread (tail, 1, ZLOG_CHECKPOINT_TAIL, file);
+    }
+    fclose (file);
+    tail [size] = 0;
+
+    const char *kinds [] = { "/VC:", "/DD:own:", "/HLC:" };
+    char *clock = NULL;
+    size_t index;
+    for (index = 0; index < sizeof (kinds) / sizeof (kinds [0]); index++) {
+        char *needle = tail;
+        while ((needle = strstr (needle, kinds [index]))) {
+            if (needle + 1 > clock)
+                clock = needle + 1;
+            needle++;
+        }
+    }
+    char *end = clock? strchr (clock, '/'): NULL;
+    clock = end? strndup (clock, end - clock): NULL;
+    free (tail);
+    return clock;
+}
+
+
+//  Put the saved tail of the ordered log back, entries waiting for their
+//  dependencies wait again
+
+static void
+s_zlog_restore_tail (zlog_t *self, const char *path)
+{
+    zfile_t *file = zfile_new (NULL, path);
+    if (zfile_input (file) != 0) {
+        zsys_error ("cannot read ordered log tail %s", path);
+        zfile_destroy (&file);
+        return;
+    }
+    const char *logmsg;
+    while ((logmsg = zfile_readln (file))) {
+        if (zdeps_add (self->deps, logmsg) == 0)
+            continue;
+        self->ordered_log_bytes += strlen (logmsg) + 1;
+        zlistx_insert (self->ordered_log, strdup (logmsg), true);
+    }
+    zfile_destroy (&file);
+    s_zlog_order_rebuilt (self);
+}
+
+
+//  Resume from the checkpoint, if there is one. The new incarnation's clock
+//  follows every event of the previous ones, their logs are shipped from
+//  the first line the leader didn't acknowledge.
+
+static void
+s_zlog_restore (zlog_t *self)
+{
+    assert (self);
+    int64_t start = zclock_usecs ();
+    zconfig_t *root = zconfig_load (self->checkpoint);
+    if (!root)
+        return;
+    s_zlog_merge_clock (self, zconfig_get (root, "clock", NULL));
+    s_zlog_merge_clock (self, zconfig_get (root, "hlc", NULL));
+    zconfig_t *logs = zconfig_locate (root, "log");
+    zconfig_t *log = logs? zconfig_child (logs): NULL;
+    while (log) {
+        //  Events after the checkpoint are in the log
+        char *clock = s_zlog_last_clock (self, zconfig_name (log));
+        s_zlog_merge_clock (self, clock);
+        zstr_free (&clock);
+
+        resumed_t *resumed = (resumed_t *) zmalloc (sizeof (resumed_t));
+        assert (resumed);
+        const char *lines = zconfig_value (log);
+        resumed->lines_acked = lines? atoi (lines): 0;
+        resumed->lines_read = resumed->lines_acked;
+        resumed->acked_at = zclock_mono ();
+        zhashx_update (self->resumed, zconfig_name (log), resumed);
+        log = zconfig_next (log);
+    }
+    s_zlog_restore_map (root, "ingested", self->ingested, true);
+    s_zlog_restore_map (root, "frontier", self->frontier, false);
+    s_zlog_restore_map (root, "hlc_frontier", self->hlc_frontier, true);
+    s_zlog_copy_map (self->durable, self->ingested);
+
+    //  A restart ends the term of a leader. Its ordered log continues after
+    //  the stable prefix with the tail and is complete then.
+    const char *term = zconfig_get (root, "ordered_log/path", NULL);
+    const char *tail = zconfig_get (root, "ordered_log/tail", NULL);
+    if (term && tail) {
+        const char *stable = zconfig_get (root, "ordered_log/stable", "0");
+        s_zlog_term_start (self, term);
+        self->ordered_stable = strtoull (stable, NULL, 10);
+        zstr_sendx (self->writer, "RESUME", stable, NULL);
+        s_zlog_restore_tail (self, tail);
+        zstr_free (&self->checkpoint_tail);
+        self->checkpoint_tail = strdup (tail);
+        s_zlog_term_end (self);
+    }
+    zconfig_destroy (&root);
+    zmetrics_observe (self->metrics, self->metric [METRIC_HANDLER_RESTORE_US], zclock_usecs () - start);
+}
+
+
+//  Send the status of this actor to the node, latency samples are reset
+
+static void
+s_zlog_send_status (zlog_t *self)
+{
+    assert (self);
+    const char *leader = zelection_leader (self->election);
+    zmsg_t *status = zmsg_new ();
+    zmsg_addstr (status, "STATUS");
+    zmsg_addstr (status, leader? leader: "");
+    zmsg_addstrf (status, "%zu", self->waves);
+    zmsg_addstrf (status, "%zu", self->ordered_entries);
+    zmsg_addmem (status, zchunk_data (self->wave_latencies), zchunk_size (self->wave_latencies));
+    zmsg_addmem (status, zchunk_data (self->entry_latencies), zchunk_size (self->entry_latencies));
+    zmsg_send (&status, self->pipe);
+    zchunk_set (self->wave_latencies, NULL, 0);
+    zchunk_set (self->entry_latencies, NULL, 0);
+}
+
+
+//  Send content to a random peer. If owner is missing or empty the own uuid
+//  is used as owner.
+
+static void
+s_zlog_send_random (zlog_t *self, zlist_t *peers, zframe_t *content, zframe_t *owner)
+{
+    assert (self);
+    assert (content);
+    if (!peers || zlist_size (peers) == 0) {
+        s_zlog_info (self, "%s", "No friends!");
+        return;
+    }
+
+    const char *owner_data = zyre_uuid (self->node);
+    int owner_size = (int) strlen (owner_data);
+    if (owner && zframe_size (owner) > 0) {
+        owner_data = (const char *) zframe_data (owner);
+        owner_size = (int) zframe_size (owner);
+    }
+
+    zmsg_t *msg = zmsg_new ();
+    zmsg_addstr (msg, "BAKERY");
+    zmsg_addmem (msg, zframe_data (content), zframe_size (content));
+    zmsg_addmem (msg, owner_data, owner_size);
+
+    s_zlog_info (self, "S: %.*s - %.*s",
+                 (int) zframe_size (content), (const char *) zframe_data (content),
+                 owner_size < 5? owner_size: 5, owner_data);
+    if (self->hlc)
+        zhlc_send_prepare (self->hlc, msg);
+    else
+        zvector_send_prepare (self->clock, msg);
+    zmetrics_count (self->metrics, self->metric [METRIC_SENT_BAKERY], 1);
+    zmetrics_count (self->metrics, self->metric [METRIC_BYTES_SENT_BAKERY], zmsg_content_size (msg));
+    zmetrics_count (self->metrics, self->metric [METRIC_CLOCK_BYTES_SENT], zframe_size (zmsg_first (msg)));
+
+    int rand = randof (zlist_size (peers));
+    const char *peer = (const char *) zlist_first (peers);
+    while (rand-- > 0)
+        peer = (const char *) zlist_next (peers);
+    zyre_whisper (self->node, peer, &msg);
+}
+
+
+//  Here we handle binary commands from the node. The opcode frame has already
+//  been removed from request.
+
+static void
+s_zlog_recv_binary (zlog_t *self, byte opcode, zmsg_t *request)
+{
+    assert (self);
+    if (opcode == ZLOG_CMD_SEND_RANDOM) {
+        zlist_t *peers = zyre_peers (self->node);
+        zframe_t *content = zmsg_first (request);
+        while (content) {
+            zframe_t *owner = zmsg_next (request);
+            s_zlog_send_random (self, peers, content, owner);
+            content = zmsg_next (request);
+        }
+        zlist_destroy (&peers);
+    }
+    else
+    if (opcode == ZLOG_CMD_INFO) {
+        zframe_t *logmsg = zmsg_first (request);
+        while (logmsg) {
+            if (self->hlc)
+                zhlc_info (self->hlc, "%.*s",
+                           (int) zframe_size (logmsg), (const char *) zframe_data (logmsg));
+            else
+                zvector_info (self->clock, "%.*s",
+                              (int) zframe_size (logmsg), (const char *) zframe_data (logmsg));
+            logmsg = zmsg_next (request);
+        }
+    }
+    else
+    if (opcode == ZLOG_CMD_BATCH)
+        self->batch = true;
+    else {
+        zsys_error ("invalid binary command '%d'", opcode);
+        assert (false);
+    }
+}
+
 
 //  Here we handle incoming message from the node
 
@@ -224,126 +1424,410 @@ s_zlog_recv_api (zloop_t *loop, zsock_t *reader, void *arg)
 {
     assert (arg);
     zlog_t *self = (zlog_t *) arg;
+    int64_t start = zclock_usecs ();
 
     //  Get the whole message of the pipe in one go
     zmsg_t *request = zmsg_recv (self->pipe);
     if (!request)
        return 0;        //  Interrupted, gracefully deny error. Keep going!
 
-    char *command = zmsg_popstr (request);
-    if (streq (command, "START"))
+    zframe_t *command = zmsg_pop (request);
+    if (zframe_size (command) == 1 && zframe_data (command) [0] < ZLOG_CMD_MAX)
+        s_zlog_recv_binary (self, zframe_data (command) [0], request);
+    else
+    if (zframe_streq (command, "START"))
         zlog_start (self);
     else
-    if (streq (command, "STOP"))
+    if (zframe_streq (command, "READY")) {
+        char *timeout = zmsg_popstr (request);
+        self->ready_pending = true;
+        if (zelection_finished (self->election))
+            s_zlog_ready_reply (self, 0);
+        else
+        if (self->elected && self->election_timer == -1 && s_zlog_peers (self) == 0)
+            s_zlog_ready_reply (self, 1);
+        else {
+            //  An election may starve, don't let the caller wait forever
+            if (self->ready_timer != -1)
+                zloop_timer_end (self->loop, self->ready_timer);
+            int ms = timeout && atoi (timeout) > 0? atoi (timeout): ZLOG_READY_TIMEOUT;
+            self->ready_timer = zloop_timer (self->loop, ms, 1, s_zlog_ready_timer, self);
+        }
+        zstr_free (&timeout);
+    }
+    else
+    if (zframe_streq (command, "STARTUP QUIET")) {
+        char *quiet = zmsg_popstr (request);
+        if (quiet && atoi (quiet) > 0)
+            self->startup_quiet = atoi (quiet);
+        zstr_free (&quiet);
+    }
+    else
+    if (zframe_streq (command, "EXPECTED PEERS")) {
+        char *peers = zmsg_popstr (request);
+        if (peers)
+            self->expected_peers = (size_t) strtoull (peers, NULL, 10);
+        zstr_free (&peers);
+    }
+    else
+    if (zframe_streq (command, "STOP"))
         zlog_stop (self);
     else
-    if (streq (command, "SEND RANDOM")) {
-        char *content = zmsg_popstr (request);
-        char *owner = zmsg_popstr (request);
+    if (zframe_streq (command, "SEND RANDOM")) {
+        zframe_t *content = zmsg_pop (request);
+        zframe_t *owner = zmsg_pop (request);
 
         zlist_t *peers = zyre_peers (self->node);
-        if (!peers || zlist_size (peers) == 0)
-            zvector_info (self->clock, "%s", "No friends!");
-        else {
-            zmsg_t *msg = zmsg_new ();
-            zmsg_addstr (msg, "BAKERY");
-            zmsg_addstr (msg, content);
-            if (!owner)
-                owner = strdup (zyre_uuid (self->node));
-
-            zmsg_addstr (msg, owner);
-
-            zvector_info (self->clock, "S: %s - %.5s", content, owner);
-            zvector_send_prepare (self->clock, msg);
-
-            int rand = randof (zlist_size (peers));
-            int index = 0;
-            const char *peer = (const char *) zlist_first (peers);
-            for (index = 0; index <= rand; index++) {
-                if (rand == index)
-                    zyre_whisper (self->node, peer, &msg);
-
-                peer =  (const char *) zlist_next (peers);
-            }
-        }
+        s_zlog_send_random (self, peers, content, owner);
 
         zlist_destroy (&peers);
-        zstr_free (&content);
-        zstr_free (&owner);
+        zframe_destroy (&content);
+        zframe_destroy (&owner);
     }
     else
-    if (streq (command, "DUMP TS"))
+    if (zframe_streq (command, "DUMP TS"))
         self->dump_ts = true;
     else
-    if (streq (command, "VERBOSE")) {
+    if (zframe_streq (command, "STATUS"))
+        s_zlog_send_status (self);
+    else
+    if (zframe_streq (command, "CLOCK")) {
+        char *clock = zvector_to_string (self->clock);
+        zstr_sendx (self->pipe, "CLOCK", clock, NULL);
+        zstr_free (&clock);
+    }
+    else
+    if (zframe_streq (command, "STATS")) {
+        char *stats = s_zlog_stats (self);
+        zstr_sendx (self->pipe, "STATS", stats, NULL);
+        zstr_free (&stats);
+    }
+    else
+    if (zframe_streq (command, "STATS INTERVAL")) {
+        char *interval = zmsg_popstr (request);
+        if (self->stats_timer != -1)
+            zloop_timer_end (self->loop, self->stats_timer);
+        self->stats_timer = -1;
+        if (interval && atoi (interval) > 0)
+            self->stats_timer = zloop_timer (self->loop, atoi (interval), 0, s_zlog_stats_timer, self);
+        zstr_free (&interval);
+    }
+    else
+    if (zframe_streq (command, "TRACE")) {
+        //  Each thread traces into its own ring, only ours can be flushed
+        char *path = zmsg_popstr (request);
+        zsock_signal (self->pipe, path? (byte) zlog_trace_flush (path): 1);
+        zstr_free (&path);
+    }
+    else
+    if (zframe_streq (command, "CLOCK MODE")) {
+        char *mode = zmsg_popstr (request);
+        char *sample_every = zmsg_popstr (request);
+        if (mode)
+            s_zlog_set_clock_mode (self, mode, sample_every? (size_t) atoi (sample_every): 0);
+        zstr_free (&mode);
+        zstr_free (&sample_every);
+    }
+    else
+    if (zframe_streq (command, "COLLECT INTERVAL")) {
+        char *interval = zmsg_popstr (request);
+        if (interval && atoi (interval) > 0)
+            self->collect_interval = atoi (interval);
+        zstr_free (&interval);
+    }
+    else
+    if (zframe_streq (command, "ORDERED LOG MAX")) {
+        char *max_bytes = zmsg_popstr (request);
+        if (max_bytes)
+            self->ordered_log_max = (size_t) strtoull (max_bytes, NULL, 10);
+        zstr_free (&max_bytes);
+    }
+    else
+    if (zframe_streq (command, "COLLECT LOG MAX")) {
+        char *max_bytes = zmsg_popstr (request);
+        if (max_bytes) {
+            self->collect_log_max = (size_t) strtoull (max_bytes, NULL, 10);
+            zlog_spool_set_max_bytes (self->collect_log, self->collect_log_max);
+        }
+        zstr_free (&max_bytes);
+    }
+    else
+    if (zframe_streq (command, "ORDERED LOG")) {
+        char *path = zmsg_popstr (request);
+        if (path) {
+            zstr_free (&self->ordered_log_path);
+            self->ordered_log_path = path;
+        }
+    }
+    else
+    if (zframe_streq (command, "LOG DIR")) {
+        char *dir = zmsg_popstr (request);
+        if (dir) {
+            zstr_free (&self->log_dir);
+            self->log_dir = dir;
+        }
+    }
+    else
+    if (zframe_streq (command, "CHECKPOINT")) {
+        char *path = zmsg_popstr (request);
+        char *interval = zmsg_popstr (request);
+        if (path && !self->checkpoint) {
+            self->checkpoint = strdup (path);
+            s_zlog_restore (self);
+            if (interval && atoi (interval) > 0)
+                self->checkpoint_timer = zloop_timer (self->loop, atoi (interval), 0, s_zlog_checkpoint_timer, self);
+        }
+        zstr_free (&path);
+        zstr_free (&interval);
+    }
+    else
+    if (zframe_streq (command, "VERBOSE")) {
         self->verbose = true;
         zelection_set_verbose (self->election, true);
     }
     else
-    if (streq (command, "$TERM"))
+    if (zframe_streq (command, "$TERM"))
         //  The $TERM command is send by zactor_destroy() method
         self->terminated = true;
     else {
-        zsys_error ("invalid command '%s'", command);
+        char *command_str = zframe_strdup (command);
+        zsys_error ("invalid command '%s'", command_str);
+        zstr_free (&command_str);
         assert (false);
     }
-    zstr_free (&command);
+    zframe_destroy (&command);
     zmsg_destroy (&request);
+    zarena_reset (self->arena);
+    zmetrics_observe (self->metrics, self->metric [METRIC_HANDLER_API_US], zclock_usecs () - start);
 
     //  Negative return value will abort loop!
     return self->terminated? -1: 0;
 }
 
 
+//  Order a collected log line unless the leader already has it. Lines are
+//  numbered per origin from 1 and taken in sequence only: retransmitted
+//  lines are dropped and so are lines after a gap, the origin sends them
+//  again. The origin won't send again the lines a leader acknowledged, so
+//  a leader which knows less about an origin, e.g. since the leadership
+//  moved, continues after them. It never skips lines nobody ingested.
+
 static void
-s_zlog_process_collect_log (zecho_t *echo, zmsg_t *msg, zlog_t *self)
+s_zlog_ingest (zlog_t *self, const char *origin, uint64_t acked, uint64_t line, const char *logmsg)
 {
     assert (self);
+    if (line == 0)
+        return;
+    uint64_t *ingested = (uint64_t *) zhashx_lookup (self->ingested, origin);
+    if (!ingested) {
+        ingested = (uint64_t *) zmalloc (sizeof (uint64_t));
+        zhashx_insert (self->ingested, origin, ingested);
+    }
+    if (acked > *ingested)
+        *ingested = acked;
+    if (line <= *ingested)
+        zmetrics_count (self->metrics, self->metric [METRIC_COLLECT_DUPLICATES], 1);
+    else
+    if (line > *ingested + 1)
+        zmetrics_count (self->metrics, self->metric [METRIC_COLLECT_OUT_OF_ORDER], 1);
+    else {
+        *ingested = line;
+        s_zlog_order_entry (self, strdup (logmsg));
+        self->wave_lines++;
+    }
+}
 
-    if (zelection_won (self->election)) {
-        /*printf ("LEADER\n");*/
-        //  Read log message and order log
-        if (self->verbose)
-            zvector_info (self->clock, "Order received logs %s\n", zyre_uuid (self->node));
 
-        char *logmsg = zmsg_popstr (msg);
-        while (logmsg) {
-            zlistx_insert (self->ordered_log, logmsg, true);
-            logmsg = zmsg_popstr (msg);
+//  Returns the spooled lines of origin, created if it's not known yet
+
+static relayed_t *
+s_zlog_relayed_require (zlog_t *self, const char *origin)
+{
+    relayed_t *relayed = (relayed_t *) zhashx_lookup (self->relayed, origin);
+    if (!relayed) {
+        relayed = (relayed_t *) zmalloc (sizeof (relayed_t));
+        assert (relayed);
+        relayed->acked_at = zclock_mono ();
+        zhashx_insert (self->relayed, origin, relayed);
+    }
+    return relayed;
+}
+
+
+//  Returns true if outstanding lines went unacknowledged for too long and
+//  have to be sent again. Restarts the timeout if so or if nothing is
+//  outstanding.
+
+static bool
+s_zlog_retransmit_due (int64_t *acked_at, bool outstanding)
+{
+    int64_t now = zclock_mono ();
+    if (outstanding && now - *acked_at < ZLOG_RETRANSMIT_TIMEOUT)
+        return false;
+    *acked_at = now;
+    return outstanding;
+}
+
+
+//  Collect messages carry runs of consecutive lines per origin and one
+//  batch with the lines of all runs:
+//  [origin][acked lines][first line][lines]...[batch]
+//  Lines are decoded into the batch's reused buffer. The leader copies
+//  only the lines it orders, duplicates are dropped without a copy.
+
+static void
+s_zlog_process_collect_log (zecho_t *echo, zmsg_t *msg, zlog_t *self)
+{
+    assert (self);
+    ZLOG_TRACE_BEGIN ("s_zlog_process_collect_log");
+    bool leader = zelection_won (self->election);
+    if (leader && self->verbose)
+        s_zlog_info (self, "Order received logs %s\n", zyre_uuid (self->node));
+
+    zframe_t *frame = zmsg_last (msg);
+    zbatch_t *batch = frame? zbatch_decode (frame): NULL;
+    while (batch && zmsg_size (msg) > 4) {
+        char *origin = zmsg_popstr (msg);
+        char *acked_str = zmsg_popstr (msg);
+        char *first = zmsg_popstr (msg);
+        char *size = zmsg_popstr (msg);
+        uint64_t acked = strtoull (acked_str, NULL, 10);
+        uint64_t line = strtoull (first, NULL, 10);
+        uint64_t lines = strtoull (size, NULL, 10);
+        //  Relays drop lines they already spooled unless they were lost
+        //  and are sent again
+        relayed_t *relayed = leader? NULL: s_zlog_relayed_require (self, origin);
+        const char *logmsg;
+        for (; lines && (logmsg = zbatch_next (batch)); lines--, line++) {
+            if (leader)
+                s_zlog_ingest (self, origin, acked, line, logmsg);
+            else
+            if (line <= relayed->spooled)
+                zmetrics_count (self->metrics, self->metric [METRIC_COLLECT_DUPLICATES], 1);
+            else {
+                //  Save collect log messages from peers, they spill to
+                //  disk if the father doesn't keep up
+                relayed->spooled = line;
+                char *record = zsys_sprintf ("%s %" PRIu64 " %" PRIu64 " %s", origin, acked, line, logmsg);
+                zlog_spool_append (self->collect_log, &record);
+            }
         }
+        zstr_free (&origin);
+        zstr_free (&acked_str);
+        zstr_free (&first);
+        zstr_free (&size);
+    }
+    if (leader)
+        s_zlog_write_ordered_log (self, false);
+    zbatch_destroy (&batch);
+    zmsg_destroy (&msg);
+    ZLOG_TRACE_END ("s_zlog_process_collect_log");
+}
 
-        FILE *logfile = fopen("./ordered_log", "w+");
-        logmsg = (char *) zlistx_first (self->ordered_log);
-        while (logmsg) {
-            fprintf (logfile, "%s\n", logmsg);
-            //  Next log message
-            logmsg = (char *) zlistx_next (self->ordered_log);
+
+//  Create the acknowledgements of an inform message, the lines ingested per
+//  origin: [origin][lines]... The leader creates them, other nodes forward
+//  the ones they received.
+
+static zmsg_t *
+s_zlog_send_acks (zecho_t *echo, zlog_t *self)
+{
+    assert (self);
+    if (!zelection_won (self->election))
+        return self->acks? zmsg_dup (self->acks): zmsg_new ();
+
+    //  With checkpoints only the lines of the last one are acknowledged
+    zhashx_t *acked = self->checkpoint? self->durable: self->ingested;
+    zmsg_t *acks = zmsg_new ();
+    uint64_t *ingested = (uint64_t *) zhashx_first (acked);
+    while (ingested) {
+        zmsg_addstr (acks, (const char *) zhashx_cursor (acked));
+        zmsg_addstrf (acks, "%" PRIu64, *ingested);
+        ingested = (uint64_t *) zhashx_next (acked);
+    }
+    return acks;
+}
+
+
+//  Process the acknowledgements of an inform message. Own lines which
+//  aren't acknowledged in time are sent again with the next collect
+//  message. Lines may just wait in a relay's spool, so they only count as
+//  lost once no acknowledgement advanced for ZLOG_RETRANSMIT_TIMEOUT.
+//  Relays then accept them again.
+
+static void
+s_zlog_process_acks (zecho_t *echo, zmsg_t *msg, zlog_t *self)
+{
+    assert (self);
+    if (zelection_won (self->election)) {
+        zmsg_destroy (&msg);
+        return;
+    }
+    zframe_t *origin = zmsg_first (msg);
+    while (origin) {
+        zframe_t *lines = zmsg_next (msg);
+        if (!lines)
+            break;
+        char *pid = zframe_strdup (origin);
+        char *value = zframe_strdup (lines);
+        long long acked = atoll (value);
+        resumed_t *resumed = (resumed_t *) zhashx_lookup (self->resumed, pid);
+        relayed_t *relayed = (relayed_t *) zhashx_lookup (self->relayed, pid);
+        if (streq (pid, zyre_uuid (self->node))) {
+            if (acked > self->lines_acked && acked <= self->linesRead) {
+                self->lines_acked = (int) acked;
+                self->acked_at = zclock_mono ();
+            }
+        }
+        else
+        if (resumed) {
+            if (acked > resumed->lines_acked && acked <= resumed->lines_read) {
+                resumed->lines_acked = (int) acked;
+                resumed->acked_at = zclock_mono ();
+            }
         }
-        fclose (logfile);
+        if (relayed) {
+            if (acked > 0 && (uint64_t) acked > relayed->acked) {
+                relayed->acked = (uint64_t) acked;
+                relayed->acked_at = zclock_mono ();
+            }
+            if (s_zlog_retransmit_due (&relayed->acked_at, relayed->spooled > relayed->acked))
+                relayed->spooled = relayed->acked;
+        }
+        zstr_free (&pid);
+        zstr_free (&value);
+        origin = zmsg_next (msg);
     }
-    else {
-        /*printf ("SLAVE\n");*/
-        //  Save collect log messages from peers
-        char *logmsg = zmsg_popstr (msg);
-        while (logmsg) {
-            zlistx_insert (self->collect_log, logmsg, false);
-            logmsg = zmsg_popstr (msg);
+    if (s_zlog_retransmit_due (&self->acked_at, self->linesRead > self->lines_acked)) {
+        zmetrics_count (self->metrics, self->metric [METRIC_COLLECT_RETRANSMITTED], self->linesRead - self->lines_acked);
+        self->linesRead = self->lines_acked;
+    }
+    resumed_t *resumed = (resumed_t *) zhashx_first (self->resumed);
+    while (resumed) {
+        if (s_zlog_retransmit_due (&resumed->acked_at, resumed->lines_read > resumed->lines_acked)) {
+            zmetrics_count (self->metrics, self->metric [METRIC_COLLECT_RETRANSMITTED], resumed->lines_read - resumed->lines_acked);
+            resumed->lines_read = resumed->lines_acked;
         }
+        resumed = (resumed_t *) zhashx_next (self->resumed);
     }
-    zmsg_destroy (&msg);
+    zmsg_destroy (&self->acks);
+    self->acks = msg;
 }
 
 
+//  Read the lines of the log of origin after lines_read, which is advanced
+//  by the lines read
+
 static zlistx_t *
-s_zlog_read_log (zlog_t *self)
+s_zlog_read_log (zlog_t *self, const char *origin, int *lines_read)
 {
     assert (self);
     zlistx_t *messages = zlistx_new ();
     zlistx_set_duplicator (messages, (zlistx_duplicator_fn *) strdup);
 
     //  Read own log file
-    char *filename = zsys_sprintf ("vc_%s.log", zyre_uuid (self->node));
-    zfile_t *logfile = zfile_new ("/tmp", filename);
+    char *filename = zsys_sprintf ("vc_%s.log", origin);
+    zfile_t *logfile = zfile_new (self->log_dir, filename);
     //  Read all log entries
     if (!zfile_is_readable (logfile))
         goto cleanup;           //  No log entries yet
@@ -353,9 +1837,9 @@ s_zlog_read_log (zlog_t *self)
     int cnt = 1;
     const char *logmsg = zfile_readln (logfile);
     while (logmsg) {
-        if (cnt > self->linesRead) {
+        if (cnt > *lines_read) {
             zlistx_insert (messages, (char *) logmsg, false);
-            self->linesRead++;
+            (*lines_read)++;
         }
         logmsg = zfile_readln (logfile);
         cnt++;
@@ -365,89 +1849,406 @@ cleanup:
     zstr_free (&filename);
     zfile_destroy (&logfile);
     if (self->verbose)
-        zvector_info (self->clock, "Collect logs %s", zyre_uuid (self->node));
+        s_zlog_info (self, "Collect logs %s", zyre_uuid (self->node));
 
     return messages;
 }
 
 
+//  Append the run to the collect message
+
+static void
+s_run_flush (run_t *run, zmsg_t *msg)
+{
+    if (run->origin) {
+        zmsg_addstr (msg, run->origin);
+        zmsg_addstrf (msg, "%" PRIu64, run->acked);
+        zmsg_addstrf (msg, "%" PRIu64, run->first);
+        zmsg_addstrf (msg, "%" PRIu64, run->size);
+        zstr_free (&run->origin);
+    }
+}
+
+//  Extend the run by a line, or start a new one if it doesn't follow. The
+//  acknowledged lines of an origin only grow, a run carries the latest.
+
+static void
+s_run_add (run_t *run, zmsg_t *msg, const char *origin, uint64_t acked, uint64_t line)
+{
+    if (run->origin && streq (run->origin, origin) && line == run->first + run->size) {
+        if (acked > run->acked)
+            run->acked = acked;
+        run->size++;
+        return;
+    }
+    s_run_flush (run, msg);
+    run->origin = strdup (origin);
+    run->acked = acked;
+    run->first = line;
+    run->size = 1;
+}
+
+//  Append the lines of the log of origin after lines_read to the collect
+//  message. Returns the number of lines.
+
+static size_t
+s_zlog_append_log (zlog_t *self, zmsg_t *msg, run_t *run, const char *origin, int *lines_read, int lines_acked)
+{
+    uint64_t line = *lines_read + 1;
+    zlistx_t *messages = s_zlog_read_log (self, origin, lines_read);
+    size_t size = zlistx_size (messages);
+    const char *logmsg = (const char *) zlistx_first (messages);
+    while (logmsg) {
+        s_run_add (run, msg, origin, lines_acked, line++);
+        zbatch_add (self->collect_batch, logmsg);
+        logmsg = (const char *) zlistx_next (messages);
+    }
+    zlistx_set_destructor (messages, (zlistx_destructor_fn *) zstr_free);
+    zlistx_destroy (&messages);
+    return size;
+}
+
 static zmsg_t *
 s_zlog_send_collect_log (zecho_t *echo, zlog_t *self)
 {
     assert (self);
+    ZLOG_TRACE_BEGIN ("s_zlog_send_collect_log");
     zmsg_t *collect_msg = zmsg_new ();
+    run_t run = { NULL, 0, 0, 0 };
+
+    //  Append collect log messages from peers, at most collect_log_max bytes
+    //  per wave. The rest is sent with the next waves. They are spooled as
+    //  '<origin> <acked lines> <line> <log message>'.
+    char *record = NULL;
+    while ((!self->collect_log_max || zbatch_bytes (self->collect_batch) < self->collect_log_max)
+    &&     (record = zlog_spool_pop (self->collect_log))) {
+        char *space = strchr (record, ' ');
+        char *acked_end = NULL;
+        char *end = NULL;
+        uint64_t acked = space? strtoull (space + 1, &acked_end, 10): 0;
+        uint64_t line = acked_end && *acked_end == ' '? strtoull (acked_end + 1, &end, 10): 0;
+        if (end && *end == ' ') {
+            *space = 0;
+            s_run_add (&run, collect_msg, record, acked, line);
+            zbatch_add (self->collect_batch, end + 1);
+        }
+        zstr_free (&record);
+    }
 
-    //  Append collect log messages from peers
-    const char *logmsg = (const char *) zlistx_first (self->collect_log);
-    while (logmsg) {
-        zmsg_addstr (collect_msg, logmsg);
-        logmsg = (const char *) zlistx_next (self->collect_log);
+    //  Own lines from the first one not acknowledged by the leader, then
+    //  those of previous incarnations. They are done once all their lines
+    //  were acknowledged.
+    s_zlog_append_log (self, collect_msg, &run, zyre_uuid (self->node), &self->linesRead, self->lines_acked);
+    zlistx_t *origins = zhashx_keys (self->resumed);
+    const char *origin = (const char *) zlistx_first (origins);
+    while (origin) {
+        resumed_t *resumed = (resumed_t *) zhashx_lookup (self->resumed, origin);
+        if (s_zlog_append_log (self, collect_msg, &run, origin, &resumed->lines_read, resumed->lines_acked) == 0
+        &&  resumed->lines_acked == resumed->lines_read)
+            zhashx_delete (self->resumed, origin);
+        origin = (const char *) zlistx_next (origins);
+    }
+    zlistx_destroy (&origins);
+    s_run_flush (&run, collect_msg);
+
+    //  All log messages go in one columnar batch
+    if (zbatch_size (self->collect_batch)) {
+        zmetrics_count (self->metrics, self->metric [METRIC_COLLECT_TEXT_BYTES], zbatch_bytes (self->collect_batch));
+        zframe_t *frame = zbatch_encode (self->collect_batch);
+        zmetrics_count (self->metrics, self->metric [METRIC_COLLECT_BATCH_BYTES], zframe_size (frame));
+        zmsg_append (collect_msg, &frame);
     }
-    zlistx_purge (self->collect_log);
 
-    zlistx_t *messages = s_zlog_read_log (self);
-    logmsg = (const char *) zlistx_first (messages);
+    ZLOG_TRACE_END ("s_zlog_send_collect_log");
+    return collect_msg;
+}
+
+
+//  The leader ingests the lines of the log of origin after lines_acked.
+//  Returns the number of lines.
+
+static size_t
+s_zlog_ingest_log (zlog_t *self, const char *origin, int *lines_read, int *lines_acked)
+{
+    *lines_read = *lines_acked;
+    uint64_t line = *lines_read + 1;
+    zlistx_t *messages = s_zlog_read_log (self, origin, lines_read);
+    size_t size = zlistx_size (messages);
+    const char *logmsg = (const char *) zlistx_first (messages);
     while (logmsg) {
-        zmsg_addstr (collect_msg, logmsg);
+        s_zlog_ingest (self, origin, *lines_acked, line++, logmsg);
         logmsg = (const char *) zlistx_next (messages);
     }
+    *lines_acked = *lines_read;
     zlistx_set_destructor (messages, (zlistx_destructor_fn *) zstr_free);
     zlistx_destroy (&messages);
-
-    return collect_msg;
+    return size;
 }
 
-
 static int
 s_zlog_collect_timer (zloop_t *loop, int timer_id, void *arg)
 {
     assert (arg);
     zlog_t *self = (zlog_t *) arg;
+    int64_t start = zclock_usecs ();
+    ZLOG_TRACE_BEGIN ("s_zlog_collect_timer");
+
+    //  Previous waves may still be in progress, they are drained concurrently
+    const char *wave_id = zecho_init (self->collector);
+    if (wave_id) {
+        //  Waves that never conclude must not pile up
+        if (zhashx_size (self->wave_starts) >= ZLOG_WAVE_STARTS_MAX)
+            zhashx_purge (self->wave_starts);
+        zhashx_update (self->wave_starts, wave_id, zsys_sprintf ("%" PRId64, zclock_usecs ()));
+    }
+    if (self->verbose)
+        s_zlog_info (self, "Start log collection %s\n", zyre_uuid (self->node));
+
+    //  Read and insert leader log and the logs of its previous incarnations,
+    //  from the first line no leader ingested
+    self->wave_lines = 0;
+    s_zlog_ingest_log (self, zyre_uuid (self->node), &self->linesRead, &self->lines_acked);
+    zlistx_t *origins = zhashx_keys (self->resumed);
+    const char *origin = (const char *) zlistx_first (origins);
+    while (origin) {
+        resumed_t *resumed = (resumed_t *) zhashx_lookup (self->resumed, origin);
+        if (s_zlog_ingest_log (self, origin, &resumed->lines_read, &resumed->lines_acked) == 0)
+            zhashx_delete (self->resumed, origin);
+        origin = (const char *) zlistx_next (origins);
+    }
+    zlistx_destroy (&origins);
+    zarena_reset (self->arena);
+    zmetrics_observe (self->metrics, self->metric [METRIC_HANDLER_COLLECT_US], zclock_usecs () - start);
+    ZLOG_TRACE_END ("s_zlog_collect_timer");
 
-    if (self->collector)
-        zecho_destroy (&self->collector);
+    return 0;
+}
 
-    self->collector = zecho_new (self->node);
-    zecho_set_clock (self->collector, self->clock);
-    zecho_set_collect_handler (self->collector, self);
-    zecho_set_collect_process (self->collector, (zecho_process_fn *) s_zlog_process_collect_log);
-    zecho_init (self->collector);
-    if (self->verbose)
-        zvector_info (self->clock, "Start log collection %s\n", zyre_uuid (self->node));
 
-    //  Read and insert leader log
-    zlistx_t *messages = s_zlog_read_log (self);
-    /*printf ("Lines read %d %d\n", self->linesRead, (int) zlistx_size (messages));*/
-    char *logmsg = (char *) zlistx_first (messages);
-    while (logmsg) {
-        zlistx_insert (self->ordered_log, logmsg, true);
-        logmsg = (char *) zlistx_next (messages);
+//  Pass a received message to the node. In batch mode messages are collected
+//  and delivered with s_zlog_flush_deliveries.
+
+static void
+s_zlog_deliver (zlog_t *self, zmsg_t *msg)
+{
+    assert (self);
+    zframe_t *content = zmsg_pop (msg);
+    zframe_t *owner = zmsg_pop (msg);
+    if (!content || !owner) {
+        zframe_destroy (&content);
+        return;         //  Malformed message
     }
-    /*printf ("Lines read %d %d\n", self->linesRead, (int) zlistx_size (self->ordered_log));*/
-    zlistx_destroy (&messages);
+    s_zlog_info (self, "R: %.*s - %.*s",
+                 (int) zframe_size (content), (const char *) zframe_data (content),
+                 zframe_size (owner) < 5? (int) zframe_size (owner): 5,
+                 (const char *) zframe_data (owner));
+
+    if (self->batch) {
+        if (!self->deliveries) {
+            byte opcode = ZLOG_CMD_DELIVER;
+            self->deliveries = zmsg_new ();
+            zmsg_addmem (self->deliveries, &opcode, 1);
+        }
+        zmsg_append (self->deliveries, &content);
+        zmsg_append (self->deliveries, &owner);
+    }
+    else {
+        zframe_send (&content, self->pipe, ZFRAME_MORE);
+        zframe_send (&owner, self->pipe, 0);
+    }
+}
 
-    return 0;
+
+//  Send all batched received messages to the node
+
+static void
+s_zlog_flush_deliveries (zlog_t *self)
+{
+    assert (self);
+    if (self->deliveries)
+        zmsg_send (&self->deliveries, self->pipe);
 }
 
 
-//  Here we handle incoming message from zyre
+//  Count a received message by its type
 
-static int
-s_zlog_recv_zyre (zloop_t *loop, zsock_t *reader, void *arg)
+static void
+s_zlog_count_recv (zlog_t *self, const char *command, size_t msg_size)
 {
-    assert (arg);
-    zlog_t *self = (zlog_t *) arg;
+    assert (self);
+    if (streq (command, "ZLE")) {
+        zmetrics_count (self->metrics, self->metric [METRIC_RECV_ZLE], 1);
+        zmetrics_count (self->metrics, self->metric [METRIC_BYTES_RECV_ZLE], msg_size);
+    }
+    else
+    if (streq (command, "ZECHO")) {
+        zmetrics_count (self->metrics, self->metric [METRIC_RECV_ZECHO], 1);
+        zmetrics_count (self->metrics, self->metric [METRIC_BYTES_RECV_ZECHO], msg_size);
+    }
+    else
+    if (streq (command, "BAKERY")) {
+        zmetrics_count (self->metrics, self->metric [METRIC_RECV_BAKERY], 1);
+        zmetrics_count (self->metrics, self->metric [METRIC_BYTES_RECV_BAKERY], msg_size);
+    }
+}
 
-    //  Get the whole message of the pipe in one go
-    zyre_event_t *event = zyre_event_new (self->node);
-    if (!event)
-       return -1;        //  Interrupted, stop zyre processing!
+
+static void
+s_prune_destroy (prune_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        prune_t *self = *self_p;
+        zhashx_destroy (&self->reporters);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  Returns the pending prune of a departed peer, starts one if there is none
+
+static prune_t *
+s_zlog_prune_require (zlog_t *self, const char *pid)
+{
+    assert (self);
+    prune_t *prune = (prune_t *) zhashx_lookup (self->departed, pid);
+    if (!prune) {
+        prune = (prune_t *) zmalloc (sizeof (prune_t));
+        assert (prune);
+        prune->reporters = zhashx_new ();
+        zhashx_insert (self->departed, pid, prune);
+    }
+    return prune;
+}
+
+
+//  Tell all peers the final clock value of a departed peer this node has
+//  seen. The value is final once the peer's exit was seen, all messages
+//  of the peer to this node arrived before.
+
+static void
+s_zlog_prune_report (zlog_t *self, const char *pid, prune_t *prune)
+{
+    assert (self);
+    unsigned long value = zvector_value (self->clock, pid);
+    if (value > prune->final)
+        prune->final = value;
+    prune->reported = true;
+
+    zmsg_t *msg = zmsg_new ();
+    zmsg_addstr (msg, "ZPRUNE");
+    zmsg_addstr (msg, pid);
+    zmsg_addstrf (msg, "%lu", value);
+    zyre_shout (self->node, "GLOBAL", &msg);
+}
+
+
+//  Prune a departed peer once every live peer reported. Later values of
+//  the departed peer are at most the final value, so they are ignored.
+
+static void
+s_zlog_prune_check (zlog_t *self, const char *pid, prune_t *prune)
+{
+    assert (self);
+    if (!prune->reported)
+        return;
+    zlist_t *peers = zyre_peers (self->node);
+    const char *peer = (const char *) zlist_first (peers);
+    while (peer) {
+        if (!streq (peer, pid) && !zhashx_lookup (prune->reporters, peer))
+            break;
+        peer = (const char *) zlist_next (peers);
+    }
+    zlist_destroy (&peers);
+    if (peer)
+        return;         //  Still waiting for reports
+
+    zvector_prune (self->clock, pid, prune->final);
+    zmetrics_count (self->metrics, self->metric [METRIC_CLOCK_PRUNED], 1);
+
+    //  Log entries of the departed peer which weren't collected yet never
+    //  will be, entries depending on them mustn't wait
+    unsigned long *received = (unsigned long *) zhashx_lookup (self->frontier, pid);
+    if (!received) {
+        received = (unsigned long *) zmalloc (sizeof (unsigned long));
+        zhashx_insert (self->frontier, pid, received);
+    }
+    *received = ULONG_MAX;
+    zhashx_delete (self->hlc_frontier, pid);
+    zdeps_retire (self->deps, pid);
+    s_zlog_order_rebuilt (self);
+    zhashx_delete (self->departed, pid);
+}
+
+
+//  Check all pending prunes, a departed peer may have been the last one
+//  which didn't report
+
+static void
+s_zlog_prune_check_all (zlog_t *self)
+{
+    assert (self);
+    zlistx_t *pids = zhashx_keys (self->departed);
+    const char *pid = (const char *) zlistx_first (pids);
+    while (pid) {
+        s_zlog_prune_check (self, pid, (prune_t *) zhashx_lookup (self->departed, pid));
+        pid = (const char *) zlistx_next (pids);
+    }
+    zlistx_destroy (&pids);
+}
+
+
+//  Handle the report of a peer on a departed peer. This node reports too,
+//  unless the departed peer is still connected to it.
+
+static void
+s_zlog_recv_prune (zlog_t *self, const char *reporter, zmsg_t *msg)
+{
+    assert (self);
+    char *pid = zmsg_popstr (msg);
+    char *value = zmsg_popstr (msg);
+    if (pid && value) {
+        prune_t *prune = s_zlog_prune_require (self, pid);
+        unsigned long final = strtoul (value, NULL, 10);
+        if (final > prune->final)
+            prune->final = final;
+        zhashx_update (prune->reporters, reporter, (void *) "");
+        char *address = zyre_peer_address (self->node, pid);
+        if (!prune->reported && (!address || !*address))
+            s_zlog_prune_report (self, pid, prune);
+        zstr_free (&address);
+        s_zlog_prune_check (self, pid, prune);
+    }
+    zstr_free (&pid);
+    zstr_free (&value);
+}
+
+
+//  Here we handle a single event from zyre
+
+static void
+s_zlog_recv_event (zlog_t *self, zyre_event_t *event)
+{
+    assert (self);
+    assert (event);
+    ZLOG_TRACE_BEGIN ("s_zlog_recv_event");
 
     const char *type = zyre_event_type (event);
     if (streq (type, "WHISPER")) {
         zmsg_t *request = zyre_event_msg (event);
-        zvector_recv (self->clock, request);
-        char *command = zmsg_popstr (request);
+        size_t msg_size = zmsg_content_size (request);
+        zmetrics_count (self->metrics, self->metric [METRIC_CLOCK_BYTES_RECV], zframe_size (zmsg_first (request)));
+        if (self->hlc)
+            zhlc_recv (self->hlc, request);
+        else
+            zvector_recv (self->clock, request);
+        zframe_t *frame = zmsg_pop (request);
+        char *command = frame?
+            zarena_strndup (self->arena, (const char *) zframe_data (frame), zframe_size (frame)):
+            zarena_strdup (self->arena, "");
+        zframe_destroy (&frame);
+        s_zlog_count_recv (self, command, msg_size);
         //  Handle election messages
         if (streq (command, "ZLE")) {
             int rc = zelection_recv (self->election, event);
@@ -455,42 +2256,100 @@ s_zlog_recv_zyre (zloop_t *loop, zsock_t *reader, void *arg)
                 if (self->verbose)
                     zelection_print (self->election);
 
-                //  Leader action
-                if (zelection_won (self->election))
-                    self->leader_timer = zloop_timer (loop, 5000, 0, s_zlog_collect_timer, self);
+                //  Leader action, a re-election may move the leadership
+                if (zelection_won (self->election)) {
+                    if (!self->writer)
+                        s_zlog_term_start (self, NULL);
+                    if (self->leader_timer == -1)
+                        self->leader_timer = zloop_timer (self->loop, self->collect_interval, 0, s_zlog_collect_timer, self);
+                }
+                else {
+                    if (self->leader_timer != -1)
+                        zloop_timer_end (self->loop, self->leader_timer);
+                    self->leader_timer = -1;
+                    s_zlog_term_end (self);
+                }
+                if (self->ready_pending)
+                    s_zlog_ready_reply (self, 0);
             }
             //  rc == -1, will be ignored! We just let the election starve.
         }
         else
         if (streq (command, "ZECHO")) {
-            if (!self->collector) {
-                self->collector = zecho_new (self->node);
-                zecho_set_clock (self->collector, self->clock);
-                zecho_set_collect_handler (self->collector, self);
-                zecho_set_collect_process (self->collector, (zecho_process_fn *) s_zlog_process_collect_log);
-                zecho_set_collect_create (self->collector, (zecho_create_fn *) s_zlog_send_collect_log);
-            }
             if (zecho_recv (self->collector, event) == 1)
-                zecho_destroy (&self->collector);
-
+                s_zlog_wave_concluded (self, zecho_wave_id (self->collector));
         }
-        else
-        if (streq (command, "BAKERY")) {
-            char *content = zmsg_popstr (zyre_event_msg (event));
-            char *owner = zmsg_popstr (zyre_event_msg (event));
-            zvector_info (self->clock, "R: %s - %.5s", content, owner);
-
-            zstr_sendm (self->pipe, content);
-            zstr_send (self->pipe, owner);
+        else {
+            if (streq (command, "BAKERY"))
+                s_zlog_deliver (self, request);
 
-            zstr_free (&content);
-            zstr_free (&owner);
+            zyre_event_destroy (&event);
         }
-        zstr_free (&command);
     }
     else
+    if (streq (type, "SHOUT")) {
+        zmsg_t *msg = zyre_event_msg (event);
+        char *command = zmsg_popstr (msg);
+        if (command && streq (command, "ZPRUNE"))
+            s_zlog_recv_prune (self, zyre_event_peer_uuid (event), msg);
+        zstr_free (&command);
+        zyre_event_destroy (&event);
+    }
+    else {
+        //  Membership changed, the collect spanning tree has to be rebuilt
+        //  and the election held again once membership is quiet
+        if (streq (type, "ENTER") || streq (type, "EXIT")
+        ||  streq (type, "JOIN") || streq (type, "LEAVE")) {
+            //  The wave of a departed initiator would block the election
+            if (streq (type, "EXIT") || streq (type, "LEAVE"))
+                zelection_peer_left (self->election, zyre_event_peer_uuid (event));
+            zecho_reset_tree (self->collector);
+            s_zlog_membership_changed (self);
+        }
+
+        //  A departed peer is pruned from the clock once all live peers
+        //  have seen its final value
+        if (streq (type, "EXIT")) {
+            const char *pid = zyre_event_peer_uuid (event);
+            prune_t *prune = s_zlog_prune_require (self, pid);
+            if (!prune->reported)
+                s_zlog_prune_report (self, pid, prune);
+            s_zlog_prune_check_all (self);
+        }
+
         zyre_event_destroy (&event);
+    }
+    //  All transient strings of this event are gone
+    zarena_reset (self->arena);
+    ZLOG_TRACE_END ("s_zlog_recv_event");
+}
+
 
+//  Here we handle incoming message from zyre. In batch mode all pending
+//  events are handled in one go so that their deliveries share a message.
+
+static int
+s_zlog_recv_zyre (zloop_t *loop, zsock_t *reader, void *arg)
+{
+    assert (arg);
+    zlog_t *self = (zlog_t *) arg;
+    int64_t start = zclock_usecs ();
+
+    int events = 0;
+    do {
+        zyre_event_t *event = zyre_event_new (self->node);
+        if (!event)
+           return -1;        //  Interrupted, stop zyre processing!
+
+        s_zlog_recv_event (self, event);
+        events++;
+    } while (self->batch
+         &&  events < ZLOG_BATCH_MAX
+         &&  (zsock_events (reader) & ZMQ_POLLIN));
+
+    s_zlog_flush_deliveries (self);
+    zmetrics_observe (self->metrics, self->metric [METRIC_HANDLER_ZYRE_US], zclock_usecs () - start);
+    zmetrics_observe (self->metrics, self->metric [METRIC_HANDLER_ZYRE_EVENTS], events);
     return 0;
 }
 
@@ -533,16 +2392,40 @@ zlog_compare_log_msg_ts (const char *log_msg_a, const char *log_msg_b)
 int
 zlog_compare_log_msg_vc (const char *log_msg_a, const char *log_msg_b)
 {
-  zvector_t *clock_a = s_get_clock_from_log_msg ((char *)log_msg_a);
-  zvector_t *clock_b = s_get_clock_from_log_msg ((char *)log_msg_b);
-
-  int ret = zvector_compare_to (clock_a, clock_b);
-  zvector_destroy (&clock_a);
-  zvector_destroy (&clock_b);
+  //  Clocks are compared in place. Messages without a valid clock sort
+  //  first, so they don't hold back the others.
+  const char *clock_a = strstr (log_msg_a, "/VC:");
+  const char *clock_b = strstr (log_msg_b, "/VC:");
+  if (!clock_a || !clock_b)
+      return clock_a? 1: -1;
+  int ret = zvector_compare_strings (clock_a + 1, clock_b + 1);
+  if (ret == -2) {
+      zvector_entry_t own;
+      ret = zvector_parse (clock_a + 1, strlen (clock_a + 1), &own, NULL, 0) < 0? -1: 1;
+  }
 
   return ret == 0? 1: ret;
 }
 
+
+//  --------------------------------------------------------------------------
+//  Compares the hybrid logical clocks of given logMsg a to logMsg b, ties
+//  are broken by pid. Messages without HLC sort first.
+//  Returns -1 if a < b, otherwiese 1
+
+int
+zlog_compare_log_msg_hlc (const char *log_msg_a, const char *log_msg_b)
+{
+  uint64_t hlc_a = 0, hlc_b = 0;
+  char pid_a [64] = "", pid_b [64] = "";
+  s_zlog_hlc_parse (log_msg_a, &hlc_a, pid_a, sizeof (pid_a));
+  s_zlog_hlc_parse (log_msg_b, &hlc_b, pid_b, sizeof (pid_b));
+
+  if (hlc_a != hlc_b)
+      return hlc_a < hlc_b? -1: 1;
+  return strcmp (pid_a, pid_b) < 0? -1: 1;
+}
+
 //  --------------------------------------------------------------------------
 //  Reads log of source filepath and orders it with given
 //  pointer to compare_function into destination filepath.
@@ -586,6 +2469,79 @@ zlog_order_log (const char *path_src, const char *path_dst, zlistx_comparator_fn
 }
 
 
+//  --------------------------------------------------------------------------
+//  Selftest helpers. A node of the test keeps its logs, ordered log and
+//  checkpoint in dir and collects often.
+
+static void
+s_zlog_test_setup (zactor_t *zlog, const char *dir, int index)
+{
+    char *ordered_log = zsys_sprintf ("%s/ordered_log_%d", dir, index);
+    char *checkpoint = zsys_sprintf ("%s/zlog_test_%d.checkpoint", dir, index);
+    zstr_sendx (zlog, "LOG DIR", dir, NULL);
+    zstr_sendx (zlog, "ORDERED LOG", ordered_log, NULL);
+    zstr_sendx (zlog, "CHECKPOINT", checkpoint, "500", NULL);
+    zstr_sendx (zlog, "EXPECTED PEERS", "2", NULL);
+    zstr_sendx (zlog, "COLLECT INTERVAL", "250", NULL);
+    zstr_free (&ordered_log);
+    zstr_free (&checkpoint);
+}
+
+//  Returns the uuid of a node, taken from the own part of its clock
+
+static char *
+s_zlog_test_uuid (zactor_t *zlog)
+{
+    char *command, *clock;
+    zstr_send (zlog, "CLOCK");
+    zstr_recvx (zlog, &command, &clock, NULL);
+    assert (streq (command, "CLOCK"));
+    char *uuid = strstr (clock, ";own:") + 5;
+    uuid = strndup (uuid, strchr (uuid, ';') - uuid);
+    zstr_free (&command);
+    zstr_free (&clock);
+    return uuid;
+}
+
+//  Returns the index of the leader among the uuids of the nodes, -1 if
+//  the node doesn't know one
+
+static int
+s_zlog_test_leader (zactor_t *zlog, char **uuids, int nodes)
+{
+    zstr_send (zlog, "STATUS");
+    zmsg_t *status = zmsg_recv (zlog);
+    char *command = zmsg_popstr (status);
+    char *leader = zmsg_popstr (status);
+    assert (streq (command, "STATUS"));
+    int index;
+    for (index = 0; index < nodes; index++)
+        if (streq (uuids [index], leader))
+            break;
+    zstr_free (&command);
+    zstr_free (&leader);
+    zmsg_destroy (&status);
+    return index < nodes? index: -1;
+}
+
+//  Returns the number of lines of a file which contain text
+
+static size_t
+s_zlog_test_count (const char *path, const char *text)
+{
+    size_t count = 0;
+    zfile_t *file = zfile_new (NULL, path);
+    if (file && zfile_input (file) == 0) {
+        const char *line;
+        while ((line = zfile_readln (file)))
+            if (strstr (line, text))
+                count++;
+    }
+    zfile_destroy (&file);
+    return count;
+}
+
+
 //  --------------------------------------------------------------------------
 //  Self test of this actor.
 
@@ -597,6 +2553,14 @@ zlog_test (bool verbose)
         printf ("\n");
 
     //  @selftest
+    //  Log entries with hybrid logical clocks order by timestamp and pid
+    const char *entry_a = "1 2024.01.01 00:00:00 host tag: /HLC:0000018d00000001;own:b;/ a";
+    const char *entry_b = "2 2024.01.01 00:00:00 host tag: /HLC:0000018d00000001;own:c;/ b";
+    const char *entry_c = "0 2024.01.01 00:00:00 host tag: /HLC:0000018d00010000;own:a;/ c";
+    assert (zlog_compare_log_msg_hlc (entry_a, entry_b) == -1);
+    assert (zlog_compare_log_msg_hlc (entry_b, entry_a) == 1);
+    assert (zlog_compare_log_msg_hlc (entry_b, entry_c) == -1);
+
     char *params1[2] = {"inproc://logger1", "GOSSIP MASTER"};
     zactor_t *zlog = zactor_new (zlog_actor, params1);
 
@@ -606,6 +2570,30 @@ zlog_test (bool verbose)
     char *params3[2] = {"inproc://logger3", "GOSSIP SLAVE"};
     zactor_t *zlog3 = zactor_new (zlog_actor, params3);
 
+    //  Every node logs a line before START, the leader orders them
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    zsys_dir_create (SELFTEST_DIR_RW);
+    zactor_t **nodes [3] = { &zlog, &zlog2, &zlog3 };
+    char **node_params [3] = { params1, params2, params3 };
+    char *uuids [3];
+    char *logs [3];
+    zlistx_t *terms = zlistx_new ();
+    zlistx_set_destructor (terms, (zlistx_destructor_fn *) zstr_free);
+    int index;
+    for (index = 0; index < 3; index++) {
+        char *path = zsys_sprintf ("%s/zlog_test_%d.checkpoint", SELFTEST_DIR_RW, index + 1);
+        zsys_file_delete (path);
+        zstr_free (&path);
+        s_zlog_test_setup (*nodes [index], SELFTEST_DIR_RW, index + 1);
+        uuids [index] = s_zlog_test_uuid (*nodes [index]);
+        zlistx_add_end (terms, zsys_sprintf ("%s/ordered_log_%d.%s.1", SELFTEST_DIR_RW, index + 1, uuids [index]));
+        logs [index] = zsys_sprintf ("%s/vc_%s.log", SELFTEST_DIR_RW, uuids [index]);
+        FILE *log_file = fopen (logs [index], "w");
+        assert (log_file);
+        fprintf (log_file, "I: /VC:1;own:%s;%s,1;/ ordered before restart\n", uuids [index], uuids [index]);
+        fclose (log_file);
+    }
+
     /*char *params4[3] = {"inproc://logger4", "logger4", "GOSSIP SLAVE"};*/
     /*zactor_t *zlog4 = zactor_new (zlog_actor, params4);*/
 
@@ -616,16 +2604,165 @@ zlog_test (bool verbose)
         /*zstr_send (zlog4, "VERBOSE");*/
     }
 
+    //  No election before START, READY gives up after its timeout
+    zstr_sendx (zlog, "READY", "100", NULL);
+    assert (zsock_wait (zlog) == 2);
+
     zstr_send (zlog, "START");
     zstr_send (zlog2, "START");
     zstr_send (zlog3, "START");
     /*zstr_send (zlog4, "START");*/
 
-    //  Give time to interconnect and elect
-    zclock_sleep (750);
+    //  Wait until discovery settled and the leader is elected
+    zstr_send (zlog, "READY");
+    assert (zsock_wait (zlog) == 0);
+    zstr_send (zlog2, "READY");
+    assert (zsock_wait (zlog2) == 0);
+    zstr_send (zlog3, "READY");
+    assert (zsock_wait (zlog3) == 0);
+
+    //  Send a batch of messages and receive them batched
+    byte opcode = ZLOG_CMD_BATCH;
+    zmsg_t *batch = zmsg_new ();
+    zmsg_addmem (batch, &opcode, 1);
+    zmsg_send (&batch, zlog2);
+    batch = zmsg_new ();
+    zmsg_addmem (batch, &opcode, 1);
+    zmsg_send (&batch, zlog3);
+
+    opcode = ZLOG_CMD_SEND_RANDOM;
+    batch = zmsg_new ();
+    zmsg_addmem (batch, &opcode, 1);
+    zmsg_addstr (batch, "STIRRED");
+    zmsg_addstr (batch, "");
+    zmsg_addstr (batch, "BAKED");
+    zmsg_addstr (batch, "");
+    zmsg_addstr (batch, "EATEN");
+    zmsg_addstr (batch, "");
+    zmsg_send (&batch, zlog);
+
+    size_t delivered = 0;
+    zpoller_t *poller = zpoller_new (zlog2, zlog3, NULL);
+    while (delivered < 3) {
+        void *which = zpoller_wait (poller, 5000);
+        assert (which);
+        batch = zmsg_recv (which);
+        zframe_t *frame = zmsg_first (batch);
+        assert (zframe_size (frame) == 1);
+        assert (zframe_data (frame) [0] == ZLOG_CMD_DELIVER);
+        delivered += (zmsg_size (batch) - 1) / 2;
+        zmsg_destroy (&batch);
+    }
+    assert (delivered == 3);
+    zpoller_destroy (&poller);
+
+    //  Query the status
+    zstr_send (zlog, "STATUS");
+    zmsg_t *status = zmsg_recv (zlog);
+    assert (zmsg_size (status) == 6);
+    char *status_command = zmsg_popstr (status);
+    assert (streq (status_command, "STATUS"));
+    zstr_free (&status_command);
+    zmsg_destroy (&status);
+
+    //  Query the metrics
+    zstr_send (zlog, "STATS");
+    char *stats_command, *stats;
+    zstr_recvx (zlog, &stats_command, &stats, NULL);
+    assert (streq (stats_command, "STATS"));
+    assert (strstr (stats, "\"sent.BAKERY\": 3"));
+    assert (strstr (stats, "\"collect_log.spilled_bytes\": 0"));
+    zstr_free (&stats_command);
+    zstr_free (&stats);
+
+    //  Wait until the ordered log of the leader's first term holds the lines
+    //  of every node
+    int leader = s_zlog_test_leader (zlog, uuids, 3);
+    assert (leader != -1);
+    char *ordered_log = zsys_sprintf ("%s/ordered_log_%d.%s.1", SELFTEST_DIR_RW, leader + 1, uuids [leader]);
+    int64_t deadline = zclock_mono () + 20000;
+    while (s_zlog_test_count (ordered_log, "ordered before restart") < 3) {
+        assert (zclock_mono () < deadline);
+        zclock_sleep (250);
+    }
 
-    //  Give time for log collect to happen
-    zclock_sleep (12000);
+    //  A restart ends the term of the leader, the file of the term keeps
+    //  the lines ordered by the previous incarnation
+    zactor_destroy (nodes [leader]);
+    *nodes [leader] = zactor_new (zlog_actor, node_params [leader]);
+    s_zlog_test_setup (*nodes [leader], SELFTEST_DIR_RW, leader + 1);
+    zactor_destroy (nodes [leader]);
+    assert (s_zlog_test_count (ordered_log, "ordered before restart") == 3);
+    zstr_free (&ordered_log);
+
+    *nodes [leader] = zactor_new (zlog_actor, node_params [leader]);
+    s_zlog_test_setup (*nodes [leader], SELFTEST_DIR_RW, leader + 1);
+    zstr_free (&uuids [leader]);
+    uuids [leader] = s_zlog_test_uuid (*nodes [leader]);
+    zlistx_add_end (terms, zsys_sprintf ("%s/ordered_log_%d.%s.1", SELFTEST_DIR_RW, leader + 1, uuids [leader]));
+    zstr_send (*nodes [leader], "START");
+    zstr_send (*nodes [leader], "READY");
+    assert (zsock_wait (*nodes [leader]) == 0);
+
+    //  A restarted node resumes from its checkpoint. Its clock follows the
+    //  previous incarnation, including a line logged after the checkpoint,
+    //  and lines the leader didn't acknowledge are collected again. It has
+    //  neither been restarted nor leads.
+    int current = s_zlog_test_leader (*nodes [leader], uuids, 3);
+    int restarted = 0;
+    while (restarted == leader || restarted == current)
+        restarted++;
+    zactor_t **node = nodes [restarted];
+    char *clock_command, *clock_old, *clock_new;
+    zstr_send (*node, "CLOCK");
+    zstr_recvx (*node, &clock_command, &clock_old, NULL);
+    assert (streq (clock_command, "CLOCK"));
+    zstr_free (&clock_command);
+    zactor_destroy (node);
+    char *checkpoint = zsys_sprintf ("%s/zlog_test_%d.checkpoint", SELFTEST_DIR_RW, restarted + 1);
+    assert (zsys_file_exists (checkpoint));
+    zstr_free (&checkpoint);
+
+    FILE *log_file = fopen (logs [restarted], "a");
+    assert (log_file);
+    fprintf (log_file, "I: /VC:1;own:%s;%s,100000;/ after checkpoint\n", uuids [restarted], uuids [restarted]);
+    fclose (log_file);
+
+    *node = zactor_new (zlog_actor, node_params [restarted]);
+    s_zlog_test_setup (*node, SELFTEST_DIR_RW, restarted + 1);
+    char *uuid_new = s_zlog_test_uuid (*node);
+    zlistx_add_end (terms, zsys_sprintf ("%s/ordered_log_%d.%s.1", SELFTEST_DIR_RW, restarted + 1, uuid_new));
+    zstr_free (&uuid_new);
+    zstr_send (*node, "CLOCK");
+    zstr_recvx (*node, &clock_command, &clock_new, NULL);
+    assert (zvector_compare_strings (clock_old, clock_new) == -1);
+    char *value_old = zsys_sprintf (";%s,100000;", uuids [restarted]);
+    assert (strstr (clock_new, value_old));
+    zstr_free (&value_old);
+    zstr_free (&clock_command);
+    zstr_free (&clock_old);
+    zstr_free (&clock_new);
+    zstr_send (*node, "STATS");
+    zstr_recvx (*node, &stats_command, &stats, NULL);
+    assert (strstr (stats, "\"handler.restore_us\": {\"count\": 1,"));
+    assert (strstr (stats, "\"collect.resumed\": 1"));
+    zstr_free (&stats_command);
+    zstr_free (&stats);
+
+    zstr_send (*node, "START");
+    zstr_send (*node, "READY");
+    assert (zsock_wait (*node) == 0);
+    deadline = zclock_mono () + 20000;
+    bool recollected = false;
+    while (!recollected && zclock_mono () < deadline) {
+        zclock_sleep (250);
+        zstr_send (*node, "STATS");
+        zstr_recvx (*node, &stats_command, &stats, NULL);
+        recollected = strstr (stats, "\"collect.resumed\": 0") != NULL;
+        zstr_free (&stats_command);
+        zstr_free (&stats);
+    }
+    assert (recollected);
 
     zstr_send (zlog, "STOP");
     zstr_send (zlog2, "STOP");
@@ -640,6 +2777,30 @@ zlog_test (bool verbose)
     zactor_destroy (&zlog3);
     /*zactor_destroy (&zlog4);*/
 
+    const char *files [] = {
+        "zlog_test_%d.checkpoint", "zlog_test_%d.checkpoint.tail.0",
+        "zlog_test_%d.checkpoint.tail.1"
+    };
+    for (index = 0; index < 3; index++) {
+        size_t file;
+        for (file = 0; file < sizeof (files) / sizeof (files [0]); file++) {
+            char *name = zsys_sprintf (files [file], index + 1);
+            char *path = zsys_sprintf ("%s/%s", SELFTEST_DIR_RW, name);
+            zsys_file_delete (path);
+            zstr_free (&path);
+            zstr_free (&name);
+        }
+        zsys_file_delete (logs [index]);
+        zstr_free (&logs [index]);
+        zstr_free (&uuids [index]);
+    }
+    const char *term = (const char *) zlistx_first (terms);
+    while (term) {
+        zsys_file_delete (term);
+        term = (const char *) zlistx_next (terms);
+    }
+    zlistx_destroy (&terms);
+
     /*zlog_order_log ("/var/log/vc.log", "ordered_vc1.log");*/
     //  @end
 
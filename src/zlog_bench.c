@@ -0,0 +1,359 @@
+/*  =========================================================================
+    zlog_bench - Micro-benchmarks for zvector operations
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zlog_bench - Micro-benchmarks for zvector operations
+@discuss
+    Runs the zvector hot paths across clock sizes 1..1024 and reports
+    ns/op, allocations/op and bytes/op as JSON on stdout. Every operation
+    runs a fixed number of times, the fastest of several repetitions is
+    reported. Setup and teardown of each operation is excluded from time
+    and allocation accounting. Allocations are counted by interposing the
+    C library allocator and are only available on glibc, otherwise they
+    are reported as null.
+@end
+*/
+
+#include "zlog_classes.h"
+
+#define ZLOG_BENCH_OPS      100000  //  Clock entries processed per repetition
+#define ZLOG_BENCH_MIN_ITER 16      //  Minimum iterations per repetition
+#define ZLOG_BENCH_REPEAT   5       //  Repetitions, the fastest is reported
+
+//  --------------------------------------------------------------------------
+//  Allocation accounting
+
+#if defined (__GLIBC__)
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static __thread bool s_counting = false;
+static __thread size_t s_allocs = 0;
+static __thread size_t s_alloc_bytes = 0;
+
+void *
+malloc (size_t size)
+{
+    if (s_counting) {
+        s_allocs++;
+        s_alloc_bytes += size;
+    }
+    return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+    if (s_counting) {
+        s_allocs++;
+        s_alloc_bytes += nmemb * size;
+    }
+    return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+    if (s_counting) {
+        s_allocs++;
+        s_alloc_bytes += size;
+    }
+    return __libc_realloc (ptr, size);
+}
+#   define ZLOG_BENCH_ALLOCS 1
+#else
+static bool s_counting = false;
+static size_t s_allocs = 0;
+static size_t s_alloc_bytes = 0;
+#   define ZLOG_BENCH_ALLOCS 0
+#endif
+
+//  Monotonic clock in nanoseconds
+
+static int64_t
+s_clock_nsecs (void)
+{
+#if defined (__UNIX__)
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return zclock_usecs () * 1000;
+#endif
+}
+
+
+//  --------------------------------------------------------------------------
+//  Benchmark state, operations and teardown
+
+typedef struct {
+    size_t size;                //  Number of entries in the clocks
+    zvector_t *clock;           //  Clock under test
+    zvector_t *other;           //  Concurrent clock of the same size
+    char *clock_string;         //  Serialized other clock
+    size_t iterations;          //  Operations per repetition
+    void **inputs;              //  Prepared input for each operation
+    void **results;             //  Result of each operation
+} bench_t;
+
+typedef void (bench_fn) (bench_t *bench, size_t index);
+typedef void (bench_destructor_fn) (void **item_p);
+
+typedef struct {
+    const char *name;           //  Name of the operation
+    bench_fn *prepare;          //  Prepare input for an operation, untimed
+    bench_fn *run;              //  The timed operation
+    bench_destructor_fn *destructor;    //  Destroys inputs and results
+} bench_op_t;
+
+//  Creates a serialized clock with size entries owned by pid index own
+
+static char *
+s_clock_string (size_t size, size_t own)
+{
+    //  Pids look like zyre uuids
+    size_t length = 32 + size * 48;
+    char *clock_string = (char *) zmalloc (length);
+    char *needle = clock_string;
+    needle += sprintf (needle, "VC:%zu;own:%032zX;", size, own);
+    size_t index;
+    for (index = 0; index < size; index++)
+        needle += sprintf (needle, "%032zX,%zu;", index, index + 1);
+    return clock_string;
+}
+
+static void
+s_prepare_msg (bench_t *bench, size_t index)
+{
+    zmsg_t *msg = zmsg_new ();
+    zmsg_pushstr (msg, bench->clock_string);
+    bench->inputs [index] = msg;
+}
+
+static void
+s_run_event (bench_t *bench, size_t index)
+{
+    zvector_event (bench->clock);
+}
+
+static void
+s_run_send_prepare (bench_t *bench, size_t index)
+{
+    bench->results [index] = zvector_send_prepare (bench->clock, zmsg_new ());
+}
+
+static void
+s_run_recv (bench_t *bench, size_t index)
+{
+    zvector_recv (bench->clock, (zmsg_t *) bench->inputs [index]);
+}
+
+static void
+s_run_to_string (bench_t *bench, size_t index)
+{
+    bench->results [index] = zvector_to_string (bench->clock);
+}
+
+static void
+s_run_from_string (bench_t *bench, size_t index)
+{
+    bench->results [index] = zvector_from_string (bench->clock_string);
+}
+
+static void
+s_prepare_entries (bench_t *bench, size_t index)
+{
+    bench->inputs [index] = zmalloc (bench->size * sizeof (zvector_entry_t));
+}
+
+static void
+s_run_parse (bench_t *bench, size_t index)
+{
+    zvector_entry_t own;
+    zvector_parse (bench->clock_string, strlen (bench->clock_string), &own,
+                   (zvector_entry_t *) bench->inputs [index], bench->size);
+}
+
+static void
+s_entries_destroy (void **entries_p)
+{
+    free (*entries_p);
+    *entries_p = NULL;
+}
+
+static void
+s_run_compare_strings (bench_t *bench, size_t index)
+{
+    bench->results [index] = (void *) (intptr_t) zvector_compare_strings (bench->clock_string,
+                                                                           bench->clock_string);
+}
+
+static void
+s_run_compare_to (bench_t *bench, size_t index)
+{
+    bench->results [index] = (void *) (intptr_t) zvector_compare_to (bench->clock, bench->other);
+}
+
+static void
+s_run_dup (bench_t *bench, size_t index)
+{
+    bench->results [index] = zvector_dup (bench->clock);
+}
+
+static bench_op_t s_ops [] = {
+    { "zvector_event", NULL, s_run_event, NULL },
+    { "zvector_send_prepare", NULL, s_run_send_prepare, (bench_destructor_fn *) zmsg_destroy },
+    { "zvector_recv", s_prepare_msg, s_run_recv, (bench_destructor_fn *) zmsg_destroy },
+    { "zvector_to_string", NULL, s_run_to_string, (bench_destructor_fn *) zstr_free },
+    { "zvector_from_string", NULL, s_run_from_string, (bench_destructor_fn *) zvector_destroy },
+    { "zvector_parse", s_prepare_entries, s_run_parse, s_entries_destroy },
+    { "zvector_compare_to", NULL, s_run_compare_to, NULL },
+    { "zvector_compare_strings", NULL, s_run_compare_strings, NULL },
+    { "zvector_dup", NULL, s_run_dup, (bench_destructor_fn *) zvector_destroy },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+//  --------------------------------------------------------------------------
+//  Runs one operation for one clock size and prints its JSON record
+
+static void
+s_bench_run (bench_op_t *op, size_t size, size_t ops, int repeat, bool first)
+{
+    bench_t bench = { size };
+    char *clock_string = s_clock_string (size, 0);
+    bench.clock = zvector_from_string (clock_string);
+    zstr_free (&clock_string);
+    bench.clock_string = s_clock_string (size, size > 1? 1: 0);
+    bench.other = zvector_from_string (bench.clock_string);
+    bench.iterations = ops / size;
+    if (bench.iterations < ZLOG_BENCH_MIN_ITER)
+        bench.iterations = ZLOG_BENCH_MIN_ITER;
+    bench.inputs = (void **) zmalloc (bench.iterations * sizeof (void *));
+    bench.results = (void **) zmalloc (bench.iterations * sizeof (void *));
+
+    int64_t best_nsecs = INT64_MAX;
+    size_t allocs = 0;
+    size_t alloc_bytes = 0;
+    size_t index;
+    int run;
+    //  The first repetition warms up caches and the allocator
+    for (run = 0; run <= repeat; run++) {
+        if (op->prepare)
+            for (index = 0; index < bench.iterations; index++)
+                op->prepare (&bench, index);
+
+        s_allocs = 0;
+        s_alloc_bytes = 0;
+        s_counting = true;
+        int64_t start = s_clock_nsecs ();
+        for (index = 0; index < bench.iterations; index++)
+            op->run (&bench, index);
+        int64_t elapsed = s_clock_nsecs () - start;
+        s_counting = false;
+
+        if (run > 0 && elapsed < best_nsecs) {
+            best_nsecs = elapsed;
+            allocs = s_allocs;
+            alloc_bytes = s_alloc_bytes;
+        }
+
+        if (op->destructor)
+            for (index = 0; index < bench.iterations; index++) {
+                if (bench.inputs [index])
+                    op->destructor (&bench.inputs [index]);
+                if (bench.results [index])
+                    op->destructor (&bench.results [index]);
+            }
+        memset (bench.inputs, 0, bench.iterations * sizeof (void *));
+        memset (bench.results, 0, bench.iterations * sizeof (void *));
+    }
+
+    printf ("%s    {\"name\": \"%s\", \"clock_size\": %zu, \"iterations\": %zu, "
+            "\"ns_per_op\": %.1f, ",
+            first? "": ",\n", op->name, size, bench.iterations,
+            (double) best_nsecs / bench.iterations);
+    if (ZLOG_BENCH_ALLOCS)
+        printf ("\"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f}",
+                (double) allocs / bench.iterations,
+                (double) alloc_bytes / bench.iterations);
+    else
+        printf ("\"allocs_per_op\": null, \"bytes_per_op\": null}");
+
+    free (bench.inputs);
+    free (bench.results);
+    zstr_free (&bench.clock_string);
+    zvector_destroy (&bench.clock);
+    zvector_destroy (&bench.other);
+}
+
+
+int main (int argc, char *argv [])
+{
+    const char *filter = NULL;
+    size_t max_size = 1024;
+    size_t ops = ZLOG_BENCH_OPS;
+    int repeat = ZLOG_BENCH_REPEAT;
+    int argn;
+    for (argn = 1; argn < argc; argn++) {
+        if (streq (argv [argn], "--help")
+        ||  streq (argv [argn], "-h")) {
+            puts ("zlog_bench [options] ...");
+            puts ("  --filter / -f name     only run operations containing name");
+            puts ("  --max-size / -m n      largest clock size (default 1024)");
+            puts ("  --ops / -o n           clock entries processed per repetition");
+            puts ("  --repeat / -r n        repetitions, the fastest is reported");
+            puts ("  --help / -h            this information");
+            return 0;
+        }
+        else
+        if ((streq (argv [argn], "--filter")
+        ||   streq (argv [argn], "-f")) && argn + 1 < argc)
+            filter = argv [++argn];
+        else
+        if ((streq (argv [argn], "--max-size")
+        ||   streq (argv [argn], "-m")) && argn + 1 < argc)
+            max_size = strtoul (argv [++argn], NULL, 10);
+        else
+        if ((streq (argv [argn], "--ops")
+        ||   streq (argv [argn], "-o")) && argn + 1 < argc)
+            ops = strtoul (argv [++argn], NULL, 10);
+        else
+        if ((streq (argv [argn], "--repeat")
+        ||   streq (argv [argn], "-r")) && argn + 1 < argc)
+            repeat = atoi (argv [++argn]);
+        else {
+            printf ("Unknown option: %s\n", argv [argn]);
+            return 1;
+        }
+    }
+    if (repeat < 1)
+        repeat = 1;
+
+    printf ("{\"benchmarks\": [\n");
+    bool first = true;
+    bench_op_t *op;
+    for (op = s_ops; op->name; op++) {
+        if (filter && !strstr (op->name, filter))
+            continue;
+        size_t size;
+        for (size = 1; size <= max_size; size *= 2) {
+            s_bench_run (op, size, ops, repeat, first);
+            first = false;
+            fflush (stdout);
+        }
+    }
+    printf ("\n]}\n");
+    return 0;
+}
@@ -26,9 +26,17 @@
 //  Extra headers
 
 //  Opaque class structures to allow forward references
+#ifndef ZLOG_SPOOL_T_DEFINED
+typedef struct _zlog_spool_t zlog_spool_t;
+#define ZLOG_SPOOL_T_DEFINED
+#endif
 
 //  Internal API
 
+#include "zlog_writer.h"
+#include "zlog_trace.h"
+#include "zlog_spool.h"
+
 
 //  *** To avoid double-definitions, only define if building without draft ***
 #ifndef ZLOG_BUILD_DRAFT_API
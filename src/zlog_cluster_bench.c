@@ -0,0 +1,413 @@
+/*  =========================================================================
+    zlog_cluster_bench - In-process cluster throughput benchmark
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zlog_cluster_bench - In-process cluster throughput benchmark
+@discuss
+    Starts N zlog actors in one process which discover each other via
+    inproc gossip like zlog_test does. Every node sends messages to random
+    peers and logs entries at a configurable rate, like the bakery. The
+    benchmark reports as JSON on stdout:
+
+    * election convergence time, until all nodes agree on a leader
+    * collect wave latency percentiles of the leader
+    * end-to-end latency percentiles of log entries until they are ordered
+    * delivered messages and payload bytes per second
+    * peak RSS of the process
+
+    Log entries reach the leader via rsyslog (see 1337-logger.conf). Without
+    it there is nothing to order and end-to-end latencies remain empty.
+    Hundreds of nodes need a raised file descriptor limit (ulimit -n).
+@end
+*/
+
+#include "zlog_classes.h"
+#if defined (__UNIX__)
+#   include <sys/resource.h>
+#endif
+
+#define ZLOG_BENCH_TICK         10      //  Workload tick in ms
+#define ZLOG_BENCH_STATUS       1000    //  Status query interval in ms
+#define ZLOG_BENCH_ELECTION     60000   //  Election timeout in ms
+
+//  Structure of the benchmark
+
+typedef struct {
+    size_t size;                //  Number of nodes
+    zactor_t **nodes;           //  zlog actors
+    char **endpoints;           //  Endpoints of the nodes
+    char **leaders;             //  Leader as seen by each node
+    zpoller_t *poller;          //  Polls all nodes
+    size_t pending_status;      //  Status queries not yet answered
+    size_t delivered;           //  Delivered messages
+    size_t delivered_bytes;     //  Delivered payload bytes
+    zchunk_t *wave_latencies;   //  Collect wave latencies in usecs
+    zchunk_t *entry_latencies;  //  Log entry to ordered log latencies in usecs
+    bool verbose;               //  Verbose output
+} bench_t;
+
+
+//  Returns the index of a node
+
+static size_t
+s_bench_node_index (bench_t *self, void *node)
+{
+    size_t index;
+    for (index = 0; index < self->size; index++)
+        if (self->nodes [index] == node)
+            break;
+    assert (index < self->size);
+    return index;
+}
+
+
+//  Handle a message from a node, either deliveries or a status reply
+
+static void
+s_bench_recv (bench_t *self, void *node)
+{
+    zmsg_t *msg = zmsg_recv (node);
+    if (!msg)
+        return;         //  Interrupted
+
+    zframe_t *frame = zmsg_first (msg);
+    if (zframe_size (frame) == 1 && zframe_data (frame) [0] == ZLOG_CMD_DELIVER) {
+        zframe_t *content = zmsg_next (msg);
+        while (content) {
+            self->delivered++;
+            self->delivered_bytes += zframe_size (content);
+            zmsg_next (msg);    //  Skip owner
+            content = zmsg_next (msg);
+        }
+    }
+    else
+    if (zframe_streq (frame, "STATUS")) {
+        size_t index = s_bench_node_index (self, node);
+        zstr_free (&self->leaders [index]);
+        self->leaders [index] = zframe_strdup (zmsg_next (msg));
+        zmsg_next (msg);        //  Skip concluded waves
+        zmsg_next (msg);        //  Skip ordered log size
+        zframe_t *latencies = zmsg_next (msg);
+        zchunk_extend (self->wave_latencies, zframe_data (latencies), zframe_size (latencies));
+        latencies = zmsg_next (msg);
+        zchunk_extend (self->entry_latencies, zframe_data (latencies), zframe_size (latencies));
+        self->pending_status--;
+    }
+    zmsg_destroy (&msg);
+}
+
+
+//  Handle messages from nodes until timeout ms passed
+
+static void
+s_bench_poll (bench_t *self, int64_t timeout)
+{
+    int64_t deadline = zclock_mono () + timeout;
+    int64_t remaining = timeout;
+    while (remaining > 0) {
+        void *node = zpoller_wait (self->poller, (int) remaining);
+        if (node)
+            s_bench_recv (self, node);
+        else
+        if (zpoller_terminated (self->poller))
+            break;
+        remaining = deadline - zclock_mono ();
+    }
+}
+
+
+//  Query the status of all nodes and wait for the replies
+
+static void
+s_bench_query_status (bench_t *self)
+{
+    size_t index;
+    for (index = 0; index < self->size; index++) {
+        zstr_send (self->nodes [index], "STATUS");
+        self->pending_status++;
+    }
+    int64_t deadline = zclock_mono () + ZLOG_BENCH_STATUS;
+    while (self->pending_status > 0 && zclock_mono () < deadline) {
+        void *node = zpoller_wait (self->poller, ZLOG_BENCH_STATUS);
+        if (node)
+            s_bench_recv (self, node);
+    }
+}
+
+
+//  Returns true if all nodes agree on the same leader
+
+static bool
+s_bench_converged (bench_t *self)
+{
+    size_t index;
+    for (index = 0; index < self->size; index++)
+        if (!self->leaders [index]
+        ||  streq (self->leaders [index], "")
+        ||  !streq (self->leaders [index], self->leaders [0]))
+            return false;
+    return true;
+}
+
+
+//  Send a batch of messages to random peers and a batch of log entries
+
+static void
+s_bench_workload (bench_t *self, size_t node, size_t messages, size_t entries,
+                  size_t payload_size, size_t *seq)
+{
+    char *payload = (char *) zmalloc (payload_size + 32);
+    byte opcode;
+    size_t index;
+    if (messages > 0) {
+        opcode = ZLOG_CMD_SEND_RANDOM;
+        zmsg_t *batch = zmsg_new ();
+        zmsg_addmem (batch, &opcode, 1);
+        for (index = 0; index < messages; index++) {
+            int length = snprintf (payload, payload_size + 32, "MSG %zu ", (*seq)++);
+            if ((size_t) length < payload_size) {
+                memset (payload + length, 'x', payload_size - length);
+                length = (int) payload_size;
+            }
+            zmsg_addmem (batch, payload, length);
+            zmsg_addmem (batch, NULL, 0);
+        }
+        zmsg_send (&batch, self->nodes [node]);
+    }
+    if (entries > 0) {
+        opcode = ZLOG_CMD_INFO;
+        zmsg_t *batch = zmsg_new ();
+        zmsg_addmem (batch, &opcode, 1);
+        for (index = 0; index < entries; index++)
+            zmsg_addstrf (batch, "LOG %zu", (*seq)++);
+        zmsg_send (&batch, self->nodes [node]);
+    }
+    free (payload);
+}
+
+
+//  Compares two int64_t values for qsort
+
+static int
+s_compare_int64 (const void *a, const void *b)
+{
+    int64_t value_a = *(const int64_t *) a;
+    int64_t value_b = *(const int64_t *) b;
+    return value_a < value_b? -1: value_a > value_b? 1: 0;
+}
+
+
+//  Print percentiles of latency samples in usecs as JSON object
+
+static void
+s_print_percentiles (const char *name, zchunk_t *samples)
+{
+    size_t count = zchunk_size (samples) / sizeof (int64_t);
+    printf ("  \"%s\": {\"count\": %zu", name, count);
+    if (count > 0) {
+        int64_t *values = (int64_t *) zmalloc (count * sizeof (int64_t));
+        memcpy (values, zchunk_data (samples), count * sizeof (int64_t));
+        qsort (values, count, sizeof (int64_t), s_compare_int64);
+        printf (", \"p50_us\": %" PRId64 ", \"p90_us\": %" PRId64
+                ", \"p99_us\": %" PRId64 ", \"max_us\": %" PRId64,
+                values [count / 2], values [count * 90 / 100],
+                values [count * 99 / 100], values [count - 1]);
+        free (values);
+    }
+    printf ("},\n");
+}
+
+
+int main (int argc, char *argv [])
+{
+    bench_t self = { 10 };
+    int duration = 10;
+    size_t msg_rate = 10;
+    size_t log_rate = 10;
+    int collect_interval = 1000;
+    size_t payload_size = 16;
+    int argn;
+    for (argn = 1; argn < argc; argn++) {
+        if (streq (argv [argn], "--help")
+        ||  streq (argv [argn], "-h")) {
+            puts ("zlog_cluster_bench [options] ...");
+            puts ("  --nodes / -n n         number of in-process nodes (default 10)");
+            puts ("  --duration / -t s      duration of the workload (default 10)");
+            puts ("  --msg-rate / -m n      messages per node and second (default 10)");
+            puts ("  --log-rate / -l n      log entries per node and second (default 10)");
+            puts ("  --collect / -c ms      collect interval of the leader (default 1000)");
+            puts ("  --payload / -p n       message payload size in bytes (default 16)");
+            puts ("  --verbose / -v         verbose test output");
+            puts ("  --help / -h            this information");
+            return 0;
+        }
+        else
+        if (streq (argv [argn], "--verbose")
+        ||  streq (argv [argn], "-v"))
+            self.verbose = true;
+        else
+        if ((streq (argv [argn], "--nodes")
+        ||   streq (argv [argn], "-n")) && argn + 1 < argc)
+            self.size = strtoul (argv [++argn], NULL, 10);
+        else
+        if ((streq (argv [argn], "--duration")
+        ||   streq (argv [argn], "-t")) && argn + 1 < argc)
+            duration = atoi (argv [++argn]);
+        else
+        if ((streq (argv [argn], "--msg-rate")
+        ||   streq (argv [argn], "-m")) && argn + 1 < argc)
+            msg_rate = strtoul (argv [++argn], NULL, 10);
+        else
+        if ((streq (argv [argn], "--log-rate")
+        ||   streq (argv [argn], "-l")) && argn + 1 < argc)
+            log_rate = strtoul (argv [++argn], NULL, 10);
+        else
+        if ((streq (argv [argn], "--collect")
+        ||   streq (argv [argn], "-c")) && argn + 1 < argc)
+            collect_interval = atoi (argv [++argn]);
+        else
+        if ((streq (argv [argn], "--payload")
+        ||   streq (argv [argn], "-p")) && argn + 1 < argc)
+            payload_size = strtoul (argv [++argn], NULL, 10);
+        else {
+            printf ("Unknown option: %s\n", argv [argn]);
+            return 1;
+        }
+    }
+    if (self.size < 2) {
+        printf ("At least two nodes are required\n");
+        return 1;
+    }
+
+    //  Every node needs a couple of sockets
+    zsys_set_max_sockets (0);
+
+    self.nodes = (zactor_t **) zmalloc (self.size * sizeof (zactor_t *));
+    self.endpoints = (char **) zmalloc (self.size * sizeof (char *));
+    self.leaders = (char **) zmalloc (self.size * sizeof (char *));
+    self.wave_latencies = zchunk_new (NULL, 0);
+    self.entry_latencies = zchunk_new (NULL, 0);
+    self.poller = zpoller_new (NULL);
+
+    char *interval = zsys_sprintf ("%d", collect_interval);
+    char *peers = zsys_sprintf ("%zu", self.size - 1);
+    size_t index;
+    for (index = 0; index < self.size; index++) {
+        self.endpoints [index] = zsys_sprintf ("inproc://zlog-bench-%zu", index);
+        char *params [2] = { self.endpoints [index],
+                             index == 0? "GOSSIP MASTER": "GOSSIP SLAVE" };
+        self.nodes [index] = zactor_new (zlog_actor, params);
+        zpoller_add (self.poller, self.nodes [index]);
+        if (self.verbose)
+            zstr_send (self.nodes [index], "VERBOSE");
+        zstr_sendx (self.nodes [index], "COLLECT INTERVAL", interval, NULL);
+        zstr_sendx (self.nodes [index], "EXPECTED PEERS", peers, NULL);
+
+        byte opcode = ZLOG_CMD_BATCH;
+        zmsg_t *batch = zmsg_new ();
+        zmsg_addmem (batch, &opcode, 1);
+        zmsg_send (&batch, self.nodes [index]);
+    }
+    zstr_free (&interval);
+    zstr_free (&peers);
+
+    //  Election convergence
+    int64_t start = zclock_usecs ();
+    for (index = 0; index < self.size; index++)
+        zstr_send (self.nodes [index], "START");
+    int64_t convergence = -1;
+    while (zclock_usecs () - start < (int64_t) ZLOG_BENCH_ELECTION * 1000) {
+        s_bench_query_status (&self);
+        if (s_bench_converged (&self)) {
+            convergence = zclock_usecs () - start;
+            break;
+        }
+        zclock_sleep (50);
+    }
+    if (self.verbose)
+        zsys_info ("Election converged after %" PRId64 " usecs", convergence);
+
+    //  Drive the workload, rates are kept by accumulating credit per tick
+    double msg_credit = 0;
+    double log_credit = 0;
+    size_t seq = 0;
+    int64_t workload_start = zclock_mono ();
+    int64_t workload_end = workload_start + (int64_t) duration * 1000;
+    int64_t next_status = workload_start + ZLOG_BENCH_STATUS;
+    int64_t last_tick = workload_start;
+    while (zclock_mono () < workload_end) {
+        int64_t now = zclock_mono ();
+        msg_credit += (double) msg_rate * (now - last_tick) / 1000;
+        log_credit += (double) log_rate * (now - last_tick) / 1000;
+        last_tick = now;
+        size_t messages = (size_t) msg_credit;
+        size_t entries = (size_t) log_credit;
+        msg_credit -= messages;
+        log_credit -= entries;
+        for (index = 0; index < self.size; index++)
+            s_bench_workload (&self, index, messages, entries, payload_size, &seq);
+
+        if (now >= next_status) {
+            s_bench_query_status (&self);
+            next_status += ZLOG_BENCH_STATUS;
+        }
+        s_bench_poll (&self, ZLOG_BENCH_TICK);
+    }
+    int64_t workload_time = zclock_mono () - workload_start;
+    size_t delivered = self.delivered;
+    size_t delivered_bytes = self.delivered_bytes;
+
+    //  Give the leader time to collect the remaining entries
+    s_bench_poll (&self, collect_interval + 1000);
+    s_bench_query_status (&self);
+
+    long peak_rss = -1;
+#if defined (__UNIX__)
+    struct rusage usage;
+    if (getrusage (RUSAGE_SELF, &usage) == 0)
+        peak_rss = usage.ru_maxrss;
+#endif
+
+    printf ("{\n");
+    printf ("  \"nodes\": %zu,\n", self.size);
+    printf ("  \"duration_s\": %d,\n", duration);
+    printf ("  \"msg_rate\": %zu,\n", msg_rate);
+    printf ("  \"log_rate\": %zu,\n", log_rate);
+    printf ("  \"collect_interval_ms\": %d,\n", collect_interval);
+    printf ("  \"election_convergence_us\": %" PRId64 ",\n", convergence);
+    s_print_percentiles ("collect_wave_latency", self.wave_latencies);
+    s_print_percentiles ("ordered_log_latency", self.entry_latencies);
+    printf ("  \"messages_per_s\": %.1f,\n", workload_time > 0? delivered * 1000.0 / workload_time: 0);
+    printf ("  \"bytes_per_s\": %.1f,\n", workload_time > 0? delivered_bytes * 1000.0 / workload_time: 0);
+    printf ("  \"peak_rss_kb\": %ld\n", peak_rss);
+    printf ("}\n");
+
+    for (index = 0; index < self.size; index++)
+        zstr_send (self.nodes [index], "STOP");
+
+    //  Give time to disconnect
+    zclock_sleep (250);
+
+    zpoller_destroy (&self.poller);
+    for (index = 0; index < self.size; index++) {
+        zactor_destroy (&self.nodes [index]);
+        zstr_free (&self.endpoints [index]);
+        zstr_free (&self.leaders [index]);
+    }
+    free (self.nodes);
+    free (self.endpoints);
+    free (self.leaders);
+    zchunk_destroy (&self.wave_latencies);
+    zchunk_destroy (&self.entry_latencies);
+    return 0;
+}
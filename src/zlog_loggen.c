@@ -0,0 +1,295 @@
+/*  =========================================================================
+    zlog_loggen - Synthetic causal log generator
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zlog_loggen - Synthetic causal log generator
+@discuss
+    Simulates processes that exchange messages and writes their logs in the
+    vc_<uuid>.log format rsyslog produces from zlog (see 1337-logger.conf).
+    Every event writes exactly one line and increments the own clock value
+    by one, messages carry the sender's clock and are merged on receive.
+
+    The output directory gets:
+
+    * vc_<uuid>.log     the log of each process
+    * combined.log      all process logs concatenated, the input a leader
+                        collects from its peers
+    * reference.log     all lines in generation order, a reference
+                        topological order
+
+    The concurrency ratio is the probability of an event being local, the
+    remaining events send or receive messages. The output is reproducible
+    for a given seed.
+@end
+*/
+
+#include "zlog_classes.h"
+
+#define ZLOG_LOGGEN_INFLIGHT    8       //  Messages in flight per process
+
+//  Simulated process
+
+typedef struct {
+    char pid [33];              //  Process uuid
+    unsigned long *clock;       //  Vector clock, one value per process
+    zlist_t *inbox;             //  Clocks of messages in flight to us
+    FILE *log;                  //  vc_<uuid>.log
+    char *path;                 //  Path of the log
+} process_t;
+
+//  Generator state
+
+typedef struct {
+    size_t size;                //  Number of processes
+    process_t *processes;       //  Simulated processes
+    FILE *reference;            //  Lines in generation order
+    uint64_t random;            //  xorshift state
+    uint64_t timestamp;         //  Unix time with four subsecond digits
+    uint64_t tick;              //  Timestamp increment per event
+    char *line;                 //  Line buffer
+    size_t line_max;            //  Size of line buffer
+} loggen_t;
+
+
+//  Reproducible pseudo random numbers
+
+static uint64_t
+s_random (loggen_t *self)
+{
+    self->random ^= self->random << 13;
+    self->random ^= self->random >> 7;
+    self->random ^= self->random << 17;
+    return self->random;
+}
+
+static double
+s_random_unit (loggen_t *self)
+{
+    return (s_random (self) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+//  Log one event of process index and return the line's size
+
+static size_t
+s_loggen_event (loggen_t *self, size_t index, const char *event, const char *peer)
+{
+    process_t *process = &self->processes [index];
+    process->clock [index]++;
+    self->timestamp += self->tick;
+
+    time_t seconds = (time_t) (self->timestamp / 10000);
+    struct tm *tm = gmtime (&seconds);
+    char *needle = self->line;
+    needle += sprintf (needle, "%" PRIu64 " %04d.%02d.%02d %02d:%02d:%02d loggen zlog: ",
+                       self->timestamp, tm->tm_year + 1900, tm->tm_mon + 1,
+                       tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec);
+
+    //  Only processes we know of are part of the clock
+    size_t known = 0;
+    size_t other;
+    for (other = 0; other < self->size; other++)
+        if (process->clock [other])
+            known++;
+    needle += sprintf (needle, "/VC:%zu;own:%s;", known, process->pid);
+    for (other = 0; other < self->size; other++)
+        if (process->clock [other])
+            needle += sprintf (needle, "%s,%lu;",
+                               self->processes [other].pid, process->clock [other]);
+    needle += sprintf (needle, "/ %s: %lu - %.5s\n",
+                       event, process->clock [index], peer? peer: process->pid);
+
+    size_t length = needle - self->line;
+    fwrite (self->line, 1, length, process->log);
+    fwrite (self->line, 1, length, self->reference);
+    return length;
+}
+
+
+//  Generate one event of a random process and return the line's size
+
+static size_t
+s_loggen_step (loggen_t *self, double concurrency)
+{
+    size_t index = s_random (self) % self->size;
+    process_t *process = &self->processes [index];
+
+    if (self->size == 1 || s_random_unit (self) < concurrency)
+        return s_loggen_event (self, index, "I", NULL);
+
+    //  Receive a message in flight or send a new one
+    if (zlist_size (process->inbox) > 0
+    && (zlist_size (process->inbox) >= ZLOG_LOGGEN_INFLIGHT || s_random (self) % 2)) {
+        unsigned long *clock = (unsigned long *) zlist_pop (process->inbox);
+        size_t other;
+        for (other = 0; other < self->size; other++)
+            if (clock [other] > process->clock [other])
+                process->clock [other] = clock [other];
+        free (clock);
+        return s_loggen_event (self, index, "R", NULL);
+    }
+    size_t peer = s_random (self) % (self->size - 1);
+    if (peer >= index)
+        peer++;
+    process_t *receiver = &self->processes [peer];
+    if (zlist_size (receiver->inbox) >= ZLOG_LOGGEN_INFLIGHT)
+        return s_loggen_event (self, index, "I", NULL);
+
+    size_t length = s_loggen_event (self, index, "S", receiver->pid);
+    unsigned long *clock = (unsigned long *) zmalloc (self->size * sizeof (unsigned long));
+    memcpy (clock, process->clock, self->size * sizeof (unsigned long));
+    zlist_append (receiver->inbox, clock);
+    return length;
+}
+
+
+//  Append the file at path to dst
+
+static void
+s_append_file (FILE *dst, const char *path)
+{
+    FILE *src = fopen (path, "r");
+    assert (src);
+    char buffer [65536];
+    size_t bytes;
+    while ((bytes = fread (buffer, 1, sizeof (buffer), src)) > 0)
+        fwrite (buffer, 1, bytes, dst);
+    fclose (src);
+}
+
+
+int main (int argc, char *argv [])
+{
+    const char *directory = "loggen";
+    size_t processes = 10;
+    size_t lines = 10000;
+    uint64_t max_bytes = 0;
+    double rate = 100;
+    double concurrency = 0.5;
+    uint64_t seed = 1;
+    int argn;
+    for (argn = 1; argn < argc; argn++) {
+        if (streq (argv [argn], "--help")
+        ||  streq (argv [argn], "-h")) {
+            puts ("zlog_loggen [options] ...");
+            puts ("  --output / -o dir      output directory (default loggen)");
+            puts ("  --processes / -p n     number of processes (default 10)");
+            puts ("  --lines / -l n         total number of lines (default 10000)");
+            puts ("  --bytes / -b n         stop after n bytes of log");
+            puts ("  --rate / -r n          events per process and second (default 100)");
+            puts ("  --concurrency / -c f   ratio of local events 0..1 (default 0.5)");
+            puts ("  --seed / -s n          random seed (default 1)");
+            puts ("  --help / -h            this information");
+            return 0;
+        }
+        else
+        if ((streq (argv [argn], "--output")
+        ||   streq (argv [argn], "-o")) && argn + 1 < argc)
+            directory = argv [++argn];
+        else
+        if ((streq (argv [argn], "--processes")
+        ||   streq (argv [argn], "-p")) && argn + 1 < argc)
+            processes = strtoul (argv [++argn], NULL, 10);
+        else
+        if ((streq (argv [argn], "--lines")
+        ||   streq (argv [argn], "-l")) && argn + 1 < argc)
+            lines = strtoul (argv [++argn], NULL, 10);
+        else
+        if ((streq (argv [argn], "--bytes")
+        ||   streq (argv [argn], "-b")) && argn + 1 < argc)
+            max_bytes = strtoull (argv [++argn], NULL, 10);
+        else
+        if ((streq (argv [argn], "--rate")
+        ||   streq (argv [argn], "-r")) && argn + 1 < argc)
+            rate = atof (argv [++argn]);
+        else
+        if ((streq (argv [argn], "--concurrency")
+        ||   streq (argv [argn], "-c")) && argn + 1 < argc)
+            concurrency = atof (argv [++argn]);
+        else
+        if ((streq (argv [argn], "--seed")
+        ||   streq (argv [argn], "-s")) && argn + 1 < argc)
+            seed = strtoull (argv [++argn], NULL, 10);
+        else {
+            printf ("Unknown option: %s\n", argv [argn]);
+            return 1;
+        }
+    }
+    if (processes < 1 || rate <= 0) {
+        printf ("Invalid number of processes or rate\n");
+        return 1;
+    }
+    if (max_bytes)
+        lines = SIZE_MAX;
+    zsys_dir_create (directory);
+
+    loggen_t self = { processes };
+    self.random = seed? seed: 1;
+    self.timestamp = (uint64_t) 1600000000 * 10000;
+    //  All processes together produce rate * size events per second
+    self.tick = (uint64_t) (10000 / (rate * processes));
+    if (self.tick == 0)
+        self.tick = 1;
+    self.line_max = 128 + processes * 64;
+    self.line = (char *) zmalloc (self.line_max);
+    char *path = zsys_sprintf ("%s/reference.log", directory);
+    self.reference = fopen (path, "w");
+    assert (self.reference);
+    zstr_free (&path);
+
+    self.processes = (process_t *) zmalloc (processes * sizeof (process_t));
+    size_t index;
+    for (index = 0; index < processes; index++) {
+        process_t *process = &self.processes [index];
+        snprintf (process->pid, sizeof (process->pid), "%016" PRIX64 "%016" PRIX64,
+                  s_random (&self), s_random (&self));
+        process->clock = (unsigned long *) zmalloc (processes * sizeof (unsigned long));
+        process->inbox = zlist_new ();
+        process->path = zsys_sprintf ("%s/vc_%s.log", directory, process->pid);
+        process->log = fopen (process->path, "w");
+        assert (process->log);
+    }
+
+    size_t line;
+    uint64_t bytes = 0;
+    for (line = 0; line < lines && (!max_bytes || bytes < max_bytes); line++)
+        bytes += s_loggen_step (&self, concurrency);
+
+    fclose (self.reference);
+    for (index = 0; index < processes; index++)
+        fclose (self.processes [index].log);
+
+    path = zsys_sprintf ("%s/combined.log", directory);
+    FILE *combined = fopen (path, "w");
+    assert (combined);
+    zstr_free (&path);
+    for (index = 0; index < processes; index++)
+        s_append_file (combined, self.processes [index].path);
+    fclose (combined);
+
+    printf ("{\"processes\": %zu, \"lines\": %zu, \"bytes\": %" PRIu64
+            ", \"concurrency\": %.2f, \"seed\": %" PRIu64 "}\n",
+            processes, line, bytes, concurrency, seed);
+
+    for (index = 0; index < processes; index++) {
+        process_t *process = &self.processes [index];
+        free (process->clock);
+        while (zlist_size (process->inbox) > 0)
+            free (zlist_pop (process->inbox));
+        zlist_destroy (&process->inbox);
+        zstr_free (&process->path);
+    }
+    free (self.processes);
+    free (self.line);
+    return 0;
+}
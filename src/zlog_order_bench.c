@@ -0,0 +1,253 @@
+/*  =========================================================================
+    zlog_order_bench - Benchmark of offline log ordering
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zlog_order_bench - Benchmark of offline log ordering
+@discuss
+    Orders the combined.log written by zlog_loggen with every ordering
+    engine and reports throughput, peak memory and correctness as JSON.
+    An order is correct if every line comes after all lines it causally
+    depends on, i.e. it is a topological order like the generator's
+    reference.log. Each engine runs in its own process so that its peak
+    RSS can be measured.
+
+    Engines with quadratic runtime are skipped for inputs larger than the
+    quadratic limit.
+@end
+*/
+
+#include "zlog_classes.h"
+#if defined (__UNIX__)
+#   include <sys/resource.h>
+#   include <sys/wait.h>
+#endif
+
+//  Orders the log of path_src into path_dst
+
+typedef void (order_fn) (const char *path_src, const char *path_dst);
+
+typedef struct {
+    const char *name;           //  Name of the engine
+    order_fn *order;            //  Orders a log file
+    bool quadratic;             //  Runtime is quadratic in the input size
+} engine_t;
+
+static void
+s_order_log_vc (const char *path_src, const char *path_dst)
+{
+    zlog_order_log (path_src, path_dst, (zlistx_comparator_fn *) zlog_compare_log_msg_vc);
+}
+
+static void
+s_order_log_ts (const char *path_src, const char *path_dst)
+{
+    zlog_order_log (path_src, path_dst, (zlistx_comparator_fn *) zlog_compare_log_msg_ts);
+}
+
+static engine_t s_engines [] = {
+    { "zlog_order_log_vc", s_order_log_vc, true },
+    { "zlog_order_log_ts", s_order_log_ts, true },
+    { NULL, NULL, false }
+};
+
+
+//  --------------------------------------------------------------------------
+//  Checks that the log at path is a topological order of the causal order.
+//  Returns the number of lines which precede one of their dependencies and
+//  stores the number of lines read in lines.
+
+static size_t
+s_check_order (const char *path, size_t *lines)
+{
+    FILE *file = fopen (path, "r");
+    if (!file) {
+        *lines = 0;
+        return 0;
+    }
+    //  Highest own clock value seen of each process, indexed by pid
+    zhashx_t *pids = zhashx_new ();
+    size_t seen_max = 64;
+    unsigned long *seen = (unsigned long *) zmalloc (seen_max * sizeof (unsigned long));
+    size_t violations = 0;
+    *lines = 0;
+
+    char *line = NULL;
+    size_t line_size = 0;
+    while (getline (&line, &line_size, file) > 0) {
+        (*lines)++;
+        char *needle = strstr (line, "/VC:");
+        char *own = needle? strstr (needle, ";own:"): NULL;
+        if (!own) {
+            violations++;
+            continue;
+        }
+        own += 5;
+        char *end = strchr (own, ';');
+        if (!end) {
+            violations++;
+            continue;
+        }
+        *end = 0;
+        char *own_pid = own;
+        bool violated = false;
+        unsigned long own_value = 0;
+        size_t own_index = 0;
+        needle = end + 1;
+        while (*needle && *needle != '/') {
+            char *comma = strchr (needle, ',');
+            if (!comma)
+                break;
+            *comma = 0;
+            char *value_end;
+            unsigned long value = strtoul (comma + 1, &value_end, 10);
+            size_t index = (size_t) (uintptr_t) zhashx_lookup (pids, needle);
+            if (!index) {
+                index = zhashx_size (pids) + 1;
+                zhashx_insert (pids, needle, (void *) (uintptr_t) index);
+                if (index >= seen_max) {
+                    seen = (unsigned long *) realloc (seen, seen_max * 2 * sizeof (unsigned long));
+                    memset (seen + seen_max, 0, seen_max * sizeof (unsigned long));
+                    seen_max *= 2;
+                }
+            }
+            if (streq (needle, own_pid)) {
+                own_index = index;
+                own_value = value;
+            }
+            else
+            if (value > seen [index])
+                violated = true;        //  Dependency not yet seen
+            needle = *value_end == ';'? value_end + 1: value_end;
+        }
+        if (!own_index || own_value <= seen [own_index])
+            violated = true;            //  Own predecessor came later
+        else
+            seen [own_index] = own_value;
+        if (violated)
+            violations++;
+    }
+    free (line);
+    free (seen);
+    zhashx_destroy (&pids);
+    fclose (file);
+    return violations;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Runs an engine and prints its JSON record
+
+static void
+s_bench_engine (engine_t *engine, const char *path_src, const char *path_dst,
+                size_t input_lines, bool first)
+{
+    int64_t start = zclock_usecs ();
+    long peak_rss = -1;
+#if defined (__UNIX__)
+    pid_t child = fork ();
+    assert (child >= 0);
+    if (child == 0) {
+        engine->order (path_src, path_dst);
+        _exit (0);
+    }
+    int status;
+    struct rusage usage;
+    wait4 (child, &status, 0, &usage);
+    peak_rss = usage.ru_maxrss;
+#else
+    engine->order (path_src, path_dst);
+#endif
+    int64_t elapsed = zclock_usecs () - start;
+
+    size_t lines;
+    size_t violations = s_check_order (path_dst, &lines);
+    printf ("%s    {\"engine\": \"%s\", \"elapsed_ms\": %.1f, \"lines_per_s\": %.1f, "
+            "\"peak_rss_kb\": %ld, \"lines\": %zu, \"violations\": %zu, \"correct\": %s}",
+            first? "": ",\n", engine->name, elapsed / 1000.0,
+            elapsed > 0? input_lines * 1000000.0 / elapsed: 0, peak_rss,
+            lines, violations, lines == input_lines && violations == 0? "true": "false");
+    zsys_file_delete (path_dst);
+}
+
+
+int main (int argc, char *argv [])
+{
+    const char *directory = "loggen";
+    const char *filter = NULL;
+    size_t quadratic_limit = 20000;
+    int argn;
+    for (argn = 1; argn < argc; argn++) {
+        if (streq (argv [argn], "--help")
+        ||  streq (argv [argn], "-h")) {
+            puts ("zlog_order_bench [options] ...");
+            puts ("  --input / -i dir       output directory of zlog_loggen (default loggen)");
+            puts ("  --engine / -e name     only run engines containing name");
+            puts ("  --quadratic / -q n     skip quadratic engines above n lines (default 20000)");
+            puts ("  --help / -h            this information");
+            return 0;
+        }
+        else
+        if ((streq (argv [argn], "--input")
+        ||   streq (argv [argn], "-i")) && argn + 1 < argc)
+            directory = argv [++argn];
+        else
+        if ((streq (argv [argn], "--engine")
+        ||   streq (argv [argn], "-e")) && argn + 1 < argc)
+            filter = argv [++argn];
+        else
+        if ((streq (argv [argn], "--quadratic")
+        ||   streq (argv [argn], "-q")) && argn + 1 < argc)
+            quadratic_limit = strtoul (argv [++argn], NULL, 10);
+        else {
+            printf ("Unknown option: %s\n", argv [argn]);
+            return 1;
+        }
+    }
+
+    char *path_src = zsys_sprintf ("%s/combined.log", directory);
+    char *path_ref = zsys_sprintf ("%s/reference.log", directory);
+    char *path_dst = zsys_sprintf ("%s/ordered.log", directory);
+    if (!zsys_file_exists (path_src)) {
+        printf ("No %s, run zlog_loggen first\n", path_src);
+        return 1;
+    }
+
+    //  The reference order validates the checker
+    size_t input_lines;
+    size_t reference_lines;
+    s_check_order (path_src, &input_lines);
+    size_t reference_violations = s_check_order (path_ref, &reference_lines);
+    if (reference_violations || reference_lines != input_lines) {
+        printf ("Reference order of %s is broken\n", directory);
+        return 1;
+    }
+
+    printf ("{\"input\": \"%s\", \"lines\": %zu, \"results\": [\n", path_src, input_lines);
+    bool first = true;
+    engine_t *engine;
+    for (engine = s_engines; engine->name; engine++) {
+        if (filter && !strstr (engine->name, filter))
+            continue;
+        if (engine->quadratic && input_lines > quadratic_limit)
+            continue;
+        s_bench_engine (engine, path_src, path_dst, input_lines, first);
+        first = false;
+        fflush (stdout);
+    }
+    printf ("\n]}\n");
+
+    zstr_free (&path_src);
+    zstr_free (&path_ref);
+    zstr_free (&path_dst);
+    return 0;
+}
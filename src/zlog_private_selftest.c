@@ -28,6 +28,12 @@
 void
 zlog_private_selftest (bool verbose)
 {
+// Tests for draft private classes:
+#ifdef ZLOG_BUILD_DRAFT_API
+    zlog_writer_test (verbose);
+    zlog_trace_test (verbose);
+    zlog_spool_test (verbose);
+#endif // ZLOG_BUILD_DRAFT_API
 }
 /*
 ################################################################################
@@ -34,6 +34,14 @@ all_tests [] = {
     { "zelection", zelection_test },
     { "selection", selection_test },
     { "zlog", zlog_test },
+    { "zmetrics", zmetrics_test },
+    { "zarena", zarena_test },
+    { "zhlc", zhlc_test },
+    { "zitc", zitc_test },
+    { "zdeps", zdeps_test },
+    { "zbloom", zbloom_test },
+    { "zbinlog", zbinlog_test },
+    { "zbatch", zbatch_test },
 #endif // ZLOG_BUILD_DRAFT_API
 #ifdef ZLOG_BUILD_DRAFT_API
     { "private_classes", zlog_private_selftest },
@@ -95,7 +103,7 @@ main (int argc, char **argv)
         else
         if (streq (argv [argn], "--number")
         ||  streq (argv [argn], "-n")) {
-            puts ("5");
+            puts ("13");
             return 0;
         }
         else
@@ -107,6 +115,14 @@ main (int argc, char **argv)
             puts ("    zelection\t\t- draft");
             puts ("    selection\t\t- draft");
             puts ("    zlog\t\t- draft");
+            puts ("    zmetrics\t\t- draft");
+            puts ("    zarena\t\t- draft");
+            puts ("    zhlc\t\t- draft");
+            puts ("    zitc\t\t- draft");
+            puts ("    zdeps\t\t- draft");
+            puts ("    zbloom\t\t- draft");
+            puts ("    zbinlog\t\t- draft");
+            puts ("    zbatch\t\t- draft");
             puts ("    private_classes\t- draft");
             return 0;
         }
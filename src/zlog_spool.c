@@ -0,0 +1,394 @@
+/*  =========================================================================
+    zlog_spool - Log record queue which spills to disk
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zlog_spool - Log record queue which spills to disk
+@discuss
+    A first in first out queue of log records. Records are kept in memory
+    until more than max_bytes are held, then all of them are written to a
+    new segment file. Records are popped from the oldest segment first, a
+    segment file is deleted as soon as it is drained. Records must not
+    contain newlines. If a segment can't be written its records stay in
+    memory, the next spill is tried once another max_bytes were appended.
+    Records of a segment which can't be read back are lost and no longer
+    counted.
+@end
+*/
+
+#include "zlog_classes.h"
+
+//  A segment file and what it still holds
+
+typedef struct {
+    char *path;                 //  Segment file name
+    size_t records;             //  Records not yet popped
+    uint64_t bytes;             //  Bytes not yet popped
+} segment_t;
+
+//  Structure of our class
+
+struct _zlog_spool_t {
+    char *path;                 //  Prefix of segment file names
+    size_t max_bytes;           //  Bytes held in memory before spilling
+    zlistx_t *records;          //  Records held in memory
+    size_t bytes;               //  Bytes held in memory
+    size_t spill_at;            //  Bytes held before the next spill is tried
+    zlist_t *segments;          //  Segment files, oldest first
+    unsigned int sequence;      //  Number of the next segment
+    FILE *reader;               //  Oldest segment while it is drained
+    char *line;                 //  Read buffer for segments
+    size_t line_size;           //  Size of read buffer
+    size_t size;                //  Number of records in the queue
+    uint64_t spilled;           //  Bytes in segments not yet popped
+};
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+static void
+s_segment_destroy (segment_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        segment_t *self = *self_p;
+        zsys_file_delete (self->path);
+        zstr_free (&self->path);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  Write all records held in memory to a new segment. They are only
+//  dropped from memory once the whole segment was written.
+
+static void
+s_zlog_spool_spill (zlog_spool_t *self)
+{
+    char *path = zsys_sprintf ("%s.%u", self->path, self->sequence++);
+    FILE *file = fopen (path, "w");
+    bool written = file != NULL;
+    const char *record = (const char *) zlistx_first (self->records);
+    while (written && record) {
+        if (fprintf (file, "%s\n", record) < 0)
+            written = false;
+        record = (const char *) zlistx_next (self->records);
+    }
+    if (file && fclose (file) != 0)
+        written = false;
+    if (!written) {
+        zsys_error ("zlog_spool: cannot write %s, keeping records in memory", path);
+        if (file)
+            zsys_file_delete (path);
+        zstr_free (&path);
+        self->spill_at = self->bytes + self->max_bytes;
+        return;
+    }
+    segment_t *segment = (segment_t *) zmalloc (sizeof (segment_t));
+    assert (segment);
+    segment->path = path;
+    segment->records = zlistx_size (self->records);
+    segment->bytes = self->bytes;
+    zlist_append (self->segments, segment);
+    zlistx_purge (self->records);
+    self->spilled += self->bytes;
+    self->bytes = 0;
+    self->spill_at = 0;
+}
+
+//  Remove the oldest record from the oldest segment. Returns NULL when all
+//  segments are drained.
+
+static char *
+s_zlog_spool_pop_segment (zlog_spool_t *self)
+{
+    while (zlist_size (self->segments) > 0) {
+        segment_t *segment = (segment_t *) zlist_first (self->segments);
+        if (!self->reader)
+            self->reader = fopen (segment->path, "r");
+        if (self->reader && segment->records > 0) {
+            ssize_t length = getline (&self->line, &self->line_size, self->reader);
+            if (length > 0) {
+                segment->records--;
+                segment->bytes -= length;
+                self->spilled -= length;
+                if (self->line [length - 1] == '\n')
+                    self->line [length - 1] = 0;
+                return strdup (self->line);
+            }
+        }
+        if (self->reader)
+            fclose (self->reader);
+        self->reader = NULL;
+        //  Whatever couldn't be read back is gone
+        if (segment->records > 0) {
+            zsys_error ("zlog_spool: cannot read %s, %zu records lost",
+                        segment->path, segment->records);
+            self->size -= segment->records;
+            self->spilled -= segment->bytes;
+        }
+        segment = (segment_t *) zlist_pop (self->segments);
+        s_segment_destroy (&segment);
+    }
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new zlog_spool. Segments are written to files named after path
+//  once more than max_bytes are held in memory. 0 never spills.
+
+zlog_spool_t *
+zlog_spool_new (const char *path, size_t max_bytes)
+{
+    assert (path);
+    zlog_spool_t *self = (zlog_spool_t *) zmalloc (sizeof (zlog_spool_t));
+    assert (self);
+    //  Initialize class properties here
+    self->path = strdup (path);
+    self->max_bytes = max_bytes;
+    self->records = zlistx_new ();
+    zlistx_set_destructor (self->records, (zlistx_destructor_fn *) zstr_free);
+    self->segments = zlist_new ();
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the zlog_spool and delete its segment files
+
+void
+zlog_spool_destroy (zlog_spool_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zlog_spool_t *self = *self_p;
+        //  Free class properties here
+        if (self->reader)
+            fclose (self->reader);
+        while (zlist_size (self->segments) > 0) {
+            segment_t *segment = (segment_t *) zlist_pop (self->segments);
+            s_segment_destroy (&segment);
+        }
+        zlist_destroy (&self->segments);
+        zlistx_destroy (&self->records);
+        free (self->line);
+        zstr_free (&self->path);
+        //  Free object itself
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Set the number of bytes held in memory before records are spilled
+
+void
+zlog_spool_set_max_bytes (zlog_spool_t *self, size_t max_bytes)
+{
+    assert (self);
+    self->max_bytes = max_bytes;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Append a record to the end of the queue. Takes ownership of the record.
+
+void
+zlog_spool_append (zlog_spool_t *self, char **record_p)
+{
+    assert (self);
+    assert (record_p && *record_p);
+    self->bytes += strlen (*record_p) + 1;
+    zlistx_add_end (self->records, *record_p);
+    *record_p = NULL;
+    self->size++;
+    if (self->max_bytes && self->bytes > self->max_bytes && self->bytes > self->spill_at)
+        s_zlog_spool_spill (self);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Remove the oldest record from the queue. Returns NULL if the queue is
+//  empty. Caller owns the record.
+
+char *
+zlog_spool_pop (zlog_spool_t *self)
+{
+    assert (self);
+    //  Records in memory are always newer than those in segments
+    char *record = s_zlog_spool_pop_segment (self);
+    if (!record) {
+        record = (char *) zlistx_detach (self->records, NULL);
+        if (record)
+            self->bytes -= strlen (record) + 1;
+    }
+    if (record)
+        self->size--;
+    return record;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the number of records in the queue
+
+size_t
+zlog_spool_size (zlog_spool_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the number of bytes held in memory
+
+size_t
+zlog_spool_bytes (zlog_spool_t *self)
+{
+    assert (self);
+    return self->bytes;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the number of bytes spilled to disk and not yet popped
+
+uint64_t
+zlog_spool_spilled (zlog_spool_t *self)
+{
+    assert (self);
+    return self->spilled;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+zlog_spool_test (bool verbose)
+{
+    printf (" * zlog_spool: ");
+
+    //  @selftest
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    zsys_dir_create (SELFTEST_DIR_RW);
+    char *path = zsys_sprintf ("%s/spool", SELFTEST_DIR_RW);
+
+    //  Without a limit nothing is spilled
+    zlog_spool_t *self = zlog_spool_new (path, 0);
+    assert (self);
+    assert (zlog_spool_pop (self) == NULL);
+    int index;
+    for (index = 0; index < 10; index++) {
+        char *record = zsys_sprintf ("record %d", index);
+        zlog_spool_append (self, &record);
+        assert (record == NULL);
+    }
+    assert (zlog_spool_size (self) == 10);
+    assert (zlog_spool_bytes (self) == 90);
+    assert (zlog_spool_spilled (self) == 0);
+    zlog_spool_destroy (&self);
+
+    //  Records beyond the limit are spilled and come back in order
+    self = zlog_spool_new (path, 20);
+    for (index = 0; index < 10; index++) {
+        char *record = zsys_sprintf ("record %d", index);
+        zlog_spool_append (self, &record);
+        assert (zlog_spool_bytes (self) <= 20);
+    }
+    assert (zlog_spool_size (self) == 10);
+    assert (zlog_spool_spilled (self) == 81);
+    char *segment = zsys_sprintf ("%s.0", path);
+    assert (zsys_file_exists (segment));
+
+    for (index = 0; index < 5; index++) {
+        char *record = zlog_spool_pop (self);
+        char *expected = zsys_sprintf ("record %d", index);
+        assert (streq (record, expected));
+        zstr_free (&expected);
+        zstr_free (&record);
+    }
+    //  Drained segments are deleted
+    assert (!zsys_file_exists (segment));
+    char *record = strdup ("record 10");
+    zlog_spool_append (self, &record);
+    for (index = 5; index <= 10; index++) {
+        record = zlog_spool_pop (self);
+        char *expected = zsys_sprintf ("record %d", index);
+        assert (streq (record, expected));
+        zstr_free (&expected);
+        zstr_free (&record);
+    }
+    assert (zlog_spool_pop (self) == NULL);
+    assert (zlog_spool_size (self) == 0);
+    assert (zlog_spool_spilled (self) == 0);
+
+    //  Pending segments are deleted on destruction
+    for (index = 0; index < 3; index++) {
+        record = zsys_sprintf ("record %d", index);
+        zlog_spool_append (self, &record);
+    }
+    zstr_free (&segment);
+    segment = zsys_sprintf ("%s.3", path);
+    assert (zsys_file_exists (segment));
+    zlog_spool_destroy (&self);
+    assert (!zsys_file_exists (segment));
+
+    //  Records of a segment which is gone are no longer counted
+    self = zlog_spool_new (path, 20);
+    for (index = 0; index < 4; index++) {
+        record = zsys_sprintf ("record %d", index);
+        zlog_spool_append (self, &record);
+    }
+    assert (zlog_spool_size (self) == 4);
+    zstr_free (&segment);
+    segment = zsys_sprintf ("%s.0", path);
+    assert (zsys_file_exists (segment));
+    zsys_file_delete (segment);
+    record = zlog_spool_pop (self);
+    assert (streq (record, "record 3"));
+    zstr_free (&record);
+    assert (zlog_spool_size (self) == 0);
+    assert (zlog_spool_spilled (self) == 0);
+    zlog_spool_destroy (&self);
+
+    //  Records which can't be spilled stay in memory
+    char *directory = zsys_sprintf ("%s.0", path);
+    zsys_dir_create (directory);
+    self = zlog_spool_new (path, 20);
+    for (index = 0; index < 3; index++) {
+        record = zsys_sprintf ("record %d", index);
+        zlog_spool_append (self, &record);
+    }
+    assert (zlog_spool_size (self) == 3);
+    assert (zlog_spool_bytes (self) == 27);
+    assert (zlog_spool_spilled (self) == 0);
+    for (index = 0; index < 3; index++) {
+        record = zlog_spool_pop (self);
+        char *expected = zsys_sprintf ("record %d", index);
+        assert (streq (record, expected));
+        zstr_free (&expected);
+        zstr_free (&record);
+    }
+    zlog_spool_destroy (&self);
+    zsys_dir_delete (directory);
+    zstr_free (&directory);
+
+    zstr_free (&segment);
+    zstr_free (&path);
+    //  @end
+
+    printf ("OK\n");
+}
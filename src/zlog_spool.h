@@ -0,0 +1,64 @@
+/*  =========================================================================
+    zlog_spool - Log record queue which spills to disk
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZLOG_SPOOL_H_INCLUDED
+#define ZLOG_SPOOL_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Create a new zlog_spool. Segments are written to files named after path
+//  once more than max_bytes are held in memory. 0 never spills.
+ZLOG_PRIVATE zlog_spool_t *
+    zlog_spool_new (const char *path, size_t max_bytes);
+
+//  Destroy the zlog_spool and delete its segment files
+ZLOG_PRIVATE void
+    zlog_spool_destroy (zlog_spool_t **self_p);
+
+//  Set the number of bytes held in memory before records are spilled
+ZLOG_PRIVATE void
+    zlog_spool_set_max_bytes (zlog_spool_t *self, size_t max_bytes);
+
+//  Append a record to the end of the queue. Takes ownership of the record.
+ZLOG_PRIVATE void
+    zlog_spool_append (zlog_spool_t *self, char **record_p);
+
+//  Remove the oldest record from the queue. Returns NULL if the queue is
+//  empty. Caller owns the record.
+ZLOG_PRIVATE char *
+    zlog_spool_pop (zlog_spool_t *self);
+
+//  Returns the number of records in the queue
+ZLOG_PRIVATE size_t
+    zlog_spool_size (zlog_spool_t *self);
+
+//  Returns the number of bytes held in memory
+ZLOG_PRIVATE size_t
+    zlog_spool_bytes (zlog_spool_t *self);
+
+//  Returns the number of bytes spilled to disk and not yet popped
+ZLOG_PRIVATE uint64_t
+    zlog_spool_spilled (zlog_spool_t *self);
+
+//  Self test of this class
+ZLOG_PRIVATE void
+    zlog_spool_test (bool verbose);
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
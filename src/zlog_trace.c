@@ -0,0 +1,231 @@
+/*  =========================================================================
+    zlog_trace - Low overhead tracing of hot paths
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zlog_trace - Low overhead tracing of hot paths
+@discuss
+    Build with ZLOG_TRACE defined (cmake -DENABLE_TRACE=ON or configure
+    --enable-trace) to compile the instrumentation points in. Every thread
+    records enter and exit events into its own ring, there is no locking.
+    Timestamps are taken from the time stamp counter on x86 and from the
+    monotonic clock elsewhere. They are converted to microseconds when the
+    ring is flushed. If a ring overflows, the oldest events are dropped.
+
+    The zlog actor flushes its ring on the "TRACE" pipe command. The
+    resulting file can be loaded in chrome://tracing or Perfetto.
+@end
+*/
+
+#include "zlog_classes.h"
+#if defined (__x86_64__) || defined (__i386__)
+#   if defined (_MSC_VER)
+#       include <intrin.h>
+#   else
+#       include <x86intrin.h>
+#   endif
+#   define ZLOG_TRACE_TSC
+#endif
+
+#if defined (_MSC_VER)
+#   define ZLOG_THREAD_LOCAL __declspec(thread)
+#else
+#   define ZLOG_THREAD_LOCAL __thread
+#endif
+
+#define ZLOG_TRACE_EVENTS 65536     //  Events per ring, a power of two
+
+typedef struct {
+    const char *name;           //  Name of the instrumentation point
+    uint64_t ticks;             //  Timestamp in ticks
+    char phase;                 //  'B' enter, 'E' exit
+} trace_event_t;
+
+typedef struct {
+    trace_event_t *events;      //  Ring of events
+    uint64_t next;              //  Number of events recorded
+    uint64_t start_ticks;       //  Ticks when the ring was created
+    int64_t start_nsecs;        //  Monotonic time when the ring was created
+} trace_ring_t;
+
+static ZLOG_THREAD_LOCAL trace_ring_t *s_ring = NULL;
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+static int64_t
+s_nsecs (void)
+{
+#if defined (__UNIX__)
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return zclock_usecs () * 1000;
+#endif
+}
+
+static inline uint64_t
+s_ticks (void)
+{
+#if defined (ZLOG_TRACE_TSC)
+    return __rdtsc ();
+#else
+    return (uint64_t) s_nsecs ();
+#endif
+}
+
+static trace_ring_t *
+s_ring_require (void)
+{
+    if (!s_ring) {
+        s_ring = (trace_ring_t *) zmalloc (sizeof (trace_ring_t));
+        assert (s_ring);
+        s_ring->events = (trace_event_t *) zmalloc (ZLOG_TRACE_EVENTS * sizeof (trace_event_t));
+        assert (s_ring->events);
+        s_ring->start_nsecs = s_nsecs ();
+        s_ring->start_ticks = s_ticks ();
+    }
+    return s_ring;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Record an enter ('B') or exit ('E') event of name in the ring of the
+//  calling thread. Use the ZLOG_TRACE_BEGIN and ZLOG_TRACE_END macros.
+
+void
+zlog_trace_record (const char *name, char phase)
+{
+    trace_ring_t *ring = s_ring? s_ring: s_ring_require ();
+    trace_event_t *event = &ring->events [ring->next & (ZLOG_TRACE_EVENTS - 1)];
+    event->ticks = s_ticks ();
+    event->name = name;
+    event->phase = phase;
+    ring->next++;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Write the events of the calling thread's ring to path in Chrome trace
+//  event format and empty the ring. Returns 0 on success, otherwise -1.
+
+int
+zlog_trace_flush (const char *path)
+{
+    assert (path);
+    trace_ring_t *ring = s_ring_require ();
+    FILE *file = fopen (path, "w");
+    if (!file)
+        return -1;
+
+    //  Calibrate ticks against the monotonic clock
+    double ticks_per_usec = 1000;
+#if defined (ZLOG_TRACE_TSC)
+    int64_t elapsed_nsecs = s_nsecs () - ring->start_nsecs;
+    uint64_t elapsed_ticks = s_ticks () - ring->start_ticks;
+    if (elapsed_nsecs > 0 && elapsed_ticks > 0)
+        ticks_per_usec = (double) elapsed_ticks * 1000 / elapsed_nsecs;
+#endif
+    int pid = 0;
+#if defined (__UNIX__)
+    pid = (int) getpid ();
+#endif
+    unsigned int tid = (unsigned int) (((uintptr_t) ring >> 4) & 0xffffff);
+
+    uint64_t first = ring->next > ZLOG_TRACE_EVENTS? ring->next - ZLOG_TRACE_EVENTS: 0;
+    uint64_t index;
+    fprintf (file, "{\"traceEvents\": [");
+    for (index = first; index < ring->next; index++) {
+        trace_event_t *event = &ring->events [index & (ZLOG_TRACE_EVENTS - 1)];
+        fprintf (file, "%s\n{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": %d, \"tid\": %u}",
+                 index == first? "": ",", event->name, event->phase,
+                 (double) (event->ticks - ring->start_ticks) / ticks_per_usec, pid, tid);
+    }
+    fprintf (file, "\n], \"displayTimeUnit\": \"ns\"}\n");
+    int rc = fclose (file) == 0? 0: -1;
+    ring->next = 0;
+    return rc;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Release the ring of the calling thread
+
+void
+zlog_trace_release (void)
+{
+    if (s_ring) {
+        free (s_ring->events);
+        free (s_ring);
+        s_ring = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+zlog_trace_test (bool verbose)
+{
+    printf (" * zlog_trace: ");
+
+    //  @selftest
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    zsys_dir_create (SELFTEST_DIR_RW);
+    char *path = zsys_sprintf ("%s/trace.json", SELFTEST_DIR_RW);
+
+    zlog_trace_record ("outer", 'B');
+    zlog_trace_record ("inner", 'B');
+    zlog_trace_record ("inner", 'E');
+    zlog_trace_record ("outer", 'E');
+    int rc = zlog_trace_flush (path);
+    assert (rc == 0);
+
+    zfile_t *file = zfile_new (NULL, path);
+    zfile_input (file);
+    const char *line = zfile_readln (file);
+    assert (streq (line, "{\"traceEvents\": ["));
+    line = zfile_readln (file);
+    assert (strstr (line, "\"name\": \"outer\", \"ph\": \"B\""));
+    int events = 1;
+    while ((line = zfile_readln (file)) && line [0] == '{')
+        events++;
+    assert (events == 4);
+    zfile_destroy (&file);
+
+    //  Flushing empties the ring, a full ring keeps the latest events
+    int index;
+    for (index = 0; index < ZLOG_TRACE_EVENTS + 2; index++)
+        zlog_trace_record (index < 2? "dropped": "kept", 'B');
+    rc = zlog_trace_flush (path);
+    assert (rc == 0);
+    file = zfile_new (NULL, path);
+    zfile_input (file);
+    events = 0;
+    while ((line = zfile_readln (file))) {
+        assert (!strstr (line, "dropped"));
+        if (strstr (line, "kept"))
+            events++;
+    }
+    assert (events == ZLOG_TRACE_EVENTS);
+    zfile_destroy (&file);
+
+    zlog_trace_release ();
+    zsys_file_delete (path);
+    zstr_free (&path);
+    //  @end
+
+    printf ("OK\n");
+}
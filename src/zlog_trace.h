@@ -0,0 +1,54 @@
+/*  =========================================================================
+    zlog_trace - Low overhead tracing of hot paths
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZLOG_TRACE_H_INCLUDED
+#define ZLOG_TRACE_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Instrumentation points are only compiled in if ZLOG_TRACE is defined,
+//  otherwise they expand to nothing. Names must be string literals.
+#if defined (ZLOG_TRACE)
+#   define ZLOG_TRACE_BEGIN(name) zlog_trace_record ((name), 'B')
+#   define ZLOG_TRACE_END(name) zlog_trace_record ((name), 'E')
+#else
+#   define ZLOG_TRACE_BEGIN(name)
+#   define ZLOG_TRACE_END(name)
+#endif
+
+//  @interface
+//  Record an enter ('B') or exit ('E') event of name in the ring of the
+//  calling thread. Use the ZLOG_TRACE_BEGIN and ZLOG_TRACE_END macros.
+ZLOG_PRIVATE void
+    zlog_trace_record (const char *name, char phase);
+
+//  Write the events of the calling thread's ring to path in Chrome trace
+//  event format and empty the ring. Returns 0 on success, otherwise -1.
+ZLOG_PRIVATE int
+    zlog_trace_flush (const char *path);
+
+//  Release the ring of the calling thread
+ZLOG_PRIVATE void
+    zlog_trace_release (void);
+
+//  Self test of this class
+ZLOG_PRIVATE void
+    zlog_trace_test (bool verbose);
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,417 @@
+/*  =========================================================================
+    zlog_writer - Asynchronous writer for the ordered log
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zlog_writer - Asynchronous writer for the ordered log
+@discuss
+    Writing the ordered log blocks on disk I/O which must not happen on the
+    zlog actor's event loop. The writer runs in its own thread and receives
+    the file over its pipe in two parts: stable entries, which never move
+    again and are appended to the stable prefix of the file, and a snapshot
+    of the tail, which replaces everything behind the stable prefix. The
+    zlog actor fills the next snapshot while the writer is busy with the
+    current one (double buffering). Writes which queue up while a write is
+    in progress are coalesced, stable entries are concatenated and only the
+    latest tail is written and synced to disk. A write which fails stays
+    pending and is retried with the next one. The first write replaces the
+    file of a previous run unless the writer resumes its stable prefix.
+@end
+*/
+
+#include "zlog_classes.h"
+
+//  Structure of our actor
+
+struct _zlog_writer_t {
+    zsock_t *pipe;              //  Actor command pipe
+    bool terminated;            //  Did caller ask us to quit?
+    char *path;                 //  Path of the file to write
+    zchunk_t *pending_stable;   //  Stable entries not yet written
+    zchunk_t *pending;          //  Latest tail snapshot not yet written
+    bool dirty;                 //  Is there anything to write?
+    uint64_t stable_size;       //  Size of the stable prefix on disk
+    size_t writes;              //  Number of snapshots written to disk
+    bool resumed;               //  Append to the file of a previous run?
+};
+
+typedef struct _zlog_writer_t zlog_writer_t;
+
+
+//  --------------------------------------------------------------------------
+//  Create a new zlog_writer instance
+
+static zlog_writer_t *
+zlog_writer_new (zsock_t *pipe, void *args)
+{
+    assert (args);
+    zlog_writer_t *self = (zlog_writer_t *) zmalloc (sizeof (zlog_writer_t));
+    assert (self);
+
+    self->pipe = pipe;
+    self->terminated = false;
+    self->path = strdup ((const char *) args);
+    self->pending_stable = NULL;
+    self->pending = NULL;
+    self->dirty = false;
+    self->stable_size = 0;
+    self->writes = 0;
+    self->resumed = false;
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Flush file to disk. Returns 0 on success, otherwise -1.
+
+static int
+s_zlog_writer_sync (FILE *file)
+{
+    if (fflush (file) != 0)
+        return -1;
+#if defined (__UNIX__)
+#   if defined (__linux__)
+    if (fdatasync (fileno (file)) != 0)
+        return -1;
+#   else
+    if (fsync (fileno (file)) != 0)
+        return -1;
+#   endif
+#endif
+    return 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Write the pending stable entries and tail to disk. Returns 0 on success,
+//  otherwise -1 and everything stays pending for the next flush.
+
+static int
+s_zlog_writer_flush (zlog_writer_t *self)
+{
+    assert (self);
+    if (!self->dirty)
+        return 0;
+
+    //  The first write replaces the file of a previous run unless it was
+    //  resumed, a file removed or rotated meanwhile is started anew with
+    //  what is pending. Both are written to a temporary file which is
+    //  renamed once it's complete.
+    FILE *file = NULL;
+    char *tmp_path = NULL;
+    bool replace = self->writes == 0 && !self->resumed;
+    if (!replace) {
+        file = fopen (self->path, "r+");
+        if (!file && errno == ENOENT)
+            replace = true;
+    }
+    if (replace) {
+        tmp_path = zsys_sprintf ("%s.tmp", self->path);
+        file = fopen (tmp_path, "w");
+    }
+    if (!file) {
+        zsys_error ("zlog_writer: cannot open %s", self->path);
+        zstr_free (&tmp_path);
+        return -1;
+    }
+    //  The stable prefix is never rewritten, only appended to. It's synced
+    //  before the tail behind it is replaced, a crash can only tear the tail.
+    uint64_t offset = replace? 0: self->stable_size;
+    size_t stable_size = self->pending_stable? zchunk_size (self->pending_stable): 0;
+    size_t tail_size = self->pending? zchunk_size (self->pending): 0;
+    int rc = fseeko (file, (off_t) offset, SEEK_SET) == 0? 0: -1;
+    if (rc == 0 && stable_size
+    &&  fwrite (zchunk_data (self->pending_stable), 1, stable_size, file) != stable_size)
+        rc = -1;
+    if (rc == 0 && stable_size && !replace)
+        rc = s_zlog_writer_sync (file);
+    if (rc == 0 && tail_size
+    &&  fwrite (zchunk_data (self->pending), 1, tail_size, file) != tail_size)
+        rc = -1;
+    if (rc == 0 && fflush (file) != 0)
+        rc = -1;
+#if defined (__UNIX__)
+    //  Cut off the rest of a longer previous tail
+    if (rc == 0 && ftruncate (fileno (file), (off_t) (offset + stable_size + tail_size)) != 0)
+        rc = -1;
+#endif
+    //  One sync for each batch of coalesced snapshots
+    if (rc == 0)
+        rc = s_zlog_writer_sync (file);
+    if (fclose (file) != 0)
+        rc = -1;
+    if (rc == 0 && replace && rename (tmp_path, self->path) != 0)
+        rc = -1;
+
+    if (rc == -1) {
+        zsys_error ("zlog_writer: cannot write %s", self->path);
+        if (replace)
+            zsys_file_delete (tmp_path);
+    }
+    else {
+        self->stable_size = offset + stable_size;
+        zchunk_destroy (&self->pending_stable);
+        zchunk_destroy (&self->pending);
+        self->dirty = false;
+        self->writes++;
+    }
+    zstr_free (&tmp_path);
+    return rc;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Keep the stable prefix of the file of a previous run, the next write
+//  appends to it and cuts off what follows
+
+static void
+s_zlog_writer_resume (zlog_writer_t *self, uint64_t stable_size)
+{
+    assert (self);
+    ssize_t size = zsys_file_size (self->path);
+    if (size < 0)
+        size = 0;
+    if ((uint64_t) size < stable_size) {
+        zsys_error ("zlog_writer: %s is shorter than its stable prefix", self->path);
+        stable_size = (uint64_t) size;
+    }
+    self->stable_size = stable_size;
+    self->resumed = true;
+    self->dirty = true;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the zlog_writer instance
+
+static void
+zlog_writer_destroy (zlog_writer_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zlog_writer_t *self = *self_p;
+        s_zlog_writer_flush (self);
+
+        //  Free actor properties
+        zstr_free (&self->path);
+
+        //  Free object itself
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  Pops a pointer frame sent with zsock_send's "p" picture
+
+static void *
+s_pop_pointer (zmsg_t *request)
+{
+    zframe_t *frame = zmsg_pop (request);
+    assert (frame && zframe_size (frame) == sizeof (void *));
+    void *pointer;
+    memcpy (&pointer, zframe_data (frame), sizeof (void *));
+    zframe_destroy (&frame);
+    return pointer;
+}
+
+
+//  Here we handle incoming message from the node
+
+static void
+s_zlog_writer_recv_api (zlog_writer_t *self)
+{
+    assert (self);
+
+    //  Get the whole message of the pipe in one go
+    zmsg_t *request = zmsg_recv (self->pipe);
+    if (!request) {
+        self->terminated = true;    //  Interrupted
+        return;
+    }
+
+    char *command = zmsg_popstr (request);
+    if (streq (command, "WRITE")) {
+        zchunk_t *stable = (zchunk_t *) s_pop_pointer (request);
+        zchunk_t *tail = (zchunk_t *) s_pop_pointer (request);
+        //  Stable entries add up, a newer tail replaces the pending one
+        if (stable && self->pending_stable) {
+            zchunk_extend (self->pending_stable, zchunk_data (stable), zchunk_size (stable));
+            zchunk_destroy (&stable);
+        }
+        else
+        if (stable)
+            self->pending_stable = stable;
+        zchunk_destroy (&self->pending);
+        self->pending = tail;
+        self->dirty = true;
+    }
+    else
+    if (streq (command, "RESUME")) {
+        char *stable_size = zmsg_popstr (request);
+        s_zlog_writer_resume (self, stable_size? strtoull (stable_size, NULL, 10): 0);
+        zstr_free (&stable_size);
+    }
+    else
+    if (streq (command, "SYNC")) {
+        int rc = s_zlog_writer_flush (self);
+        zsock_signal (self->pipe, rc == 0? 0: 1);
+    }
+    else
+    if (streq (command, "$TERM"))
+        //  The $TERM command is send by zactor_destroy() method
+        self->terminated = true;
+    else {
+        zsys_error ("invalid command '%s'", command);
+        assert (false);
+    }
+    zstr_free (&command);
+    zmsg_destroy (&request);
+}
+
+
+//  --------------------------------------------------------------------------
+//  This is the actor which runs in its own thread.
+
+void
+zlog_writer_actor (zsock_t *pipe, void *args)
+{
+    zlog_writer_t *self = zlog_writer_new (pipe, args);
+    if (!self)
+        return;          //  Interrupted
+
+    //  Signal actor successfully initiated
+    zsock_signal (self->pipe, 0);
+
+    while (!self->terminated) {
+        s_zlog_writer_recv_api (self);
+        //  Coalesce all snapshots that queued up in the meantime
+        while (!self->terminated && (zsock_events (self->pipe) & ZMQ_POLLIN))
+            s_zlog_writer_recv_api (self);
+
+        s_zlog_writer_flush (self);
+    }
+    zlog_writer_destroy (&self);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this actor.
+
+void
+zlog_writer_test (bool verbose)
+{
+    printf (" * zlog_writer: ");
+    if (verbose)
+        printf ("\n");
+
+    //  @selftest
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    zsys_dir_create (SELFTEST_DIR_RW);
+    char *path = zsys_sprintf ("%s/ordered_log", SELFTEST_DIR_RW);
+
+    zactor_t *zlog_writer = zactor_new (zlog_writer_actor, path);
+
+    //  All stable entries but only the latest tail survive
+    int index;
+    for (index = 0; index < 3; index++) {
+        char *content = zsys_sprintf ("stable %d\n", index);
+        zchunk_t *stable = zchunk_new (content, strlen (content));
+        zstr_free (&content);
+        content = zsys_sprintf ("snapshot %d\nsnapshot %d\n", index, index);
+        zchunk_t *tail = zchunk_new (content, strlen (content));
+        zstr_free (&content);
+        zsock_send (zlog_writer, "spp", "WRITE", stable, tail);
+    }
+    zstr_send (zlog_writer, "SYNC");
+    int rc = zsock_wait (zlog_writer);
+    assert (rc == 0);
+
+    zfile_t *file = zfile_new (NULL, path);
+    rc = zfile_input (file);
+    assert (rc == 0);
+    assert (streq (zfile_readln (file), "stable 0"));
+    assert (streq (zfile_readln (file), "stable 1"));
+    assert (streq (zfile_readln (file), "stable 2"));
+    assert (streq (zfile_readln (file), "snapshot 2"));
+    assert (streq (zfile_readln (file), "snapshot 2"));
+    assert (zfile_readln (file) == NULL);
+    zfile_destroy (&file);
+
+    //  A pending write is done on destruction, a shorter tail truncates
+    zchunk_t *stable = zchunk_new ("stable 3\n", 9);
+    zsock_send (zlog_writer, "spp", "WRITE", stable, NULL);
+    zactor_destroy (&zlog_writer);
+
+    file = zfile_new (NULL, path);
+    zfile_input (file);
+    assert (streq (zfile_readln (file), "stable 0"));
+    zfile_readln (file);
+    zfile_readln (file);
+    assert (streq (zfile_readln (file), "stable 3"));
+    assert (zfile_readln (file) == NULL);
+    zfile_destroy (&file);
+
+    //  A failed write keeps its entries for the next one, a removed file is
+    //  started anew
+    zlog_writer = zactor_new (zlog_writer_actor, path);
+    stable = zchunk_new ("stable 4\n", 9);
+    zsock_send (zlog_writer, "spp", "WRITE", stable, NULL);
+    zstr_send (zlog_writer, "SYNC");
+    rc = zsock_wait (zlog_writer);
+    assert (rc == 0);
+    zsys_file_delete (path);
+    zsys_dir_create (path);
+    stable = zchunk_new ("stable 5\n", 9);
+    zchunk_t *tail = zchunk_new ("snapshot 5\n", 11);
+    zsock_send (zlog_writer, "spp", "WRITE", stable, tail);
+    zstr_send (zlog_writer, "SYNC");
+    rc = zsock_wait (zlog_writer);
+    assert (rc == 1);
+    zsys_dir_delete (path);
+    zstr_send (zlog_writer, "SYNC");
+    rc = zsock_wait (zlog_writer);
+    assert (rc == 0);
+    zactor_destroy (&zlog_writer);
+
+    file = zfile_new (NULL, path);
+    zfile_input (file);
+    assert (streq (zfile_readln (file), "stable 5"));
+    assert (streq (zfile_readln (file), "snapshot 5"));
+    assert (zfile_readln (file) == NULL);
+    zfile_destroy (&file);
+
+    //  A resumed writer appends to the stable prefix of the previous run
+    zlog_writer = zactor_new (zlog_writer_actor, path);
+    zstr_sendx (zlog_writer, "RESUME", "9", NULL);
+    stable = zchunk_new ("stable 6\n", 9);
+    tail = zchunk_new ("snapshot 6\n", 11);
+    zsock_send (zlog_writer, "spp", "WRITE", stable, tail);
+    zstr_send (zlog_writer, "SYNC");
+    rc = zsock_wait (zlog_writer);
+    assert (rc == 0);
+    zactor_destroy (&zlog_writer);
+
+    file = zfile_new (NULL, path);
+    zfile_input (file);
+    assert (streq (zfile_readln (file), "stable 5"));
+    assert (streq (zfile_readln (file), "stable 6"));
+    assert (streq (zfile_readln (file), "snapshot 6"));
+    assert (zfile_readln (file) == NULL);
+    zfile_destroy (&file);
+
+    zsys_file_delete (path);
+    zstr_free (&path);
+    //  @end
+
+    printf ("OK\n");
+}
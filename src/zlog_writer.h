@@ -0,0 +1,62 @@
+/*  =========================================================================
+    zlog_writer - Asynchronous writer for the ordered log
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZLOG_WRITER_H_INCLUDED
+#define ZLOG_WRITER_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//  @interface
+//  Create new zlog_writer actor instance. The argument is the path of the
+//  file to write.
+//
+//      zactor_t *zlog_writer = zactor_new (zlog_writer_actor, "./ordered_log");
+//
+//  Destroy zlog_writer instance. A pending write is done first.
+//
+//      zactor_destroy (&zlog_writer);
+//
+//  Append stable entries to the stable prefix of the file and replace the
+//  rest of the file by a snapshot of the tail. The writer takes ownership
+//  of both chunks, either may be NULL. If several writes are pending their
+//  stable entries are concatenated and only the latest tail is written.
+//
+//      zsock_send (zlog_writer, "spp", "WRITE", stable, tail);
+//
+//  Keep the first stable_size bytes of the file of a previous run as the
+//  stable prefix. Writes append to it instead of replacing the file, the
+//  next one cuts off the rest. Send it before the first write.
+//
+//      zstr_sendx (zlog_writer, "RESUME", "1024", NULL);
+//
+//  Do the pending write and wait until it is on disk.
+//
+//      zstr_send (zlog_writer, "SYNC");
+//      zsock_wait (zlog_writer);
+//
+//  This is the zlog_writer constructor as a zactor_fn;
+ZLOG_PRIVATE void
+    zlog_writer_actor (zsock_t *pipe, void *args);
+
+//  Self test of this actor
+ZLOG_PRIVATE void
+    zlog_writer_test (bool verbose);
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
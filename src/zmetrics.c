@@ -0,0 +1,374 @@
+/*  =========================================================================
+    zmetrics - Counters, gauges and histograms
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of zlogger.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    zmetrics - Counters, gauges and histograms
+@discuss
+    Metrics are registered by name once and updated by the handle that
+    returns, the name is only looked up again to report the metrics. A
+    zmetrics instance belongs to the thread which updates it, i.e. to one
+    actor. Updates are plain increments without locks or atomics, others
+    query the metrics through the actor's pipe. Histograms keep one bucket per power
+    of two, percentiles are estimated by the upper bound of their bucket.
+@end
+*/
+
+#include "zlog_classes.h"
+
+#define ZMETRICS_BUCKETS 64
+
+typedef enum {
+    ZMETRICS_COUNTER,
+    ZMETRICS_GAUGE,
+    ZMETRICS_HISTOGRAM
+} metric_type_t;
+
+typedef struct {
+    metric_type_t type;
+    size_t handle;              //  Index in the metrics by handle
+    int64_t value;              //  Counter or gauge value, histogram sum
+    uint64_t count;             //  Number of observations
+    uint64_t min;               //  Smallest observation
+    uint64_t max;               //  Largest observation
+    uint64_t *buckets;          //  Observations per power of two
+} metric_t;
+
+//  Structure of our class
+
+struct _zmetrics_t {
+    zhashx_t *names;            //  Metrics by name, owns them
+    metric_t **metrics;         //  Metrics by handle
+    size_t size;                //  Number of metrics
+    size_t limit;               //  Allocated handles
+};
+
+
+//  --------------------------------------------------------------------------
+//  Local helper functions
+
+static void
+s_metric_destroy (metric_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        metric_t *self = *self_p;
+        free (self->buckets);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+static size_t
+s_zmetrics_register (zmetrics_t *self, const char *name, metric_type_t type)
+{
+    assert (self);
+    assert (name);
+    metric_t *metric = (metric_t *) zhashx_lookup (self->names, name);
+    if (!metric) {
+        metric = (metric_t *) zmalloc (sizeof (metric_t));
+        assert (metric);
+        metric->type = type;
+        if (type == ZMETRICS_HISTOGRAM)
+            metric->buckets = (uint64_t *) zmalloc (ZMETRICS_BUCKETS * sizeof (uint64_t));
+        if (self->size == self->limit) {
+            self->limit = self->limit? self->limit * 2: 16;
+            self->metrics = (metric_t **) realloc (self->metrics, self->limit * sizeof (metric_t *));
+            assert (self->metrics);
+        }
+        metric->handle = self->size;
+        self->metrics [self->size++] = metric;
+        zhashx_insert (self->names, name, metric);
+    }
+    assert (metric->type == type);
+    return metric->handle;
+}
+
+static metric_t *
+s_zmetrics_metric (zmetrics_t *self, size_t handle)
+{
+    assert (self);
+    assert (handle < self->size);
+    return self->metrics [handle];
+}
+
+//  Bucket 0 holds 0, bucket n holds values from 2^(n-1) to 2^n - 1
+
+static size_t
+s_bucket (uint64_t value)
+{
+    size_t bucket = 0;
+    while (value) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket < ZMETRICS_BUCKETS? bucket: ZMETRICS_BUCKETS - 1;
+}
+
+//  Estimates the percentile of a histogram by its bucket's upper bound
+
+static uint64_t
+s_percentile (metric_t *metric, double percentile)
+{
+    uint64_t rank = (uint64_t) (metric->count * percentile);
+    uint64_t seen = 0;
+    size_t bucket;
+    for (bucket = 0; bucket < ZMETRICS_BUCKETS; bucket++) {
+        seen += metric->buckets [bucket];
+        if (seen > rank) {
+            uint64_t upper = bucket? (((uint64_t) 1 << (bucket - 1)) << 1) - 1: 0;
+            return upper < metric->max? upper: metric->max;
+        }
+    }
+    return metric->max;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new zmetrics
+
+zmetrics_t *
+zmetrics_new (void)
+{
+    zmetrics_t *self = (zmetrics_t *) zmalloc (sizeof (zmetrics_t));
+    assert (self);
+    //  Initialize class properties here
+    self->names = zhashx_new ();
+    zhashx_set_destructor (self->names, (zhashx_destructor_fn *) s_metric_destroy);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the zmetrics
+
+void
+zmetrics_destroy (zmetrics_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zmetrics_t *self = *self_p;
+        //  Free class properties here
+        zhashx_destroy (&self->names);
+        free (self->metrics);
+        //  Free object itself
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the handle of the counter name, creating the counter at 0.
+//  Resolve handles once, updates by handle don't look up the name.
+
+size_t
+zmetrics_counter (zmetrics_t *self, const char *name)
+{
+    return s_zmetrics_register (self, name, ZMETRICS_COUNTER);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the handle of the gauge name, creating the gauge at 0
+
+size_t
+zmetrics_gauge (zmetrics_t *self, const char *name)
+{
+    return s_zmetrics_register (self, name, ZMETRICS_GAUGE);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the handle of the histogram name, creating the histogram empty.
+//  Its buckets are powers of two.
+
+size_t
+zmetrics_histogram (zmetrics_t *self, const char *name)
+{
+    return s_zmetrics_register (self, name, ZMETRICS_HISTOGRAM);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Add value to a counter
+
+void
+zmetrics_count (zmetrics_t *self, size_t metric, uint64_t value)
+{
+    metric_t *counter = s_zmetrics_metric (self, metric);
+    assert (counter->type == ZMETRICS_COUNTER);
+    counter->value += value;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Set a gauge to value
+
+void
+zmetrics_set (zmetrics_t *self, size_t metric, int64_t value)
+{
+    metric_t *gauge = s_zmetrics_metric (self, metric);
+    assert (gauge->type == ZMETRICS_GAUGE);
+    gauge->value = value;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Record value in a histogram
+
+void
+zmetrics_observe (zmetrics_t *self, size_t metric, uint64_t value)
+{
+    metric_t *histogram = s_zmetrics_metric (self, metric);
+    assert (histogram->type == ZMETRICS_HISTOGRAM);
+    if (histogram->count == 0 || value < histogram->min)
+        histogram->min = value;
+    if (value > histogram->max)
+        histogram->max = value;
+    histogram->count++;
+    histogram->value += value;
+    histogram->buckets [s_bucket (value)]++;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the value of a counter or gauge, or the sum of a histogram
+
+int64_t
+zmetrics_value (zmetrics_t *self, size_t metric)
+{
+    return s_zmetrics_metric (self, metric)->value;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the number of values recorded in a histogram
+
+uint64_t
+zmetrics_observations (zmetrics_t *self, size_t metric)
+{
+    return s_zmetrics_metric (self, metric)->count;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns all metrics as JSON object sorted by name. Histograms report
+//  count, sum, min, max and estimated percentiles. Caller owns the string.
+
+char *
+zmetrics_to_json (zmetrics_t *self)
+{
+    assert (self);
+    zlistx_t *names = zhashx_keys (self->names);
+    zlistx_set_comparator (names, (zlistx_comparator_fn *) strcmp);
+    zlistx_sort (names);
+
+    zchunk_t *json = zchunk_new (NULL, 256);
+    zchunk_extend (json, "{", 1);
+    const char *name = (const char *) zlistx_first (names);
+    while (name) {
+        metric_t *metric = (metric_t *) zhashx_lookup (self->names, name);
+        char *entry;
+        if (metric->type == ZMETRICS_HISTOGRAM)
+            entry = zsys_sprintf ("\"%s\": {\"count\": %" PRIu64 ", \"sum\": %" PRId64
+                                  ", \"min\": %" PRIu64 ", \"max\": %" PRIu64
+                                  ", \"p50\": %" PRIu64 ", \"p90\": %" PRIu64
+                                  ", \"p99\": %" PRIu64 "}",
+                                  name, metric->count, metric->value,
+                                  metric->min, metric->max,
+                                  s_percentile (metric, 0.5), s_percentile (metric, 0.9),
+                                  s_percentile (metric, 0.99));
+        else
+            entry = zsys_sprintf ("\"%s\": %" PRId64, name, metric->value);
+        zchunk_extend (json, entry, strlen (entry));
+        zstr_free (&entry);
+
+        name = (const char *) zlistx_next (names);
+        if (name)
+            zchunk_extend (json, ", ", 2);
+    }
+    zchunk_extend (json, "}", 2);    //  Including null terminator
+    zlistx_destroy (&names);
+
+    char *result = strdup ((const char *) zchunk_data (json));
+    zchunk_destroy (&json);
+    return result;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Print all metrics for debug purposes
+
+void
+zmetrics_print (zmetrics_t *self)
+{
+    assert (self);
+    char *json = zmetrics_to_json (self);
+    printf ("%s\n", json);
+    zstr_free (&json);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+zmetrics_test (bool verbose)
+{
+    printf (" * zmetrics: ");
+
+    //  @selftest
+    zmetrics_t *self = zmetrics_new ();
+    assert (self);
+
+    size_t sent = zmetrics_counter (self, "sent");
+    size_t size = zmetrics_gauge (self, "size");
+    size_t latency = zmetrics_histogram (self, "latency");
+    assert (zmetrics_counter (self, "sent") == sent);
+    assert (size != sent);
+
+    zmetrics_count (self, sent, 1);
+    zmetrics_count (self, sent, 2);
+    assert (zmetrics_value (self, sent) == 3);
+
+    assert (zmetrics_value (self, size) == 0);
+    zmetrics_set (self, size, 10);
+    zmetrics_set (self, size, 7);
+    assert (zmetrics_value (self, size) == 7);
+
+    uint64_t value;
+    for (value = 1; value <= 100; value++)
+        zmetrics_observe (self, latency, value);
+    assert (zmetrics_observations (self, latency) == 100);
+    assert (zmetrics_value (self, latency) == 5050);
+
+    char *json = zmetrics_to_json (self);
+    if (verbose)
+        printf ("%s\n", json);
+    assert (streq (json, "{\"latency\": {\"count\": 100, \"sum\": 5050, \"min\": 1, "
+                         "\"max\": 100, \"p50\": 63, \"p90\": 100, \"p99\": 100}, "
+                         "\"sent\": 3, \"size\": 7}"));
+    zstr_free (&json);
+
+    zmetrics_destroy (&self);
+
+    //  An empty instance is an empty object
+    self = zmetrics_new ();
+    json = zmetrics_to_json (self);
+    assert (streq (json, "{}"));
+    zstr_free (&json);
+    zmetrics_destroy (&self);
+    //  @end
+
+    printf ("OK\n");
+}
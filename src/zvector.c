@@ -19,16 +19,55 @@
 
 #include "zlog_classes.h"
 
+//  Records of the space-time diagram, they are formatted when dumped. A
+//  state is identified by its process and own counter. Processes are
+//  interned as indexes into pid_names, the own process is 0.
+
+typedef struct {
+    size_t sender;              //  Interned pid of the sender
+    unsigned long sender_counter;   //  Sender's state when sending
+    unsigned long counter;      //  Own state when receiving
+} space_time_event_t;
+
+typedef struct {
+    unsigned long counter;      //  Own state
+    char *label;                //  Log message of the state
+} space_time_label_t;
+
 //  Structure of our class
 
 struct _zvector_t {
     char *own_pid;
     zhashx_t *clock;
-    zhash_t *space_time_states_label;
-    zlist_t *space_time_states;
-    zlist_t *space_time_events;
+    zhashx_t *pid_indexes;      //  Interned pids, index + 1 by pid
+    char **pid_names;           //  Interned pids by index
+    size_t pid_names_size;
+    size_t pid_names_max;
+    unsigned long *states;      //  Own counters in order of events
+    size_t states_size;
+    size_t states_max;
+    space_time_event_t *events; //  Received messages
+    size_t events_size;
+    size_t events_max;
+    space_time_label_t *labels; //  Labeled states
+    size_t labels_size;
+    size_t labels_max;
+    zarena_t *arena;            //  Transient strings, not owned
+    zhashx_t *retired;          //  Final counter by pruned pid
+    bool direct;                //  Track direct dependencies only
+    size_t events_logged;       //  Events already listed in a log record
+    char *cache;                //  Serialized clock, own entry last
+    size_t cache_size;          //  Length of the serialized clock
+    size_t cache_max;           //  Bytes allocated for the cache
+    size_t cache_own;           //  Offset of the own entry
+    bool cache_valid;           //  False once another pid's value changed
+    uint64_t generation;        //  Counts changes of other pids' values
 };
 
+//  Pruned pids remembered to ignore stale values still in flight. Beyond
+//  this number the memory is cleared, a stale value then re-adds its pid.
+#define ZVECTOR_RETIRED_MAX 4096
+
 
 //  --------------------------------------------------------------------------
 //  Local helper functions
@@ -43,6 +82,227 @@ s_destroy_clock_value (void **clock_value_p)
     }
 }
 
+//  Returns a free slot at the end of a growable array
+
+static void *
+s_array_append (void **array, size_t *size, size_t *max, size_t item_size)
+{
+    if (*size == *max) {
+        *max = *max? *max * 2: 16;
+        *array = realloc (*array, *max * item_size);
+        assert (*array);
+    }
+    return (char *) *array + (*size)++ * item_size;
+}
+
+//  Returns the interned index of pid, interning it on first use
+
+static size_t
+s_zvector_intern (zvector_t *self, const char *pid)
+{
+    if (!self->pid_indexes)
+        self->pid_indexes = zhashx_new ();
+    size_t index = (size_t) (uintptr_t) zhashx_lookup (self->pid_indexes, pid);
+    if (index)
+        return index - 1;
+    char **name = (char **) s_array_append ((void **) &self->pid_names, &self->pid_names_size,
+                                            &self->pid_names_max, sizeof (char *));
+    *name = strdup (pid);
+    zhashx_insert (self->pid_indexes, pid, (void *) (uintptr_t) self->pid_names_size);
+    return self->pid_names_size - 1;
+}
+
+//  Transient strings are taken from the arena if there is one, then they
+//  must not be freed
+
+static char *
+s_strndup (zarena_t *arena, const char *string, size_t size)
+{
+    return arena? zarena_strndup (arena, string, size): strndup (string, size);
+}
+
+static void
+s_str_free (zarena_t *arena, char **string_p)
+{
+    if (arena)
+        *string_p = NULL;
+    else
+        zstr_free (string_p);
+}
+
+//  Converts the zvector into string representation, pids are cut after
+//  pid_length characters unless pid_length is 0.
+//  formation: 'VC:$numberOfClocks;own:$ownPid;$pid1,$val1;...;$pidx,$valx;\0'
+
+static char *
+s_zvector_format (zvector_t *self, size_t pid_length, zarena_t *arena)
+{
+    //  Negative precision prints pids in full
+    int precision = pid_length? (int) pid_length: -1;
+    size_t size = strlen ("VC:;own:;") + 20 + strlen (self->own_pid) + 1;
+    unsigned long *value = (unsigned long *) zhashx_first (self->clock);
+    while (value) {
+        //  Separators and up to 20 digits per value
+        size += strlen ((const char *) zhashx_cursor (self->clock)) + 22;
+        value = (unsigned long *) zhashx_next (self->clock);
+    }
+    char *result = arena? (char *) zarena_alloc (arena, size): (char *) zmalloc (size);
+
+    char *needle = result;
+    needle += sprintf (needle, "VC:%zu;own:%.*s;",
+                       zhashx_size (self->clock), precision, self->own_pid);
+    value = (unsigned long *) zhashx_first (self->clock);
+    while (value) {
+        needle += sprintf (needle, "%.*s,%lu;",
+                           precision, (const char *) zhashx_cursor (self->clock), *value);
+        value = (unsigned long *) zhashx_next (self->clock);
+    }
+    return result;
+}
+
+//  Returns the serialized clock from the cache. Other pids' values only
+//  change on receive, so the cache is rebuilt then. Events of the own pid
+//  patch its entry, which comes last for that. The string is valid until
+//  the clock changes.
+
+static const char *
+s_zvector_serialized (zvector_t *self, size_t *size)
+{
+    unsigned long *own_value = (unsigned long *) zhashx_lookup (self->clock, self->own_pid);
+    if (!self->cache_valid) {
+        size_t max = strlen ("VC:;own:;") + 20 + strlen (self->own_pid) + 1;
+        unsigned long *value = (unsigned long *) zhashx_first (self->clock);
+        while (value) {
+            max += strlen ((const char *) zhashx_cursor (self->clock)) + 22;
+            value = (unsigned long *) zhashx_next (self->clock);
+        }
+        if (max > self->cache_max) {
+            free (self->cache);
+            self->cache = (char *) malloc (max);
+            assert (self->cache);
+            self->cache_max = max;
+        }
+        char *needle = self->cache;
+        needle += sprintf (needle, "VC:%zu;own:%s;", zhashx_size (self->clock), self->own_pid);
+        value = (unsigned long *) zhashx_first (self->clock);
+        while (value) {
+            if (value != own_value)
+                needle += sprintf (needle, "%s,%lu;", (const char *) zhashx_cursor (self->clock), *value);
+            value = (unsigned long *) zhashx_next (self->clock);
+        }
+        self->cache_own = needle - self->cache;
+        self->cache_size = self->cache_own;
+        self->cache_valid = true;
+    }
+    //  The room for the own entry was reserved when rebuilding
+    if (own_value)
+        self->cache_size = self->cache_own
+                         + sprintf (self->cache + self->cache_own, "%s,%lu;", self->own_pid, *own_value);
+    *size = self->cache_size;
+    return self->cache;
+}
+
+//  Formats a direct dependency record: the own state and every message
+//  received since the last record as sender, sender's state and own state.
+//  formation: 'DD:own:$ownPid,$val;$pid1,$val1,$own1;...;$pidx,$valx,$ownx;\0'
+
+static char *
+s_zvector_format_direct (zvector_t *self, zarena_t *arena)
+{
+    size_t size = strlen ("DD:own:,;") + 20 + strlen (self->own_pid) + 1;
+    size_t index;
+    for (index = self->events_logged; index < self->events_size; index++)
+        size += strlen (self->pid_names [self->events [index].sender]) + 43;
+    char *result = arena? (char *) zarena_alloc (arena, size): (char *) zmalloc (size);
+
+    char *needle = result;
+    needle += sprintf (needle, "DD:own:%s,%lu;", self->own_pid,
+                       zvector_value (self, self->own_pid));
+    for (index = self->events_logged; index < self->events_size; index++) {
+        space_time_event_t *event = &self->events [index];
+        needle += sprintf (needle, "%s,%lu,%lu;", self->pid_names [event->sender],
+                           event->sender_counter, event->counter);
+    }
+    self->events_logged = self->events_size;
+    return result;
+}
+
+//  Handles a direct dependency of a received message, only the sender's
+//  state is recorded.
+//  formation: 'DD:$pid,$val;\0'
+
+static void
+s_zvector_recv_direct (zvector_t *self, const char *clock_string)
+{
+    const char *pid = clock_string + 3;
+    const char *comma = strrchr (pid, ',');
+    zvector_event (self);
+    if (!comma || comma == pid)
+        return;                 //  Malformed, counts as local event
+    char *sender = s_strndup (self->arena, pid, comma - pid);
+    space_time_event_t *event = (space_time_event_t *) s_array_append (
+        (void **) &self->events, &self->events_size, &self->events_max, sizeof (space_time_event_t));
+    event->sender = s_zvector_intern (self, sender);
+    event->sender_counter = strtoul (comma + 1, NULL, 10);
+    event->counter = self->states [self->states_size - 1];
+    s_str_free (self->arena, &sender);
+}
+
+//  Parses an unsigned decimal value between needle and end. Returns a
+//  pointer past the digits or NULL if there are none or it overflows.
+
+static const char *
+s_parse_value (const char *needle, const char *end, unsigned long *value)
+{
+    const char *start = needle;
+    *value = 0;
+    while (needle < end && *needle >= '0' && *needle <= '9') {
+        unsigned long digit = *needle - '0';
+        if (*value > (ULONG_MAX - digit) / 10)
+            return NULL;
+        *value = *value * 10 + digit;
+        needle++;
+    }
+    return needle > start? needle: NULL;
+}
+
+//  Returns the entry of pid, NULL if there is none
+
+static zvector_entry_t *
+s_entries_lookup (zvector_entry_t *entries, size_t size, const char *pid, size_t pid_size)
+{
+    size_t index;
+    for (index = 0; index < size; index++)
+        if (entries [index].pid_size == pid_size
+        &&  memcmp (entries [index].pid, pid, pid_size) == 0)
+            return &entries [index];
+    return NULL;
+}
+
+//  Copies the pid of an entry into buffer, or into a fresh string if it
+//  doesn't fit. The copy is freed with s_pid_free.
+
+static char *
+s_pid_copy (zvector_entry_t *entry, char *buffer, size_t buffer_size, zarena_t *arena)
+{
+    if (entry->pid_size >= buffer_size)
+        return s_strndup (arena, entry->pid, entry->pid_size);
+    memcpy (buffer, entry->pid, entry->pid_size);
+    buffer [entry->pid_size] = 0;
+    return buffer;
+}
+
+static void
+s_pid_free (char **pid_p, char *buffer, zarena_t *arena)
+{
+    if (*pid_p != buffer)
+        s_str_free (arena, pid_p);
+    *pid_p = NULL;
+}
+
+//  Number of entries parsed on the stack before falling back to the heap
+#define ZVECTOR_PARSE_ENTRIES 64
+
 
 //  --------------------------------------------------------------------------
 //  Create a new zvector
@@ -60,9 +320,6 @@ zvector_new (const char *pid)
     unsigned long *clock_val = (unsigned long *) zmalloc (sizeof (unsigned long));
     *clock_val = 0;
     zhashx_insert (self->clock, pid, clock_val);
-    self->space_time_states_label = zhash_new ();
-    self->space_time_states = zlist_new ();
-    self->space_time_events = zlist_new ();
     return self;
 }
 
@@ -79,12 +336,18 @@ zvector_destroy (zvector_t **self_p)
         //  Free class properties here
         zstr_free (&self->own_pid);
         zhashx_destroy (&self->clock);
-        zhash_autofree (self->space_time_states_label);
-        zhash_destroy (&self->space_time_states_label);
-        zlist_autofree (self->space_time_states);
-        zlist_destroy (&self->space_time_states);
-        zlist_autofree (self->space_time_events);
-        zlist_destroy (&self->space_time_events);
+        zhashx_destroy (&self->pid_indexes);
+        zhashx_destroy (&self->retired);
+        size_t index;
+        for (index = 0; index < self->pid_names_size; index++)
+            free (self->pid_names [index]);
+        free (self->pid_names);
+        free (self->states);
+        free (self->events);
+        for (index = 0; index < self->labels_size; index++)
+            free (self->labels [index].label);
+        free (self->labels);
+        free (self->cache);
         //  Free object itself
         free (self);
         *self_p = NULL;
@@ -92,6 +355,33 @@ zvector_destroy (zvector_t **self_p)
 }
 
 
+//  --------------------------------------------------------------------------
+//  Take transient strings from arena instead of the heap. The caller owns
+//  the arena and resets it after strings returned by this class are freed.
+
+void
+zvector_set_arena (zvector_t *self, zarena_t *arena)
+{
+    assert (self);
+    self->arena = arena;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Track direct dependencies only. Sent messages carry the own pid and
+//  counter instead of the whole clock and log records list the messages
+//  received since the previous record. The full clocks are rebuilt from
+//  the records by zdeps. Received whole clocks are still merged.
+
+void
+zvector_set_direct (zvector_t *self, bool direct)
+{
+    assert (self);
+    self->direct = direct;
+    self->events_logged = self->events_size;
+}
+
+
 //  --------------------------------------------------------------------------
 //  Event the zvector
 
@@ -102,7 +392,9 @@ zvector_event (zvector_t *self)
     unsigned long *own_clock_value = (unsigned long *) zhashx_lookup (self->clock, self->own_pid);
     (*own_clock_value)++;
 
-    zlist_append (self->space_time_states, zvector_to_string_short (self, 3));
+    unsigned long *state = (unsigned long *) s_array_append ((void **) &self->states, &self->states_size,
+                                                             &self->states_max, sizeof (unsigned long));
+    *state = *own_clock_value;
 }
 
 
@@ -116,9 +408,16 @@ zvector_send_prepare (zvector_t *self, zmsg_t *msg)
     assert (msg);
 
     zvector_event (self);
-    char *clock_string = zvector_to_string (self);
-    zmsg_pushstr (msg, clock_string);
-    zstr_free (&clock_string);
+    if (self->direct) {
+        char *clock_string = zsys_sprintf ("DD:%s,%lu;", self->own_pid,
+                                           zvector_value (self, self->own_pid));
+        zmsg_pushstr (msg, clock_string);
+        zstr_free (&clock_string);
+        return msg;
+    }
+    size_t size;
+    const char *clock_string = s_zvector_serialized (self, &size);
+    zmsg_pushmem (msg, clock_string, size);
     return msg;
 }
 
@@ -131,43 +430,81 @@ zvector_recv (zvector_t *self, zmsg_t *msg)
 {
     assert (self);
     assert (msg);
-
-    char *clock_string = zmsg_popstr (msg);
-    zvector_t *sender_vector = zvector_from_string (clock_string);
-    zstr_free (&clock_string);
-
-    zhashx_t *sender_clock = sender_vector->clock;
+    ZLOG_TRACE_BEGIN ("zvector_recv");
+
+    zframe_t *frame = zmsg_pop (msg);
+    assert (frame);
+    const char *clock_string = (const char *) zframe_data (frame);
+    size_t clock_size = zframe_size (frame);
+    if (clock_size > 3 && memcmp (clock_string, "DD:", 3) == 0) {
+        char *direct_string = s_strndup (self->arena, clock_string, clock_size);
+        s_zvector_recv_direct (self, direct_string);
+        s_str_free (self->arena, &direct_string);
+        zframe_destroy (&frame);
+        ZLOG_TRACE_END ("zvector_recv");
+        return;
+    }
+    //  The clock is parsed in place, only pids new to us are copied
+    zvector_entry_t own;
+    zvector_entry_t entries_buffer [ZVECTOR_PARSE_ENTRIES];
+    zvector_entry_t *entries = entries_buffer;
+    int size = zvector_parse (clock_string, clock_size, &own, entries, ZVECTOR_PARSE_ENTRIES);
+    if (size > ZVECTOR_PARSE_ENTRIES) {
+        entries = (zvector_entry_t *) (self->arena?
+            zarena_alloc (self->arena, size * sizeof (zvector_entry_t)):
+            malloc (size * sizeof (zvector_entry_t)));
+        assert (entries);
+        zvector_parse (clock_string, clock_size, &own, entries, size);
+    }
 
     zvector_event (self);
-    char *self_clock_string = zvector_to_string_short (self, 3);
-    clock_string = zvector_to_string_short (sender_vector, 3);
-    zlist_append (self->space_time_events, zsys_sprintf ("\"%s\" -> \"%s\"\n",
-                                                         clock_string, self_clock_string));
-    zstr_free (&clock_string);
-    zstr_free (&self_clock_string);
-
-    zlistx_t *sender_clock_procs = zhashx_keys (sender_clock);
-    const char *pid = (const char *) zlistx_first (sender_clock_procs);
-    while (pid) {
-        if (zhashx_lookup (self->clock, pid)) {
-            unsigned long *own_pid_clock_value = (unsigned long *) zhashx_lookup (self->clock, pid);
-            unsigned long *sender_pid_clock_value = (unsigned long *) zhashx_lookup (sender_clock, pid);
-
-            if ( (*sender_pid_clock_value) > (*own_pid_clock_value) )
-                 (*own_pid_clock_value) = (*sender_pid_clock_value);
+    if (size < 0) {
+        //  Malformed, counts as local event
+        zframe_destroy (&frame);
+        ZLOG_TRACE_END ("zvector_recv");
+        return;
+    }
+    char buffer [256];
+    char *pid = s_pid_copy (&own, buffer, sizeof (buffer), self->arena);
+    space_time_event_t *event = (space_time_event_t *) s_array_append (
+        (void **) &self->events, &self->events_size, &self->events_max, sizeof (space_time_event_t));
+    event->sender = s_zvector_intern (self, pid);
+    event->sender_counter = own.value;
+    event->counter = self->states [self->states_size - 1];
+    s_pid_free (&pid, buffer, self->arena);
+
+    int index;
+    for (index = 0; index < size; index++) {
+        pid = s_pid_copy (&entries [index], buffer, sizeof (buffer), self->arena);
+        unsigned long sender_pid_clock_value = entries [index].value;
+        unsigned long *own_pid_clock_value = (unsigned long *) zhashx_lookup (self->clock, pid);
+        unsigned long *final = self->retired?
+            (unsigned long *) zhashx_lookup (self->retired, pid): NULL;
+        if (final && sender_pid_clock_value <= *final) {
+            //  Pruned pid, the value is stale
+        }
+        else
+        if (own_pid_clock_value) {
+            if (sender_pid_clock_value > *own_pid_clock_value) {
+                *own_pid_clock_value = sender_pid_clock_value;
+                self->cache_valid = false;
+                self->generation++;
+            }
         }
-        else{
-            unsigned long *sender_pid_clock_value = (unsigned long *) zhashx_lookup (sender_clock, pid);
-            unsigned long *own_pid_clock_value = (unsigned long *) zmalloc (sizeof (unsigned long));
-            (*own_pid_clock_value) = (*sender_pid_clock_value);
+        else {
+            own_pid_clock_value = (unsigned long *) zmalloc (sizeof (unsigned long));
+            *own_pid_clock_value = sender_pid_clock_value;
             zhashx_insert (self->clock, pid, own_pid_clock_value);
+            self->cache_valid = false;
+            self->generation++;
         }
-
-        pid = (const char*) zlistx_next (sender_clock_procs);
+        s_pid_free (&pid, buffer, self->arena);
     }
 
-    zlistx_destroy (&sender_clock_procs);
-    zvector_destroy (&sender_vector);
+    if (entries != entries_buffer && !self->arena)
+        free (entries);
+    zframe_destroy (&frame);
+    ZLOG_TRACE_END ("zvector_recv");
 }
 
 
@@ -177,72 +514,13 @@ zvector_recv (zvector_t *self, zmsg_t *msg)
 char *
 zvector_to_string (zvector_t *self)
 {
-  assert (self);
-
-  //formation: 'VC:$numberOfClocks;own:$ownPid;$pid1,$val1;...;$pidx,$valx;\0'
-  char *result = NULL;
-  int string_length = 10;
-  unsigned long tmp_val_length = 0;
-
-  int vector_size = zhashx_size (self->clock);
-
-  // calculate needed chars for allocation
-  string_length += strlen(self->own_pid);
-
-  // digits needed for numberOfClocks
-  tmp_val_length = vector_size;
-  while (tmp_val_length) {
-      tmp_val_length /= 10;
-      string_length += 1;
-  }
-
-  // chars needed for seperators
-  string_length += (vector_size * 2);
-  unsigned long *value = (unsigned long *) zhashx_first (self->clock);
-  const char *pid = (const char *) zhashx_cursor (self->clock);
-  tmp_val_length = *value;
-
-  while (value) {
-
-    string_length += strlen (pid);
-
-    // calc digits of clock_value
-    while (tmp_val_length) {
-        tmp_val_length /= 10;
-        string_length += 1;
-    }
-
-    value = (unsigned long *) zhashx_next (self->clock);
-    pid = (const char*) zhashx_cursor (self->clock);
-
-    if (value)
-      tmp_val_length = *value;
-  }
-
-  result = (char *) zmalloc (string_length * sizeof (char));
-
-  // fill up string
-  value = (unsigned long *) zhashx_first (self->clock);
-  pid = (const char *) zhashx_cursor (self->clock);
-  char tmp_string[11]; // max digits of an unsigned long value
-  tmp_string[10] = '\0';
-
-  sprintf(result, "VC:%d;", vector_size);
-  strcat(result, "own:");
-  strcat(result, self->own_pid);
-  strcat(result, ";");
-  while (value) {
-    strcat (result, pid);
-    strcat (result, ",");
-    sprintf(tmp_string, "%lu", *value);
-    strcat (result, tmp_string);
-    strcat (result, ";");
-
-    value = (unsigned long *) zhashx_next (self->clock);
-    pid = (const char *) zhashx_cursor (self->clock);
-  }
-
-  return result;
+    assert (self);
+    size_t size;
+    const char *serialized = s_zvector_serialized (self, &size);
+    char *result = (char *) malloc (size + 1);
+    assert (result);
+    memcpy (result, serialized, size + 1);
+    return result;
 }
 
 
@@ -252,145 +530,169 @@ zvector_to_string (zvector_t *self)
 char *
 zvector_to_string_short (zvector_t *self, uint8_t pid_length)
 {
-  assert (self);
-
-  //formation: 'VC:$numberOfClocks;own:$ownPid;$pid1,$val1;...;$pidx,$valx;\0'
-  char *result = NULL;
-  int string_length = 10;
-  unsigned long tmp_val_length = 0;
-
-  int vector_size = zhashx_size (self->clock);
-
-  // calculate needed chars for allocation
-  // own pid
-  string_length += pid_length;
-
-  // digits needed for numberOfClocks
-  tmp_val_length = vector_size;
-  while (tmp_val_length) {
-      tmp_val_length /= 10;
-      string_length += 1;
-  }
-
-  // chars needed for seperators
-  string_length += (vector_size * 2);
-  unsigned long *value = (unsigned long *) zhashx_first (self->clock);
-  const char *pid = (const char *) zhashx_cursor (self->clock);
-  tmp_val_length = *value;
+    assert (self);
+    return s_zvector_format (self, pid_length, NULL);
+}
 
-  while (value) {
 
-    string_length += pid_length;
+//  --------------------------------------------------------------------------
+//  Parses a string representation without allocating. The clock ends at
+//  size, a null or a '/', so it can be parsed inside a log line. Pids point
+//  into clock_string and are not terminated. Writes the own pid and value
+//  into own and at most entries_max entries into entries. Returns the
+//  number of entries of the clock, which may exceed entries_max, or -1 if
+//  it is malformed.
 
-    // calc digits of clock_value
-    while (tmp_val_length) {
-        tmp_val_length /= 10;
-        string_length += 1;
+int
+zvector_parse (const char *clock_string, size_t size, zvector_entry_t *own,
+               zvector_entry_t *entries, size_t entries_max)
+{
+    assert (clock_string);
+    assert (own);
+    //  Delimiters are found with memchr, which libc scans word or vector
+    //  wise
+    const char *end = (const char *) memchr (clock_string, '/', size);
+    if (!end)
+        end = clock_string + size;
+    const char *null = (const char *) memchr (clock_string, 0, end - clock_string);
+    if (null)
+        end = null;
+
+    //  formation: 'VC:$numberOfClocks;own:$ownPid;$pid1,$val1;...;$pidx,$valx;'
+    unsigned long count;
+    const char *needle = clock_string;
+    if (end - needle < 3 || memcmp (needle, "VC:", 3) != 0)
+        return -1;
+    needle = s_parse_value (needle + 3, end, &count);
+    if (!needle || count > INT_MAX || end - needle < 5 || memcmp (needle, ";own:", 5) != 0)
+        return -1;
+    needle += 5;
+    const char *separator = (const char *) memchr (needle, ';', end - needle);
+    if (!separator || separator == needle)
+        return -1;
+    own->pid = needle;
+    own->pid_size = separator - needle;
+    own->value = 0;
+    needle = separator + 1;
+
+    size_t entry = 0;
+    while (needle < end) {
+        separator = (const char *) memchr (needle, ';', end - needle);
+        if (!separator)
+            return -1;
+        //  The value follows the last comma
+        const char *comma = separator - 1;
+        while (comma > needle && *comma != ',')
+            comma--;
+        unsigned long value;
+        if (comma == needle || s_parse_value (comma + 1, separator, &value) != separator)
+            return -1;
+        if (entry < entries_max) {
+            entries [entry].pid = needle;
+            entries [entry].pid_size = comma - needle;
+            entries [entry].value = value;
+        }
+        if ((size_t) (comma - needle) == own->pid_size
+        &&  memcmp (needle, own->pid, own->pid_size) == 0)
+            own->value = value;
+        entry++;
+        needle = separator + 1;
     }
+    return entry == count? (int) entry: -1;
+}
 
-    value = (unsigned long *) zhashx_next (self->clock);
-    pid = (const char*) zhashx_cursor (self->clock);
-
-    if (value)
-      tmp_val_length = *value;
-  }
-
-  result = (char *) zmalloc (string_length * sizeof (char));
-
-  // fill up string
-  value = (unsigned long *) zhashx_first (self->clock);
-  pid = (const char *) zhashx_cursor (self->clock);
-  char tmp_string[11]; // max digits of an unsigned long value
-  tmp_string[10] = '\0';
 
-  sprintf(result, "VC:%d;", vector_size);
-  strcat(result, "own:");
-  strncat(result, self->own_pid, pid_length);
-  strcat(result, ";");
-  while (value) {
-    strncat (result, pid, pid_length);
-    strcat (result, ",");
-    sprintf(tmp_string, "%lu", *value);
-    strcat (result, tmp_string);
-    strcat (result, ";");
+//  --------------------------------------------------------------------------
+//  Creates a zvector from a given string representation. Returns NULL if
+//  the string is malformed.
 
-    value = (unsigned long *) zhashx_next (self->clock);
-    pid = (const char *) zhashx_cursor (self->clock);
-  }
+zvector_t *
+zvector_from_string (char *clock_string)
+{
+    assert (clock_string);
+    zvector_entry_t own;
+    zvector_entry_t entries_buffer [ZVECTOR_PARSE_ENTRIES];
+    zvector_entry_t *entries = entries_buffer;
+    size_t size = strlen (clock_string);
+    int count = zvector_parse (clock_string, size, &own, entries, ZVECTOR_PARSE_ENTRIES);
+    if (count < 0)
+        return NULL;
+    if (count > ZVECTOR_PARSE_ENTRIES) {
+        entries = (zvector_entry_t *) malloc (count * sizeof (zvector_entry_t));
+        assert (entries);
+        zvector_parse (clock_string, size, &own, entries, count);
+    }
 
-  return result;
+    char buffer [256];
+    char *pid = s_pid_copy (&own, buffer, sizeof (buffer), NULL);
+    zvector_t *self = zvector_new (pid);
+    s_pid_free (&pid, buffer, NULL);
+    zhashx_purge (self->clock);
+    int index;
+    for (index = 0; index < count; index++) {
+        pid = s_pid_copy (&entries [index], buffer, sizeof (buffer), NULL);
+        unsigned long *clock_value = (unsigned long *) zmalloc (sizeof (unsigned long));
+        *clock_value = entries [index].value;
+        zhashx_update (self->clock, pid, clock_value);
+        s_pid_free (&pid, buffer, NULL);
+    }
+    if (entries != entries_buffer)
+        free (entries);
+    return self;
 }
 
 
 //  --------------------------------------------------------------------------
-//  Creates a zvector from a given string representation
+//  Compares two clocks in string representation like zvector_compare_to,
+//  without creating them. The clocks end at a null or a '/'. Returns -2 if
+//  one of them is malformed.
 
-zvector_t *
-zvector_from_string (char *clock_string)
+int
+zvector_compare_strings (const char *clock_a, const char *clock_b)
 {
-    assert (clock_string);
-    assert (clock_string[0] == 'V');
-    assert (clock_string[1] == 'C');
-    assert (clock_string[strlen (clock_string)-1] == ';');
-
-    //formation: 'VC:$numberOfClocks;own:$ownPid;$pid1,$val1;...;$pidx,$valx;\0'
-    unsigned long vc_count = 0;
-    zvector_t *ret = NULL;
-
-    int state = 0;
-    char *needle, *pid = NULL, *beginWord = NULL;
-    size_t len = strlen (clock_string);
-    needle = (char *) clock_string;
-    char *needle_stop = needle + len;
-    beginWord = needle;
-
-    while (needle < needle_stop + 1) {
-        if (*needle == ':') {
-            char *word = strndup (beginWord, needle - beginWord);
-            beginWord = needle + 1;
-            if (streq (word, "VC"))
-                state = 1;
-            else
-            if (streq (word, "own"))
-                state = 2;
-            else
-                assert (false);
-
-            zstr_free (&word);
-        }
-        else
-        if (*needle == ',') {
-            pid = strndup (beginWord, needle - beginWord);
-            beginWord = needle + 1;
-            state = 3;
-        }
-        else
-        if (*needle == ';') {
-            assert (state != 0);
-            char *word = strndup (beginWord, needle - beginWord);
-            if (state == 1)
-                vc_count = strtoul (word, NULL, 10);
-            else
-            if (state == 2) {
-                ret = zvector_new (word);
-                zhashx_purge (ret->clock);
-            }
-            else
-            if (state == 3) {
-                unsigned long *clock_value = (unsigned long *) zmalloc (sizeof (unsigned long));
-                *clock_value = strtoul(word, NULL, 10);
-                zhashx_insert (ret->clock, pid, clock_value);
-                zstr_free (&pid);
-            }
-            beginWord = needle + 1;
-            state = 0;
-            zstr_free (&word);
-        }
-        needle++;
+    assert (clock_a);
+    assert (clock_b);
+    zvector_entry_t own_a, own_b;
+    zvector_entry_t buffer_a [ZVECTOR_PARSE_ENTRIES];
+    zvector_entry_t buffer_b [ZVECTOR_PARSE_ENTRIES];
+    zvector_entry_t *entries_a = buffer_a;
+    zvector_entry_t *entries_b = buffer_b;
+    size_t size_a = strlen (clock_a);
+    size_t size_b = strlen (clock_b);
+    int count_a = zvector_parse (clock_a, size_a, &own_a, entries_a, ZVECTOR_PARSE_ENTRIES);
+    int count_b = zvector_parse (clock_b, size_b, &own_b, entries_b, ZVECTOR_PARSE_ENTRIES);
+    if (count_a < 0 || count_b < 0)
+        return -2;
+    if (count_a > ZVECTOR_PARSE_ENTRIES) {
+        entries_a = (zvector_entry_t *) malloc (count_a * sizeof (zvector_entry_t));
+        assert (entries_a);
+        zvector_parse (clock_a, size_a, &own_a, entries_a, count_a);
+    }
+    if (count_b > ZVECTOR_PARSE_ENTRIES) {
+        entries_b = (zvector_entry_t *) malloc (count_b * sizeof (zvector_entry_t));
+        assert (entries_b);
+        zvector_parse (clock_b, size_b, &own_b, entries_b, count_b);
+    }
+
+    //  a => b
+    int result = 0;
+    zvector_entry_t *value_a = s_entries_lookup (entries_a, count_a, own_a.pid, own_a.pid_size);
+    zvector_entry_t *value_b = s_entries_lookup (entries_b, count_b, own_a.pid, own_a.pid_size);
+    if (value_a && value_b && value_a->value <= value_b->value)
+        result = -1;
+    else {
+        //  b => a
+        value_a = s_entries_lookup (entries_a, count_a, own_b.pid, own_b.pid_size);
+        value_b = s_entries_lookup (entries_b, count_b, own_b.pid, own_b.pid_size);
+        if (value_a && value_b && value_b->value <= value_a->value)
+            result = 1;
     }
-    assert (vc_count == zhashx_size (ret->clock));
 
-    return ret;
+    if (entries_a != buffer_a)
+        free (entries_a);
+    if (entries_b != buffer_b)
+        free (entries_b);
+    return result;
 }
 
 
@@ -432,14 +734,16 @@ zvector_info (zvector_t *self, char *format, ...)
     va_start (argptr, format);
     char *logmsg = zsys_vprintf (format, argptr);
     va_end (argptr);
-    char *clockstr = zvector_to_string (self);
-    zsys_info ("/%s/ %s", clockstr, logmsg);
+    size_t size;
+    char *clockstr = self->direct? s_zvector_format_direct (self, self->arena): NULL;
+    zsys_info ("/%s/ %s", clockstr? clockstr: s_zvector_serialized (self, &size), logmsg);
 
     zvector_event (self);
-    char *state = zvector_to_string_short (self, 3);
-    zhash_insert (self->space_time_states_label, state, logmsg);
-    zstr_free (&state);
-    zstr_free (&clockstr);
+    space_time_label_t *label = (space_time_label_t *) s_array_append (
+        (void **) &self->labels, &self->labels_size, &self->labels_max, sizeof (space_time_label_t));
+    label->counter = self->states [self->states_size - 1];
+    label->label = logmsg;
+    s_str_free (self->arena, &clockstr);
 }
 
 void
@@ -449,57 +753,109 @@ zvector_dump_time_space (zvector_t *self)
     char *filename = zsys_sprintf ("%s.sdot", self->own_pid);
     FILE *file_dst = fopen(filename, "w");
     assert (file_dst);
-    const char newLineSymbol = '\n';
-    const char *line;
-
-    char *subgraph_string = zsys_sprintf ("    subgraph cluster_%s {\n" \
-                                          "        label = \"P#%s\";\n" \
-                                          "        color = blue;\n",
-                                          self->own_pid,
-                                          self->own_pid);
-    fwrite (subgraph_string, 1, strlen (subgraph_string), file_dst);
-    zstr_free (&subgraph_string);
-
-    const char * label = (const char *) zhash_first (self->space_time_states_label);
-    line = (const char *) zhash_cursor (self->space_time_states_label);
-    size_t index;
-    for (index = 0; index < zhash_size (self->space_time_states_label); index++) {
-        if (label) {
-            fwrite ("        \"", 1, 9, file_dst);
-            fwrite (line, 1, strlen (line), file_dst);
-            fwrite ("\"[style=filled, fillcolor=aquamarine label=\"", 1, 44, file_dst);
-            fwrite (label, 1, strlen (label) - 1, file_dst);
-            fwrite ("\"];\n", 1, 4, file_dst);
-        }
-        label = (const char *) zhash_next (self->space_time_states_label);
-        line = (const char *) zhash_cursor (self->space_time_states_label);
-    }
 
-    fwrite ("        ", 1, 8, file_dst);
-    line = (const char *) zlist_first (self->space_time_states);
-    while (line) {
-        fwrite ("\"", 1, 1, file_dst);
-        fwrite (line, 1, strlen (line), file_dst);
-        fwrite ("\"", 1, 1, file_dst);
-        line = (const char *) zlist_next (self->space_time_states);
-        if (line)
-            fwrite (" -> ", 1, 4, file_dst);
+    //  Node names are globally unique, so the dumps of all processes can be
+    //  concatenated into one graph
+    fprintf (file_dst, "    subgraph cluster_%s {\n"
+                       "        label = \"P#%s\";\n"
+                       "        color = blue;\n",
+                       self->own_pid, self->own_pid);
+    size_t index;
+    for (index = 0; index < self->states_size; index++)
+        fprintf (file_dst, "        \"%s:%lu\"[label=\"%lu\"];\n",
+                 self->own_pid, self->states [index], self->states [index]);
+    for (index = 0; index < self->labels_size; index++) {
+        const char *label = self->labels [index].label;
+        size_t length = strlen (label);
+        if (length > 0 && label [length - 1] == '\n')
+            length--;
+        fprintf (file_dst, "        \"%s:%lu\"[style=filled, fillcolor=aquamarine label=\"%.*s\"];\n",
+                 self->own_pid, self->labels [index].counter, (int) length, label);
     }
 
-    fwrite (";\n}\n", 1, 4, file_dst);
+    fprintf (file_dst, "        ");
+    for (index = 0; index < self->states_size; index++)
+        fprintf (file_dst, "%s\"%s:%lu\"", index? " -> ": "", self->own_pid, self->states [index]);
+    fprintf (file_dst, ";\n}\n");
 
-    line = (const char *) zlist_first (self->space_time_events);
-    while (line != NULL) {
-        fwrite (line, 1, strlen (line), file_dst);
-        fwrite (";", 1, 1, file_dst);
-        fwrite (&newLineSymbol, 1, 1, file_dst);
-        line = (const char *) zlist_next (self->space_time_events);
+    for (index = 0; index < self->events_size; index++) {
+        space_time_event_t *event = &self->events [index];
+        fprintf (file_dst, "\"%s:%lu\" -> \"%s:%lu\";\n",
+                 self->pid_names [event->sender], event->sender_counter,
+                 self->own_pid, event->counter);
     }
     fclose (file_dst);
     zstr_free (&filename);
 }
 
 
+//  --------------------------------------------------------------------------
+//  Returns the clock value of pid, 0 if pid is unknown
+
+unsigned long
+zvector_value (zvector_t *self, const char *pid)
+{
+    assert (self);
+    assert (pid);
+    unsigned long *value = (unsigned long *) zhashx_lookup (self->clock, pid);
+    return value? *value: 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns the number of pids in the clock
+
+size_t
+zvector_size (zvector_t *self)
+{
+    assert (self);
+    return zhashx_size (self->clock);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Returns a number which changes whenever the value of a pid other than
+//  the own one changes. While it stays the same, the clock only differs in
+//  the own value.
+
+uint64_t
+zvector_generation (zvector_t *self)
+{
+    assert (self);
+    return self->generation;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Removes a departed pid from the clock. Values up to final received later
+//  are ignored, so messages still in flight don't add it again. Call it
+//  once every live process has seen the final value of pid. The own pid
+//  can't be pruned.
+
+void
+zvector_prune (zvector_t *self, const char *pid, unsigned long final)
+{
+    assert (self);
+    assert (pid);
+    if (streq (pid, self->own_pid))
+        return;
+    unsigned long value = zvector_value (self, pid);
+    zhashx_delete (self->clock, pid);
+    self->cache_valid = false;
+    self->generation++;
+
+    if (!self->retired) {
+        self->retired = zhashx_new ();
+        zhashx_set_destructor (self->retired, s_destroy_clock_value);
+    }
+    if (zhashx_size (self->retired) >= ZVECTOR_RETIRED_MAX)
+        zhashx_purge (self->retired);
+    unsigned long *retired = (unsigned long *) zmalloc (sizeof (unsigned long));
+    *retired = value > final? value: final;
+    zhashx_update (self->retired, pid, retired);
+}
+
+
 //  --------------------------------------------------------------------------
 //  Duplicates the given zvector, returns a freshly allocated dulpicate.
 
@@ -514,7 +870,9 @@ zvector_dup (zvector_t *self)
     unsigned long *value = (unsigned long *) zhashx_first (self->clock);
     const char *pid = (const char *) zhashx_cursor (self->clock);
     while (value) {
-      zhashx_insert (dup->clock, pid, value);
+      unsigned long *dup_value = (unsigned long *) zmalloc (sizeof (unsigned long));
+      *dup_value = *value;
+      zhashx_insert (dup->clock, pid, dup_value);
       value = (unsigned long *) zhashx_next (self->clock);
       pid = (const char *) zhashx_cursor (self->clock);
     }
@@ -576,7 +934,7 @@ zvector_test (bool verbose)
     zhashx_insert (test2_self->clock, "1002", test2_inserted_value2);
 
     char *test2_string = zvector_to_string (test2_self);
-    assert (streq (test2_string, "VC:3;own:1000;1001,7;1000,1;1002,11;"));
+    assert (streq (test2_string, "VC:3;own:1000;1001,7;1002,11;1000,1;"));
 
     zvector_t *test2_generated = zvector_from_string (test2_string);
     assert ( *(unsigned long *) zhashx_lookup (test2_generated->clock, "1000") == 1 );
@@ -697,6 +1055,197 @@ zvector_test (bool verbose)
     zvector_destroy (&test6_after1);
     zvector_destroy (&test6_after2);
 
+    //  TEST: dup owns its clock values
+    zvector_t *test7_self = zvector_new ("1000");
+    zvector_event (test7_self);
+    zvector_t *test7_dup = zvector_dup (test7_self);
+    zvector_event (test7_self);
+    assert (zvector_compare_to (test7_dup, test7_self) == -1);
+    zvector_destroy (&test7_self);
+    char *test7_stringrep = zvector_to_string (test7_dup);
+    assert (streq (test7_stringrep, "VC:1;own:1000;1000,1;"));
+    zstr_free (&test7_stringrep);
+    zvector_destroy (&test7_dup);
+
+    //  TEST: recv with transient strings from an arena
+    zarena_t *test8_arena = zarena_new (0);
+    zvector_t *test8_self = zvector_new ("1000");
+    zvector_set_arena (test8_self, test8_arena);
+    zmsg_t *test8_msg = zmsg_new ();
+    zmsg_pushstr (test8_msg, "VC:2;own:1001;1000,5;1001,10;");
+    zvector_recv (test8_self, test8_msg);
+    zmsg_destroy (&test8_msg);
+    //  The clock is parsed in place, short pids need no transient strings
+    assert (zarena_used (test8_arena) == 0);
+    zarena_reset (test8_arena);
+    assert ( *(unsigned long *) zhashx_lookup (test8_self->clock, "1000") == 5 );
+    assert ( *(unsigned long *) zhashx_lookup (test8_self->clock, "1001") == 10 );
+    char *test8_stringrep = zvector_to_string_short (test8_self, 2);
+    assert (streq (test8_stringrep, "VC:2;own:10;10,5;10,10;")
+        ||  streq (test8_stringrep, "VC:2;own:10;10,10;10,5;"));
+    zstr_free (&test8_stringrep);
+    zvector_destroy (&test8_self);
+    zarena_destroy (&test8_arena);
+
+    //  TEST: space-time dump names states by pid and own counter
+    zvector_t *test9_self = zvector_new ("1000");
+    zvector_info (test9_self, "%s", "hello\n");
+    zmsg_t *test9_msg = zmsg_new ();
+    zmsg_pushstr (test9_msg, "VC:2;own:1001;1000,1;1001,10;");
+    zvector_recv (test9_self, test9_msg);
+    zmsg_destroy (&test9_msg);
+    zvector_dump_time_space (test9_self);
+    zvector_destroy (&test9_self);
+
+    zfile_t *test9_file = zfile_new (NULL, "1000.sdot");
+    int test9_rc = zfile_input (test9_file);
+    assert (test9_rc == 0);
+    bool test9_label = false;
+    bool test9_chain = false;
+    bool test9_event = false;
+    const char *test9_line = zfile_readln (test9_file);
+    while (test9_line) {
+        if (streq (test9_line, "        \"1000:1\"[style=filled, fillcolor=aquamarine label=\"hello\"];"))
+            test9_label = true;
+        if (streq (test9_line, "        \"1000:1\" -> \"1000:2\";"))
+            test9_chain = true;
+        if (streq (test9_line, "\"1001:10\" -> \"1000:2\";"))
+            test9_event = true;
+        test9_line = zfile_readln (test9_file);
+    }
+    assert (test9_label && test9_chain && test9_event);
+    zfile_destroy (&test9_file);
+    zsys_file_delete ("1000.sdot");
+
+    //  TEST: pruning of departed pids
+    zvector_t *test10_self = zvector_new ("1000");
+    zmsg_t *test10_msg = zmsg_new ();
+    zmsg_pushstr (test10_msg, "VC:3;own:1001;1001,4;1002,7;1003,2;");
+    zvector_recv (test10_self, test10_msg);
+    assert (zvector_size (test10_self) == 4);
+    assert (zvector_value (test10_self, "1002") == 7);
+
+    zvector_prune (test10_self, "1002", 9);
+    zvector_prune (test10_self, "1000", 0);
+    assert (zvector_size (test10_self) == 3);
+    assert (zvector_value (test10_self, "1002") == 0);
+    assert (zvector_value (test10_self, "1000") == 1);
+
+    //  Stale values in flight don't add the pid again
+    zmsg_pushstr (test10_msg, "VC:2;own:1003;1003,5;1002,9;");
+    zvector_recv (test10_self, test10_msg);
+    assert (zvector_size (test10_self) == 3);
+    assert (zvector_value (test10_self, "1003") == 5);
+    char *test10_string = zvector_to_string (test10_self);
+    assert (!strstr (test10_string, "1002"));
+    zstr_free (&test10_string);
+    zmsg_destroy (&test10_msg);
+    zvector_destroy (&test10_self);
+
+    //  test11: direct dependencies have a constant size on the wire
+    zvector_t *test11_sender = zvector_new ("1001");
+    zvector_t *test11_self = zvector_new ("1000");
+    zvector_set_direct (test11_sender, true);
+    zvector_set_direct (test11_self, true);
+    zvector_event (test11_sender);
+    zmsg_t *test11_msg = zmsg_new ();
+    zvector_send_prepare (test11_sender, test11_msg);
+    char *test11_string = zmsg_popstr (test11_msg);
+    assert (streq (test11_string, "DD:1001,2;"));
+    zmsg_pushstr (test11_msg, test11_string);
+    zstr_free (&test11_string);
+    zvector_recv (test11_self, test11_msg);
+    assert (zvector_size (test11_self) == 1);
+    assert (zvector_value (test11_self, "1000") == 1);
+
+    //  Records list the messages received since the previous record
+    test11_string = s_zvector_format_direct (test11_self, NULL);
+    assert (streq (test11_string, "DD:own:1000,1;1001,2,1;"));
+    zstr_free (&test11_string);
+    zvector_event (test11_self);
+    test11_string = s_zvector_format_direct (test11_self, NULL);
+    assert (streq (test11_string, "DD:own:1000,2;"));
+    zstr_free (&test11_string);
+    zmsg_destroy (&test11_msg);
+    zvector_destroy (&test11_self);
+    zvector_destroy (&test11_sender);
+
+    //  test12: parsing in place validates instead of asserting
+    zvector_entry_t test12_own;
+    zvector_entry_t test12_entries [2];
+    const char *test12_line = "VC:3;own:1001;1000,4;1001,7;1002,1;/ message";
+    assert (zvector_parse (test12_line, strlen (test12_line), &test12_own, test12_entries, 2) == 3);
+    assert (test12_own.pid_size == 4 && memcmp (test12_own.pid, "1001", 4) == 0);
+    assert (test12_own.value == 7);
+    assert (test12_entries [0].value == 4 && test12_entries [1].value == 7);
+    assert (zvector_parse ("VC:0;own:1000;", 14, &test12_own, NULL, 0) == 0);
+    assert (zvector_parse ("VC:1;own:1000;1000,1;", 12, &test12_own, NULL, 0) == -1);
+    const char *test12_malformed [] = {
+        "", "VC:", "VC:x;own:1000;", "VC:1;own:1000;1000,1", "VC:1;own:;1000,1;",
+        "VC:2;own:1000;1000,1;", "VC:1;own:1000;1000;", "VC:1;own:1000;,1;",
+        "VC:1;own:1000;1000,;", "VC:1;own:1000;1000,1x;", "VC:1;own:1000;1000,99999999999999999999999;",
+        "VC:1;pid:1000;1000,1;", NULL
+    };
+    int test12_index;
+    for (test12_index = 0; test12_malformed [test12_index]; test12_index++) {
+        char *test12_string = strdup (test12_malformed [test12_index]);
+        assert (zvector_parse (test12_string, strlen (test12_string), &test12_own, test12_entries, 2) == -1);
+        assert (zvector_from_string (test12_string) == NULL);
+        zstr_free (&test12_string);
+    }
+
+    //  Received malformed clocks count as local event
+    zvector_t *test12_self = zvector_new ("1000");
+    zmsg_t *test12_msg = zmsg_new ();
+    zmsg_pushstr (test12_msg, "VC:2;own:1001;1001,3;");
+    zvector_recv (test12_self, test12_msg);
+    assert (zvector_size (test12_self) == 1);
+    assert (zvector_value (test12_self, "1000") == 1);
+
+    //  Comparing strings agrees with comparing clocks
+    char *test12_a = strdup ("VC:2;own:1000;1000,2;1001,1;");
+    char *test12_b = strdup ("VC:2;own:1001;1000,2;1001,3;/ b");
+    char *test12_c = strdup ("VC:1;own:1002;1002,1;");
+    assert (zvector_compare_strings (test12_a, test12_b) == -1);
+    assert (zvector_compare_strings (test12_b, test12_a) == 1);
+    assert (zvector_compare_strings (test12_a, test12_c) == 0);
+    assert (zvector_compare_strings (test12_a, "VC:1;") == -2);
+    zvector_t *test12_clock_a = zvector_from_string (test12_a);
+    test12_b [strlen (test12_b) - 3] = 0;
+    zvector_t *test12_clock_b = zvector_from_string (test12_b);
+    assert (zvector_compare_to (test12_clock_a, test12_clock_b) == -1);
+    zvector_destroy (&test12_clock_a);
+    zvector_destroy (&test12_clock_b);
+    zstr_free (&test12_a);
+    zstr_free (&test12_b);
+    zstr_free (&test12_c);
+    zmsg_destroy (&test12_msg);
+    zvector_destroy (&test12_self);
+
+    //  test13: the serialized clock is patched on own events and rebuilt
+    //  when other pids change
+    zvector_t *test13_self = zvector_new ("1000");
+    zmsg_t *test13_msg = zmsg_new ();
+    zmsg_pushstr (test13_msg, "VC:2;own:1001;1001,9;1002,3;");
+    zvector_recv (test13_self, test13_msg);
+    char *test13_string = zvector_to_string (test13_self);
+    assert (strstr (test13_string, ";1000,1;") == test13_string + strlen (test13_string) - 8);
+    zstr_free (&test13_string);
+    int test13_index;
+    for (test13_index = 0; test13_index < 9; test13_index++)
+        zvector_event (test13_self);
+    zvector_send_prepare (test13_self, test13_msg);
+    assert (zframe_size (zmsg_first (test13_msg)) == strlen ("VC:3;own:1000;1001,9;1002,3;1000,11;"));
+    test13_string = zmsg_popstr (test13_msg);
+    assert (strstr (test13_string, ";1001,9;") && strstr (test13_string, ";1002,3;"));
+    assert (strstr (test13_string, ";1000,11;"));
+    zstr_free (&test13_string);
+    zvector_prune (test13_self, "1002", 3);
+    test13_string = zvector_to_string (test13_self);
+    assert (streq (test13_string, "VC:2;own:1000;1001,9;1000,11;"));
+    zstr_free (&test13_string);
+    zmsg_destroy (&test13_msg);
+    zvector_destroy (&test13_self);
 
     //  @end
     printf ("OK\n");